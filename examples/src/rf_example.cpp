@@ -39,6 +39,9 @@ rf::context_descriptor MakeCtxtDesc()
 	desc.FOV = 45.f;
 	desc.NearPlane = 0.1f;
 	desc.FarPlane = 1000.f;
+	desc.HotReload = true;
+	desc.MipFilter = rf::MIP_KAISER;
+	desc.MipCache = true;
 	memcpy(desc.ExecutableName, ExeName, MAX_PATH);
 
 	return desc;
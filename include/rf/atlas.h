@@ -0,0 +1,48 @@
+#ifndef RF_ATLAS_H
+#define RF_ATLAS_H
+
+#include "rf_common.h"
+
+namespace rf {
+struct atlas_skyline_node
+{
+    uint32  X;
+    uint32  Y;
+    uint32  Width;
+};
+
+/// Skyline rectangle packer (bottom-left heuristic) : the top edge of the packed area is kept as a list of horizontal
+/// segments, each rect is put where its top ends the lowest. Good occupancy on glyph-like sets of small rects, and
+/// rects can be added over time (e.g. new fonts in a shared atlas).
+/// Padding empty texels are kept between the rects and around the atlas border, so that bilinear filtering (or the
+/// spread of distance fields) doesn't bleed between neighbours.
+struct atlas_packer
+{
+    uint32              Width;
+    uint32              Height;     // can be increased with atlas::Grow, the packed rects stay where they are
+    uint32              Padding;
+    uint32              UsedHeight; // bottom of the lowest packed rect, padding included
+    atlas_skyline_node  *Nodes;     // malloc'ed, at most Width nodes
+    uint32              NodeCount;
+};
+
+namespace atlas {
+    void    Init(atlas_packer *Packer, uint32 Width, uint32 Height, uint32 Padding);
+    void    Free(atlas_packer *Packer);
+    /// Forgets every packed rect
+    void    Reset(atlas_packer *Packer);
+    /// Extends the packing area down to NewHeight (larger than the current one)
+    void    Grow(atlas_packer *Packer, uint32 NewHeight);
+
+    /// Finds a place for a Width x Height rect, returned in X, Y (its top-left texel, padding excluded).
+    /// Returns false if it doesn't fit. Empty rects aren't packed, and are returned at 0, 0.
+    bool    Pack(atlas_packer *Packer, uint32 Width, uint32 Height, uint32 *X, uint32 *Y);
+
+    /// Packs Count rects in the smallest atlas that holds them, tallest rects first. The atlas width is a power of two
+    /// (at most MaxSize), and so is its height if PowerOfTwo, otherwise the height is trimmed to the packed rects.
+    /// Returns false if they don't fit in MaxSize x MaxSize.
+    bool    PackAll(uint32 const *Widths, uint32 const *Heights, uint32 Count, uint32 Padding, bool PowerOfTwo,
+                uint32 MaxSize, uint32 *X, uint32 *Y, uint32 *AtlasWidth, uint32 *AtlasHeight);
+}
+}
+#endif
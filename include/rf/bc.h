@@ -0,0 +1,66 @@
+#ifndef RF_BC_H
+#define RF_BC_H
+
+#include "rf_common.h"
+
+namespace rf {
+enum bc_format
+{
+    BC_NONE,
+    BC1,        // RGB + 1-bit alpha, 4 bpp
+    BC3,        // RGBA, 8 bpp
+    BC4,        // R, 4 bpp
+    BC5,        // RG, 8 bpp (normal maps)
+    BC7         // RGBA, 8 bpp, higher quality than BC1/BC3
+};
+
+#define BC_MAX_MIPS 16
+
+/// Block-compressed texture and its mip chain (level 0 first), as parsed from a DDS/KTX2 file or built by the encoder.
+/// Parsed textures point in the file data, encoded ones in Allocated (to free with bc::FreeTexture).
+struct compressed_texture
+{
+    bc_format   Format;
+    bool        SRGB;
+    uint32      Width;
+    uint32      Height;
+    uint32      MipCount;
+    uint8 const *Mips[BC_MAX_MIPS];
+    uint64      MipSizes[BC_MAX_MIPS];
+    uint8       *Allocated;
+};
+
+/// CPU encoder of the BCn block-compressed formats, and DDS/KTX2 containers for them.
+/// The encoder is meant for import or cache-build time : blocks are encoded in parallel in the jobs worker threads,
+/// the inner loops use SSE2.
+/// BC7 blocks are encoded with mode 6 only (single subset, RGBA endpoints, 4-bit indices) : fast and good on smooth
+/// content, not as good as a partition-searching encoder on blocks mixing several distinct colors.
+namespace bc {
+    /// Size in bytes of a 4x4 block
+    uint32  BlockBytes(bc_format Format);
+    uint64  MipSize(bc_format Format, uint32 Width, uint32 Height);
+    /// GL internal format to give to glCompressedTexImage2D, 0 if unknown
+    uint32  GLFormat(bc_format Format, bool SRGB);
+
+    /// Encodes one 4x4 block of RGBA8 pixels (row major). BC4 encodes the red channel, BC5 red and green.
+    void    EncodeBlock(bc_format Format, uint8 const *Pixels, uint8 *Dst);
+
+    /// Encodes a whole RGBA8 image in Dst (MipSize(Format, Width, Height) bytes). Partial blocks on the right and bottom
+    /// edges are padded with the edge pixels.
+    void    Encode(bc_format Format, uint8 const *RGBA, uint32 Width, uint32 Height, uint8 *Dst);
+
+    /// Encodes an RGBA8 image and, if MakeMips, its whole mip chain (see mip.h, Kaiser filter, in linear space when SRGB)
+    bool    EncodeTexture(compressed_texture *Texture, bc_format Format, bool SRGB, uint8 const *RGBA, uint32 Width,
+                uint32 Height, bool MakeMips);
+    void    FreeTexture(compressed_texture *Texture);
+
+    /// Parses a DDS (DX10 header or DXT1/DXT5/ATI1/ATI2 FourCC) or KTX2 (without supercompression) file in memory.
+    /// The texture points in Data, which must stay valid while it is used.
+    bool    ParseDDS(compressed_texture *Texture, uint8 const *Data, uint64 Size);
+    bool    ParseKTX2(compressed_texture *Texture, uint8 const *Data, uint64 Size);
+
+    /// Writes the texture as a DDS file with a DX10 header
+    bool    WriteDDS(path const Filename, compressed_texture const *Texture);
+}
+}
+#endif
@@ -25,6 +25,10 @@ struct context_descriptor
     real32		NearPlane, FarPlane;
     path		ExecutableName;
 	int32		AALevel;
+    bool		HotReload;					// reload textures, fonts, shaders and UI theme when modified on disk (Linux only)
+    int32		WorkerThreads;				// background job threads (asset I/O...), 0 : one per logical core minus one, <0 : none
+    mip_filter	MipFilter;					// filter of the mip chains generated for the loaded textures
+    bool		MipCache;					// store the generated mip chains in <executable path>/cache/, reused by the next runs
 };
 
 struct context
@@ -0,0 +1,23 @@
+#ifndef RF_CONVERT_H
+#define RF_CONVERT_H
+
+#include "rf_common.h"
+
+namespace rf {
+/// Pixel format conversions done before texture uploads, so that the driver receives the data in a format it stores
+/// as-is (no conversion on the calling thread) and fewer bytes are transferred.
+/// Each conversion picks the best path the CPU supports (see simd.h), with a scalar fallback giving the same results.
+namespace convert {
+    /// RGB8 to RGBA8 with an opaque alpha. Dst rows are then 4-byte aligned whatever the width.
+    void    RGB8ToRGBA8(uint8 const *Src, uint8 *Dst, uint64 PixelCount);
+
+    /// 32-bit floats to half floats (IEEE binary16, round to nearest even, overflows to infinity). Uses F16C.
+    void    FloatToHalf(real32 const *Src, uint16 *Dst, uint64 Count);
+
+    /// Packs float RGB pixels (Channels 3 or 4, the 4th one is dropped) to the shared exponent GL_RGB9_E5 format
+    /// (GL_UNSIGNED_INT_5_9_9_9_REV), as specified by EXT_texture_shared_exponent. Negative and NaN values become 0,
+    /// values are clamped to the largest representable one (65408).
+    void    FloatToRGB9E5(real32 const *Src, uint32 Channels, uint32 *Dst, uint64 PixelCount);
+}
+}
+#endif
@@ -0,0 +1,80 @@
+#ifndef RF_GLYPHCACHE_H
+#define RF_GLYPHCACHE_H
+
+#include "render.h"
+
+namespace rf {
+#define GLYPH_CACHE_MAX_FACES 64
+
+/// One square region of the glyph cache texture, packed independently and evicted as a whole
+struct glyph_cache_page
+{
+    atlas_packer    Packer;
+    uint32          X, Y;           // top-left texel of the page in the cache texture
+    uint64          LastUse;        // frame the page was last drawn from
+    uint32          Generation;     // incremented on eviction, the glyphs cached with an older one are stale
+    uint32          GlyphCount;
+};
+
+struct cached_glyph
+{
+    uint64          Key;            // face, pixel height and codepoint, 0 : empty slot
+    glyph           Glyph;
+    uint32          Page;
+    uint32          Generation;
+};
+
+/// On-demand glyph rasterization, for fonts whose codepoints can't all be baked up front (any UTF-8 text).
+/// The TTF files are parsed once into faces shared by every pixel height. Glyphs are rasterized the first time they are
+/// looked up, in pages of a single R8 texture : when every page is full, the least recently drawn page is cleared
+/// and reused (never a page drawn from in the current frame).
+/// The rasterized texels are uploaded once per frame by glyphcache::Flush, in one sub-upload of the area that changed.
+struct glyph_cache
+{
+    int32           Width;          // of the texture, a multiple of PageSize
+    int32           Height;
+    int32           PageSize;
+    uint8           *Buffer;        // malloc'ed CPU copy of the texture
+    uint32          TextureID;
+
+    glyph_cache_page *Pages;        // malloc'ed
+    uint32          PageCount;
+
+    cached_glyph    *Slots;         // malloc'ed open-addressing table, power of two size
+    uint32          SlotCount;
+    uint32          UsedSlots;      // stale glyphs included, they are dropped when the table grows
+
+    font_face       *Faces[GLYPH_CACHE_MAX_FACES];  // NULL for released faces, their index is part of the glyph keys
+    uint64          Frame;
+
+    // Area rasterized since the last flush, empty if X0 >= X1
+    int32           DirtyX0, DirtyY0, DirtyX1, DirtyY1;
+};
+
+namespace glyphcache {
+    /// Width and Height must be multiples of PageSize. The glyphs taller or wider than a page can't be cached.
+    void        Init(glyph_cache *Cache, int32 Width = 1024, int32 Height = 1024, int32 PageSize = 256);
+    /// Every face must have been released before
+    void        Destroy(glyph_cache *Cache);
+
+    /// Returns the face parsed from Filename, acquiring a reference on it, NULL if not parsed yet
+    font_face   *FindFace(glyph_cache *Cache, char const *Filename);
+    /// Parses the TTF file Contents (copied), and returns the face with a reference on it, NULL if not a valid font
+    font_face   *AddFace(glyph_cache *Cache, char const *Filename, void const *Contents, uint64 Size);
+    void        ReleaseFace(glyph_cache *Cache, font_face *Face);
+
+    /// Fills the vertical metrics of a font of the face (Ascent, LineGap, GlyphHeight, MaxGlyphWidth)
+    void        GetFontMetrics(font_face *Face, uint32 PixelHeight, font *Font);
+    /// Horizontal adjustment between two codepoints of the face, in pixels
+    real32      GetKerning(font_face *Face, uint32 PixelHeight, uint32 First, uint32 Second);
+
+    /// Returns the glyph of the codepoint, rasterizing it first if needed, NULL if it can't be cached this frame.
+    /// The pointer is only valid until the next call.
+    glyph const *Get(glyph_cache *Cache, font_face *Face, uint32 PixelHeight, uint32 Codepoint);
+
+    /// Uploads the glyphs rasterized since the last call, and starts a new frame. To be called once per frame,
+    /// before drawing the text laid out with the cache (ui::Draw does it).
+    void        Flush(glyph_cache *Cache);
+}
+}
+#endif
@@ -0,0 +1,47 @@
+#ifndef RF_IO_H
+#define RF_IO_H
+
+#include "rf_defs.h"
+
+namespace rf {
+/// One file of a batch read
+struct io_file
+{
+    char const  *Filename;
+    uint8       *Data;      // contents followed by a 0 byte (not counted in Size), NULL if the file couldn't be read
+    uint64      Size;
+    uint32      Index;      // position of the file in the array given to BatchRead
+};
+
+struct io_batch;
+
+/// Batched asynchronous file reads.
+/// All the reads of a batch are in flight at once (up to IO_BATCH_DEPTH files), so that loading many files isn't
+/// bound by the latency of each one. On Linux the reads go through io_uring, with a fallback on pread in the
+/// jobs worker threads when io_uring isn't available (old kernel, seccomp...). Other platforms always use the fallback.
+/// The io_uring instances are created once and reused by the next batches.
+/// Files found in the mounted packs are returned right away, like vfs::ReadFile.
+namespace io {
+#define IO_BATCH_DEPTH 64
+
+    /// Starts reading the given files. The receiving buffers are allocated from Pool, always on the calling thread,
+    /// so BatchNext and BatchFree must be called from the same thread as BatchRead.
+    /// Filenames must stay valid until BatchFree.
+    io_batch *BatchRead(context *Context, mem_pool *Pool, char const * const *Filenames, uint32 Count);
+
+    /// Returns the next read file, in completion order, blocking until one is available.
+    /// Returns NULL once every file of the batch was returned.
+    io_file *BatchNext(io_batch *Batch);
+
+    /// Waits for the reads still in flight and frees the batch. The returned io_files become invalid, the file
+    /// contents stay valid in their pool.
+    void BatchFree(io_batch *Batch);
+
+    /// Returns true if batches are read with io_uring
+    bool UsesIoUring();
+
+    /// Closes the io_uring instances kept between batches. No batch must be in flight.
+    void Destroy();
+}
+}
+#endif
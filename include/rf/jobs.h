@@ -0,0 +1,34 @@
+#ifndef RF_JOBS_H
+#define RF_JOBS_H
+
+#include "rf_common.h"
+
+namespace rf {
+typedef void (*job_func)(void *UserData);
+
+/// Counts the pending jobs submitted with it, so that a caller can wait for its own jobs only.
+/// Must be zero-initialized, and outlive its jobs.
+struct job_group
+{
+    uint32 Pending;
+};
+
+/// Worker thread pool for background work (file reads, texture processing...).
+/// Started by ctx::Init with context_descriptor::WorkerThreads.
+/// Jobs must not use the mem_pools nor the logger, which are not thread-safe : allocate on the submitting thread
+/// and report errors through the UserData.
+namespace jobs {
+    /// Starts WorkerCount threads. With 0 workers, jobs are run directly by Submit.
+    bool Init(uint32 WorkerCount);
+    /// Waits for the queued jobs and stops the workers
+    void Destroy();
+    uint32 WorkerCount();
+
+    /// Queues Func(UserData) for a worker. The group can be NULL for jobs that nobody waits for.
+    void Submit(job_group *Group, job_func Func, void *UserData);
+
+    /// Returns once every job of the group is done. The calling thread runs queued jobs in the meantime.
+    void Wait(job_group *Group);
+}
+}
+#endif
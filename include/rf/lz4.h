@@ -0,0 +1,23 @@
+#ifndef RF_LZ4_H
+#define RF_LZ4_H
+
+#include "rf_common.h"
+
+namespace rf {
+/// LZ4 block format codec (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md)
+/// Output is compatible with the reference LZ4_decompress_safe. The compressor is a simple greedy one,
+/// meant for offline packing : decompression speed matters more than the ratio here.
+namespace lz4 {
+    /// Max size of the compressed data for an input of SrcSize bytes
+    int32 CompressBound(int32 SrcSize);
+
+    /// Compresses Src in Dst and returns the compressed size.
+    /// Returns 0 if DstCapacity is smaller than CompressBound(SrcSize)
+    int32 Compress(uint8 const *Src, int32 SrcSize, uint8 *Dst, int32 DstCapacity);
+
+    /// Decompresses Src in Dst and returns the decompressed size.
+    /// Returns -1 if the data is malformed or doesn't fit in DstCapacity. Never reads or writes out of the given buffers.
+    int32 Decompress(uint8 const *Src, int32 SrcSize, uint8 *Dst, int32 DstCapacity);
+}
+}
+#endif
@@ -0,0 +1,57 @@
+#ifndef RF_MIP_H
+#define RF_MIP_H
+
+#include "rf_common.h"
+#include "utils.h"
+
+namespace rf {
+/// Downsampling filter used to build the mip levels
+enum mip_filter
+{
+    MIP_BOX,        // 2x2 average, what glGenerateMipmap does on most drivers
+    MIP_KAISER,     // Kaiser-windowed sinc (width 3, alpha 4) : sharp, little ringing
+    MIP_LANCZOS     // Lanczos 3 : sharpest, some ringing on hard edges
+};
+
+#define MIP_MAX_LEVELS 16
+
+/// Mip chain of an image, level 0 first. Levels have the channels and component type of the source image.
+/// Levels[0] is the source image itself, the others are allocated by the chain, or point in a mapped cache file.
+struct mip_chain
+{
+    uint32      Width;
+    uint32      Height;
+    uint32      Channels;
+    bool        IsFloat;
+    uint32      LevelCount;
+    void const  *Levels[MIP_MAX_LEVELS];
+    uint64      LevelSizes[MIP_MAX_LEVELS];
+    uint8       *Allocated;
+    file_view   CacheView;
+};
+
+/// CPU mip chain generation, so that textures are uploaded with their levels instead of relying on glGenerateMipmap.
+/// Each level is filtered from the previous one with separable polyphase filters (any size, odd ones too), rows
+/// clamped at the edges. The rows of a level are split in bands filtered in the jobs worker threads, the inner
+/// loops work on whole RGBA pixels with SSE2.
+/// sRGB images are filtered in linear space (the alpha channel is always linear).
+namespace mip {
+    /// Number of levels of the full chain, down to 1x1
+    uint32  LevelCount(uint32 Width, uint32 Height);
+
+    /// Generates the full chain of a uint8 or real32 image of 1 to 4 channels.
+    /// SRGB is only taken into account for the color channels of uint8 images of 3 or 4 channels.
+    bool    Generate(mip_chain *Chain, void const *Pixels, uint32 Width, uint32 Height, uint32 Channels, bool IsFloat,
+                bool SRGB, mip_filter Filter);
+
+    /// Same as Generate, looking up the chain in CacheDir first (keyed on the pixels and the generation
+    /// parameters), and storing it there when generated. Cached chains are mapped, not copied.
+    /// Without CacheDir (NULL or empty), this is just Generate.
+    /// Returns true if the chain was read from the cache in *CacheHit, if given.
+    bool    Build(mip_chain *Chain, char const *CacheDir, void const *Pixels, uint32 Width, uint32 Height,
+                uint32 Channels, bool IsFloat, bool SRGB, mip_filter Filter, bool *CacheHit = NULL);
+
+    void    Free(mip_chain *Chain);
+}
+}
+#endif
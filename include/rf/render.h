@@ -2,6 +2,10 @@
 #define RF_RENDER_H
 
 #include "rf_defs.h"
+#include "bc.h"
+#include "mip.h"
+#include "texarray.h"
+#include "atlas.h"
 #include "GL/glew.h"
 #include <map>
 
@@ -29,15 +33,27 @@ struct glyph
     //       x-----------> AdvX
     int X, Y;
     real32 TexX0, TexY0, TexX1, TexY1; // Absolute texcoords in Font Bitmap where the char is
+    int AtlasX, AtlasY; // Top-left texel of the char in the Font Bitmap
     int CW, CH;
     real32 AdvX;
 };
 
-// NOTE - Ascii-only
-// TODO - UTF
+/// Advance adjustment between two baked chars, in pixels
+struct glyph_kerning
+{
+    uint32 Pair;        // (First - Char0) << 16 | (Second - Char0)
+    real32 Advance;
+};
+
+struct font_atlas;
+struct font_face;
+struct glyph_cache;
+
+/// Glyphs are either baked for the [Char0, CharN) codepoints at load, or rasterized on first use in a glyph_cache
+/// (ResourceLoadDynamicFont). Use GetFontGlyph to look them up in both cases.
 struct font
 {
-    int Width;
+    int Width;      // of the atlas texture, the glyphs being packed tightly in it
     int Height;
     int LineGap;
     int Ascent;
@@ -46,8 +62,38 @@ struct font
     real32 MaxGlyphWidth;
     real32 GlyphHeight;
     uint32 AtlasTextureID;
-    uint8 *Buffer;
+    uint8 *Buffer;      // malloc'ed atlas, NULL when the glyphs are in a shared Atlas
     glyph *Glyphs;
+    font_atlas *Atlas;  // shared atlas the glyphs are packed in, NULL if the font has its own
+    glyph_cache *Cache; // dynamic fonts : where the glyphs are rasterized, Glyphs is NULL
+    font_face *Face;
+    uint32 PixelHeight;
+    int SDFSpread;      // SDF fonts : distance range encoded on each side of the glyph edges (atlas texels), 0 otherwise
+    font *Source;       // SDF fonts of a given height : the distance field font they scale, owning the atlas
+    glyph_kerning *Kerning; // malloc'ed, sorted by Pair, only the non-zero pairs
+    uint32 KerningCount;
+    uint32 GlyphRects[2];   // instanced text : texture buffer of the glyph rects (buffer, texture), see GetFontGlyphRects
+    bool GlyphRectsDirty;   // the glyphs changed since their rects were uploaded
+};
+
+/// Glyph atlas shared by several fonts, so that text in different fonts and sizes uses a single texture.
+/// Fonts are packed in it as they are loaded, the atlas growing in height (same texture name, the glyph texcoords
+/// of the fonts already in it being updated) up to MaxHeight. Once full, the glyphs of the fonts still in it are
+/// packed again, giving back the rects of the freed fonts (freed as soon as they are released) and those of the
+/// previous glyphs of hot-reloaded fonts.
+/// A few white texels are reserved in it, for untextured quads to be drawn with the atlas bound, in the same draws
+/// as the text.
+struct font_atlas
+{
+    atlas_packer    Packer;
+    uint8           *Buffer;        // malloc'ed, Width x Height R8
+    int32           Width;
+    int32           Height;
+    int32           MaxHeight;
+    int32           TextureHeight;  // height the texture storage was last specified with
+    uint32          TextureID;
+    font            **Fonts;        // Buf of the fonts packed in the atlas
+    uint32          WhiteX, WhiteY; // top-left of the white texels
 };
 
 struct display_text
@@ -75,6 +121,12 @@ struct material
     uint32 NormalTexture;
     uint32 EmissiveTexture;
 
+    // Set instead of the textures above when the model is loaded in a texture_array_pool
+    texture_layer AlbedoLayer;
+    texture_layer RoughnessMetallicLayer;
+    texture_layer NormalLayer;
+    texture_layer EmissiveLayer;
+
     vec3f AlbedoMult;
     vec3f EmissiveMult;
     float RoughnessMult;
@@ -107,6 +159,44 @@ enum render_resource_type
 
 typedef map_store resource_store;
 
+#define RESIDENCY_LOWMIP_SIZE 64
+
+// What is kept on the CPU side of a texture once uploaded
+enum texture_residency
+{
+    RESIDENCY_KEEP,         // the decoded image stays in the Images store
+    RESIDENCY_DISCARD,      // the decoded image is freed after upload (if not used by someone else)
+    RESIDENCY_LOWMIP        // only a copy downsampled to RESIDENCY_LOWMIP_SIZE is kept
+};
+
+// Bookkeeping of a stored resource. The resource stores map a resource name to its entry
+struct resource_entry
+{
+    render_resource_type Type;
+    void    *Resource;
+    path    Name;
+    int32   RefCount;       // evictable when 0
+    uint64  CPUBytes;
+    uint64  GPUBytes;
+    uint64  LastUse;        // RenderResources->UseTick at the last acquire
+    resource_entry *Parent; // entry this one holds a reference on (e.g. the source image of a texture)
+    void    *ReloadInfo;    // hot-reload UserData, unregistered when evicted
+    uint64  Index;          // in RenderResources->Entries
+};
+
+struct resource_stats
+{
+    uint64 CPUBytes;        // resident bytes
+    uint64 GPUBytes;
+    uint64 Hits;
+    uint64 Misses;
+    uint64 Evictions;
+    uint64 ResidencySavedBytes; // CPU bytes freed after upload by the texture residency policies (cumulative)
+    uint64 MipsGenerated;       // mip chains generated on the CPU, and read back from the mip cache
+    uint64 MipCacheHits;
+    uint32 Count;           // number of resident resources
+};
+
 struct render_resources
 {
     path ExecutablePath;
@@ -118,6 +208,22 @@ struct render_resources
     resource_store Images;
     resource_store Textures;
     resource_store Fonts;
+
+    mem_pool        *Pool;      // where the resources and their entries are allocated (SessionPool)
+    resource_entry  **Entries;  // Buf of every resident entry, scanned for LRU eviction
+    resource_entry  **EntryTable; // malloc'ed open-addressing table of the entries by Resource, power of two size
+    uint32          EntryTableSize;
+    uint64          UseTick;
+    uint64          CPUBudget;  // bytes, 0 : unlimited
+    uint64          GPUBudget;
+    resource_stats  Stats;
+
+    glyph_cache     *GlyphCache;    // shared by the dynamic fonts, created with the first one
+    uint32          FontGeneration; // incremented when a font is created, re-baked or destroyed (glyphs or texcoords
+                                    // changing), for what keeps laid out text
+
+    mip_filter      MipFilter;      // filter of the mip chains generated for the loaded textures
+    path            MipCacheDir;    // where the generated mip chains are stored, empty : not stored
 };
 
 /// Error Handling
@@ -125,22 +231,104 @@ void            CheckGLError(char const *Mark = "");
 void            CheckFramebufferError(char const *Mark = "");
 
 /// Resource loading and storage
+/// Each ResourceLoad* call (hit or miss) acquires a reference on the returned resource, that should be given back
+/// with ResourceRelease when not used anymore. Unreferenced resources stay resident until a budget is exceeded,
+/// they are then evicted in least-recently-used order.
+/// Resources given to ResourceStore are owned by the manager from then on, and must be allocated in RenderResources->Pool
 void            *ResourceCheckExist(render_resources *RenderResources, render_resource_type Type, path const Filename);
-void            ResourceStore(render_resources *RenderResources, render_resource_type Type, path const Filename, void *Resource);
+void            *ResourceAcquire(render_resources *RenderResources, render_resource_type Type, path const Filename);
+void            ResourceRelease(render_resources *RenderResources, void *Resource);
+resource_entry  *ResourceStore(render_resources *RenderResources, render_resource_type Type, path const Filename, void *Resource,
+                    uint64 CPUBytes = 0, uint64 GPUBytes = 0);
+void            ResourceSetBudget(render_resources *RenderResources, uint64 CPUBudget, uint64 GPUBudget);
 void            ResourceFree(render_resources *RenderResources);
 image           *ResourceLoadImage(context *Context, path const Filename, bool IsFloat, bool FlipY = true,
                     int32 ForceNumChannel = 0);
-font            *ResourceLoadFont(context *Context, path const Filename, uint32 PixelHeight, int Char0 = 32, int CharN = 127);
+/// The glyphs are packed in a tightly sized atlas of their own, or in the given shared Atlas.
+/// Fonts stored under the same filename and height are shared whatever Atlas they were loaded with.
+font            *ResourceLoadFont(context *Context, path const Filename, uint32 PixelHeight, int Char0 = 32, int CharN = 127,
+                    font_atlas *Atlas = NULL);
+/// Font whose glyphs are rasterized when first looked up, in RenderResources->GlyphCache : can display any codepoint
+/// of the file. The file is parsed once for all the heights it is loaded with.
+/// glyphcache::Flush must be called each frame before drawing its text (ui::Draw does it), and the text must be laid
+/// out again each frame (the glyphs not drawn for a while are evicted).
+font            *ResourceLoadDynamicFont(context *Context, path const Filename, uint32 PixelHeight);
+/// Font whose atlas holds signed distance fields of the glyphs : drawn with a distance field shader (the UI does it),
+/// text stays sharp at any height and scale. The field is generated once per file, at a fixed height, and shared by
+/// every PixelHeight the file is loaded with (each getting its own scaled glyph metrics).
+font            *ResourceLoadSDFFont(context *Context, path const Filename, uint32 PixelHeight, int Char0 = 32,
+                    int CharN = 127);
+/// Creates an empty shared atlas, Width wide, growing from Height up to MaxHeight as fonts are packed in it
+void            FontAtlasInit(context *Context, font_atlas *Atlas, int32 Width = 1024, int32 Height = 256,
+                    int32 MaxHeight = 4096);
+/// The fonts packed in the atlas must have been freed before
+void            FontAtlasDestroy(font_atlas *Atlas);
+/// Texcoord sampling white in the atlas. It changes when the atlas grows, as the glyph texcoords do.
+vec2f           FontAtlasWhiteTexcoord(font_atlas const *Atlas);
+/// DDS and KTX2 files are uploaded as they are (block-compressed, with their mip chain) : IsFloat, ForceNumChannel
+/// and Residency are ignored for them, and no CPU copy is kept. Their rows aren't flipped either : unlike the images
+/// decoded by stb_image (flipped to be Y-descending), they keep the row order of the file.
+/// Other files get their mip chain generated on the CPU (see Make2DMipmappedTexture). SRGB tells that the color
+/// channels are sRGB-encoded, so that they are filtered in linear space. It doesn't change the texture format.
 uint32          *ResourceLoad2DTexture(context *Context, path const Filename, bool IsFloat, bool FloatHalfPrecision,
                     uint32 AnisotropicLevel, int MagFilter = GL_LINEAR, int MinFilter = GL_LINEAR_MIPMAP_LINEAR, 
-                    int WrapS = GL_CLAMP_TO_EDGE, int WrapT = GL_CLAMP_TO_EDGE, int32 ForceNumChannel = 0);
+                    int WrapS = GL_CLAMP_TO_EDGE, int WrapT = GL_CLAMP_TO_EDGE, int32 ForceNumChannel = 0,
+                    texture_residency Residency = RESIDENCY_KEEP, bool SRGB = false);
+/// Returns the CPU copy kept with a texture loaded by ResourceLoad2DTexture (full or low mip), NULL if discarded
+image           *ResourceGetTextureImage(render_resources *RenderResources, uint32 *Texture);
+
+/// Progress of a ResourceLoadManifest call
+struct manifest_progress
+{
+    uint32      Done;       // entries processed, loaded or not
+    uint32      Failed;
+    uint32      Total;
+    char const  *Current;   // filename of the last processed entry
+};
+
+/// Called on the loading thread after each processed entry, e.g. to draw a loading screen frame with a progressbar
+typedef void (*manifest_progress_func)(context *Context, manifest_progress const *Progress, void *UserData);
+
+/// Resources loaded from a manifest, per kind in the manifest order. Entries that failed are NULL (zeroed models).
+struct resource_manifest
+{
+    image           **Images;   // Bufs
+    uint32          **Textures;
+    font            **Fonts;
+    model           *Models;
+    manifest_progress Progress;
+};
+
+/// Loads every resource listed in a JSON manifest :
+///     { "images":   [ "data/a.png", { "file": "data/b.hdr", "float": 1, "flip": 0, "channels": 3 } ],
+///       "textures": [ { "file": "data/c.png", "srgb": 1, "aniso": 8, "mag": "linear", "min": "linear_mipmap_linear",
+///                       "wrap_s": "repeat", "wrap_t": "clamp", "half": 0, "residency": "keep|discard|lowmip" } ],
+///       "fonts":    [ { "file": "data/Roboto.ttf", "height": 16, "first": 32, "last": 127 } ],
+///       "models":   [ { "file": "data/model.gltf", "aniso": 8 } ] }
+/// Omitted parameters take the defaults of the matching ResourceLoad* call (1 for aniso, 16 for a font height).
+/// Entries already stored are acquired without being read again, as are files listed twice. The other image and font
+/// files are read in io batches of IO_BATCH_DEPTH files, decoded/rasterized in the jobs worker threads, then uploaded and
+/// stored on the calling thread in the manifest order, while the next ones are decoded. Models are loaded one by one.
+/// Each loaded resource holds a reference, given back by ResourceReleaseManifest. Returns false if any entry failed.
+bool            ResourceLoadManifest(context *Context, resource_manifest *Manifest, path const Filename,
+                    manifest_progress_func ProgressFunc = NULL, void *UserData = NULL);
+void            ResourceReleaseManifest(context *Context, resource_manifest *Manifest);
 
 /// Texture Utilities
 void            BindTexture2D(uint32 TextureID, uint32 TextureUnit);
 void            BindTexture3D(uint32 TextureID, uint32 TextureUnit);
 void            BindCubemap(uint32 TextureID, uint32 TextureUnit);
+/// Mipmapping MinFilters get their mips from glGenerateMipmap
 uint32          Make2DTexture(void *ImageBuffer, uint32 Width, uint32 Height, uint32 Channels, bool IsFloat,
                     bool FloatHalfPrecision, real32 AnisotropicLevel, int MagFilter, int MinFilter, int WrapS, int WrapT);
+/// Same as Make2DTexture, the mip chain being generated on the CPU with RenderResources->MipFilter (and read from/stored
+/// in RenderResources->MipCacheDir), then uploaded level by level
+uint32          Make2DMipmappedTexture(render_resources *RenderResources, void *ImageBuffer, uint32 Width, uint32 Height,
+                    uint32 Channels, bool IsFloat, bool FloatHalfPrecision, bool SRGB, real32 AnisotropicLevel, int MagFilter,
+                    int MinFilter, int WrapS, int WrapT);
+/// Uploads a block-compressed texture with glCompressedTexImage2D, the mip levels being the ones of the texture
+uint32          Make2DCompressedTexture(compressed_texture const *Texture, real32 AnisotropicLevel, int MagFilter, int MinFilter,
+                    int WrapS, int WrapT);
 uint32          Make3DTexture(uint32 Width, uint32 Height, uint32 Depth, uint32 Channels, bool IsFloat, bool FloatHalfPrecision,
                     int MagFilter, int MinFilter, int WrapS, int WrapT, int WrapR);
 uint32          MakeCubemap(context *Context, path *Paths, bool IsFloat, bool FloatHalfPrecision, uint32 Width, uint32 Height, bool MakeMipmap);
@@ -170,8 +358,11 @@ void			FillUBO(size_t Offset, size_t Size, void const *Data);
 void			DestroyUBO(uint32 ID);
 
 /// Model Utilities
-bool            ModelLoadGLTF(context *Context, model *Model, path const Filename, int AnisotropicLevel);
-void			ModelFree(model *Model);
+/// With TextureArrays, the material textures are stored in layers of the pool's arrays instead of separate textures
+bool            ModelLoadGLTF(context *Context, model *Model, path const Filename, int AnisotropicLevel,
+                              texture_array_pool *TextureArrays = NULL);
+/// Give the same pool as ModelLoadGLTF, for the material layers to be released
+void			ModelFree(model *Model, texture_array_pool *TextureArrays = NULL);
 
 /// Shader Utilities
 uint32          BuildShader(context *Context, char *VSPath, char *FSPath, char *GSPath = NULL, char *TESCPath = NULL, char *TESEPath = NULL);
@@ -193,6 +384,15 @@ void            FramebufferAttachBuffer(frame_buffer *FB, uint32 Attachment, uin
 void            FramebufferSetAttachmentCount(frame_buffer *FB, int Count);
 
 /// Display Text Utilities
+/// Returns an empty glyph (no quad, no advance) for the codepoints the font can't display.
+/// The glyph of a dynamic font is only valid until the next lookup.
+glyph const     *GetFontGlyph(font *Font, uint32 Codepoint);
+/// Texture buffer (RGBA32F) of the glyph rects of a baked font, for text drawn instanced : 2 texels per char of
+/// [Char0, CharN), its texcoords (TexX0, TexY0, TexX1, TexY1) then its size (CW, CH, 0, 0).
+/// Uploaded on first use and again when the glyphs change. 0 for dynamic fonts, whose glyphs move in the glyph cache.
+uint32          GetFontGlyphRects(font *Font);
+/// Adjustment of the advance of First when followed by Second (negative when they get closer), in pixels
+real32          GetFontKerning(font *Font, uint32 First, uint32 Second);
 real32          GetDisplayTextWidth(char const *Text, font *Font, real32 Scale);
 void            FillDisplayTextInterleaved(char const *Text, int32 TextLength, font *Font, vec3i Pos, int MaxPixelWidth,
                     real32 *VertData, uint16 *Indices, real32 Scale = 1.0f);
@@ -240,9 +240,14 @@ inline bool		BufPush(T *&b, T v)
 }
 
 
-inline bool BufPushBytes(uint8 *b, const uint8 *v, uint64 vLen)
+// Removes and returns the last element, the buffer must not be empty
+template<typename T>
+inline T		BufPop(T *b) { return b[--mem_buf__hdr(b)->Size]; }
+
+
+inline bool BufPushBytes(uint8 *&b, const uint8 *v, uint64 vLen)
 {
-	bool realloced = _MemBufCheckGrowth(b, vLen);
+	bool realloced = _MemBufCheckGrowth(b, BufSize(b) + vLen);
 	memcpy(b + BufSize(b), v, vLen);
 	mem_buf__hdr(b)->Size += vLen;
 	return realloced;
@@ -288,6 +293,8 @@ map_store	MapStore(mem_pool *Pool, uint64 Capacity = 0);
 void		MapStoreFree(map_store *MStore);
 bool		MapStoreAdd(map_store *MStore, const char *Key, void *Value);
 void		*MapStoreGet(map_store *MStore, const char *Key);
+// The key string stays allocated, and its slot is reused if the key is added again
+void		MapStoreRemove(map_store *MStore, const char *Key);
 const char  *MapStoreGetKey(map_store *MStore, uint64 KeyIdx);
 
 // ##########################################################################
@@ -376,6 +383,7 @@ enum decoration_flag
 	DECORATION_BORDER = 1 << 5,
 	DECORATION_INVISIBLE = 1 << 6,
 	DECORATION_FOCUS = 1 << 7,
+	DECORATION_SDFTEXT = 1 << 8,	// text of an SDF font, drawn with the distance field shader
 };
 
 enum theme_font
@@ -0,0 +1,20 @@
+#ifndef RF_SDF_H
+#define RF_SDF_H
+
+#include "rf_common.h"
+
+namespace rf {
+/// Signed distance fields from coverage masks, for glyphs that stay sharp at any scale.
+/// The mask is rendered Oversample times larger than the field, its exact Euclidean distance transform is computed
+/// (Felzenszwalb-Huttenlocher, linear in the texel count) inside and outside of the shape, and each field texel gets
+/// the average signed distance of the mask texels it covers.
+/// Fields are stored as uint8 : 128 on the edge, increasing inside the shape, Spread field texels away from the edge
+/// mapping to 0 (outside) and 255 (inside).
+namespace sdf {
+    /// Mask is Width x Height (multiples of Oversample), texels >= 128 being inside the shape.
+    /// Writes the (Width / Oversample) x (Height / Oversample) field in Dst.
+    void    Generate(uint8 const *Mask, int32 Width, int32 Height, int32 Oversample, real32 Spread, uint8 *Dst,
+                int32 DstStride);
+}
+}
+#endif
@@ -0,0 +1,28 @@
+#ifndef RF_SIMD_H
+#define RF_SIMD_H
+
+#include "rf_common.h"
+
+// SSE2 is part of x86_64, so it is always there on the targeted platforms. The scalar paths are kept for other
+// architectures and for reference.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define RF_SSE2 1
+#   include <emmintrin.h>
+#endif
+
+// Later instruction sets are used in functions compiled for them with RF_TARGET, and only called when the CPU
+// supports them (see simd::Has*), so that the library is still built for the baseline x86_64.
+#if defined(RF_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#   define RF_TARGET(Features) __attribute__((target(Features)))
+#else
+#   define RF_TARGET(Features)
+#endif
+
+namespace rf {
+/// Instruction sets found at runtime (cpuid), always false on non-x86 platforms
+namespace simd {
+    bool    HasSSSE3();
+    bool    HasF16C();      // also implies that AVX is supported by the CPU and the OS
+}
+}
+#endif
@@ -0,0 +1,50 @@
+#ifndef RF_STREAMBUF_H
+#define RF_STREAMBUF_H
+
+#include "rf_common.h"
+#include "GL/glew.h"
+
+namespace rf {
+#define STREAM_BUFFER_FRAMES 3      // frames the GPU can be behind the CPU before Alloc waits
+
+/// GL buffer for the data written every frame (dynamic vertices, indices, instances), written in place.
+/// The buffer is a ring of STREAM_BUFFER_FRAMES regions, one per frame : the current frame is written in its region
+/// while the GPU reads the previous ones, and a fence per region tells when it can be written again.
+/// With ARB_buffer_storage the buffer is mapped persistently (and coherently) once, Alloc returning pointers in the
+/// mapping. Without it, Alloc returns pointers in a CPU copy of the region, that Flush uploads to the buffer orphaned
+/// at the start of each frame.
+/// The same GL buffer can be bound to any target : attributes, indices, instances, uniforms.
+struct stream_buffer
+{
+    uint32  Buffer;         // GL name, changes when Reserve grows the buffer
+    bool    Persistent;     // ARB_buffer_storage mapping, or orphaning
+    size_t  RegionSize;     // bytes per frame
+    uint8   *Mapping;       // persistent : the whole buffer. orphaning : malloc'ed copy of a region
+    GLsync  Fences[STREAM_BUFFER_FRAMES];
+    uint32  Region;         // region of the current frame
+    size_t  Head;           // bytes allocated in the current frame
+    size_t  Flushed;        // bytes uploaded in the current frame (orphaning)
+};
+
+namespace streambuf {
+    /// RegionSize bytes can be allocated per frame (rounded up, and grown by Reserve)
+    void    Init(stream_buffer *Stream, size_t RegionSize);
+    void    Destroy(stream_buffer *Stream);
+
+    /// Makes room for Size bytes in the frame, waiting for the GPU to be done with the region if needed. When the
+    /// region is too small the buffer is made larger : the allocations made before in the frame are then lost, so
+    /// it must be called first.
+    void    Reserve(stream_buffer *Stream, size_t Size);
+
+    /// Returns where to write Size bytes, Alignment aligned (power of two), and their offset in the GL buffer in
+    /// Offset. Returns NULL when the region is full.
+    void    *Alloc(stream_buffer *Stream, size_t Size, size_t Alignment, size_t *Offset);
+
+    /// Makes the data written since the last Flush visible to the GPU. To be called before the draws reading it.
+    void    Flush(stream_buffer *Stream);
+
+    /// Fences the region of the frame and moves to the next one. To be called once per frame, after the draws.
+    void    EndFrame(stream_buffer *Stream);
+}
+}
+#endif
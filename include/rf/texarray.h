@@ -0,0 +1,71 @@
+#ifndef RF_TEXARRAY_H
+#define RF_TEXARRAY_H
+
+#include "rf_defs.h"
+
+namespace rf {
+struct render_resources;
+
+/// Handle of a texture stored in a layer of a texture array of a texture_array_pool
+struct texture_layer
+{
+    uint32  Array;      // index of the array in the pool + 1, 0 : no texture
+    uint32  Layer;
+};
+
+/// One GL_TEXTURE_2D_ARRAY : all its layers have the same size, format and sampling parameters
+struct texture_array
+{
+    uint32  Texture;        // GL name, changes when the array grows
+    uint32  Width;
+    uint32  Height;
+    uint32  Channels;
+    bool    IsFloat;
+    bool    FloatHalfPrecision;
+    int     MagFilter, MinFilter, WrapS, WrapT;
+    real32  AnisotropicLevel;
+    uint32  LevelCount;
+    uint32  LayerCapacity;  // allocated layers
+    uint32  LayerCount;     // layers handed out at least once, the next new one is LayerCount
+    uint32  *FreeLayers;    // Buf of released layers, reused first
+};
+
+/// Groups textures in texture arrays, so that objects using different textures can be drawn without rebinding,
+/// or in the same draw call (the layer being a per-draw or per-instance attribute).
+/// Textures are grouped by size, channels/format and sampling parameters. Arrays grow by doubling their layer count
+/// (the layers are copied GPU side with glCopyImageSubData, or through the CPU without ARB_copy_image), so their GL
+/// name must be read at bind time with texarray::Texture or texarray::Bind, not kept around.
+/// Mip chains are generated on the CPU like Make2DMipmappedTexture does.
+struct texture_array_pool
+{
+    render_resources    *RenderResources;   // for the mip filter and cache
+    texture_array       *Arrays;            // Buf
+    uint32              MaxLayers;          // GL_MAX_ARRAY_TEXTURE_LAYERS
+
+    // 1x1 layers standing for missing material textures, shared : Remove ignores them
+    texture_layer       DefaultDiffuse;     // white
+    texture_layer       DefaultNormal;      // flat (0.5, 0.5, 1)
+    texture_layer       DefaultEmissive;    // black
+};
+
+namespace texarray {
+    /// Also creates the default layers
+    void            Init(texture_array_pool *Pool, render_resources *RenderResources);
+    /// Deletes every array, the handles become invalid
+    void            Destroy(texture_array_pool *Pool);
+
+    /// Stores the image (uint8 or float, 1 to 4 channels) in a free layer of a matching array, created if needed.
+    /// Same parameters as Make2DMipmappedTexture. Returns a null handle (Array 0) on error.
+    texture_layer   Add(texture_array_pool *Pool, void const *Pixels, uint32 Width, uint32 Height, uint32 Channels,
+                        bool IsFloat, bool FloatHalfPrecision, bool SRGB, real32 AnisotropicLevel, int MagFilter,
+                        int MinFilter, int WrapS, int WrapT);
+    /// Gives the layer back to its array, for a later Add to reuse it. Null handles, default layers and layers
+    /// already given back are ignored.
+    void            Remove(texture_array_pool *Pool, texture_layer Layer);
+
+    /// GL name of the array of the handle, 0 for a null handle
+    uint32          Texture(texture_array_pool const *Pool, texture_layer Layer);
+    void            Bind(texture_array_pool const *Pool, texture_layer Layer, uint32 TextureUnit);
+}
+}
+#endif
@@ -0,0 +1,107 @@
+#ifndef RF_TEXTLAYOUT_H
+#define RF_TEXTLAYOUT_H
+
+#include "render.h"
+#include "simd.h"
+
+namespace rf {
+#define TEXT_LAYOUT_VERTEX_SIZE 5   // floats : position xyz, texcoord uv
+#define TEXT_LAYOUT_MAX_AGE 60      // frames a layout is kept without being drawn
+
+/// A glyph of text drawn instanced, its quad being expanded by the vertex shader from the glyph rect table of the font
+/// (GetFontGlyphRects)
+struct glyph_instance
+{
+    real32  X, Y;           // top-left corner of the quad
+    real32  Scale;
+    uint32  Rect;           // index of the glyph in the rect table : codepoint - Char0
+    uint32  Color;          // RGBA8
+};
+
+/// Text laid out in glyph quads, 4 vertices (TL, BL, BR, TR) per glyph, relative to the text origin (top-left, y up).
+/// The chars without texels (spaces) have no quad.
+struct text_layout
+{
+    uint64  Key;            // hash of the text and the layout parameters, 0 : empty slot
+    font    *Font;
+    real32  Scale;
+    int32   MaxWidth;
+    uint32  TextLength;     // bytes
+
+    uint32  GlyphCount;     // quads
+    uint32  LineCount;
+    real32  Width;          // of the widest line, in pixels
+    real32  MinX, MinY, MaxX, MaxY; // bounds of the quads, relative to the text origin (y up)
+    real32  *Vertices;      // malloc'ed, GlyphCount * 4 * TEXT_LAYOUT_VERTEX_SIZE
+    glyph_instance *Instances; // malloc'ed, the same glyphs as instances (without color), for the baked fonts
+    uint32  Capacity;       // glyphs Vertices and Instances have room for
+    uint64  LastUse;        // frame
+};
+
+struct text_layout_pen;
+
+/// Layouts of the texts drawn recently, so that the labels that don't change from a frame to the next are copied
+/// instead of being decoded, measured and kerned again.
+/// Layouts are keyed by (text, font, scale, max width), and dropped when unused for TEXT_LAYOUT_MAX_AGE frames, or
+/// all at once when fonts change (render_resources::FontGeneration).
+/// The text of dynamic fonts isn't cached : its glyphs move when evicted from the glyph cache, and laying it out
+/// is what marks their pages as used in the frame.
+struct text_layout_cache
+{
+    render_resources *Resources;
+    uint32          FontGeneration;
+
+    text_layout     *Slots;         // malloc'ed open-addressing table, power of two size
+    uint32          SlotCount;
+    uint32          Count;
+    uint64          Frame;
+
+    text_layout     Scratch;        // layout of the uncached text
+    uint32          *Codepoints;    // malloc'ed, decoded text being laid out
+    text_layout_pen *Pens;          // malloc'ed, pen position before each char of the line being laid out
+    uint32          ScratchCapacity; // of Codepoints and Pens
+};
+
+namespace textlayout {
+    void        Init(text_layout_cache *Cache, render_resources *Resources);
+    void        Destroy(text_layout_cache *Cache);
+    void        Clear(text_layout_cache *Cache);
+
+    /// Returns the layout of the UTF-8 Text, laying it out if not cached : '\n' breaks lines, kerning is applied, and
+    /// lines wider than MaxWidth are clamped and end with "..".
+    /// The pointer is only valid until the next call.
+    text_layout const *Get(text_layout_cache *Cache, font *Font, char const *Text, real32 Scale, int32 MaxWidth);
+
+    /// Writes the quads of the layout translated to Pos in VertData (TEXT_LAYOUT_VERTEX_SIZE floats per vertex), and
+    /// their indices, starting at vertex BaseVertex, in IdxData (6 per glyph)
+    void        Fill(text_layout const *Layout, vec3i const &Pos, real32 *VertData, uint16 *IdxData,
+                    uint16 BaseVertex = 0);
+
+    /// Writes the glyph instances of the layout translated to Pos, with Color (RGBA8), in Instances
+    void        FillInstances(text_layout const *Layout, vec3i const &Pos, uint32 Color, glyph_instance *Instances);
+
+    /// Writes the 4 vertices (TL, BL, BR, TR) of a glyph quad, from its corners (X0, Y0) top-left and (X1, Y1)
+    /// bottom-right
+    inline void StoreQuad(real32 *Dst, real32 X0, real32 Y0, real32 X1, real32 Y1, real32 Z, glyph const &Glyph)
+    {
+#ifdef RF_SSE2
+        // The 20 floats of the quad in 5 unaligned stores
+        _mm_storeu_ps(Dst + 0, _mm_setr_ps(X0, Y0, Z, Glyph.TexX0));
+        _mm_storeu_ps(Dst + 4, _mm_setr_ps(Glyph.TexY0, X0, Y1, Z));
+        _mm_storeu_ps(Dst + 8, _mm_setr_ps(Glyph.TexX0, Glyph.TexY1, X1, Y1));
+        _mm_storeu_ps(Dst + 12, _mm_setr_ps(Z, Glyph.TexX1, Glyph.TexY1, X1));
+        _mm_storeu_ps(Dst + 16, _mm_setr_ps(Y0, Z, Glyph.TexX1, Glyph.TexY0));
+#else
+        Dst[0] = X0;  Dst[1] = Y0;  Dst[2] = Z;  Dst[3] = Glyph.TexX0;  Dst[4] = Glyph.TexY0;
+        Dst[5] = X0;  Dst[6] = Y1;  Dst[7] = Z;  Dst[8] = Glyph.TexX0;  Dst[9] = Glyph.TexY1;
+        Dst[10] = X1; Dst[11] = Y1; Dst[12] = Z; Dst[13] = Glyph.TexX1; Dst[14] = Glyph.TexY1;
+        Dst[15] = X1; Dst[16] = Y0; Dst[17] = Z; Dst[18] = Glyph.TexX1; Dst[19] = Glyph.TexY0;
+#endif
+    }
+
+    /// Starts a new frame, dropping the layouts that weren't drawn for a while. To be called once per frame (ui::Draw
+    /// does it).
+    void        EndFrame(text_layout_cache *Cache);
+}
+}
+#endif
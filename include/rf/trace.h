@@ -0,0 +1,51 @@
+#ifndef RF_TRACE_H
+#define RF_TRACE_H
+
+#include "rf_common.h"
+
+namespace rf {
+/// Startup timeline profiling.
+/// When the RF_TRACE environment variable is set to a filename, ctx::Init starts recording timed spans : each init
+/// phase, each resource load (images, textures, fonts, models, shaders, manifests) and the decode jobs, on every thread.
+/// The first frames are recorded too (RF_TRACE_FRAMES, 1 by default, 0 to record until ctx::Destroy), a frame going
+/// from one ctx::GetFrameInput to the next. The spans are then written as Chrome trace JSON (chrome://tracing,
+/// Perfetto) and the recording stops.
+/// Without RF_TRACE, every call returns right away.
+namespace trace {
+    /// Reads the environment variables, and starts recording if RF_TRACE is set. Called first thing by ctx::Init.
+    void    Init();
+    bool    IsActive();
+
+    /// Microseconds since trace::Init (from 1), 0 when not recording
+    uint64  Now();
+
+    /// Records a span that started at Start (from trace::Now) and ends now. Thread-safe.
+    /// Category and Name must be string literals, Arg (e.g. a filename, can be NULL) is copied.
+    void    Span(char const *Category, char const *Name, char const *Arg, uint64 Start);
+
+    /// Ends the current frame span and starts the next one, the trace being written after the last recorded frame.
+    /// Called by ctx::GetFrameInput.
+    void    FrameMark();
+
+    /// Writes the recorded spans to the RF_TRACE file and stops recording. Called by ctx::Destroy if still recording.
+    void    Dump();
+}
+
+/// Records a span covering the enclosing scope
+struct trace_scope
+{
+    char const  *Category;
+    char const  *Name;
+    char const  *Arg;
+    uint64      Start;
+
+    trace_scope(char const *Category, char const *Name, char const *Arg = NULL)
+        : Category(Category), Name(Name), Arg(Arg), Start(trace::Now()) {}
+    ~trace_scope() { if (Start) trace::Span(Category, Name, Arg, Start); }
+};
+
+#define TRACE_CONCAT_(A, B) A##B
+#define TRACE_CONCAT(A, B) TRACE_CONCAT_(A, B)
+#define TRACE_SCOPE(Category, Name, ...) rf::trace_scope TRACE_CONCAT(TraceScope, __LINE__)(Category, Name, ##__VA_ARGS__)
+}
+#endif
@@ -25,10 +25,16 @@ namespace ui {
     int32 GetFontLineGap(theme_font Font);
 
     void Init(context *Context);
+    /// To be called after ResourceFree : the theme fonts must have been freed before their atlas is
+    void Destroy();
     void ReloadShaders(context *Context);
     void BeginFrame(input *Input);
     void Draw();
 
+    /// Commands drawn in the last frame (widgets and texts), the draw calls they took, and the panels whose geometry
+    /// was rebuilt (the others being drawn from the geometry kept on the GPU)
+    void GetDrawStats(uint32 *CommandCount, uint32 *DrawCallCount, uint32 *RebuiltPanelCount = NULL);
+
     bool HasFocus();
 
     // DecorationFlags is of the type decoration_flag from definitions.h
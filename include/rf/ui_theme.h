@@ -4,6 +4,7 @@
 // This file should only be included in ui.cpp
 
 #include "ui.h"
+#include "render.h"
 
 namespace rf {
 namespace ui {
@@ -39,6 +40,9 @@ struct ui_theme
 // Defined in ui_theme.cpp
 extern ui_theme Theme;
 extern ui_theme DefaultTheme;
+// Shared atlas of the baked theme fonts (text and icons), whose white texels the solid widgets sample, so that a
+// panel is drawn with a single texture
+extern font_atlas ThemeAtlas;
 
 void ParseUIConfig(context *Context, path const ConfigPath);
 }
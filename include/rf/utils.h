@@ -31,10 +31,13 @@ void    GetExecutablePath(path Path);
 bool    DiskFileExists(path const Filename);
 /// Copy a file on disk
 void    DiskFileCopy(path const DstPath, path const SrcPath);
+/// Creates a directory on disk (its parent must exist). Returns true if it exists after the call
+bool    DiskCreateDirectory(path const Dirname);
 
 /// Reads the content of Filename and returns it.
 /// Also returns the file size in out-parameter if needed
 /// Context is needed for the scratch alloc of opening the file
+/// Files in the mounted packs (see vfs.h) are found before the ones on disk
 void    *ReadFileContents(context *Context, path const Filename, int32 *FileSize);
 
 /// Same as previous, but doesn't necessitate the Context to call
@@ -42,6 +45,47 @@ void    *ReadFileContents(context *Context, path const Filename, int32 *FileSize
 /// the caller HAS to free it. It should only be used if the Context doesn't exist yet
 void    *ReadFileContentsNoContext(path const Filename, int32 *FileSize);
 
+/// NOTE - Both ReadFileContents functions copy the whole file and are limited to files under 2GB.
+/// Use a file_view or a file_stream for large files.
+
+/// Read-only view of a whole file mapped in memory
+struct file_view
+{
+    uint8   *Data;
+    uint64  Size;
+};
+
+/// Access pattern hint given to the OS for a mapped view (madvise on Unix, ignored on Windows)
+enum file_access_hint
+{
+    FILE_ACCESS_NORMAL,
+    FILE_ACCESS_SEQUENTIAL,     // read front to back, aggressive read-ahead
+    FILE_ACCESS_RANDOM,         // no read-ahead
+    FILE_ACCESS_WILLNEED        // starts loading the whole file now
+};
+
+/// Maps the whole file in memory without copying it, the pages are read on first access.
+/// The view is copy-on-write : writing in it never modifies the file.
+/// Empty files give an empty view (Data NULL, Size 0).
+/// Returns false if the file can't be opened or can't be mapped
+bool    FileMapView(file_view *View, path const Filename, file_access_hint Hint = FILE_ACCESS_NORMAL);
+void    FileUnmapView(file_view *View);
+
+/// Chunked reader for files of any size, filling buffers given by the caller (unbuffered, no intermediate copy)
+struct file_stream
+{
+    FILE    *File;
+    uint64  Size;
+    uint64  Offset;
+};
+
+bool    FileStreamOpen(file_stream *Stream, path const Filename);
+/// Reads at most BufferSize bytes from the current offset in Buffer, and returns the number of bytes read
+/// Returns 0 at the end of the file or on error
+uint64  FileStreamRead(file_stream *Stream, void *Buffer, uint64 BufferSize);
+bool    FileStreamSeek(file_stream *Stream, uint64 Offset);
+void    FileStreamClose(file_stream *Stream);
+
 /// Returns the index of the first iterance of the character in the given string
 /// returns -1 if none is found
 int     FindFirstOf(char const *Str, char charToFind);
@@ -58,6 +102,14 @@ uint32  UTF8Len(char const *Str, uint32 MaxChar = -1);
 /// Converts the UTF8 string to an unsigned integers (e.g. for indexing)
 uint16  UTF8CharToInt(char const *Str, size_t *CharAdvance);
 
+#define UTF8_REPLACEMENT_CHAR 0xFFFD
+
+/// Validates and decodes the Length bytes of the UTF8 string in a single pass, writing their codepoints in Codepoints
+/// (room for Length of them needed) and returning the codepoint count. Runs of ASCII are decoded 16 bytes at a time.
+/// Invalid sequences (bad or missing bytes, overlong encodings, surrogates, above U+10FFFF) are decoded as
+/// UTF8_REPLACEMENT_CHAR, and Valid, if non NULL, is set to false.
+uint32  UTF8Decode(char const *Str, uint32 Length, uint32 *Codepoints, bool *Valid = NULL);
+
 /// Returns a pointer to the first non-whitespace character in a pointed string buffer
 /// This does not erase anything
 char *GetFirstNonWhitespace(char *Src);
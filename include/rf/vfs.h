@@ -0,0 +1,32 @@
+#ifndef RF_VFS_H
+#define RF_VFS_H
+
+#include "rf_defs.h"
+
+namespace rf {
+/// Virtual file system over asset pack files.
+/// A pack is one file holding many assets : a header, a table of contents sorted by name hash, the names, then the
+/// data of each entry (16-byte aligned), stored raw or LZ4 compressed. Packs are memory-mapped once when mounted.
+/// ReadFileContents, ResourceLoadImage, ResourceLoadFont and BuildShader look into the mounted packs first, then on
+/// disk. So hot-reload only applies to loose files that aren't packed.
+/// Entry names are relative paths with '/' separators, paths given to lookups are normalized the same way, and
+/// the executable path is stripped from them.
+namespace vfs {
+    /// Maps the pack file in memory and adds it to the lookups. Packs mounted last take precedence.
+    bool Mount(context *Context, path const PackFilename);
+    /// Unmaps every mounted pack. Pointers returned by ReadFile become invalid.
+    void Destroy();
+
+    bool Exists(char const *Filename);
+
+    /// Returns the contents of Filename if it is in a mounted pack, NULL otherwise.
+    /// Raw entries are returned in place in the mapping (zero-copy, the pages are copy-on-write), compressed entries are
+    /// decompressed in Context->ScratchPool. The contents are followed by a 0 byte in both cases (not counted in FileSize).
+    void *ReadFile(context *Context, char const *Filename, uint64 *FileSize);
+
+    /// Builds a pack file out of the given files. Entries are named after the normalized given filenames.
+    /// If Compress is true, each entry is LZ4 compressed when it makes it smaller.
+    bool WritePack(path const PackFilename, char const * const *Filenames, uint32 FileCount, bool Compress);
+}
+}
+#endif
@@ -0,0 +1,35 @@
+#ifndef RF_WATCH_H
+#define RF_WATCH_H
+
+#include "rf_defs.h"
+
+namespace rf {
+/// Callback called when a watched file changed on disk.
+/// Filename is the path the file was registered with. The resources (images, textures, fonts) register theirs
+/// under the executable directory (ctx::GetExePath), whatever the working directory.
+typedef void (*watch_reload_func)(context *Context, char const *Filename, void *UserData);
+
+/// File watching service used for asset hot-reloading.
+/// Enabled with context_descriptor::HotReload. Uses inotify on Linux. On other platforms hot reload does nothing :
+/// Init logs it and returns false, and every other function is a no-op.
+/// The reload callbacks are called from watch::Update (in ctx::GetFrameInput), on the main thread, with the
+/// GL context current. So they can re-upload GPU resources in place.
+namespace watch {
+    bool Init(context *Context);
+    void Destroy();
+    bool IsActive();
+
+    /// Polls the pending file events (non-blocking) and calls the callbacks of every modified file.
+    /// Each callback is called once per Update even if its file received several events.
+    void Update(context *Context);
+
+    /// Registers Filename to be watched. Func is called with UserData each time the file is written to.
+    /// Several callbacks can be registered on the same file, they are called in registration order.
+    /// Registering the same (Filename, Func, UserData) triplet twice has no effect.
+    void AddFile(char const *Filename, watch_reload_func Func, void *UserData);
+
+    /// Unregisters every callback that was registered with UserData
+    void RemoveUserData(void *UserData);
+}
+}
+#endif
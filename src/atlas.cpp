@@ -0,0 +1,192 @@
+#include "atlas.h"
+
+namespace rf {
+namespace atlas {
+
+void Init(atlas_packer *Packer, uint32 Width, uint32 Height, uint32 Padding)
+{
+	Packer->Width = Width;
+	Packer->Height = Height;
+	Packer->Padding = Padding;
+	Packer->Nodes = (atlas_skyline_node*)malloc((Width + 1) * sizeof(atlas_skyline_node));
+	Reset(Packer);
+}
+
+void Free(atlas_packer *Packer)
+{
+	free(Packer->Nodes);
+	Packer->Nodes = NULL;
+	Packer->NodeCount = 0;
+}
+
+void Reset(atlas_packer *Packer)
+{
+	// The skyline starts below the top border padding, and right of the left one
+	Packer->Nodes[0].X = Packer->Padding;
+	Packer->Nodes[0].Y = Packer->Padding;
+	Packer->Nodes[0].Width = Packer->Width > Packer->Padding ? Packer->Width - Packer->Padding : 0;
+	Packer->NodeCount = 1;
+	Packer->UsedHeight = Packer->Padding;
+}
+
+void Grow(atlas_packer *Packer, uint32 NewHeight)
+{
+	Packer->Height = Max(Packer->Height, NewHeight);
+}
+
+// Top of a Width-wide rect whose left edge is on node Index, resting on the skyline. Returns false if it goes past
+// the right edge.
+static bool RectTop(atlas_packer const *Packer, uint32 Index, uint32 Width, uint32 *Top)
+{
+	atlas_skyline_node const *Nodes = Packer->Nodes;
+	if (Nodes[Index].X + Width > Packer->Width)
+		return false;
+
+	uint32 Y = 0;
+	int32 Remaining = (int32)Width;
+	for (uint32 i = Index; Remaining > 0 && i < Packer->NodeCount; ++i)
+	{
+		Y = Max(Y, Nodes[i].Y);
+		Remaining -= (int32)Nodes[i].Width;
+	}
+	*Top = Y;
+	return true;
+}
+
+bool Pack(atlas_packer *Packer, uint32 Width, uint32 Height, uint32 *X, uint32 *Y)
+{
+	// Empty rects (e.g. the space glyph) take no room
+	if (!Width || !Height)
+	{
+		*X = *Y = 0;
+		return true;
+	}
+
+	// Reserves the rect and its padding on its right and bottom sides
+	uint32 const W = Width + Packer->Padding, H = Height + Packer->Padding;
+
+	uint32 BestIndex = ~0u, BestTop = 0, BestBottom = ~0u, BestNodeWidth = ~0u;
+	for (uint32 i = 0; i < Packer->NodeCount; ++i)
+	{
+		uint32 Top;
+		if (!RectTop(Packer, i, W, &Top) || Top + H > Packer->Height)
+			continue;
+
+		// Lowest bottom edge first, then the narrowest segment (less wasted space under the rect)
+		if (Top + H < BestBottom || (Top + H == BestBottom && Packer->Nodes[i].Width < BestNodeWidth))
+		{
+			BestIndex = i;
+			BestTop = Top;
+			BestBottom = Top + H;
+			BestNodeWidth = Packer->Nodes[i].Width;
+		}
+	}
+
+	if (BestIndex == ~0u)
+		return false;
+
+	atlas_skyline_node *Nodes = Packer->Nodes;
+	atlas_skyline_node NewNode = { Nodes[BestIndex].X, BestBottom, W };
+
+	// Trims the nodes now under the new one, then inserts it
+	uint32 Right = NewNode.X + NewNode.Width;
+	uint32 First = BestIndex, Last = BestIndex;
+	while (Last < Packer->NodeCount && Nodes[Last].X + Nodes[Last].Width <= Right)
+		++Last;
+	if (Last < Packer->NodeCount && Nodes[Last].X < Right)
+	{
+		Nodes[Last].Width -= Right - Nodes[Last].X;
+		Nodes[Last].X = Right;
+	}
+
+	// Nodes [First, Last) are replaced by the new one
+	uint32 Removed = Last - First;
+	if (Removed != 1)
+	{
+		memmove(Nodes + First + 1, Nodes + Last, (Packer->NodeCount - Last) * sizeof(atlas_skyline_node));
+		Packer->NodeCount = Packer->NodeCount - Removed + 1;
+	}
+	Nodes[First] = NewNode;
+
+	// Merges neighbours at the same height
+	for (uint32 i = (First > 0) ? First - 1 : 0; i + 1 < Packer->NodeCount && i <= First + 1; )
+	{
+		if (Nodes[i].Y == Nodes[i + 1].Y)
+		{
+			Nodes[i].Width += Nodes[i + 1].Width;
+			memmove(Nodes + i + 1, Nodes + i + 2, (Packer->NodeCount - i - 2) * sizeof(atlas_skyline_node));
+			--Packer->NodeCount;
+			if (i < First)
+				--First;
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	*X = NewNode.X;
+	*Y = BestTop;
+	Packer->UsedHeight = Max(Packer->UsedHeight, BestBottom);
+	return true;
+}
+
+struct pack_order
+{
+	uint32 const *Widths;
+	uint32 const *Heights;
+	bool operator()(uint32 A, uint32 B) const
+	{
+		return Heights[A] != Heights[B] ? Heights[A] > Heights[B] : Widths[A] > Widths[B];
+	}
+};
+
+bool PackAll(uint32 const *Widths, uint32 const *Heights, uint32 Count, uint32 Padding, bool PowerOfTwo,
+	uint32 MaxSize, uint32 *X, uint32 *Y, uint32 *AtlasWidth, uint32 *AtlasHeight)
+{
+	uint32 *Order = (uint32*)malloc(Max(Count, 1u) * sizeof(uint32));
+	uint64 Area = 0;
+	uint32 MaxWidth = 1;
+	for (uint32 i = 0; i < Count; ++i)
+	{
+		Order[i] = i;
+		Area += (uint64)(Widths[i] + Padding) * (Heights[i] + Padding);
+		MaxWidth = Max(MaxWidth, Widths[i] + 2 * Padding);
+	}
+	pack_order Cmp = { Widths, Heights };
+	std::sort(Order, Order + Count, Cmp);
+
+	// Tries the candidate sizes by increasing area : square, then twice as wide
+	uint32 Size = 16;
+	while ((uint64)Size * Size < Area && Size < MaxSize)
+		Size *= 2;
+	if (Size > 16 && (uint64)Size * Size / 2 >= Area)
+		Size /= 2;
+
+	bool Packed = false;
+	atlas_packer Packer;
+	for (uint32 Height = Size; !Packed && Height <= MaxSize; Height *= 2)
+	{
+		for (uint32 Width = Max(Height, NextPow2(MaxWidth)); !Packed && Width <= Min(2 * Height, MaxSize); Width *= 2)
+		{
+			Init(&Packer, Width, Height, Padding);
+			Packed = true;
+			for (uint32 i = 0; Packed && i < Count; ++i)
+			{
+				uint32 Idx = Order[i];
+				Packed = Pack(&Packer, Widths[Idx], Heights[Idx], &X[Idx], &Y[Idx]);
+			}
+			if (Packed)
+			{
+				*AtlasWidth = Width;
+				*AtlasHeight = PowerOfTwo ? Height : Max(Packer.UsedHeight, 1u);
+			}
+			Free(&Packer);
+		}
+	}
+
+	free(Order);
+	return Packed;
+}
+}
+}
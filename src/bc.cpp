@@ -0,0 +1,1024 @@
+#include "bc.h"
+#include "mip.h"
+#include "jobs.h"
+#include "simd.h"
+#include "log.h"
+#include "GL/glew.h"
+
+#include <cfloat>
+#include <cmath>
+
+namespace rf {
+namespace bc {
+
+uint32 BlockBytes(bc_format Format)
+{
+	switch (Format)
+	{
+	case BC1:
+	case BC4:
+		return 8;
+	case BC3:
+	case BC5:
+	case BC7:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+uint64 MipSize(bc_format Format, uint32 Width, uint32 Height)
+{
+	return (((uint64)Width + 3) / 4) * (((uint64)Height + 3) / 4) * BlockBytes(Format);
+}
+
+uint32 GLFormat(bc_format Format, bool SRGB)
+{
+	switch (Format)
+	{
+	case BC1: return SRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	case BC3: return SRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case BC4: return GL_COMPRESSED_RED_RGTC1;
+	case BC5: return GL_COMPRESSED_RG_RGTC2;
+	case BC7: return SRGB ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+	default: return 0;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Block encoders
+// Pixels are kept as floats in [0, 255], one array of 16 values per channel (SoA), so that the palette searches
+// process 4 pixels per SSE2 instruction.
+
+// Fills Indices with the nearest palette entry of each pixel (squared euclidean distance over Channels),
+// and Errors with the squared distance to it
+static void NearestIndices(float const (*Px)[16], int32 Channels, float const (*Pal)[16], int32 PalCount,
+	uint8 *Indices, float *Errors)
+{
+#ifdef RF_SSE2
+	for (int32 i = 0; i < 16; i += 4)
+	{
+		__m128 Best = _mm_set1_ps(FLT_MAX);
+		__m128i BestIdx = _mm_setzero_si128();
+		for (int32 p = 0; p < PalCount; ++p)
+		{
+			__m128 Dist = _mm_setzero_ps();
+			for (int32 c = 0; c < Channels; ++c)
+			{
+				__m128 Diff = _mm_sub_ps(_mm_loadu_ps(&Px[c][i]), _mm_set1_ps(Pal[c][p]));
+				Dist = _mm_add_ps(Dist, _mm_mul_ps(Diff, Diff));
+			}
+			__m128i Closer = _mm_castps_si128(_mm_cmplt_ps(Dist, Best));
+			Best = _mm_min_ps(Dist, Best);
+			BestIdx = _mm_or_si128(_mm_and_si128(Closer, _mm_set1_epi32(p)), _mm_andnot_si128(Closer, BestIdx));
+		}
+
+		int32 Idx[4];
+		_mm_storeu_ps(Errors + i, Best);
+		_mm_storeu_si128((__m128i*)Idx, BestIdx);
+		for (int32 j = 0; j < 4; ++j)
+		{
+			Indices[i + j] = (uint8)Idx[j];
+		}
+	}
+#else
+	for (int32 i = 0; i < 16; ++i)
+	{
+		float Best = FLT_MAX;
+		for (int32 p = 0; p < PalCount; ++p)
+		{
+			float Dist = 0.f;
+			for (int32 c = 0; c < Channels; ++c)
+			{
+				float Diff = Px[c][i] - Pal[c][p];
+				Dist += Diff * Diff;
+			}
+			if (Dist < Best)
+			{
+				Best = Dist;
+				Indices[i] = (uint8)p;
+			}
+		}
+		Errors[i] = Best;
+	}
+#endif
+}
+
+// Principal axis of the weighted pixels (power iteration on the covariance matrix), returns the mean in Mean.
+// Axis is left at 0 for uniform blocks, and blocks without weighted pixels.
+static void PrincipalAxis(float const (*Px)[16], int32 Channels, float const *Weights, float *Mean, float *Axis)
+{
+	float WeightSum = 0.f;
+	for (int32 c = 0; c < Channels; ++c)
+		Mean[c] = 0.f;
+	for (int32 i = 0; i < 16; ++i)
+	{
+		WeightSum += Weights[i];
+		for (int32 c = 0; c < Channels; ++c)
+			Mean[c] += Px[c][i] * Weights[i];
+	}
+	for (int32 c = 0; c < Channels; ++c)
+	{
+		Mean[c] /= Max(WeightSum, 1.f);
+		Axis[c] = 0.f;
+	}
+	if (WeightSum == 0.f)
+		return;
+
+	float Cov[4][4] = {};
+	float Lo[4], Hi[4];
+	for (int32 c = 0; c < Channels; ++c)
+	{
+		Lo[c] = FLT_MAX;
+		Hi[c] = -FLT_MAX;
+	}
+	for (int32 i = 0; i < 16; ++i)
+	{
+		if (Weights[i] == 0.f)
+			continue;
+		for (int32 a = 0; a < Channels; ++a)
+		{
+			float Da = Px[a][i] - Mean[a];
+			Lo[a] = Min(Lo[a], Px[a][i]);
+			Hi[a] = Max(Hi[a], Px[a][i]);
+			for (int32 b = a; b < Channels; ++b)
+				Cov[a][b] += Da * (Px[b][i] - Mean[b]) * Weights[i];
+		}
+	}
+	for (int32 a = 0; a < Channels; ++a)
+		for (int32 b = 0; b < a; ++b)
+			Cov[a][b] = Cov[b][a];
+
+	// Start from the bounding box diagonal, already close to the axis for most blocks
+	float Norm = 0.f;
+	for (int32 c = 0; c < Channels; ++c)
+	{
+		Axis[c] = Hi[c] - Lo[c];
+		Norm += Axis[c] * Axis[c];
+	}
+	if (Norm < 1e-6f)
+	{
+		for (int32 c = 0; c < Channels; ++c)
+			Axis[c] = 0.f;
+		return;
+	}
+
+	for (int32 Iter = 0; Iter < 8; ++Iter)
+	{
+		float V[4];
+		Norm = 0.f;
+		for (int32 a = 0; a < Channels; ++a)
+		{
+			V[a] = 0.f;
+			for (int32 b = 0; b < Channels; ++b)
+				V[a] += Cov[a][b] * Axis[b];
+			Norm += V[a] * V[a];
+		}
+		if (Norm < 1e-12f)
+			break;
+		Norm = 1.f / sqrtf(Norm);
+		for (int32 c = 0; c < Channels; ++c)
+			Axis[c] = V[c] * Norm;
+	}
+
+	// Normalize again in case the iteration stopped on the unnormalized bbox diagonal
+	Norm = 0.f;
+	for (int32 c = 0; c < Channels; ++c)
+		Norm += Axis[c] * Axis[c];
+	Norm = 1.f / sqrtf(Norm);
+	for (int32 c = 0; c < Channels; ++c)
+		Axis[c] *= Norm;
+}
+
+// Endpoints at the extremes of the pixels projected on the principal axis, inset by Inset of the range
+static void AxisEndpoints(float const (*Px)[16], int32 Channels, float const *Weights, float Inset, float *A, float *B)
+{
+	float Mean[4], Axis[4];
+	PrincipalAxis(Px, Channels, Weights, Mean, Axis);
+
+	float TMin = FLT_MAX, TMax = -FLT_MAX;
+	for (int32 i = 0; i < 16; ++i)
+	{
+		if (Weights[i] == 0.f)
+			continue;
+		float T = 0.f;
+		for (int32 c = 0; c < Channels; ++c)
+			T += (Px[c][i] - Mean[c]) * Axis[c];
+		TMin = Min(TMin, T);
+		TMax = Max(TMax, T);
+	}
+	if (TMin > TMax)
+	{
+		TMin = TMax = 0.f;
+	}
+
+	float InsetT = (TMax - TMin) * Inset;
+	TMin += InsetT;
+	TMax -= InsetT;
+	for (int32 c = 0; c < Channels; ++c)
+	{
+		A[c] = Clamp(Mean[c] + Axis[c] * TMin, 0.f, 255.f);
+		B[c] = Clamp(Mean[c] + Axis[c] * TMax, 0.f, 255.f);
+	}
+}
+
+// Least squares endpoints A, B such that Px ~ A + T * (B - A), T being the palette weight of each pixel's index.
+// Returns false if the system is degenerate (all pixels on the same weight).
+static bool LeastSquaresEndpoints(float const (*Px)[16], int32 Channels, float const *Weights, uint8 const *Indices,
+	float const *IndexT, float *A, float *B)
+{
+	float AA = 0.f, AB = 0.f, BB = 0.f;
+	float AX[4] = {}, BX[4] = {};
+	for (int32 i = 0; i < 16; ++i)
+	{
+		if (Weights[i] == 0.f)
+			continue;
+		float T = IndexT[Indices[i]];
+		float S = 1.f - T;
+		AA += S * S;
+		AB += S * T;
+		BB += T * T;
+		for (int32 c = 0; c < Channels; ++c)
+		{
+			AX[c] += S * Px[c][i];
+			BX[c] += T * Px[c][i];
+		}
+	}
+
+	float Det = AA * BB - AB * AB;
+	if (fabsf(Det) < 1e-6f)
+		return false;
+
+	float InvDet = 1.f / Det;
+	for (int32 c = 0; c < Channels; ++c)
+	{
+		A[c] = Clamp((AX[c] * BB - BX[c] * AB) * InvDet, 0.f, 255.f);
+		B[c] = Clamp((BX[c] * AA - AX[c] * AB) * InvDet, 0.f, 255.f);
+	}
+	return true;
+}
+
+static void LoadPixels(uint8 const *Pixels, float (*Px)[16])
+{
+	for (int32 i = 0; i < 16; ++i)
+		for (int32 c = 0; c < 4; ++c)
+			Px[c][i] = (float)Pixels[i * 4 + c];
+}
+
+//// BC1
+
+static uint16 Pack565(float const *Color)
+{
+	uint32 R = (uint32)(Clamp(Color[0], 0.f, 255.f) * (31.f / 255.f) + 0.5f);
+	uint32 G = (uint32)(Clamp(Color[1], 0.f, 255.f) * (63.f / 255.f) + 0.5f);
+	uint32 B = (uint32)(Clamp(Color[2], 0.f, 255.f) * (31.f / 255.f) + 0.5f);
+	return (uint16)((R << 11) | (G << 5) | B);
+}
+
+static void Unpack565(uint16 C, float *Color)
+{
+	uint32 R = (C >> 11) & 31, G = (C >> 5) & 63, B = C & 31;
+	Color[0] = (float)((R << 3) | (R >> 2));
+	Color[1] = (float)((G << 2) | (G >> 4));
+	Color[2] = (float)((B << 3) | (B >> 2));
+}
+
+struct bc1_block
+{
+	uint16	C0, C1;
+	uint8	Indices[16];
+	float	Error;
+};
+
+// Palette positions of the indices, as the T of A + T * (B - A)
+static float const BC1T4[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+static float const BC1T3[4] = { 0.f, 1.f, 0.5f, 0.f };
+
+// Quantizes the endpoints and picks the indices. ThreeColor : c0 <= c1 mode, with index 3 for transparent pixels
+static void EvalBC1(float const (*Px)[16], float const *Weights, float const *A, float const *B, bool ThreeColor,
+	bc1_block *Block)
+{
+	uint16 C0 = Pack565(A), C1 = Pack565(B);
+	if (ThreeColor ? (C0 > C1) : (C0 < C1))
+	{
+		uint16 Tmp = C0; C0 = C1; C1 = Tmp;
+	}
+	Block->C0 = C0;
+	Block->C1 = C1;
+
+	if (!ThreeColor && C0 == C1)
+	{ // would be decoded in 3-color mode, index 0 is the only safe one
+		float Color[3];
+		Unpack565(C0, Color);
+		Block->Error = 0.f;
+		for (int32 i = 0; i < 16; ++i)
+		{
+			Block->Indices[i] = 0;
+			for (int32 c = 0; c < 3; ++c)
+				Block->Error += (Px[c][i] - Color[c]) * (Px[c][i] - Color[c]) * Weights[i];
+		}
+		return;
+	}
+
+	float E0[3], E1[3];
+	Unpack565(C0, E0);
+	Unpack565(C1, E1);
+
+	float const *T = ThreeColor ? BC1T3 : BC1T4;
+	int32 PalCount = ThreeColor ? 3 : 4;
+	float Pal[3][16];
+	for (int32 p = 0; p < PalCount; ++p)
+		for (int32 c = 0; c < 3; ++c)
+			Pal[c][p] = E0[c] + T[p] * (E1[c] - E0[c]);
+
+	float Errors[16];
+	NearestIndices(Px, 3, Pal, PalCount, Block->Indices, Errors);
+
+	Block->Error = 0.f;
+	for (int32 i = 0; i < 16; ++i)
+	{
+		if (Weights[i] == 0.f)
+			Block->Indices[i] = 3;
+		else
+			Block->Error += Errors[i];
+	}
+}
+
+static void EncodeBC1(float const (*Px)[16], bool AllowAlpha, uint8 *Dst)
+{
+	// Transparent pixels don't weigh in the endpoints, and use index 3 in 3-color mode
+	float Weights[16];
+	bool ThreeColor = false;
+	for (int32 i = 0; i < 16; ++i)
+	{
+		bool Transparent = AllowAlpha && Px[3][i] < 128.f;
+		Weights[i] = Transparent ? 0.f : 1.f;
+		ThreeColor |= Transparent;
+	}
+
+	if (AllowAlpha)
+	{
+		bool AllTransparent = true;
+		for (int32 i = 0; i < 16; ++i)
+			AllTransparent &= Weights[i] == 0.f;
+		if (AllTransparent)
+		{ // 3-color mode (C0 <= C1), every index 3
+			memset(Dst, 0, 4);
+			memset(Dst + 4, 0xFF, 4);
+			return;
+		}
+	}
+
+	bc1_block Best;
+	float A[4], B[4];
+	AxisEndpoints(Px, 3, Weights, 1.f / 16.f, A, B);
+	EvalBC1(Px, Weights, A, B, ThreeColor, &Best);
+
+	// Refine the endpoints from the chosen indices
+	for (int32 Iter = 0; Iter < 2 && Best.Error > 0.f; ++Iter)
+	{
+		if (!LeastSquaresEndpoints(Px, 3, Weights, Best.Indices, ThreeColor ? BC1T3 : BC1T4, A, B))
+			break;
+
+		bc1_block Block;
+		EvalBC1(Px, Weights, A, B, ThreeColor, &Block);
+		if (Block.Error >= Best.Error)
+			break;
+		Best = Block;
+	}
+
+	uint32 Bits = 0;
+	for (int32 i = 0; i < 16; ++i)
+		Bits |= (uint32)Best.Indices[i] << (2 * i);
+
+	Dst[0] = (uint8)(Best.C0 & 0xFF);
+	Dst[1] = (uint8)(Best.C0 >> 8);
+	Dst[2] = (uint8)(Best.C1 & 0xFF);
+	Dst[3] = (uint8)(Best.C1 >> 8);
+	memcpy(Dst + 4, &Bits, 4);
+}
+
+//// BC4, also the alpha block of BC3
+
+static void EncodeBC4(float const *Values, uint8 *Dst)
+{
+	float Lo = 255.f, Hi = 0.f;
+	for (int32 i = 0; i < 16; ++i)
+	{
+		Lo = Min(Lo, Values[i]);
+		Hi = Max(Hi, Values[i]);
+	}
+
+	// 8-value mode (E0 > E1), the 7 intervals between E1 and E0 are equal. Index 0 is E0, 1 is E1, 2..7 go from E0 to E1
+	uint32 E0 = (uint32)Hi, E1 = (uint32)Lo;
+	uint64 Bits = 0;
+	if (E0 > E1)
+	{
+		float Scale = 7.f / (Hi - Lo);
+		for (int32 i = 0; i < 16; ++i)
+		{
+			uint32 Step = (uint32)((Values[i] - Lo) * Scale + 0.5f); // 0 at E1 .. 7 at E0
+			uint32 Idx = (Step == 0) ? 1 : (Step == 7) ? 0 : 8 - Step;
+			Bits |= (uint64)Idx << (3 * i);
+		}
+	}
+
+	Dst[0] = (uint8)E0;
+	Dst[1] = (uint8)E1;
+	for (int32 b = 0; b < 6; ++b)
+		Dst[2 + b] = (uint8)(Bits >> (8 * b));
+}
+
+//// BC7, mode 6 only
+
+static uint32 const BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct bc7_mode6
+{
+	uint8	Q[2][4];	// 7-bit endpoints
+	uint8	P[2];		// p-bits
+	uint8	Indices[16];
+	float	Error;
+};
+
+// Quantizes an RGBA endpoint to 7 bits + a shared p-bit, picking the p-bit with the smallest error
+static void QuantizeBC7Endpoint(float const *E, uint8 *Q, uint8 *P)
+{
+	float BestErr = FLT_MAX;
+	for (uint32 PBit = 0; PBit < 2; ++PBit)
+	{
+		uint8 Quant[4];
+		float Err = 0.f;
+		for (int32 c = 0; c < 4; ++c)
+		{
+			int32 V = (int32)floorf((E[c] - PBit) * 0.5f + 0.5f);
+			Quant[c] = (uint8)Min(Max(V, 0), 127);
+			float Diff = (float)((Quant[c] << 1) | PBit) - E[c];
+			Err += Diff * Diff;
+		}
+		if (Err < BestErr)
+		{
+			BestErr = Err;
+			memcpy(Q, Quant, 4);
+			*P = (uint8)PBit;
+		}
+	}
+}
+
+static void EvalBC7(float const (*Px)[16], float const *A, float const *B, bc7_mode6 *Block)
+{
+	QuantizeBC7Endpoint(A, Block->Q[0], &Block->P[0]);
+	QuantizeBC7Endpoint(B, Block->Q[1], &Block->P[1]);
+
+	// Palette interpolated like the decoders do, on the 8-bit endpoints
+	float Pal[4][16];
+	for (int32 c = 0; c < 4; ++c)
+	{
+		uint32 E0 = (Block->Q[0][c] << 1) | Block->P[0];
+		uint32 E1 = (Block->Q[1][c] << 1) | Block->P[1];
+		for (int32 p = 0; p < 16; ++p)
+			Pal[c][p] = (float)(((64 - BC7Weights4[p]) * E0 + BC7Weights4[p] * E1 + 32) >> 6);
+	}
+
+	float Errors[16];
+	NearestIndices(Px, 4, Pal, 16, Block->Indices, Errors);
+
+	Block->Error = 0.f;
+	for (int32 i = 0; i < 16; ++i)
+		Block->Error += Errors[i];
+}
+
+// Little-endian bit writer for the 128-bit BC7 blocks
+static void WriteBits(uint8 *Dst, uint32 *BitPos, uint32 Value, uint32 Count)
+{
+	for (uint32 b = 0; b < Count; ++b, ++*BitPos)
+	{
+		if ((Value >> b) & 1)
+			Dst[*BitPos >> 3] |= (uint8)(1 << (*BitPos & 7));
+	}
+}
+
+static void EncodeBC7(float const (*Px)[16], uint8 *Dst)
+{
+	float const Weights[16] = { 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f };
+	float IndexT[16];
+	for (int32 p = 0; p < 16; ++p)
+		IndexT[p] = BC7Weights4[p] / 64.f;
+
+	bc7_mode6 Best;
+	float A[4], B[4];
+	AxisEndpoints(Px, 4, Weights, 0.f, A, B);
+	EvalBC7(Px, A, B, &Best);
+
+	for (int32 Iter = 0; Iter < 2 && Best.Error > 0.f; ++Iter)
+	{
+		if (!LeastSquaresEndpoints(Px, 4, Weights, Best.Indices, IndexT, A, B))
+			break;
+
+		bc7_mode6 Block;
+		EvalBC7(Px, A, B, &Block);
+		if (Block.Error >= Best.Error)
+			break;
+		Best = Block;
+	}
+
+	// The MSB of the first index is implicit 0 : swap the endpoints if needed
+	if (Best.Indices[0] & 8)
+	{
+		for (int32 c = 0; c < 4; ++c)
+		{
+			uint8 Tmp = Best.Q[0][c]; Best.Q[0][c] = Best.Q[1][c]; Best.Q[1][c] = Tmp;
+		}
+		uint8 Tmp = Best.P[0]; Best.P[0] = Best.P[1]; Best.P[1] = Tmp;
+		for (int32 i = 0; i < 16; ++i)
+			Best.Indices[i] = 15 - Best.Indices[i];
+	}
+
+	memset(Dst, 0, 16);
+	uint32 BitPos = 0;
+	WriteBits(Dst, &BitPos, 1 << 6, 7); // mode 6
+	for (int32 c = 0; c < 4; ++c)
+	{
+		WriteBits(Dst, &BitPos, Best.Q[0][c], 7);
+		WriteBits(Dst, &BitPos, Best.Q[1][c], 7);
+	}
+	WriteBits(Dst, &BitPos, Best.P[0], 1);
+	WriteBits(Dst, &BitPos, Best.P[1], 1);
+	WriteBits(Dst, &BitPos, Best.Indices[0], 3);
+	for (int32 i = 1; i < 16; ++i)
+		WriteBits(Dst, &BitPos, Best.Indices[i], 4);
+}
+
+void EncodeBlock(bc_format Format, uint8 const *Pixels, uint8 *Dst)
+{
+	float Px[4][16];
+	LoadPixels(Pixels, Px);
+
+	switch (Format)
+	{
+	case BC1:
+		EncodeBC1(Px, true, Dst);
+		break;
+	case BC3:
+		EncodeBC4(Px[3], Dst);
+		EncodeBC1(Px, false, Dst + 8);
+		break;
+	case BC4:
+		EncodeBC4(Px[0], Dst);
+		break;
+	case BC5:
+		EncodeBC4(Px[0], Dst);
+		EncodeBC4(Px[1], Dst + 8);
+		break;
+	case BC7:
+		EncodeBC7(Px, Dst);
+		break;
+	default:
+		break;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Image encoding
+
+#define BC_JOB_BLOCK_ROWS 4
+
+struct encode_job
+{
+	bc_format	Format;
+	uint8 const *RGBA;
+	uint32		Width, Height;
+	uint8		*Dst;
+	uint32		RowBegin, RowEnd;	// block rows
+};
+
+static void EncodeRows(void *UserData)
+{
+	encode_job const *Job = (encode_job const*)UserData;
+	uint32 BlocksX = (Job->Width + 3) / 4;
+	uint32 BlockBytes = bc::BlockBytes(Job->Format);
+
+	uint8 Pixels[64];
+	for (uint32 by = Job->RowBegin; by < Job->RowEnd; ++by)
+	{
+		uint8 *Dst = Job->Dst + (uint64)by * BlocksX * BlockBytes;
+		for (uint32 bx = 0; bx < BlocksX; ++bx, Dst += BlockBytes)
+		{
+			// Edge blocks repeat the last row/column
+			for (uint32 y = 0; y < 4; ++y)
+			{
+				uint32 SrcY = Min(by * 4 + y, Job->Height - 1);
+				for (uint32 x = 0; x < 4; ++x)
+				{
+					uint32 SrcX = Min(bx * 4 + x, Job->Width - 1);
+					memcpy(Pixels + (y * 4 + x) * 4, Job->RGBA + ((uint64)SrcY * Job->Width + SrcX) * 4, 4);
+				}
+			}
+			EncodeBlock(Job->Format, Pixels, Dst);
+		}
+	}
+}
+
+void Encode(bc_format Format, uint8 const *RGBA, uint32 Width, uint32 Height, uint8 *Dst)
+{
+	uint32 BlocksY = (Height + 3) / 4;
+	uint32 JobCount = (BlocksY + BC_JOB_BLOCK_ROWS - 1) / BC_JOB_BLOCK_ROWS;
+	encode_job *Jobs = (encode_job*)malloc(JobCount * sizeof(encode_job));
+
+	job_group Group = {};
+	for (uint32 j = 0; j < JobCount; ++j)
+	{
+		encode_job &Job = Jobs[j];
+		Job.Format = Format;
+		Job.RGBA = RGBA;
+		Job.Width = Width;
+		Job.Height = Height;
+		Job.Dst = Dst;
+		Job.RowBegin = j * BC_JOB_BLOCK_ROWS;
+		Job.RowEnd = Min(Job.RowBegin + BC_JOB_BLOCK_ROWS, BlocksY);
+		jobs::Submit(&Group, EncodeRows, &Job);
+	}
+	jobs::Wait(&Group);
+
+	free(Jobs);
+}
+
+bool EncodeTexture(compressed_texture *Texture, bc_format Format, bool SRGB, uint8 const *RGBA, uint32 Width,
+	uint32 Height, bool MakeMips)
+{
+	memset(Texture, 0, sizeof(compressed_texture));
+	if (!BlockBytes(Format) || !Width || !Height)
+		return false;
+
+	uint32 MipCount = 1;
+	if (MakeMips)
+	{
+		for (uint32 Size = Max(Width, Height); Size > 1 && MipCount < BC_MAX_MIPS; Size >>= 1)
+			++MipCount;
+	}
+
+	uint64 TotalSize = 0;
+	for (uint32 m = 0; m < MipCount; ++m)
+		TotalSize += MipSize(Format, Max(Width >> m, 1u), Max(Height >> m, 1u));
+
+	Texture->Allocated = (uint8*)malloc(TotalSize);
+	if (!Texture->Allocated)
+		return false;
+
+	Texture->Format = Format;
+	Texture->SRGB = SRGB;
+	Texture->Width = Width;
+	Texture->Height = Height;
+	Texture->MipCount = MipCount;
+
+	mip_chain Chain = {};
+	if (MipCount > 1 && !mip::Generate(&Chain, RGBA, Width, Height, 4, false, SRGB, MIP_KAISER))
+	{
+		FreeTexture(Texture);
+		return false;
+	}
+
+	uint8 *Dst = Texture->Allocated;
+	for (uint32 m = 0; m < MipCount; ++m)
+	{
+		uint32 W = Max(Width >> m, 1u), H = Max(Height >> m, 1u);
+		Encode(Format, m ? (uint8 const*)Chain.Levels[m] : RGBA, W, H, Dst);
+		Texture->Mips[m] = Dst;
+		Texture->MipSizes[m] = MipSize(Format, W, H);
+		Dst += Texture->MipSizes[m];
+	}
+	mip::Free(&Chain);
+
+	return true;
+}
+
+void FreeTexture(compressed_texture *Texture)
+{
+	free(Texture->Allocated);
+	memset(Texture, 0, sizeof(compressed_texture));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Containers
+
+#define MAKE_FOURCC(a, b, c, d) ((uint32)(a) | ((uint32)(b) << 8) | ((uint32)(c) << 16) | ((uint32)(d) << 24))
+
+#define DDS_MAGIC MAKE_FOURCC('D', 'D', 'S', ' ')
+#define DDS_FOURCC_FLAG 0x4
+#define DDS_CUBEMAP_FLAG 0x200
+#define DDS_VOLUME_FLAG 0x200000
+#define DDS_DIMENSION_TEXTURE2D 3
+
+struct dds_pixel_format
+{
+	uint32 Size;
+	uint32 Flags;
+	uint32 FourCC;
+	uint32 RGBBitCount;
+	uint32 RBitMask, GBitMask, BBitMask, ABitMask;
+};
+
+struct dds_header
+{
+	uint32				Size;
+	uint32				Flags;
+	uint32				Height;
+	uint32				Width;
+	uint32				PitchOrLinearSize;
+	uint32				Depth;
+	uint32				MipMapCount;
+	uint32				Reserved1[11];
+	dds_pixel_format	PixelFormat;
+	uint32				Caps, Caps2, Caps3, Caps4;
+	uint32				Reserved2;
+};
+
+struct dds_header_dx10
+{
+	uint32 DXGIFormat;
+	uint32 ResourceDimension;
+	uint32 MiscFlag;
+	uint32 ArraySize;
+	uint32 MiscFlags2;
+};
+
+struct dxgi_format_entry
+{
+	uint32		DXGIFormat;
+	bc_format	Format;
+	bool		SRGB;
+};
+
+static dxgi_format_entry const DXGIFormats[] = {
+	{ 70, BC1, false }, { 71, BC1, false }, { 72, BC1, true },
+	{ 76, BC3, false }, { 77, BC3, false }, { 78, BC3, true },
+	{ 79, BC4, false }, { 80, BC4, false },
+	{ 82, BC5, false }, { 83, BC5, false },
+	{ 97, BC7, false }, { 98, BC7, false }, { 99, BC7, true },
+};
+
+// Levels announced by a file : at least one, at most the full chain of the texture
+static uint32 ClampMipCount(uint32 FileMipCount, uint32 Width, uint32 Height)
+{
+	return Min(Min(Max(FileMipCount, 1u), mip::LevelCount(Width, Height)), (uint32)BC_MAX_MIPS);
+}
+
+// Fills the mip pointers of a texture whose levels are contiguous from Data, once checked they all fit in Size bytes
+static bool SetContiguousMips(compressed_texture *Texture, uint8 const *Data, uint64 Size)
+{
+	uint64 TotalSize = 0;
+	for (uint32 m = 0; m < Texture->MipCount; ++m)
+	{
+		Texture->MipSizes[m] = MipSize(Texture->Format, Max(Texture->Width >> m, 1u), Max(Texture->Height >> m, 1u));
+		TotalSize += Texture->MipSizes[m];
+	}
+	if (TotalSize > Size)
+		return false;
+
+	uint64 Offset = 0;
+	for (uint32 m = 0; m < Texture->MipCount; ++m)
+	{
+		Texture->Mips[m] = Data + Offset;
+		Offset += Texture->MipSizes[m];
+	}
+	return true;
+}
+
+bool ParseDDS(compressed_texture *Texture, uint8 const *Data, uint64 Size)
+{
+	memset(Texture, 0, sizeof(compressed_texture));
+
+	dds_header Header;
+	if (Size < 4 + sizeof(dds_header) || *(uint32 const*)Data != DDS_MAGIC)
+		return false;
+	memcpy(&Header, Data + 4, sizeof(dds_header));
+	uint64 Offset = 4 + sizeof(dds_header);
+
+	if (!(Header.PixelFormat.Flags & DDS_FOURCC_FLAG))
+	{
+		LogError("DDS : only block-compressed formats are supported.");
+		return false;
+	}
+
+	switch (Header.PixelFormat.FourCC)
+	{
+	case MAKE_FOURCC('D', 'X', 'T', '1'): Texture->Format = BC1; break;
+	case MAKE_FOURCC('D', 'X', 'T', '5'): Texture->Format = BC3; break;
+	case MAKE_FOURCC('A', 'T', 'I', '1'):
+	case MAKE_FOURCC('B', 'C', '4', 'U'): Texture->Format = BC4; break;
+	case MAKE_FOURCC('A', 'T', 'I', '2'):
+	case MAKE_FOURCC('B', 'C', '5', 'U'): Texture->Format = BC5; break;
+	case MAKE_FOURCC('D', 'X', '1', '0'):
+	{
+		dds_header_dx10 Header10;
+		if (Size - Offset < sizeof(dds_header_dx10))
+			return false;
+		memcpy(&Header10, Data + Offset, sizeof(dds_header_dx10));
+		Offset += sizeof(dds_header_dx10);
+
+		if (Header10.ResourceDimension != DDS_DIMENSION_TEXTURE2D || Header10.ArraySize > 1 || (Header10.MiscFlag & 0x4))
+		{
+			LogError("DDS : only single 2D textures are supported.");
+			return false;
+		}
+		for (uint32 i = 0; i < sizeof(DXGIFormats) / sizeof(DXGIFormats[0]); ++i)
+		{
+			if (DXGIFormats[i].DXGIFormat == Header10.DXGIFormat)
+			{
+				Texture->Format = DXGIFormats[i].Format;
+				Texture->SRGB = DXGIFormats[i].SRGB;
+			}
+		}
+	} break;
+	default:
+		break;
+	}
+
+	if (Texture->Format == BC_NONE)
+	{
+		LogError("DDS : unsupported pixel format.");
+		return false;
+	}
+	if (Header.Caps2 & (DDS_CUBEMAP_FLAG | DDS_VOLUME_FLAG))
+	{
+		LogError("DDS : only single 2D textures are supported.");
+		return false;
+	}
+
+	Texture->Width = Header.Width;
+	Texture->Height = Header.Height;
+	Texture->MipCount = ClampMipCount(Header.MipMapCount, Header.Width, Header.Height);
+	if (!Texture->Width || !Texture->Height || !SetContiguousMips(Texture, Data + Offset, Size - Offset))
+	{
+		LogError("DDS : invalid or truncated file.");
+		return false;
+	}
+	return true;
+}
+
+static uint8 const KTX2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+struct ktx2_header
+{
+	uint8	Identifier[12];
+	uint32	VkFormat;
+	uint32	TypeSize;
+	uint32	PixelWidth;
+	uint32	PixelHeight;
+	uint32	PixelDepth;
+	uint32	LayerCount;
+	uint32	FaceCount;
+	uint32	LevelCount;
+	uint32	SupercompressionScheme;
+	uint32	DFDByteOffset;
+	uint32	DFDByteLength;
+	uint32	KVDByteOffset;
+	uint32	KVDByteLength;
+	uint64	SGDByteOffset;
+	uint64	SGDByteLength;
+};
+
+struct ktx2_level
+{
+	uint64 ByteOffset;
+	uint64 ByteLength;
+	uint64 UncompressedByteLength;
+};
+
+struct vk_format_entry
+{
+	uint32		VkFormat;
+	bc_format	Format;
+	bool		SRGB;
+};
+
+static vk_format_entry const VkFormats[] = {
+	{ 131, BC1, false }, { 132, BC1, true }, { 133, BC1, false }, { 134, BC1, true },
+	{ 137, BC3, false }, { 138, BC3, true },
+	{ 139, BC4, false },
+	{ 141, BC5, false },
+	{ 145, BC7, false }, { 146, BC7, true },
+};
+
+bool ParseKTX2(compressed_texture *Texture, uint8 const *Data, uint64 Size)
+{
+	memset(Texture, 0, sizeof(compressed_texture));
+
+	ktx2_header Header;
+	if (Size < sizeof(ktx2_header) || memcmp(Data, KTX2Identifier, sizeof(KTX2Identifier)))
+		return false;
+	memcpy(&Header, Data, sizeof(ktx2_header));
+
+	for (uint32 i = 0; i < sizeof(VkFormats) / sizeof(VkFormats[0]); ++i)
+	{
+		if (VkFormats[i].VkFormat == Header.VkFormat)
+		{
+			Texture->Format = VkFormats[i].Format;
+			Texture->SRGB = VkFormats[i].SRGB;
+		}
+	}
+
+	if (Texture->Format == BC_NONE)
+	{
+		LogError("KTX2 : unsupported format (VkFormat %u).", Header.VkFormat);
+		return false;
+	}
+	if (Header.SupercompressionScheme != 0)
+	{
+		LogError("KTX2 : supercompressed files are not supported.");
+		return false;
+	}
+	if (Header.PixelDepth > 1 || Header.LayerCount > 1 || Header.FaceCount != 1)
+	{
+		LogError("KTX2 : only single 2D textures are supported.");
+		return false;
+	}
+
+	Texture->Width = Header.PixelWidth;
+	Texture->Height = Header.PixelHeight;
+	Texture->MipCount = ClampMipCount(Header.LevelCount, Header.PixelWidth, Header.PixelHeight);
+	if (!Texture->Width || !Texture->Height || Size - sizeof(ktx2_header) < Texture->MipCount * sizeof(ktx2_level))
+	{
+		LogError("KTX2 : invalid or truncated file.");
+		return false;
+	}
+
+	// Levels are not necessarily contiguous nor in order in the file, the level index gives each one
+	ktx2_level const *Levels = (ktx2_level const*)(Data + sizeof(ktx2_header));
+	for (uint32 m = 0; m < Texture->MipCount; ++m)
+	{
+		ktx2_level Level;
+		memcpy(&Level, Levels + m, sizeof(ktx2_level));
+
+		uint64 LevelSize = MipSize(Texture->Format, Max(Texture->Width >> m, 1u), Max(Texture->Height >> m, 1u));
+		if (Level.ByteLength < LevelSize || Level.ByteOffset > Size || Size - Level.ByteOffset < LevelSize)
+		{
+			LogError("KTX2 : invalid or truncated file.");
+			return false;
+		}
+		Texture->Mips[m] = Data + Level.ByteOffset;
+		Texture->MipSizes[m] = LevelSize;
+	}
+	return true;
+}
+
+bool WriteDDS(path const Filename, compressed_texture const *Texture)
+{
+	uint32 DXGIFormat = 0;
+	for (uint32 i = 0; i < sizeof(DXGIFormats) / sizeof(DXGIFormats[0]); ++i)
+	{
+		// first typed (not typeless) entry of the format
+		if (DXGIFormats[i].Format == Texture->Format && DXGIFormats[i].SRGB == Texture->SRGB &&
+			DXGIFormats[i].DXGIFormat != 70 && DXGIFormats[i].DXGIFormat != 76 && DXGIFormats[i].DXGIFormat != 79 &&
+			DXGIFormats[i].DXGIFormat != 82 && DXGIFormats[i].DXGIFormat != 97)
+		{
+			DXGIFormat = DXGIFormats[i].DXGIFormat;
+			break;
+		}
+	}
+	if (!DXGIFormat)
+	{
+		LogError("Can't write %s : unsupported format.", Filename);
+		return false;
+	}
+
+	FILE *fp = fopen(Filename, "wb");
+	if (!fp)
+	{
+		LogError("Couldn't open %s for writing.", Filename);
+		return false;
+	}
+
+	dds_header Header = {};
+	Header.Size = sizeof(dds_header);
+	Header.Flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // caps, height, width, pixelformat, mipmapcount, linearsize
+	Header.Height = Texture->Height;
+	Header.Width = Texture->Width;
+	Header.PitchOrLinearSize = (uint32)Texture->MipSizes[0];
+	Header.MipMapCount = Texture->MipCount;
+	Header.PixelFormat.Size = sizeof(dds_pixel_format);
+	Header.PixelFormat.Flags = DDS_FOURCC_FLAG;
+	Header.PixelFormat.FourCC = MAKE_FOURCC('D', 'X', '1', '0');
+	Header.Caps = 0x1000 | (Texture->MipCount > 1 ? (0x8 | 0x400000) : 0); // texture, complex + mipmap
+
+	dds_header_dx10 Header10 = {};
+	Header10.DXGIFormat = DXGIFormat;
+	Header10.ResourceDimension = DDS_DIMENSION_TEXTURE2D;
+	Header10.ArraySize = 1;
+
+	uint32 Magic = DDS_MAGIC;
+	fwrite(&Magic, sizeof(Magic), 1, fp);
+	fwrite(&Header, sizeof(Header), 1, fp);
+	fwrite(&Header10, sizeof(Header10), 1, fp);
+	for (uint32 m = 0; m < Texture->MipCount; ++m)
+	{
+		fwrite(Texture->Mips[m], 1, Texture->MipSizes[m], fp);
+	}
+
+	bool Success = !ferror(fp);
+	fclose(fp);
+	return Success;
+}
+
+}
+}
@@ -1,6 +1,12 @@
 #include "context.h"
 #include "utils.h"
 #include "ui.h"
+#include "watch.h"
+#include "vfs.h"
+#include "jobs.h"
+#include "io.h"
+#include "simd.h"
+#include "trace.h"
 //#include "sound.h"
 
 namespace rf {
@@ -161,6 +167,8 @@ static void InitResourceMgr(context *Context)
 	Context->RenderResources.Images = MapStore(Context->SessionPool, 64);
 	Context->RenderResources.Textures = MapStore(Context->SessionPool, 64);
 	Context->RenderResources.Fonts = MapStore(Context->SessionPool, 64);
+	Context->RenderResources.Pool = Context->SessionPool;
+	Context->RenderResources.Entries = Buf<resource_entry*>(Context->SessionPool, 64);
 }
 
 context *Init(context_descriptor const *Desc)
@@ -171,6 +179,9 @@ context *Init(context_descriptor const *Desc)
 		exit(1);
 	}
 
+	trace::Init();
+	uint64 InitStart = trace::Now(), PhaseStart = InitStart;
+
 	bool GLFWValid = false, GLEWValid = false;//, SoundValid = false;
 
 	context *Context = rf::PoolAlloc<context>(Desc->SessionPool, 1);
@@ -180,14 +191,45 @@ context *Init(context_descriptor const *Desc)
 	InitResourceMgr(Context);
 
 	log::Init(Context);
+	trace::Span("init", "Resource manager & log", NULL, PhaseStart);
 
+	Context->RenderResources.MipFilter = Desc->MipFilter;
+	if (Desc->MipCache)
+	{
+		path CacheDir;
+		ConcatStrings(CacheDir, Context->RenderResources.ExecutablePath, "cache/");
+		if (DiskCreateDirectory(CacheDir))
+			strncpy(Context->RenderResources.MipCacheDir, CacheDir, MAX_PATH);
+		else
+			LogError("Can't create the mip cache directory %s, mip chains won't be cached.", CacheDir);
+	}
+
+	if (Desc->HotReload)
+	{
+		PhaseStart = trace::Now();
+		watch::Init(Context);
+		trace::Span("init", "watch::Init", NULL, PhaseStart);
+	}
+
+	PhaseStart = trace::Now();
 	GetSystemInfo(Context->SysInfo);
 	LogInfo("%s %u.%u.%u", Context->SysInfo.OSVersion.OSName, Context->SysInfo.OSVersion.Major, Context->SysInfo.OSVersion.Minor, Context->SysInfo.OSVersion.Build);
 	LogInfo("CPU : [%s] %s, %d cores at %.2lf GHz", Context->SysInfo.CPUName, Context->SysInfo.CPUBrand, Context->SysInfo.CPUCountLogical, Context->SysInfo.CPUGHz);
 	LogInfo("Using %d MB RAM", Context->SysInfo.SystemMB);
 	LogInfo("SSE Support : %s", Context->SysInfo.SSESupport ? "yes" : "no");
+	LogInfo("SSSE3 Support : %s, F16C Support : %s", simd::HasSSSE3() ? "yes" : "no", simd::HasF16C() ? "yes" : "no");
+
+	trace::Span("init", "GetSystemInfo", NULL, PhaseStart);
+
+	PhaseStart = trace::Now();
+	int32 WorkerThreads = Desc->WorkerThreads ? Desc->WorkerThreads : Context->SysInfo.CPUCountLogical - 1;
+	jobs::Init((uint32)Max(WorkerThreads, 0));
+	LogInfo("Using %u worker threads", jobs::WorkerCount());
+	trace::Span("init", "jobs::Init", NULL, PhaseStart);
 
+	PhaseStart = trace::Now();
 	GLFWValid = glfwInit() == GLFW_TRUE;
+	trace::Span("init", "glfwInit", NULL, PhaseStart);
 	if (Context && GLFWValid)
 	{
 		glfwSetErrorCallback(ProcessErrorEvent);
@@ -201,9 +243,12 @@ context *Init(context_descriptor const *Desc)
 		int AAlvl = std::max(0, std::min(8, Desc->AALevel));
 		glfwWindowHint(GLFW_SAMPLES, AAlvl);
 
+		PhaseStart = trace::Now();
 		Context->Window = glfwCreateWindow(Desc->WindowWidth, Desc->WindowHeight, Desc->ExecutableName, NULL, NULL);
+		trace::Span("init", "glfwCreateWindow", NULL, PhaseStart);
 		if (Context->Window)
 		{
+			PhaseStart = trace::Now();
 			glfwMakeContextCurrent(Context->Window);
 
 			// TODO - Only in windowed mode for debug
@@ -219,9 +264,14 @@ context *Init(context_descriptor const *Desc)
 			CursorHResize = glfwCreateStandardCursor(GLFW_HRESIZE_CURSOR);
 			CursorVResize = glfwCreateStandardCursor(GLFW_VRESIZE_CURSOR);
 
+			trace::Span("init", "Window setup", NULL, PhaseStart);
+
+			PhaseStart = trace::Now();
 			GLEWValid = (GLEW_OK == glewInit());
+			trace::Span("init", "glewInit", NULL, PhaseStart);
 			if (GLEWValid)
 			{
+				PhaseStart = trace::Now();
 				GLubyte const *GLVendor = glGetString(GL_VENDOR);
 				GLubyte const *GLRenderer = glGetString(GL_RENDERER);
 				GLubyte const *GLVersion = glGetString(GL_VERSION);
@@ -247,6 +297,9 @@ context *Init(context_descriptor const *Desc)
 				glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &MaxUBOSize);
 				LogInfo("GL Max Uniforms : [V] %d [F] %d [G] %d", MaxVertexUniforms, MaxFragmentUniforms, MaxGeomUniforms);
 				LogInfo("GL Max UBO Block Size : %d", MaxUBOSize);
+				trace::Span("init", "GL queries", NULL, PhaseStart);
+
+				PhaseStart = trace::Now();
 
 				ResizeWidth = Desc->WindowWidth;
 				ResizeHeight = Desc->WindowHeight;
@@ -296,6 +349,7 @@ context *Init(context_descriptor const *Desc)
 				Context->RenderResources.DefaultEmissiveTexture = rf::PoolAlloc<uint32>(Context->SessionPool, 1);
 				*Context->RenderResources.DefaultEmissiveTexture = Make2DTexture((void*)&texColor, 1, 1, 3, false, false, 1,
 					GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+				trace::Span("init", "GL state & default textures", NULL, PhaseStart);
 			}
 			else
 			{
@@ -321,10 +375,13 @@ context *Init(context_descriptor const *Desc)
 		Context->IsValid = true;
 	}
 
+	PhaseStart = trace::Now();
 	ui::Init(Context);
+	trace::Span("init", "ui::Init", NULL, PhaseStart);
 
 	rf::BindTexture2D(0, 0);
 
+	trace::Span("init", "ctx::Init", NULL, InitStart);
 	return Context;
 }
 
@@ -335,10 +392,13 @@ void GetFrameInput(context *Context, input *Input)
 	memset(FrameReleasedMouseButton, 0, sizeof(FrameReleasedMouseButton));
 	memset(FramePressedMouseButton, 0, sizeof(FramePressedMouseButton));
 
+	trace::FrameMark();
+
 	FrameMouseWheel = 0;
 	Context->HasResized = false;
 
 	glfwPollEvents();
+	watch::Update(Context);
 
 	// NOTE - The mouse position can go outside the Window bounds in windowed mode
 	// See if this can cause problems in the future.
@@ -374,9 +434,11 @@ void Destroy(context *Context)
 {
 	if (Context)
 	{
+		trace::Dump();
 		glDeleteProgram(Context->ProgramPostProcess);
 		//sound::Destroy();
 		ResourceFree(&Context->RenderResources);
+		ui::Destroy();
 
 		if (Context->Window)
 		{
@@ -387,6 +449,10 @@ void Destroy(context *Context)
 		}
 		glfwTerminate();
 
+		watch::Destroy();
+		io::Destroy();
+		jobs::Destroy();
+		vfs::Destroy();
 		log::Destroy();
 	}
 }
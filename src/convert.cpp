@@ -0,0 +1,212 @@
+#include "convert.h"
+#include "simd.h"
+
+#ifdef RF_SSE2
+#include <tmmintrin.h>
+#include <immintrin.h>
+#endif
+
+namespace rf {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// RGB8 to RGBA8
+
+static void RGB8ToRGBA8Scalar(uint8 const *Src, uint8 *Dst, uint64 PixelCount)
+{
+	for (uint64 i = 0; i < PixelCount; ++i, Src += 3, Dst += 4)
+	{
+		Dst[0] = Src[0];
+		Dst[1] = Src[1];
+		Dst[2] = Src[2];
+		Dst[3] = 255;
+	}
+}
+
+#ifdef RF_SSE2
+// 4 pixels per 16-byte load, the loop stops early enough for the 4 extra bytes read to stay in the source
+RF_TARGET("ssse3")
+static uint64 RGB8ToRGBA8SSSE3(uint8 const *Src, uint8 *Dst, uint64 PixelCount)
+{
+	__m128i const Shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	__m128i const Alpha = _mm_set1_epi32((int)0xFF000000);
+
+	uint64 i = 0;
+	for (; i + 6 <= PixelCount; i += 4)
+	{
+		__m128i RGB = _mm_loadu_si128((__m128i const*)(Src + i * 3));
+		_mm_storeu_si128((__m128i*)(Dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(RGB, Shuffle), Alpha));
+	}
+	return i;
+}
+#endif
+
+void convert::RGB8ToRGBA8(uint8 const *Src, uint8 *Dst, uint64 PixelCount)
+{
+	uint64 Done = 0;
+#ifdef RF_SSE2
+	if (simd::HasSSSE3())
+		Done = RGB8ToRGBA8SSSE3(Src, Dst, PixelCount);
+#endif
+	RGB8ToRGBA8Scalar(Src + Done * 3, Dst + Done * 4, PixelCount - Done);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Float to half
+
+// Round to nearest even, the same as the F16C instructions with the default rounding mode
+static uint16 FloatToHalfScalar(real32 Value)
+{
+	uint32 Bits;
+	memcpy(&Bits, &Value, sizeof(Bits));
+	uint32 Sign = (Bits >> 16) & 0x8000;
+	Bits &= 0x7FFFFFFF;
+
+	if (Bits >= (143u << 23)) // >= 65536 (after rounding, 65520 and up overflow, see below), Inf or NaN
+		return (uint16)(Sign | (Bits > (255u << 23) ? 0x7E00 : 0x7C00));
+
+	if (Bits < (113u << 23))
+	{ // Half denormal (or 0) : adding the magic number aligns the mantissa, the FPU rounds to nearest even
+		uint32 const Magic = ((127 - 15) + (23 - 10) + 1) << 23;
+		real32 MagicF, F;
+		memcpy(&MagicF, &Magic, sizeof(Magic));
+		memcpy(&F, &Bits, sizeof(Bits));
+		F += MagicF;
+		memcpy(&Bits, &F, sizeof(Bits));
+		return (uint16)(Sign | (Bits - Magic));
+	}
+
+	// Normal : rebias the exponent and round the mantissa to nearest even. Overflows carry in the exponent,
+	// up to the infinity encoding.
+	uint32 MantissaOdd = (Bits >> 13) & 1;
+	Bits += ((uint32)(15 - 127) << 23) + 0xFFF + MantissaOdd;
+	return (uint16)(Sign | (Bits >> 13));
+}
+
+#ifdef RF_SSE2
+RF_TARGET("avx,f16c")
+static uint64 FloatToHalfF16C(real32 const *Src, uint16 *Dst, uint64 Count)
+{
+	uint64 i = 0;
+	for (; i + 8 <= Count; i += 8)
+	{
+		__m128i Halves = _mm256_cvtps_ph(_mm256_loadu_ps(Src + i), _MM_FROUND_TO_NEAREST_INT);
+		_mm_storeu_si128((__m128i*)(Dst + i), Halves);
+	}
+	return i;
+}
+#endif
+
+void convert::FloatToHalf(real32 const *Src, uint16 *Dst, uint64 Count)
+{
+	uint64 i = 0;
+#ifdef RF_SSE2
+	if (simd::HasF16C())
+		i = FloatToHalfF16C(Src, Dst, Count);
+#endif
+	for (; i < Count; ++i)
+		Dst[i] = FloatToHalfScalar(Src[i]);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Float RGB to RGB9E5
+
+#define RGB9E5_MANTISSA_BITS 9
+#define RGB9E5_EXP_BIAS 15
+#define RGB9E5_MAX 65408.f // (2^9 - 1) / 2^9 * 2^(31 - 15)
+
+// Shared exponent of a pixel from its largest component (in [0, RGB9E5_MAX]) : max(-B - 1, floor(log2(MaxC))) + 1 + B,
+// plus one if the largest mantissa rounds up to 2^N. floor(log2()) is the float exponent, denormals giving -127.
+static uint32 RGB9E5Scalar(real32 R, real32 G, real32 B)
+{
+	// NOTE - Written so that NaNs become 0, like _mm_max_ps(x, 0)
+	R = (R > 0.f) ? Min(R, RGB9E5_MAX) : 0.f;
+	G = (G > 0.f) ? Min(G, RGB9E5_MAX) : 0.f;
+	B = (B > 0.f) ? Min(B, RGB9E5_MAX) : 0.f;
+	real32 MaxC = Max(R, Max(G, B));
+
+	uint32 MaxBits;
+	memcpy(&MaxBits, &MaxC, sizeof(MaxBits));
+	int32 Exp = Max((int32)(MaxBits >> 23) - 127, -RGB9E5_EXP_BIAS - 1) + 1 + RGB9E5_EXP_BIAS;
+
+	// Scale = 2^(B + N - Exp), built from its bits
+	uint32 ScaleBits = (uint32)(127 + RGB9E5_EXP_BIAS + RGB9E5_MANTISSA_BITS - Exp) << 23;
+	real32 Scale;
+	memcpy(&Scale, &ScaleBits, sizeof(Scale));
+	if ((uint32)(MaxC * Scale + 0.5f) == (1 << RGB9E5_MANTISSA_BITS))
+	{
+		++Exp;
+		Scale *= 0.5f;
+	}
+
+	uint32 RM = (uint32)(R * Scale + 0.5f), GM = (uint32)(G * Scale + 0.5f), BM = (uint32)(B * Scale + 0.5f);
+	return RM | (GM << 9) | (BM << 18) | ((uint32)Exp << 27);
+}
+
+#ifdef RF_SSE2
+// The same as RGB9E5Scalar on 4 pixels at once
+static uint64 FloatToRGB9E5SSE2(real32 const *Src, uint32 Channels, uint32 *Dst, uint64 PixelCount)
+{
+	__m128 const Zero = _mm_setzero_ps();
+	__m128 const MaxValue = _mm_set1_ps(RGB9E5_MAX);
+	__m128 const Half = _mm_set1_ps(0.5f);
+	__m128i const MinExp = _mm_set1_epi32(-RGB9E5_EXP_BIAS - 1);
+	__m128i const MantissaOverflow = _mm_set1_epi32(1 << RGB9E5_MANTISSA_BITS);
+
+	uint64 i = 0;
+	for (; i + 4 <= PixelCount; i += 4, Src += 4 * Channels)
+	{
+		__m128 R, G, B;
+		if (Channels == 4)
+		{
+			__m128 P0 = _mm_loadu_ps(Src), P1 = _mm_loadu_ps(Src + 4), P2 = _mm_loadu_ps(Src + 8), P3 = _mm_loadu_ps(Src + 12);
+			_MM_TRANSPOSE4_PS(P0, P1, P2, P3);
+			R = P0; G = P1; B = P2;
+		}
+		else
+		{
+			R = _mm_setr_ps(Src[0], Src[3], Src[6], Src[9]);
+			G = _mm_setr_ps(Src[1], Src[4], Src[7], Src[10]);
+			B = _mm_setr_ps(Src[2], Src[5], Src[8], Src[11]);
+		}
+		R = _mm_min_ps(_mm_max_ps(R, Zero), MaxValue);
+		G = _mm_min_ps(_mm_max_ps(G, Zero), MaxValue);
+		B = _mm_min_ps(_mm_max_ps(B, Zero), MaxValue);
+		__m128 MaxC = _mm_max_ps(R, _mm_max_ps(G, B));
+
+		// max(floor(log2(MaxC)), -B - 1), without _mm_max_epi32 (SSE4.1)
+		__m128i Exp = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(MaxC), 23), _mm_set1_epi32(127));
+		__m128i Greater = _mm_cmpgt_epi32(Exp, MinExp);
+		Exp = _mm_or_si128(_mm_and_si128(Greater, Exp), _mm_andnot_si128(Greater, MinExp));
+		Exp = _mm_add_epi32(Exp, _mm_set1_epi32(1 + RGB9E5_EXP_BIAS));
+
+		__m128i ScaleBits = _mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(127 + RGB9E5_EXP_BIAS + RGB9E5_MANTISSA_BITS), Exp), 23);
+		__m128 Scale = _mm_castsi128_ps(ScaleBits);
+
+		// Largest mantissa rounding up to 2^N : one more in the exponent (the comparison mask is -1)
+		__m128i MaxM = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(MaxC, Scale), Half));
+		__m128i Overflow = _mm_cmpeq_epi32(MaxM, MantissaOverflow);
+		Exp = _mm_sub_epi32(Exp, Overflow);
+		Scale = _mm_castsi128_ps(_mm_sub_epi32(ScaleBits, _mm_and_si128(Overflow, _mm_set1_epi32(1 << 23))));
+
+		__m128i RM = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(R, Scale), Half));
+		__m128i GM = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(G, Scale), Half));
+		__m128i BM = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(B, Scale), Half));
+		__m128i Packed = _mm_or_si128(_mm_or_si128(RM, _mm_slli_epi32(GM, 9)),
+			_mm_or_si128(_mm_slli_epi32(BM, 18), _mm_slli_epi32(Exp, 27)));
+		_mm_storeu_si128((__m128i*)(Dst + i), Packed);
+	}
+	return i;
+}
+#endif
+
+void convert::FloatToRGB9E5(real32 const *Src, uint32 Channels, uint32 *Dst, uint64 PixelCount)
+{
+	uint64 i = 0;
+#ifdef RF_SSE2
+	i = FloatToRGB9E5SSE2(Src, Channels, Dst, PixelCount);
+	Src += i * Channels;
+#endif
+	for (; i < PixelCount; ++i, Src += Channels)
+		Dst[i] = RGB9E5Scalar(Src[0], Src[1], Src[2]);
+}
+}
@@ -0,0 +1,368 @@
+#include "glyphcache.h"
+#include "log.h"
+#include "trace.h"
+
+#include "stb_truetype.h"
+
+namespace rf {
+struct font_face
+{
+	stbtt_fontinfo	Info;
+	uint8			*Contents;	// malloc'ed copy of the file, referenced by Info
+	path			Filename;
+	uint32			Index;		// in Cache->Faces
+	uint32			RefCount;
+};
+
+namespace glyphcache {
+
+#define GLYPH_CACHE_PADDING 1
+#define GLYPH_CACHE_MIN_SLOTS 1024
+
+static uint64 GlyphKey(font_face const *Face, uint32 PixelHeight, uint32 Codepoint)
+{
+	// NOTE - Face index + 1 so that no key is 0, the empty slot key
+	return ((uint64)(Face->Index + 1) << 48) | ((uint64)(PixelHeight & 0xFFFF) << 32) | Codepoint;
+}
+
+static uint32 KeyFace(uint64 Key)
+{
+	return (uint32)(Key >> 48) - 1;
+}
+
+static uint32 SlotIndex(uint64 Key, uint32 SlotCount)
+{
+	// 64-bit mix (splitmix64 finalizer), the keys differing mostly in their low bits
+	Key ^= Key >> 30; Key *= 0xbf58476d1ce4e5b9ULL;
+	Key ^= Key >> 27; Key *= 0x94d049bb133111ebULL;
+	Key ^= Key >> 31;
+	return (uint32)Key & (SlotCount - 1);
+}
+
+static bool IsStale(glyph_cache const *Cache, cached_glyph const *Slot)
+{
+	return Slot->Generation != Cache->Pages[Slot->Page].Generation;
+}
+
+// Slot holding Key, or the empty slot where it would go
+static cached_glyph *FindSlot(cached_glyph *Slots, uint32 SlotCount, uint64 Key)
+{
+	uint32 Index = SlotIndex(Key, SlotCount);
+	while (Slots[Index].Key && Slots[Index].Key != Key)
+		Index = (Index + 1) & (SlotCount - 1);
+	return &Slots[Index];
+}
+
+// Re-inserts the up-to-date glyphs in a new table, growing it to keep it at most 1/4 full.
+// The glyphs of the face DropFace are dropped too.
+static void Rehash(glyph_cache *Cache, uint32 DropFace = ~0u)
+{
+	uint32 Valid = 0;
+	for (uint32 i = 0; i < Cache->SlotCount; ++i)
+	{
+		cached_glyph const *Slot = &Cache->Slots[i];
+		if (Slot->Key && !IsStale(Cache, Slot) && KeyFace(Slot->Key) != DropFace)
+			++Valid;
+	}
+
+	uint32 NewCount = Max(Cache->SlotCount, (uint32)GLYPH_CACHE_MIN_SLOTS);
+	while (Valid * 4 > NewCount)
+		NewCount *= 2;
+
+	cached_glyph *NewSlots = (cached_glyph*)calloc(NewCount, sizeof(cached_glyph));
+	for (uint32 i = 0; i < Cache->SlotCount; ++i)
+	{
+		cached_glyph const *Slot = &Cache->Slots[i];
+		if (Slot->Key && !IsStale(Cache, Slot) && KeyFace(Slot->Key) != DropFace)
+			*FindSlot(NewSlots, NewCount, Slot->Key) = *Slot;
+	}
+
+	free(Cache->Slots);
+	Cache->Slots = NewSlots;
+	Cache->SlotCount = NewCount;
+	Cache->UsedSlots = Valid;
+}
+
+static void MarkDirty(glyph_cache *Cache, int32 X0, int32 Y0, int32 X1, int32 Y1)
+{
+	if (Cache->DirtyX0 >= Cache->DirtyX1)
+	{
+		Cache->DirtyX0 = X0; Cache->DirtyY0 = Y0;
+		Cache->DirtyX1 = X1; Cache->DirtyY1 = Y1;
+	}
+	else
+	{
+		Cache->DirtyX0 = Min(Cache->DirtyX0, X0); Cache->DirtyY0 = Min(Cache->DirtyY0, Y0);
+		Cache->DirtyX1 = Max(Cache->DirtyX1, X1); Cache->DirtyY1 = Max(Cache->DirtyY1, Y1);
+	}
+}
+
+void Init(glyph_cache *Cache, int32 Width, int32 Height, int32 PageSize)
+{
+	Assert(Width % PageSize == 0 && Height % PageSize == 0);
+	Cache->Width = Width;
+	Cache->Height = Height;
+	Cache->PageSize = PageSize;
+	Cache->Buffer = (uint8*)calloc((size_t)Width * Height, 1);
+	Cache->TextureID = Make2DTexture(Cache->Buffer, Width, Height, 1, false, false, 1.0f,
+		GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+
+	uint32 const PagesPerRow = (uint32)(Width / PageSize);
+	Cache->PageCount = PagesPerRow * (uint32)(Height / PageSize);
+	Cache->Pages = (glyph_cache_page*)calloc(Cache->PageCount, sizeof(glyph_cache_page));
+	for (uint32 p = 0; p < Cache->PageCount; ++p)
+	{
+		glyph_cache_page *Page = &Cache->Pages[p];
+		Page->X = (p % PagesPerRow) * PageSize;
+		Page->Y = (p / PagesPerRow) * PageSize;
+		atlas::Init(&Page->Packer, PageSize, PageSize, GLYPH_CACHE_PADDING);
+	}
+
+	Cache->SlotCount = GLYPH_CACHE_MIN_SLOTS;
+	Cache->Slots = (cached_glyph*)calloc(Cache->SlotCount, sizeof(cached_glyph));
+	Cache->UsedSlots = 0;
+
+	memset(Cache->Faces, 0, sizeof(Cache->Faces));
+	Cache->Frame = 1;
+	Cache->DirtyX0 = Cache->DirtyX1 = 0;
+}
+
+void Destroy(glyph_cache *Cache)
+{
+	for (uint32 f = 0; f < GLYPH_CACHE_MAX_FACES; ++f)
+	{
+		if (Cache->Faces[f])
+		{
+			LogError("Glyph cache destroyed with the face %s still referenced.", Cache->Faces[f]->Filename);
+			free(Cache->Faces[f]->Contents);
+			free(Cache->Faces[f]);
+			Cache->Faces[f] = NULL;
+		}
+	}
+
+	for (uint32 p = 0; p < Cache->PageCount; ++p)
+		atlas::Free(&Cache->Pages[p].Packer);
+	free(Cache->Pages);
+	Cache->Pages = NULL;
+	free(Cache->Slots);
+	Cache->Slots = NULL;
+	free(Cache->Buffer);
+	Cache->Buffer = NULL;
+	glDeleteTextures(1, &Cache->TextureID);
+}
+
+font_face *FindFace(glyph_cache *Cache, char const *Filename)
+{
+	for (uint32 f = 0; f < GLYPH_CACHE_MAX_FACES; ++f)
+	{
+		font_face *Face = Cache->Faces[f];
+		if (Face && !strcmp(Face->Filename, Filename))
+		{
+			++Face->RefCount;
+			return Face;
+		}
+	}
+	return NULL;
+}
+
+font_face *AddFace(glyph_cache *Cache, char const *Filename, void const *Contents, uint64 Size)
+{
+	uint32 Index = 0;
+	while (Index < GLYPH_CACHE_MAX_FACES && Cache->Faces[Index])
+		++Index;
+	if (Index == GLYPH_CACHE_MAX_FACES)
+	{
+		LogError("Can't add the face %s, the glyph cache already has %d faces.", Filename, GLYPH_CACHE_MAX_FACES);
+		return NULL;
+	}
+
+	font_face *Face = (font_face*)calloc(1, sizeof(font_face));
+	Face->Contents = (uint8*)malloc(Size);
+	memcpy(Face->Contents, Contents, Size);
+	if (!stbtt_InitFont(&Face->Info, Face->Contents, stbtt_GetFontOffsetForIndex(Face->Contents, 0)))
+	{
+		LogError("%s isn't a valid TrueType font.", Filename);
+		free(Face->Contents);
+		free(Face);
+		return NULL;
+	}
+
+	strncpy(Face->Filename, Filename, MAX_PATH - 1);
+	Face->Index = Index;
+	Face->RefCount = 1;
+	Cache->Faces[Index] = Face;
+	return Face;
+}
+
+void ReleaseFace(glyph_cache *Cache, font_face *Face)
+{
+	if (--Face->RefCount > 0)
+		return;
+
+	// The face index can be reused, its glyphs must go. Their texels stay until their page is evicted.
+	Rehash(Cache, Face->Index);
+	Cache->Faces[Face->Index] = NULL;
+	free(Face->Contents);
+	free(Face);
+}
+
+void GetFontMetrics(font_face *Face, uint32 PixelHeight, font *Font)
+{
+	stbtt_fontinfo const *Info = &Face->Info;
+	real32 PixelScale = stbtt_ScaleForPixelHeight(Info, (real32)PixelHeight);
+	int Ascent, Descent, LineGap;
+	stbtt_GetFontVMetrics(Info, &Ascent, &Descent, &LineGap);
+	Ascent = (int)floor(Ascent * PixelScale);
+	Descent = (int)floor(Descent * PixelScale);
+
+	Font->NumGlyphs = Info->numGlyphs;
+	Font->LineGap = Ascent - Descent;
+	Font->Ascent = Ascent;
+	Font->GlyphHeight = (real32)(Ascent - Descent);
+
+	// Average advance of the printable ascii chars, used to estimate text widths
+	Font->MaxGlyphWidth = 0;
+	for (int Codepoint = 32; Codepoint < 127; ++Codepoint)
+	{
+		int AdvX, Lsb;
+		stbtt_GetCodepointHMetrics(Info, Codepoint, &AdvX, &Lsb);
+		Font->MaxGlyphWidth += AdvX * PixelScale;
+	}
+	Font->MaxGlyphWidth /= real32(127 - 32);
+}
+
+real32 GetKerning(font_face *Face, uint32 PixelHeight, uint32 First, uint32 Second)
+{
+	stbtt_fontinfo const *Info = &Face->Info;
+	if (!Info->kern)
+		return 0.f;
+	return stbtt_ScaleForPixelHeight(Info, (real32)PixelHeight) *
+		(real32)stbtt_GetCodepointKernAdvance(Info, (int)First, (int)Second);
+}
+
+static void ClearPage(glyph_cache *Cache, glyph_cache_page *Page)
+{
+	atlas::Reset(&Page->Packer);
+	for (int32 Row = 0; Row < Cache->PageSize; ++Row)
+		memset(Cache->Buffer + (size_t)(Page->Y + Row) * Cache->Width + Page->X, 0, Cache->PageSize);
+	MarkDirty(Cache, Page->X, Page->Y, Page->X + Cache->PageSize, Page->Y + Cache->PageSize);
+	++Page->Generation;
+	Page->GlyphCount = 0;
+}
+
+// Finds room for a Width x Height glyph, evicting the least recently drawn page if needed
+static bool AllocateGlyph(glyph_cache *Cache, uint32 Width, uint32 Height, uint32 *PageIndex, uint32 *X, uint32 *Y)
+{
+	for (uint32 p = 0; p < Cache->PageCount; ++p)
+	{
+		if (atlas::Pack(&Cache->Pages[p].Packer, Width, Height, X, Y))
+		{
+			*PageIndex = p;
+			return true;
+		}
+	}
+
+	uint32 Oldest = ~0u;
+	for (uint32 p = 0; p < Cache->PageCount; ++p)
+	{
+		uint64 LastUse = Cache->Pages[p].LastUse;
+		if (LastUse < Cache->Frame && (Oldest == ~0u || LastUse < Cache->Pages[Oldest].LastUse))
+			Oldest = p;
+	}
+	if (Oldest == ~0u)
+		return false;
+
+	ClearPage(Cache, &Cache->Pages[Oldest]);
+	*PageIndex = Oldest;
+	return atlas::Pack(&Cache->Pages[Oldest].Packer, Width, Height, X, Y);
+}
+
+glyph const *Get(glyph_cache *Cache, font_face *Face, uint32 PixelHeight, uint32 Codepoint)
+{
+	uint64 Key = GlyphKey(Face, PixelHeight, Codepoint);
+	cached_glyph *Slot = FindSlot(Cache->Slots, Cache->SlotCount, Key);
+	if (Slot->Key && !IsStale(Cache, Slot))
+	{
+		Cache->Pages[Slot->Page].LastUse = Cache->Frame;
+		return &Slot->Glyph;
+	}
+
+	if (!Slot->Key && (Cache->UsedSlots + 1) * 2 > Cache->SlotCount)
+	{
+		Rehash(Cache);
+		Slot = FindSlot(Cache->Slots, Cache->SlotCount, Key);
+	}
+
+	TRACE_SCOPE("resource", "CacheGlyph");
+	stbtt_fontinfo const *Info = &Face->Info;
+	real32 PixelScale = stbtt_ScaleForPixelHeight(Info, (real32)PixelHeight);
+	int Glyph = stbtt_FindGlyphIndex(Info, (int)Codepoint);
+
+	int AdvX, Lsb;
+	int X0, X1, Y0, Y1;
+	stbtt_GetGlyphBitmapBox(Info, Glyph, PixelScale, PixelScale, &X0, &Y0, &X1, &Y1);
+	stbtt_GetGlyphHMetrics(Info, Glyph, &AdvX, &Lsb);
+
+	int32 const MaxSize = Cache->PageSize - 2 * GLYPH_CACHE_PADDING;
+	if (X1 - X0 > MaxSize || Y1 - Y0 > MaxSize)
+		return NULL;
+
+	uint32 PageIndex, X, Y;
+	if (!AllocateGlyph(Cache, (uint32)(X1 - X0), (uint32)(Y1 - Y0), &PageIndex, &X, &Y))
+		return NULL;
+
+	glyph_cache_page *Page = &Cache->Pages[PageIndex];
+	if (!Slot->Key)
+		++Cache->UsedSlots;
+	Slot->Key = Key;
+	Slot->Page = PageIndex;
+	Slot->Generation = Page->Generation;
+	Page->LastUse = Cache->Frame;
+	++Page->GlyphCount;
+
+	glyph &DstGlyph = Slot->Glyph;
+	DstGlyph.X = X0; DstGlyph.Y = Y0;
+	DstGlyph.CW = X1 - X0; DstGlyph.CH = Y1 - Y0; DstGlyph.AdvX = AdvX * PixelScale;
+	DstGlyph.AtlasX = (int)(Page->X + X);
+	DstGlyph.AtlasY = (int)(Page->Y + Y);
+	DstGlyph.TexX0 = DstGlyph.AtlasX / (real32)Cache->Width;  DstGlyph.TexX1 = (DstGlyph.AtlasX + DstGlyph.CW) / (real32)Cache->Width;
+	DstGlyph.TexY0 = DstGlyph.AtlasY / (real32)Cache->Height; DstGlyph.TexY1 = (DstGlyph.AtlasY + DstGlyph.CH) / (real32)Cache->Height;
+
+	if (DstGlyph.CW > 0 && DstGlyph.CH > 0)
+	{
+		uint8 *BitmapPtr = Cache->Buffer + ((size_t)DstGlyph.AtlasY * Cache->Width + DstGlyph.AtlasX);
+		stbtt_MakeGlyphBitmap(Info, BitmapPtr, DstGlyph.CW, DstGlyph.CH, Cache->Width, PixelScale, PixelScale, Glyph);
+		MarkDirty(Cache, DstGlyph.AtlasX, DstGlyph.AtlasY, DstGlyph.AtlasX + DstGlyph.CW, DstGlyph.AtlasY + DstGlyph.CH);
+	}
+
+	return &DstGlyph;
+}
+
+void Flush(glyph_cache *Cache)
+{
+	if (Cache->DirtyX0 < Cache->DirtyX1)
+	{
+		GLint CurrentAlignment;
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &CurrentAlignment);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, Cache->Width);
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS, Cache->DirtyX0);
+		glPixelStorei(GL_UNPACK_SKIP_ROWS, Cache->DirtyY0);
+
+		glBindTexture(GL_TEXTURE_2D, Cache->TextureID);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, Cache->DirtyX0, Cache->DirtyY0, Cache->DirtyX1 - Cache->DirtyX0,
+			Cache->DirtyY1 - Cache->DirtyY0, GL_RED, GL_UNSIGNED_BYTE, Cache->Buffer);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+		glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, CurrentAlignment);
+
+		Cache->DirtyX0 = Cache->DirtyX1 = 0;
+	}
+
+	++Cache->Frame;
+}
+}
+}
@@ -0,0 +1,556 @@
+#include "io.h"
+#include "context.h"
+#include "utils.h"
+#include "jobs.h"
+#include "vfs.h"
+
+#include <mutex>
+#include <condition_variable>
+
+#ifdef RF_UNIX
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+namespace rf {
+
+#define IO_MAX_READ (1llu << 30) // max size of one read call, larger files are read in several
+
+struct io_slot
+{
+	io_file		File;
+	io_batch	*Batch;
+	uint64		Offset;		// bytes read so far
+	int32		Error;		// errno of the failed call, 0 if none
+	bool		Failed;
+	bool		Done;
+#ifdef RF_UNIX
+	int32		Fd;
+	struct iovec Vec;		// must stay valid while the read is in flight
+#else
+	file_stream	Stream;
+#endif
+};
+
+#ifdef RF_UNIX
+// io_uring instance, driven with raw syscalls (see io_uring_setup(2) and io_uring_enter(2))
+struct io_ring
+{
+	int32					Fd;
+	uint32					*SQHead, *SQTail, *SQMask, *SQArray;
+	uint32					*CQHead, *CQTail, *CQMask;
+	struct io_uring_sqe		*SQEs;
+	struct io_uring_cqe		*CQEs;
+	void					*SQRing, *CQRing;
+	size_t					SQRingSize, CQRingSize, SQEsSize;
+	uint32					ToSubmit;	// SQEs queued since the last io_uring_enter
+};
+#endif
+
+struct io_batch
+{
+	context		*Context;
+	mem_pool	*Pool;
+	io_slot		*Slots;
+	uint32		Count;
+	uint32		NextSubmit;		// files [0, NextSubmit) were submitted
+	uint32		Returned;		// files returned by BatchNext, in Ready order
+
+	// Indices of the completed files in completion order, filled by the reads. Protected by Lock.
+	uint32		*Ready;
+	uint32		ReadyCount;
+	std::mutex	Lock;
+	std::condition_variable Completed;
+
+	job_group	Group;			// fallback reads in flight
+	bool		UseRing;
+#ifdef RF_UNIX
+	io_ring		Ring;
+#endif
+};
+
+namespace io {
+
+static int32 RingSupport = -1; // -1 : not tried yet, 0 : unavailable, 1 : available
+
+static void FinishSlot(io_slot *Slot);
+
+#ifdef RF_UNIX
+static bool OpenSlot(io_slot *Slot)
+{
+	Slot->Fd = open(Slot->File.Filename, O_RDONLY | O_CLOEXEC);
+	if (Slot->Fd < 0)
+	{
+		Slot->Error = errno;
+		return false;
+	}
+
+	struct stat St;
+	if (fstat(Slot->Fd, &St) != 0 || !S_ISREG(St.st_mode))
+	{
+		Slot->Error = errno ? errno : EISDIR;
+		close(Slot->Fd);
+		Slot->Fd = -1;
+		return false;
+	}
+
+	Slot->File.Size = (uint64)St.st_size;
+	return true;
+}
+
+static void CloseSlot(io_slot *Slot)
+{
+	if (Slot->Fd >= 0)
+	{
+		close(Slot->Fd);
+		Slot->Fd = -1;
+	}
+}
+
+static void ReadJob(void *UserData)
+{
+	io_slot *Slot = (io_slot*)UserData;
+	while (Slot->Offset < Slot->File.Size)
+	{
+		ssize_t Res = pread(Slot->Fd, Slot->File.Data + Slot->Offset, (size_t)Min(Slot->File.Size - Slot->Offset, IO_MAX_READ),
+							(off_t)Slot->Offset);
+		if (Res < 0 && errno == EINTR)
+			continue;
+		if (Res < 0)
+		{
+			Slot->Failed = true;
+			Slot->Error = errno;
+		}
+		if (Res <= 0) // 0 : the file was truncated since it was opened
+			break;
+		Slot->Offset += (uint64)Res;
+	}
+	FinishSlot(Slot);
+}
+
+static void RingDestroy(io_ring *Ring)
+{
+	if (Ring->SQEs)
+		munmap(Ring->SQEs, Ring->SQEsSize);
+	if (Ring->CQRing && Ring->CQRing != Ring->SQRing)
+		munmap(Ring->CQRing, Ring->CQRingSize);
+	if (Ring->SQRing)
+		munmap(Ring->SQRing, Ring->SQRingSize);
+	if (Ring->Fd >= 0)
+		close(Ring->Fd); // cancels the requests still in flight
+	memset(Ring, 0, sizeof(io_ring));
+	Ring->Fd = -1;
+}
+
+static void *RingMap(int32 Fd, size_t Size, off_t Offset)
+{
+	void *Ptr = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd, Offset);
+	return (Ptr == MAP_FAILED) ? NULL : Ptr;
+}
+
+static bool RingInit(io_ring *Ring, uint32 Depth)
+{
+	memset(Ring, 0, sizeof(io_ring));
+
+	struct io_uring_params Params;
+	memset(&Params, 0, sizeof(Params));
+	Ring->Fd = (int32)syscall(__NR_io_uring_setup, Depth, &Params);
+	if (Ring->Fd < 0)
+		return false;
+
+	Ring->SQRingSize = Params.sq_off.array + Params.sq_entries * sizeof(uint32);
+	Ring->CQRingSize = Params.cq_off.cqes + Params.cq_entries * sizeof(struct io_uring_cqe);
+	Ring->SQEsSize = Params.sq_entries * sizeof(struct io_uring_sqe);
+
+	bool SingleMap = (Params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (SingleMap)
+	{
+		Ring->SQRingSize = Ring->CQRingSize = Max(Ring->SQRingSize, Ring->CQRingSize);
+	}
+
+	Ring->SQRing = RingMap(Ring->Fd, Ring->SQRingSize, IORING_OFF_SQ_RING);
+	Ring->CQRing = SingleMap ? Ring->SQRing : RingMap(Ring->Fd, Ring->CQRingSize, IORING_OFF_CQ_RING);
+	Ring->SQEs = (struct io_uring_sqe*)RingMap(Ring->Fd, Ring->SQEsSize, IORING_OFF_SQES);
+	if (!Ring->SQRing || !Ring->CQRing || !Ring->SQEs)
+	{
+		RingDestroy(Ring);
+		return false;
+	}
+
+	uint8 *SQ = (uint8*)Ring->SQRing;
+	Ring->SQHead = (uint32*)(SQ + Params.sq_off.head);
+	Ring->SQTail = (uint32*)(SQ + Params.sq_off.tail);
+	Ring->SQMask = (uint32*)(SQ + Params.sq_off.ring_mask);
+	Ring->SQArray = (uint32*)(SQ + Params.sq_off.array);
+
+	uint8 *CQ = (uint8*)Ring->CQRing;
+	Ring->CQHead = (uint32*)(CQ + Params.cq_off.head);
+	Ring->CQTail = (uint32*)(CQ + Params.cq_off.tail);
+	Ring->CQMask = (uint32*)(CQ + Params.cq_off.ring_mask);
+	Ring->CQEs = (struct io_uring_cqe*)(CQ + Params.cq_off.cqes);
+	return true;
+}
+
+// Rings are kept between batches, one per batch read at the same time : setting one up (io_uring_setup and the
+// mapping of its queues) costs more than reading the few small files of most batches.
+#define IO_MAX_IDLE_RINGS 4
+static io_ring		IdleRings[IO_MAX_IDLE_RINGS];
+static uint32		IdleRingCount = 0;
+static std::mutex	IdleRingsLock;
+
+static bool RingAcquire(io_ring *Ring)
+{
+	{
+		std::lock_guard<std::mutex> Guard(IdleRingsLock);
+		if (IdleRingCount)
+		{
+			*Ring = IdleRings[--IdleRingCount];
+			return true;
+		}
+	}
+	return RingInit(Ring, IO_BATCH_DEPTH);
+}
+
+// Keeps a ring for the next batches. Nothing must be in flight, and every completion reaped.
+static void RingRelease(io_ring *Ring)
+{
+	{
+		std::lock_guard<std::mutex> Guard(IdleRingsLock);
+		if (IdleRingCount < IO_MAX_IDLE_RINGS)
+		{
+			IdleRings[IdleRingCount++] = *Ring;
+			memset(Ring, 0, sizeof(io_ring));
+			Ring->Fd = -1;
+			return;
+		}
+	}
+	RingDestroy(Ring);
+}
+
+// Queues the read of the rest of the slot's file. Only the batch thread produces SQEs.
+static void RingQueueRead(io_ring *Ring, io_slot *Slot)
+{
+	uint32 Tail = *Ring->SQTail;
+	uint32 SQIdx = Tail & *Ring->SQMask;
+
+	Slot->Vec.iov_base = Slot->File.Data + Slot->Offset;
+	Slot->Vec.iov_len = (size_t)Min(Slot->File.Size - Slot->Offset, IO_MAX_READ);
+
+	// READV rather than READ, it is available since the first io_uring kernels (5.1)
+	struct io_uring_sqe *SQE = &Ring->SQEs[SQIdx];
+	memset(SQE, 0, sizeof(struct io_uring_sqe));
+	SQE->opcode = IORING_OP_READV;
+	SQE->fd = Slot->Fd;
+	SQE->addr = (uint64)(uintptr_t)&Slot->Vec;
+	SQE->len = 1;
+	SQE->off = Slot->Offset;
+	SQE->user_data = Slot->File.Index;
+
+	Ring->SQArray[SQIdx] = SQIdx;
+	__atomic_store_n(Ring->SQTail, Tail + 1, __ATOMIC_RELEASE);
+	++Ring->ToSubmit;
+}
+
+// Submits the queued SQEs, and waits for MinComplete completions
+static bool RingEnter(io_ring *Ring, uint32 MinComplete)
+{
+	int32 Ret = (int32)syscall(__NR_io_uring_enter, Ring->Fd, Ring->ToSubmit, MinComplete,
+							   MinComplete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	if (Ret >= 0)
+	{
+		Ring->ToSubmit -= (uint32)Ret;
+		return true;
+	}
+
+	// Interrupted or out of resources for now, the caller tries again
+	return errno == EINTR || errno == EAGAIN || errno == EBUSY;
+}
+
+static void RingReap(io_batch *Batch)
+{
+	io_ring *Ring = &Batch->Ring;
+	uint32 Head = *Ring->CQHead;
+	uint32 Tail = __atomic_load_n(Ring->CQTail, __ATOMIC_ACQUIRE);
+
+	for (; Head != Tail; ++Head)
+	{
+		struct io_uring_cqe const *CQE = &Ring->CQEs[Head & *Ring->CQMask];
+		io_slot *Slot = &Batch->Slots[CQE->user_data];
+		int32 Res = CQE->res;
+
+		if (Res > 0)
+		{
+			Slot->Offset += (uint64)Res;
+		}
+
+		if (Res == -EINTR || Res == -EAGAIN || (Res > 0 && Slot->Offset < Slot->File.Size))
+		{ // short read (large file), continue from the new offset
+			RingQueueRead(Ring, Slot);
+			continue;
+		}
+
+		if (Res < 0)
+		{
+			Slot->Failed = true;
+			Slot->Error = -Res;
+		}
+		FinishSlot(Slot);
+	}
+
+	__atomic_store_n(Ring->CQHead, Head, __ATOMIC_RELEASE);
+}
+
+// io_uring broke down in the middle of a batch : fails the reads in flight, the rest of the batch uses the fallback
+static void RingAbort(io_batch *Batch)
+{
+	LogError("io_uring error (errno %d), falling back on pread.", errno);
+	RingDestroy(&Batch->Ring);
+	Batch->UseRing = false;
+
+	for (uint32 i = 0; i < Batch->NextSubmit; ++i)
+	{
+		io_slot *Slot = &Batch->Slots[i];
+		if (!Slot->Done)
+		{
+			Slot->Failed = true;
+			Slot->Error = EIO;
+			FinishSlot(Slot);
+		}
+	}
+}
+#else
+static bool OpenSlot(io_slot *Slot)
+{
+	if (!FileStreamOpen(&Slot->Stream, Slot->File.Filename))
+	{
+		Slot->Error = -1;
+		return false;
+	}
+
+	Slot->File.Size = Slot->Stream.Size;
+	return true;
+}
+
+static void CloseSlot(io_slot *Slot)
+{
+	if (Slot->Stream.File)
+	{
+		FileStreamClose(&Slot->Stream);
+	}
+}
+
+static void ReadJob(void *UserData)
+{
+	io_slot *Slot = (io_slot*)UserData;
+	while (Slot->Offset < Slot->File.Size)
+	{
+		uint64 Read = FileStreamRead(&Slot->Stream, Slot->File.Data + Slot->Offset, Min(Slot->File.Size - Slot->Offset, IO_MAX_READ));
+		if (!Read)
+			break;
+		Slot->Offset += Read;
+	}
+	FinishSlot(Slot);
+}
+#endif
+
+static void PushReady(io_slot *Slot)
+{
+	io_batch *Batch = Slot->Batch;
+	{
+		std::lock_guard<std::mutex> Guard(Batch->Lock);
+		Slot->Done = true;
+		Batch->Ready[Batch->ReadyCount++] = Slot->File.Index;
+	}
+	Batch->Completed.notify_one();
+}
+
+// Called once per file read from disk, by the thread that completed its read
+static void FinishSlot(io_slot *Slot)
+{
+	CloseSlot(Slot);
+
+	if (Slot->File.Data && !Slot->Failed)
+	{ // shorter if the file was truncated while being read
+		Slot->File.Size = Slot->Offset;
+		Slot->File.Data[Slot->File.Size] = 0;
+	}
+
+	PushReady(Slot);
+}
+
+// Opens and submits files until IO_BATCH_DEPTH files are in flight (or waiting to be returned)
+static void SubmitFiles(io_batch *Batch)
+{
+	while (Batch->NextSubmit < Batch->Count && Batch->NextSubmit - Batch->Returned < IO_BATCH_DEPTH)
+	{
+		io_slot *Slot = &Batch->Slots[Batch->NextSubmit++];
+
+		uint64 PackedSize;
+		uint8 *Packed = (uint8*)vfs::ReadFile(Batch->Context, Slot->File.Filename, &PackedSize);
+		if (Packed)
+		{
+			Slot->File.Data = Packed;
+			Slot->File.Size = PackedSize;
+			PushReady(Slot); // already null-terminated, and not written to so that the mapped pages stay shared
+			continue;
+		}
+
+		if (!OpenSlot(Slot))
+		{
+			Slot->Failed = true;
+			FinishSlot(Slot);
+			continue;
+		}
+
+		Slot->File.Data = PoolAlloc<uint8>(Batch->Pool, Slot->File.Size + 1);
+		if (!Slot->File.Data || !Slot->File.Size)
+		{
+			Slot->Failed = !Slot->File.Data;
+			FinishSlot(Slot);
+			continue;
+		}
+
+#ifdef RF_UNIX
+		if (Batch->UseRing)
+		{
+			RingQueueRead(&Batch->Ring, Slot);
+			continue;
+		}
+#endif
+		jobs::Submit(&Batch->Group, ReadJob, Slot);
+	}
+
+#ifdef RF_UNIX
+	if (Batch->UseRing && Batch->Ring.ToSubmit && !RingEnter(&Batch->Ring, 0))
+	{
+		RingAbort(Batch);
+	}
+#endif
+}
+
+io_batch *BatchRead(context *Context, mem_pool *Pool, char const * const *Filenames, uint32 Count)
+{
+	io_batch *Batch = new io_batch();
+	Batch->Context = Context;
+	Batch->Pool = Pool;
+	Batch->Count = Count;
+	Batch->Slots = (io_slot*)calloc(Max(Count, 1u), sizeof(io_slot));
+	Batch->Ready = (uint32*)calloc(Max(Count, 1u), sizeof(uint32));
+
+	for (uint32 i = 0; i < Count; ++i)
+	{
+		io_slot *Slot = &Batch->Slots[i];
+		Slot->File.Filename = Filenames[i];
+		Slot->File.Index = i;
+		Slot->Batch = Batch;
+#ifdef RF_UNIX
+		Slot->Fd = -1;
+#endif
+	}
+
+#ifdef RF_UNIX
+	if (RingSupport != 0)
+	{
+		Batch->UseRing = RingAcquire(&Batch->Ring);
+		if (RingSupport < 0)
+		{
+			RingSupport = Batch->UseRing ? 1 : 0;
+			if (!Batch->UseRing)
+			{
+				LogInfo("io_uring unavailable (errno %d), batch reads use pread workers.", errno);
+			}
+		}
+	}
+#endif
+
+	SubmitFiles(Batch);
+	return Batch;
+}
+
+io_file *BatchNext(io_batch *Batch)
+{
+	if (Batch->Returned == Batch->Count)
+		return NULL;
+
+	SubmitFiles(Batch);
+
+#ifdef RF_UNIX
+	// Ring completions are reaped by this thread, no need to lock to check them
+	while (Batch->UseRing && Batch->ReadyCount == Batch->Returned)
+	{
+		if (!RingEnter(&Batch->Ring, 1))
+		{
+			RingAbort(Batch);
+			break;
+		}
+		RingReap(Batch);
+	}
+#endif
+
+	io_slot *Slot;
+	{
+		std::unique_lock<std::mutex> Guard(Batch->Lock);
+		Batch->Completed.wait(Guard, [Batch] { return Batch->ReadyCount > Batch->Returned; });
+		Slot = &Batch->Slots[Batch->Ready[Batch->Returned++]];
+	}
+
+	if (Slot->Failed)
+	{
+		LogError("File Open Error [%s] : %s.", Slot->File.Filename, Slot->Error > 0 ? strerror(Slot->Error) : "Couldn't read file");
+		Slot->File.Data = NULL;
+		Slot->File.Size = 0;
+	}
+
+	// Refill the window right away, so that reads go on while the caller works on this file
+	SubmitFiles(Batch);
+	return &Slot->File;
+}
+
+void BatchFree(io_batch *Batch)
+{
+#ifdef RF_UNIX
+	if (Batch->UseRing)
+	{
+		while (Batch->ReadyCount < Batch->NextSubmit)
+		{
+			if (!RingEnter(&Batch->Ring, 1))
+			{
+				RingAbort(Batch);
+				break;
+			}
+			RingReap(Batch);
+		}
+		if (Batch->UseRing)
+			RingRelease(&Batch->Ring);
+	}
+#endif
+	jobs::Wait(&Batch->Group);
+
+	free(Batch->Slots);
+	free(Batch->Ready);
+	delete Batch;
+}
+
+bool UsesIoUring()
+{
+	return RingSupport == 1;
+}
+
+void Destroy()
+{
+#ifdef RF_UNIX
+	std::lock_guard<std::mutex> Guard(IdleRingsLock);
+	for (uint32 i = 0; i < IdleRingCount; ++i)
+		RingDestroy(&IdleRings[i]);
+	IdleRingCount = 0;
+#endif
+}
+
+}
+}
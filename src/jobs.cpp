@@ -0,0 +1,169 @@
+#include "jobs.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace rf {
+namespace jobs {
+
+struct job
+{
+	job_func	Func;
+	void		*UserData;
+	job_group	*Group;
+};
+
+// FIFO ring of queued jobs, grown when full. Everything below is protected by Lock.
+static job						*Queue = nullptr;
+static uint32					QueueCapacity = 0;
+static uint32					QueueHead = 0;
+static uint32					QueueCount = 0;
+
+static std::mutex				Lock;
+static std::condition_variable	JobQueued;
+static std::condition_variable	JobDone;
+static bool						Running = false;
+
+static std::thread				*Workers = nullptr;
+static uint32					NumWorkers = 0;
+
+static void PushJob(job const &Job)
+{
+	if (QueueCount == QueueCapacity)
+	{
+		uint32 NewCapacity = Max(64u, QueueCapacity * 2);
+		job *NewQueue = (job*)malloc(NewCapacity * sizeof(job));
+		for (uint32 i = 0; i < QueueCount; ++i)
+		{
+			NewQueue[i] = Queue[(QueueHead + i) % QueueCapacity];
+		}
+		free(Queue);
+		Queue = NewQueue;
+		QueueCapacity = NewCapacity;
+		QueueHead = 0;
+	}
+
+	Queue[(QueueHead + QueueCount) % QueueCapacity] = Job;
+	++QueueCount;
+}
+
+static job PopJob()
+{
+	job Job = Queue[QueueHead];
+	QueueHead = (QueueHead + 1) % QueueCapacity;
+	--QueueCount;
+	return Job;
+}
+
+// Runs the job outside of the lock, then retires it from its group
+static void RunJob(std::unique_lock<std::mutex> &Guard, job const &Job)
+{
+	Guard.unlock();
+	Job.Func(Job.UserData);
+	Guard.lock();
+
+	if (Job.Group && --Job.Group->Pending == 0)
+	{
+		JobDone.notify_all();
+	}
+}
+
+static void WorkerLoop()
+{
+	std::unique_lock<std::mutex> Guard(Lock);
+	for (;;)
+	{
+		JobQueued.wait(Guard, [] { return QueueCount > 0 || !Running; });
+		if (!QueueCount) // stopped, and the queue is drained
+			break;
+
+		RunJob(Guard, PopJob());
+	}
+}
+
+bool Init(uint32 WorkerCount)
+{
+	if (Running)
+		return true;
+
+	Running = true;
+	NumWorkers = WorkerCount;
+	if (NumWorkers)
+	{
+		Workers = new std::thread[NumWorkers];
+		for (uint32 i = 0; i < NumWorkers; ++i)
+		{
+			Workers[i] = std::thread(WorkerLoop);
+		}
+	}
+	return true;
+}
+
+void Destroy()
+{
+	if (!Running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> Guard(Lock);
+		Running = false;
+	}
+	JobQueued.notify_all();
+
+	for (uint32 i = 0; i < NumWorkers; ++i)
+	{
+		Workers[i].join();
+	}
+	delete[] Workers;
+	Workers = nullptr;
+	NumWorkers = 0;
+
+	free(Queue);
+	Queue = nullptr;
+	QueueCapacity = QueueHead = QueueCount = 0;
+}
+
+uint32 WorkerCount()
+{
+	return NumWorkers;
+}
+
+void Submit(job_group *Group, job_func Func, void *UserData)
+{
+	if (!NumWorkers)
+	{
+		Func(UserData);
+		return;
+	}
+
+	job Job = { Func, UserData, Group };
+	{
+		std::lock_guard<std::mutex> Guard(Lock);
+		if (Group)
+		{
+			++Group->Pending;
+		}
+		PushJob(Job);
+	}
+	JobQueued.notify_one();
+}
+
+void Wait(job_group *Group)
+{
+	std::unique_lock<std::mutex> Guard(Lock);
+	while (Group->Pending)
+	{
+		if (QueueCount)
+		{
+			RunJob(Guard, PopJob());
+		}
+		else
+		{
+			JobDone.wait(Guard);
+		}
+	}
+}
+
+}
+}
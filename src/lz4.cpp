@@ -0,0 +1,189 @@
+#include "lz4.h"
+
+namespace rf {
+namespace lz4 {
+
+#define LZ4_MINMATCH 4
+#define LZ4_LASTLITERALS 5		// the last 5 bytes are always literals
+#define LZ4_MFLIMIT 12			// the last match must start at least 12 bytes before the end
+#define LZ4_MAXOFFSET 65535
+#define LZ4_HASHLOG 12
+
+static inline uint32 Read32(uint8 const *Ptr)
+{
+	uint32 Val;
+	memcpy(&Val, Ptr, sizeof(Val));
+	return Val;
+}
+
+static inline uint32 Hash32(uint32 Seq)
+{
+	return (Seq * 2654435761u) >> (32 - LZ4_HASHLOG);
+}
+
+// Writes the bytes extending a length that didn't fit in its 4-bit token field
+static uint8 *WriteLength(uint8 *Op, int32 Len)
+{
+	while (Len >= 255)
+	{
+		*Op++ = 255;
+		Len -= 255;
+	}
+	*Op++ = (uint8)Len;
+	return Op;
+}
+
+static uint8 *WriteLiterals(uint8 *Op, uint8 *Token, uint8 const *Literals, int32 LitLen)
+{
+	*Token = (uint8)(Min(LitLen, 15) << 4);
+	if (LitLen >= 15)
+	{
+		Op = WriteLength(Op, LitLen - 15);
+	}
+	memcpy(Op, Literals, LitLen);
+	return Op + LitLen;
+}
+
+int32 CompressBound(int32 SrcSize)
+{
+	return SrcSize + SrcSize / 255 + 16;
+}
+
+int32 Compress(uint8 const *Src, int32 SrcSize, uint8 *Dst, int32 DstCapacity)
+{
+	if (SrcSize < 0 || DstCapacity < CompressBound(SrcSize))
+		return 0;
+
+	uint8 *Op = Dst;
+	int32 Anchor = 0;
+
+	if (SrcSize > LZ4_MFLIMIT)
+	{
+		int32 HashTable[1 << LZ4_HASHLOG];
+		memset(HashTable, 0xFF, sizeof(HashTable));
+
+		int32 const MatchStartLimit = SrcSize - LZ4_MFLIMIT;
+		int32 const MatchEndLimit = SrcSize - LZ4_LASTLITERALS;
+
+		int32 Ip = 0;
+		while (Ip <= MatchStartLimit)
+		{
+			uint32 Seq = Read32(Src + Ip);
+			uint32 H = Hash32(Seq);
+			int32 Ref = HashTable[H];
+			HashTable[H] = Ip;
+
+			if (Ref < 0 || (Ip - Ref) > LZ4_MAXOFFSET || Read32(Src + Ref) != Seq)
+			{
+				++Ip;
+				continue;
+			}
+
+			int32 MatchLen = LZ4_MINMATCH;
+			while (Ip + MatchLen < MatchEndLimit && Src[Ref + MatchLen] == Src[Ip + MatchLen])
+			{
+				++MatchLen;
+			}
+
+			uint8 *Token = Op++;
+			Op = WriteLiterals(Op, Token, Src + Anchor, Ip - Anchor);
+
+			int32 Offset = Ip - Ref;
+			*Op++ = (uint8)(Offset & 0xFF);
+			*Op++ = (uint8)(Offset >> 8);
+
+			int32 ML = MatchLen - LZ4_MINMATCH;
+			*Token |= (uint8)Min(ML, 15);
+			if (ML >= 15)
+			{
+				Op = WriteLength(Op, ML - 15);
+			}
+
+			Ip += MatchLen;
+			Anchor = Ip;
+		}
+	}
+
+	// Last sequence, literals only
+	uint8 *Token = Op++;
+	Op = WriteLiterals(Op, Token, Src + Anchor, SrcSize - Anchor);
+
+	return (int32)(Op - Dst);
+}
+
+int32 Decompress(uint8 const *Src, int32 SrcSize, uint8 *Dst, int32 DstCapacity)
+{
+	int32 Ip = 0, Op = 0;
+
+	while (Ip < SrcSize)
+	{
+		uint8 Token = Src[Ip++];
+
+		int32 LitLen = Token >> 4;
+		if (LitLen == 15)
+		{
+			uint8 Byte;
+			do
+			{
+				if (Ip >= SrcSize) return -1;
+				Byte = Src[Ip++];
+				// checked before adding : a long run of 255 would overflow LitLen
+				if (Byte > SrcSize - Ip - LitLen || Byte > DstCapacity - Op - LitLen) return -1;
+				LitLen += Byte;
+			} while (Byte == 255);
+		}
+
+		if (LitLen > SrcSize - Ip || LitLen > DstCapacity - Op)
+			return -1;
+
+		memcpy(Dst + Op, Src + Ip, LitLen);
+		Ip += LitLen;
+		Op += LitLen;
+
+		if (Ip == SrcSize)
+		{ // last sequence has no match
+			break;
+		}
+
+		if (SrcSize - Ip < 2)
+			return -1;
+		int32 Offset = Src[Ip] | (Src[Ip + 1] << 8);
+		Ip += 2;
+		if (Offset == 0 || Offset > Op)
+			return -1;
+
+		int32 MatchLen = Token & 15;
+		if (MatchLen == 15)
+		{
+			uint8 Byte;
+			do
+			{
+				if (Ip >= SrcSize) return -1;
+				Byte = Src[Ip++];
+				if (Byte > DstCapacity - Op - LZ4_MINMATCH - MatchLen) return -1;
+				MatchLen += Byte;
+			} while (Byte == 255);
+		}
+		MatchLen += LZ4_MINMATCH;
+
+		if (MatchLen > DstCapacity - Op)
+			return -1;
+
+		uint8 *Match = Dst + Op - Offset;
+		if (Offset >= MatchLen)
+		{
+			memcpy(Dst + Op, Match, MatchLen);
+		}
+		else
+		{ // overlapping copy, repeats the last Offset bytes
+			for (int32 i = 0; i < MatchLen; ++i)
+				Dst[Op + i] = Match[i];
+		}
+		Op += MatchLen;
+	}
+
+	return Op;
+}
+
+}
+}
@@ -0,0 +1,588 @@
+#include "mip.h"
+#include "jobs.h"
+#include "simd.h"
+#include "log.h"
+#include "trace.h"
+
+#include <cmath>
+
+namespace rf {
+
+uint32 mip::LevelCount(uint32 Width, uint32 Height)
+{
+	uint32 Count = 1;
+	for (uint32 Size = Max(Width, Height); Size > 1; Size >>= 1)
+		++Count;
+	return Count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Filters
+
+#define KAISER_WIDTH 3.f
+#define KAISER_ALPHA 4.f
+#define LANCZOS_WIDTH 3.f
+
+static real32 Sinc(real32 X)
+{
+	if (fabsf(X) < 1e-5f)
+		return 1.f;
+	X *= M_PI;
+	return sinf(X) / X;
+}
+
+// Modified Bessel function of the first kind, order 0 (power series)
+static real32 BesselI0(real32 X)
+{
+	real32 Sum = 1.f, Term = 1.f, HalfX2 = X * X * 0.25f;
+	for (int32 k = 1; k < 32 && Term > Sum * 1e-7f; ++k)
+	{
+		Term *= HalfX2 / (real32)(k * k);
+		Sum += Term;
+	}
+	return Sum;
+}
+
+// Half width of the filter, in source pixels
+static real32 FilterSupport(mip_filter Filter, real32 Scale)
+{
+	switch (Filter)
+	{
+	case MIP_KAISER: return KAISER_WIDTH * Scale;
+	case MIP_LANCZOS: return LANCZOS_WIDTH * Scale;
+	default: return 0.5f * Scale + 0.5f;
+	}
+}
+
+// Weight of the source pixel whose center is at X destination pixels from the center of the destination pixel
+static real32 FilterWeight(mip_filter Filter, real32 X, real32 Scale)
+{
+	X = fabsf(X);
+	switch (Filter)
+	{
+	case MIP_KAISER:
+	{
+		real32 T = X / KAISER_WIDTH;
+		if (T >= 1.f)
+			return 0.f;
+		return Sinc(X) * BesselI0(KAISER_ALPHA * sqrtf(1.f - T * T)) / BesselI0(KAISER_ALPHA);
+	}
+	case MIP_LANCZOS:
+		return (X < LANCZOS_WIDTH) ? Sinc(X) * Sinc(X / LANCZOS_WIDTH) : 0.f;
+	default:
+	{ // Area of the source pixel covered by the destination pixel : source pixels on the border of two destination
+	  // pixels (odd sizes) are shared by both
+		real32 HalfPixel = 0.5f / Scale;
+		return Max(0.f, Min(X + HalfPixel, 0.5f) - (X - HalfPixel));
+	}
+	}
+}
+
+// Polyphase weights of one axis : each destination pixel has its own taps, so that odd sizes (where the footprint
+// of a destination pixel isn't aligned on the source pixels) are filtered correctly.
+struct filter_axis
+{
+	uint32	TapCount;
+	int32	*First;		// first source pixel of each destination pixel, may be out of the image (clamped when read)
+	real32	*Weights;	// TapCount per destination pixel, normalized
+};
+
+static void MakeFilterAxis(filter_axis *Axis, mip_filter Filter, uint32 SrcSize, uint32 DstSize)
+{
+	real32 Scale = (real32)SrcSize / DstSize;
+	real32 Support = FilterSupport(Filter, Scale);
+
+	// Weights of every source pixel whose center is in the support (j + 0.5 in [Center - Support, Center + Support]),
+	// then trimmed to the non-zero ones so that every destination pixel has the same (smallest) tap count
+	uint32 RawTapCount = (uint32)ceilf(2.f * Support) + 2;
+	real32 *RawWeights = (real32*)malloc((uint64)DstSize * RawTapCount * sizeof(real32));
+	uint32 *Spans = (uint32*)malloc(DstSize * sizeof(uint32));
+	Axis->First = (int32*)malloc(DstSize * sizeof(int32));
+	Axis->TapCount = 1;
+	for (uint32 i = 0; i < DstSize; ++i)
+	{
+		real32 Center = (i + 0.5f) * Scale;
+		int32 First = (int32)floorf(Center - Support - 0.5f);
+		real32 *Weights = RawWeights + (uint64)i * RawTapCount;
+
+		uint32 Lo = RawTapCount, Hi = 0;
+		for (uint32 t = 0; t < RawTapCount; ++t)
+		{
+			Weights[t] = FilterWeight(Filter, (First + (int32)t + 0.5f - Center) / Scale, Scale);
+			if (Weights[t] != 0.f)
+			{
+				Lo = Min(Lo, t);
+				Hi = t;
+			}
+		}
+
+		Axis->First[i] = First + (int32)Lo;
+		Spans[i] = Hi - Lo + 1;
+		memmove(Weights, Weights + Lo, Spans[i] * sizeof(real32));
+		Axis->TapCount = Max(Axis->TapCount, Spans[i]);
+	}
+
+	Axis->Weights = (real32*)malloc((uint64)DstSize * Axis->TapCount * sizeof(real32));
+	for (uint32 i = 0; i < DstSize; ++i)
+	{
+		real32 const *Src = RawWeights + (uint64)i * RawTapCount;
+		real32 *Weights = Axis->Weights + (uint64)i * Axis->TapCount;
+
+		real32 Sum = 0.f;
+		for (uint32 t = 0; t < Spans[i]; ++t)
+			Sum += Src[t];
+		for (uint32 t = 0; t < Axis->TapCount; ++t)
+			Weights[t] = (t < Spans[i]) ? Src[t] / Sum : 0.f;
+	}
+
+	free(Spans);
+	free(RawWeights);
+}
+
+static void FreeFilterAxis(filter_axis *Axis)
+{
+	free(Axis->First);
+	free(Axis->Weights);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Level generation
+
+#define MIP_JOB_ROWS 64
+#define MIP_JOB_MIN_PIXELS (16 * 1024)
+#define MIP_SRGB_LUT_SIZE 16384
+
+static real32 SRGBToLinear(real32 V)
+{
+	return (V <= 0.04045f) ? V / 12.92f : powf((V + 0.055f) / 1.055f, 2.4f);
+}
+
+static real32 LinearToSRGB(real32 V)
+{
+	return (V <= 0.0031308f) ? V * 12.92f : 1.055f * powf(V, 1.f / 2.4f) - 0.055f;
+}
+
+// Conversion tables for uint8 images, built once (thread-safe static init)
+struct conversion_tables
+{
+	real32	ToLinear[256];
+	uint8	FromLinear[MIP_SRGB_LUT_SIZE + 1];
+
+	conversion_tables()
+	{
+		for (int32 i = 0; i < 256; ++i)
+			ToLinear[i] = SRGBToLinear(i / 255.f);
+		for (int32 i = 0; i <= MIP_SRGB_LUT_SIZE; ++i)
+			FromLinear[i] = (uint8)(LinearToSRGB((real32)i / MIP_SRGB_LUT_SIZE) * 255.f + 0.5f);
+	}
+};
+
+static conversion_tables const &Tables()
+{
+	static conversion_tables Tables;
+	return Tables;
+}
+
+struct level_job
+{
+	void const			*Src;
+	uint32				SrcWidth, SrcHeight;
+	void				*Dst;
+	uint32				DstWidth;
+	uint32				Channels;
+	bool				IsFloat;
+	bool				SRGB;		// color channels are sRGB-encoded
+	filter_axis const	*AxisX, *AxisY;
+	uint32				RowBegin, RowEnd;
+};
+
+// Source row to RGBA linear floats (missing channels are 0)
+static void LoadRow(level_job const *Job, uint32 Y, real32 *Out)
+{
+	uint64 Offset = (uint64)Y * Job->SrcWidth * Job->Channels;
+	if (Job->IsFloat)
+	{
+		real32 const *Src = (real32 const*)Job->Src + Offset;
+		for (uint32 x = 0; x < Job->SrcWidth; ++x, Src += Job->Channels, Out += 4)
+		{
+			for (uint32 c = 0; c < 4; ++c)
+				Out[c] = (c < Job->Channels) ? Src[c] : 0.f;
+		}
+	}
+	else
+	{
+		real32 const *ToLinear = Tables().ToLinear;
+		uint8 const *Src = (uint8 const*)Job->Src + Offset;
+		uint32 SRGBChannels = Job->SRGB ? 3 : 0;
+		for (uint32 x = 0; x < Job->SrcWidth; ++x, Src += Job->Channels, Out += 4)
+		{
+			for (uint32 c = 0; c < 4; ++c)
+				Out[c] = (c >= Job->Channels) ? 0.f : (c < SRGBChannels ? ToLinear[Src[c]] : Src[c] * (1.f / 255.f));
+		}
+	}
+}
+
+static void StoreRow(level_job const *Job, uint32 Y, real32 const *In)
+{
+	uint64 Offset = (uint64)Y * Job->DstWidth * Job->Channels;
+	if (Job->IsFloat)
+	{
+		// NOTE - The negative lobes of the sharper filters can ring below 0 near bright texels, which is clamped
+		real32 *Dst = (real32*)Job->Dst + Offset;
+		for (uint32 x = 0; x < Job->DstWidth; ++x, Dst += Job->Channels, In += 4)
+		{
+			for (uint32 c = 0; c < Job->Channels; ++c)
+				Dst[c] = Max(In[c], 0.f);
+		}
+	}
+	else
+	{
+		uint8 const *FromLinear = Tables().FromLinear;
+		uint8 *Dst = (uint8*)Job->Dst + Offset;
+		uint32 SRGBChannels = Job->SRGB ? 3 : 0;
+		for (uint32 x = 0; x < Job->DstWidth; ++x, Dst += Job->Channels, In += 4)
+		{
+			for (uint32 c = 0; c < Job->Channels; ++c)
+			{
+				real32 V = Clamp(In[c], 0.f, 1.f);
+				Dst[c] = (c < SRGBChannels) ? FromLinear[(int32)(V * MIP_SRGB_LUT_SIZE + 0.5f)] : (uint8)(V * 255.f + 0.5f);
+			}
+		}
+	}
+}
+
+static void FilterRowHorizontal(filter_axis const *Axis, real32 const *Src, int32 SrcWidth, real32 *Dst, uint32 DstWidth)
+{
+	for (uint32 x = 0; x < DstWidth; ++x, Dst += 4)
+	{
+		int32 First = Axis->First[x];
+		real32 const *Weights = Axis->Weights + (uint64)x * Axis->TapCount;
+#ifdef RF_SSE2
+		__m128 Acc = _mm_setzero_ps();
+		for (uint32 t = 0; t < Axis->TapCount; ++t)
+		{
+			int32 SrcX = Min(Max(First + (int32)t, 0), SrcWidth - 1);
+			Acc = _mm_add_ps(Acc, _mm_mul_ps(_mm_set1_ps(Weights[t]), _mm_loadu_ps(Src + SrcX * 4)));
+		}
+		_mm_storeu_ps(Dst, Acc);
+#else
+		Dst[0] = Dst[1] = Dst[2] = Dst[3] = 0.f;
+		for (uint32 t = 0; t < Axis->TapCount; ++t)
+		{
+			int32 SrcX = Min(Max(First + (int32)t, 0), SrcWidth - 1);
+			for (uint32 c = 0; c < 4; ++c)
+				Dst[c] += Weights[t] * Src[SrcX * 4 + c];
+		}
+#endif
+	}
+}
+
+// Dst = sum of the rows weighted, Count floats (multiple of 4)
+static void FilterRowsVertical(real32 const * const *Rows, real32 const *Weights, uint32 TapCount, real32 *Dst, uint32 Count)
+{
+#ifdef RF_SSE2
+	for (uint32 i = 0; i < Count; i += 4)
+	{
+		__m128 Acc = _mm_setzero_ps();
+		for (uint32 t = 0; t < TapCount; ++t)
+			Acc = _mm_add_ps(Acc, _mm_mul_ps(_mm_set1_ps(Weights[t]), _mm_loadu_ps(Rows[t] + i)));
+		_mm_storeu_ps(Dst + i, Acc);
+	}
+#else
+	for (uint32 i = 0; i < Count; ++i)
+	{
+		real32 Acc = 0.f;
+		for (uint32 t = 0; t < TapCount; ++t)
+			Acc += Weights[t] * Rows[t][i];
+		Dst[i] = Acc;
+	}
+#endif
+}
+
+// Filters the destination rows [RowBegin, RowEnd) : the source rows they use are loaded and filtered horizontally
+// once, then combined vertically
+static void FilterRows(void *UserData)
+{
+	level_job const *Job = (level_job const*)UserData;
+	filter_axis const *AxisY = Job->AxisY;
+	uint32 TapCount = AxisY->TapCount;
+	uint32 RowFloats = Job->DstWidth * 4;
+
+	int32 FirstRow = AxisY->First[Job->RowBegin];
+	uint32 RowCount = (uint32)(AxisY->First[Job->RowEnd - 1] - FirstRow) + TapCount;
+
+	real32 *Line = (real32*)malloc((uint64)Job->SrcWidth * 4 * sizeof(real32));
+	real32 *Rows = (real32*)malloc(((uint64)RowCount + 1) * RowFloats * sizeof(real32));
+	real32 *Out = Rows + (uint64)RowCount * RowFloats;
+	real32 const **RowPtrs = (real32 const**)malloc(TapCount * sizeof(real32*));
+
+	for (uint32 r = 0; r < RowCount; ++r)
+	{
+		uint32 SrcY = (uint32)Min(Max(FirstRow + (int32)r, 0), (int32)Job->SrcHeight - 1);
+		LoadRow(Job, SrcY, Line);
+		FilterRowHorizontal(Job->AxisX, Line, (int32)Job->SrcWidth, Rows + (uint64)r * RowFloats, Job->DstWidth);
+	}
+
+	for (uint32 y = Job->RowBegin; y < Job->RowEnd; ++y)
+	{
+		for (uint32 t = 0; t < TapCount; ++t)
+			RowPtrs[t] = Rows + (uint64)(AxisY->First[y] - FirstRow + t) * RowFloats;
+		FilterRowsVertical(RowPtrs, AxisY->Weights + (uint64)y * TapCount, TapCount, Out, RowFloats);
+		StoreRow(Job, y, Out);
+	}
+
+	free(RowPtrs);
+	free(Rows);
+	free(Line);
+}
+
+static void GenerateLevel(mip_chain const *Chain, bool SRGB, mip_filter Filter, uint32 Level)
+{
+	uint32 SrcWidth = Max(Chain->Width >> (Level - 1), 1u), SrcHeight = Max(Chain->Height >> (Level - 1), 1u);
+	uint32 DstWidth = Max(Chain->Width >> Level, 1u), DstHeight = Max(Chain->Height >> Level, 1u);
+
+	filter_axis AxisX, AxisY;
+	MakeFilterAxis(&AxisX, Filter, SrcWidth, DstWidth);
+	MakeFilterAxis(&AxisY, Filter, SrcHeight, DstHeight);
+
+	// Bands big enough for the job overhead (and the rows shared with the neighbouring bands) to stay small
+	uint32 BandRows = Max((uint32)MIP_JOB_ROWS, MIP_JOB_MIN_PIXELS / DstWidth);
+	uint32 JobCount = (DstHeight + BandRows - 1) / BandRows;
+	level_job *Jobs = (level_job*)malloc(JobCount * sizeof(level_job));
+
+	job_group Group = {};
+	for (uint32 j = 0; j < JobCount; ++j)
+	{
+		level_job &Job = Jobs[j];
+		Job.Src = Chain->Levels[Level - 1];
+		Job.SrcWidth = SrcWidth;
+		Job.SrcHeight = SrcHeight;
+		Job.Dst = (void*)Chain->Levels[Level];
+		Job.DstWidth = DstWidth;
+		Job.Channels = Chain->Channels;
+		Job.IsFloat = Chain->IsFloat;
+		Job.SRGB = SRGB && !Chain->IsFloat && Chain->Channels >= 3;
+		Job.AxisX = &AxisX;
+		Job.AxisY = &AxisY;
+		Job.RowBegin = j * BandRows;
+		Job.RowEnd = Min(Job.RowBegin + BandRows, DstHeight);
+		jobs::Submit(&Group, FilterRows, &Job);
+	}
+	jobs::Wait(&Group);
+
+	free(Jobs);
+	FreeFilterAxis(&AxisX);
+	FreeFilterAxis(&AxisY);
+}
+
+// Sets the chain description and level sizes, without the level data
+static void InitChain(mip_chain *Chain, void const *Pixels, uint32 Width, uint32 Height, uint32 Channels, bool IsFloat)
+{
+	memset(Chain, 0, sizeof(mip_chain));
+	Chain->Width = Width;
+	Chain->Height = Height;
+	Chain->Channels = Channels;
+	Chain->IsFloat = IsFloat;
+	Chain->LevelCount = Min(mip::LevelCount(Width, Height), (uint32)MIP_MAX_LEVELS);
+	Chain->Levels[0] = Pixels;
+
+	uint64 TexelSize = Channels * (IsFloat ? sizeof(real32) : sizeof(uint8));
+	for (uint32 m = 0; m < Chain->LevelCount; ++m)
+		Chain->LevelSizes[m] = (uint64)Max(Width >> m, 1u) * Max(Height >> m, 1u) * TexelSize;
+}
+
+bool mip::Generate(mip_chain *Chain, void const *Pixels, uint32 Width, uint32 Height, uint32 Channels, bool IsFloat,
+	bool SRGB, mip_filter Filter)
+{
+	memset(Chain, 0, sizeof(mip_chain));
+	if (!Pixels || !Width || !Height || Channels < 1 || Channels > 4)
+		return false;
+
+	InitChain(Chain, Pixels, Width, Height, Channels, IsFloat);
+
+	uint64 LevelsSize = 0;
+	for (uint32 m = 1; m < Chain->LevelCount; ++m)
+		LevelsSize += Chain->LevelSizes[m];
+
+	if (LevelsSize)
+	{
+		Chain->Allocated = (uint8*)malloc(LevelsSize);
+		if (!Chain->Allocated)
+		{
+			LogError("Mip chain generation : can't allocate %llu bytes.", (unsigned long long)LevelsSize);
+			memset(Chain, 0, sizeof(mip_chain));
+			return false;
+		}
+	}
+
+	uint8 *Dst = Chain->Allocated;
+	for (uint32 m = 1; m < Chain->LevelCount; ++m)
+	{
+		Chain->Levels[m] = Dst;
+		Dst += Chain->LevelSizes[m];
+		GenerateLevel(Chain, SRGB, Filter, m);
+	}
+
+	return true;
+}
+
+void mip::Free(mip_chain *Chain)
+{
+	free(Chain->Allocated);
+	FileUnmapView(&Chain->CacheView);
+	memset(Chain, 0, sizeof(mip_chain));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Cache
+//
+// One file per chain, named after its key : a mip_cache_header followed by the levels 1..LevelCount-1.
+// The key hashes the source pixels and every generation parameter, so modified sources just get a new file.
+
+#define MIP_CACHE_MAGIC 0x434D4652 // "RFMC"
+#define MIP_CACHE_VERSION 1
+
+struct mip_cache_header
+{
+	uint32 Magic;
+	uint32 Version;
+	uint64 Key;
+	uint32 Width, Height;
+	uint32 Channels, IsFloat;
+	uint32 SRGB, Filter;
+	uint32 LevelCount, Pad;
+};
+
+// Hashes 8 bytes at a time, the images can be large
+static uint64 HashPixels(void const *Data, uint64 Size)
+{
+	uint8 const *Bytes = (uint8 const*)Data;
+	uint64 Hash = 0xcbf29ce484222325ull ^ Size;
+	uint64 i = 0;
+	for (; i + 8 <= Size; i += 8)
+	{
+		uint64 Word;
+		memcpy(&Word, Bytes + i, 8);
+		Hash = (Hash ^ Word) * 0xff51afd7ed558ccdull;
+		Hash ^= Hash >> 29;
+	}
+	for (; i < Size; ++i)
+		Hash = (Hash ^ Bytes[i]) * 0x100000001b3ull;
+	return hash_uint64(Hash);
+}
+
+// False when the name doesn't fit in a path
+static bool CacheFilename(path Dst, char const *CacheDir, uint64 Key)
+{
+	int const Length = snprintf(Dst, MAX_PATH, "%s%016llx.mips", CacheDir, (unsigned long long)Key);
+	return Length > 0 && Length < MAX_PATH;
+}
+
+static bool ReadCache(mip_chain *Chain, char const *CacheDir, mip_cache_header const *Expected)
+{
+	path Filename;
+	if (!CacheFilename(Filename, CacheDir, Expected->Key))
+		return false;
+	if (!DiskFileExists(Filename) || !FileMapView(&Chain->CacheView, Filename, FILE_ACCESS_SEQUENTIAL))
+		return false;
+
+	uint64 Size = sizeof(mip_cache_header);
+	for (uint32 m = 1; m < Chain->LevelCount; ++m)
+		Size += Chain->LevelSizes[m];
+
+	file_view const *View = &Chain->CacheView;
+	if (View->Size != Size || memcmp(View->Data, Expected, sizeof(mip_cache_header)))
+	{
+		LogInfo("Mip cache : %s doesn't match its source, regenerating it.", Filename);
+		FileUnmapView(&Chain->CacheView);
+		return false;
+	}
+
+	uint8 const *Level = View->Data + sizeof(mip_cache_header);
+	for (uint32 m = 1; m < Chain->LevelCount; ++m)
+	{
+		Chain->Levels[m] = Level;
+		Level += Chain->LevelSizes[m];
+	}
+	return true;
+}
+
+// Written in a temp file renamed once complete, so that an interrupted write is never read back
+static void WriteCache(mip_chain const *Chain, char const *CacheDir, mip_cache_header const *Header)
+{
+	path Filename, TmpFilename;
+	int const TmpLength = CacheFilename(Filename, CacheDir, Header->Key) ?
+		snprintf(TmpFilename, MAX_PATH, "%s.tmp", Filename) : -1;
+	if (TmpLength <= 0 || TmpLength >= MAX_PATH)
+	{
+		LogError("Mip cache : the cache file name in %s is longer than %d chars, not written.", CacheDir, MAX_PATH - 1);
+		return;
+	}
+
+	FILE *fp = fopen(TmpFilename, "wb");
+	if (!fp)
+	{
+		LogError("Mip cache : can't write %s.", TmpFilename);
+		return;
+	}
+
+	bool Written = fwrite(Header, sizeof(mip_cache_header), 1, fp) == 1;
+	for (uint32 m = 1; Written && m < Chain->LevelCount; ++m)
+		Written = fwrite(Chain->Levels[m], 1, Chain->LevelSizes[m], fp) == Chain->LevelSizes[m];
+	fclose(fp);
+
+	if (Written)
+	{
+		remove(Filename);
+		Written = rename(TmpFilename, Filename) == 0;
+	}
+	if (!Written)
+	{
+		LogError("Mip cache : error writing %s.", Filename);
+		remove(TmpFilename);
+	}
+}
+
+bool mip::Build(mip_chain *Chain, char const *CacheDir, void const *Pixels, uint32 Width, uint32 Height, uint32 Channels,
+	bool IsFloat, bool SRGB, mip_filter Filter, bool *CacheHit)
+{
+	TRACE_SCOPE("resource", "mip::Build");
+	if (CacheHit)
+		*CacheHit = false;
+	if (!CacheDir || !CacheDir[0])
+		return Generate(Chain, Pixels, Width, Height, Channels, IsFloat, SRGB, Filter);
+
+	if (!Pixels || !Width || !Height || Channels < 1 || Channels > 4)
+	{
+		memset(Chain, 0, sizeof(mip_chain));
+		return false;
+	}
+
+	InitChain(Chain, Pixels, Width, Height, Channels, IsFloat);
+
+	mip_cache_header Header = {};
+	Header.Magic = MIP_CACHE_MAGIC;
+	Header.Version = MIP_CACHE_VERSION;
+	Header.Width = Width;
+	Header.Height = Height;
+	Header.Channels = Channels;
+	Header.IsFloat = IsFloat;
+	Header.SRGB = SRGB && !IsFloat && Channels >= 3;
+	Header.Filter = (uint32)Filter;
+	Header.LevelCount = Chain->LevelCount;
+	Header.Key = HashPixels(Pixels, Chain->LevelSizes[0]) ^ hash_bytes((char const*)&Header, sizeof(Header));
+
+	if (ReadCache(Chain, CacheDir, &Header))
+	{
+		if (CacheHit)
+			*CacheHit = true;
+		return true;
+	}
+
+	if (!Generate(Chain, Pixels, Width, Height, Channels, IsFloat, SRGB, Filter))
+		return false;
+
+	WriteCache(Chain, CacheDir, &Header);
+	return true;
+}
+}
@@ -1,5 +1,6 @@
 #include "context.h"
 #include "utils.h"
+#include "trace.h"
 
 #define TINYGLTF_IMPLEMENTATION
 #include "tiny_gltf.h"
@@ -55,8 +56,28 @@ static size_t GetComponentSize(int ComponentType)
     }
 }
 
-bool ModelLoadGLTF(context *Context, model *Model, path const Filename, int AnisotropicLevel)
+// Loads a material texture as a separate texture, or in a layer of the texture arrays if given
+static void MaterialTexture(render_resources *RenderResources, texture_array_pool *TextureArrays,
+                            tinygltf::Image const &Img, tinygltf::Sampler const &Spl, bool SRGB, real32 AnisotropicLevel,
+                            uint32 *Texture, texture_layer *Layer)
 {
+    if(TextureArrays)
+    {
+        *Layer = texarray::Add(TextureArrays, (void const*)&Img.image[0], (uint32)Img.width, (uint32)Img.height,
+                               (uint32)Img.component, false, false, SRGB, AnisotropicLevel,
+                               Spl.magFilter, Spl.minFilter, Spl.wrapS, Spl.wrapT);
+    }
+    else
+    {
+        *Texture = Make2DMipmappedTexture(RenderResources, (void*)&Img.image[0], (uint32)Img.width, (uint32)Img.height,
+                                          (uint32)Img.component, false, false, SRGB, AnisotropicLevel,
+                                          Spl.magFilter, Spl.minFilter, Spl.wrapS, Spl.wrapT);
+    }
+}
+
+bool ModelLoadGLTF(context *Context, model *Model, path const Filename, int AnisotropicLevel, texture_array_pool *TextureArrays)
+{
+    TRACE_SCOPE("resource", "ModelLoadGLTF", Filename);
     tinygltf::Model Mdl;
     tinygltf::TinyGLTF Loader;
 
@@ -65,11 +86,27 @@ bool ModelLoadGLTF(context *Context, model *Model, path const Filename, int Anis
     
     using namespace tinygltf;
 
-    stbi_set_flip_vertically_on_load(0);
+    // NOTE - rf never sets stbi_set_flip_vertically_on_load (see DecodeImageMemory), images are decoded as stored
 	bool Ret;
 	{
+		// Parse from a mapped view, tinygltf copies what it keeps from it
+		file_view View;
+		if (!FileMapView(&View, Filepath, FILE_ACCESS_SEQUENTIAL) || !View.Size)
+		{
+			printf("Error loading glTF model %s : can't read the file, or it is empty\n", Filepath);
+			return false;
+		}
+
+		std::string BaseDir(Filepath);
+		size_t LastSep = BaseDir.find_last_of("/\\");
+		BaseDir = (LastSep != std::string::npos) ? BaseDir.substr(0, LastSep) : "";
+
 		std::string LoadErr;
-		Ret = Loader.LoadASCIIFromFile(&Mdl, &LoadErr, Filepath);
+		if (View.Size >= 4 && !memcmp(View.Data, "glTF", 4))
+			Ret = Loader.LoadBinaryFromMemory(&Mdl, &LoadErr, View.Data, (unsigned int)View.Size, BaseDir);
+		else
+			Ret = Loader.LoadASCIIFromString(&Mdl, &LoadErr, (char const*)View.Data, (unsigned int)View.Size, BaseDir);
+		FileUnmapView(&View);
 
 		if (!LoadErr.empty())
 		{
@@ -103,7 +140,7 @@ bool ModelLoadGLTF(context *Context, model *Model, path const Filename, int Anis
     for(auto const &SrcMtl : Mdl.materials)
     {
         //material &DstMtl = Model->Material[iter++];
-		material DstMtl;
+		material DstMtl = {};
 
         if(SrcMtl.values.size() == 0)
         { // NOTE - Default Magenta color for error
@@ -122,9 +159,8 @@ bool ModelLoadGLTF(context *Context, model *Model, path const Filename, int Anis
                 int TextureIndex = (int)DiffuseTexIdx->second.json_double_value.at("index");
                 const Image &img = Mdl.images[Mdl.textures[TextureIndex].source];
                 const Sampler &spl = Mdl.samplers[Mdl.textures[TextureIndex].sampler];
-                DstMtl.AlbedoTexture = Make2DTexture((void*)&img.image[0], (uint32)img.width, (uint32)img.height, (uint32)img.component, 
-                        false, false, (real32)AnisotropicLevel,
-                        spl.magFilter, spl.minFilter, spl.wrapS, spl.wrapT);
+                MaterialTexture(RenderResources, TextureArrays, img, spl, true, (real32)AnisotropicLevel,
+                                &DstMtl.AlbedoTexture, &DstMtl.AlbedoLayer);
             }
             else
             { // NOTE - No diffuse texture : put in the Default
@@ -137,9 +173,8 @@ bool ModelLoadGLTF(context *Context, model *Model, path const Filename, int Anis
                 int TextureIndex = (int)RoughnessTexIdx->second.json_double_value.at("index");
                 const Image &img = Mdl.images[Mdl.textures[TextureIndex].source];
                 const Sampler &spl = Mdl.samplers[Mdl.textures[TextureIndex].sampler];
-                DstMtl.RoughnessMetallicTexture = Make2DTexture((void*)&img.image[0], (uint32)img.width, (uint32)img.height, (uint32)img.component, 
-                        false, false, (real32)AnisotropicLevel,
-                        spl.magFilter, spl.minFilter, spl.wrapS, spl.wrapT);
+                MaterialTexture(RenderResources, TextureArrays, img, spl, false, (real32)AnisotropicLevel,
+                                &DstMtl.RoughnessMetallicTexture, &DstMtl.RoughnessMetallicLayer);
             }
             else
             { // NOTE - No diffuse texture : put in the Default
@@ -152,8 +187,8 @@ bool ModelLoadGLTF(context *Context, model *Model, path const Filename, int Anis
                 int TextureIndex = (int)NormalTexIdx->second.json_double_value.at("index");
                 const Image &img = Mdl.images[Mdl.textures[TextureIndex].source];
                 const Sampler &spl = Mdl.samplers[Mdl.textures[TextureIndex].sampler];
-                DstMtl.NormalTexture = Make2DTexture((void*)&img.image[0], img.width, img.height, img.component,
-                        false, false, (real32)AnisotropicLevel, spl.magFilter, spl.minFilter, spl.wrapS, spl.wrapT);
+                MaterialTexture(RenderResources, TextureArrays, img, spl, false, (real32)AnisotropicLevel,
+                                &DstMtl.NormalTexture, &DstMtl.NormalLayer);
             }
             else
             {
@@ -166,8 +201,8 @@ bool ModelLoadGLTF(context *Context, model *Model, path const Filename, int Anis
                 int TextureIndex = (int)EmissiveTexIdx->second.json_double_value.at("index");
                 const Image &img = Mdl.images[Mdl.textures[TextureIndex].source];
                 const Sampler &spl = Mdl.samplers[Mdl.textures[TextureIndex].sampler];
-                DstMtl.EmissiveTexture = Make2DTexture((void*)&img.image[0], img.width, img.height, img.component,
-                        false, false, (real32)AnisotropicLevel, spl.magFilter, spl.minFilter, spl.wrapS, spl.wrapT);
+                MaterialTexture(RenderResources, TextureArrays, img, spl, true, (real32)AnisotropicLevel,
+                                &DstMtl.EmissiveTexture, &DstMtl.EmissiveLayer);
             }
             else
             {
@@ -218,6 +253,14 @@ bool ModelLoadGLTF(context *Context, model *Model, path const Filename, int Anis
                 DstMtl.EmissiveMult = vec3f(1.f);
             }
         }
+
+        if(TextureArrays)
+        { // NOTE - Missing textures : default layers, the shader samples the arrays only
+            if(!DstMtl.AlbedoLayer.Array) DstMtl.AlbedoLayer = TextureArrays->DefaultDiffuse;
+            if(!DstMtl.RoughnessMetallicLayer.Array) DstMtl.RoughnessMetallicLayer = TextureArrays->DefaultDiffuse;
+            if(!DstMtl.NormalLayer.Array) DstMtl.NormalLayer = TextureArrays->DefaultNormal;
+            if(!DstMtl.EmissiveLayer.Array) DstMtl.EmissiveLayer = TextureArrays->DefaultEmissive;
+        }
 		rf::BufPush(Model->Materials, DstMtl);
     }
 
@@ -394,10 +437,21 @@ bool ModelLoadGLTF(context *Context, model *Model, path const Filename, int Anis
     return true;
 }
 
-void ModelFree(model *Model)
+void ModelFree(model *Model, texture_array_pool *TextureArrays)
 {
 	Assert(Model);
 
+	if (TextureArrays)
+	{
+		for (material *Mtl = Model->Materials; Mtl != BufEnd(Model->Materials); ++Mtl)
+		{
+			texarray::Remove(TextureArrays, Mtl->AlbedoLayer);
+			texarray::Remove(TextureArrays, Mtl->RoughnessMetallicLayer);
+			texarray::Remove(TextureArrays, Mtl->NormalLayer);
+			texarray::Remove(TextureArrays, Mtl->EmissiveLayer);
+		}
+	}
+
 	for (int i = 0; i < BufSize(Model->Meshes); ++i)
 	{
 		rf::DestroyMesh(&Model->Meshes[i]);
@@ -1,6 +1,15 @@
 #include "render.h"
 #include "context.h"
 #include "utils.h"
+#include "watch.h"
+#include "vfs.h"
+#include "io.h"
+#include "jobs.h"
+#include "convert.h"
+#include "trace.h"
+#include "glyphcache.h"
+#include "textlayout.h"
+#include "sdf.h"
 
 #include "stb_image.h"
 #include "stb_truetype.h"
@@ -37,76 +46,347 @@ static char const *GetResourceTypeName(render_resource_type Type)
 	return ResourceTypeName[Type];
 }
 
-void *ResourceCheckExist(render_resources *RenderResources, render_resource_type Type, path const Filename)
+static resource_entry *GetEntry(render_resources *RenderResources, render_resource_type Type, path const Filename)
 {
-	Assert(Type < RESOURCE_COUNT);
-	LogDebug("Checking for %s resource %s", GetResourceTypeName(Type), (char*)Filename);
-
 	resource_store *Store = GetStore(RenderResources, Type);
 	if (Store)
 	{
-		return MapStoreGet(Store, Filename);
+		return (resource_entry*)MapStoreGet(Store, Filename);
 	}
 
 	return NULL;
 }
 
-void ResourceStore(render_resources *RenderResources, render_resource_type Type, path const Filename, void *Resource)
+// The entries are found by their resource pointer through EntryTable, kept at most half full
+static uint32 EntrySlot(render_resources const *RenderResources, void const *Resource)
 {
-	Assert(Type < RESOURCE_COUNT);
+	uint64 Hash = (uint64)Resource * 0x9E3779B97F4A7C15ULL;
+	return (uint32)(Hash ^ (Hash >> 32)) & (RenderResources->EntryTableSize - 1);
+}
 
-	resource_store *Store = GetStore(RenderResources, Type);
-	if (Store)
+static resource_entry *FindEntry(render_resources const *RenderResources, void const *Resource)
+{
+	if (!RenderResources->EntryTableSize)
+		return NULL;
+
+	uint32 const Mask = RenderResources->EntryTableSize - 1;
+	for (uint32 i = EntrySlot(RenderResources, Resource); RenderResources->EntryTable[i]; i = (i + 1) & Mask)
 	{
-		LogDebug("Storing %s [%llu]", Filename, (Type == RESOURCE_IMAGE || Type == RESOURCE_TEXTURE) ? (uint64)*((uint32*)Resource) : (uint64)Resource);
-		MapStoreAdd(Store, Filename, Resource);
+		if (RenderResources->EntryTable[i]->Resource == Resource)
+			return RenderResources->EntryTable[i];
 	}
+	return NULL;
 }
 
-void DestroyImage(image *Image);
-void ResourceFree(render_resources *RenderResources)
+static void InsertEntry(render_resources *RenderResources, resource_entry *Entry)
 {
-	resource_store *Store;
+	if (2 * (BufSize(RenderResources->Entries) + 1) > RenderResources->EntryTableSize)
 	{
-		Store = &RenderResources->Images;
-		for (uint64 i = 0; i < Store->HMap.Capacity; ++i)
+		resource_entry **OldTable = RenderResources->EntryTable;
+		uint32 const OldSize = RenderResources->EntryTableSize;
+		RenderResources->EntryTableSize = OldSize ? 2 * OldSize : 64;
+		RenderResources->EntryTable = (resource_entry**)calloc(RenderResources->EntryTableSize, sizeof(resource_entry*));
+		for (uint32 i = 0; i < OldSize; ++i)
 		{
-			const char *KeyStr = MapStoreGetKey(Store, i);
-			if (KeyStr)
-			{
-				LogDebug("Destroying image %s", KeyStr);
-				DestroyImage((image*)MapStoreGet(Store, KeyStr));
-			}
+			if (OldTable[i])
+				InsertEntry(RenderResources, OldTable[i]);
 		}
-		MapStoreFree(Store);
-		
+		free(OldTable);
+	}
+
+	uint32 const Mask = RenderResources->EntryTableSize - 1;
+	uint32 i = EntrySlot(RenderResources, Entry->Resource);
+	while (RenderResources->EntryTable[i])
+		i = (i + 1) & Mask;
+	RenderResources->EntryTable[i] = Entry;
+}
+
+// Removes the entry and moves back the ones after it in the probe run, so that no search stops short
+static void EraseEntry(render_resources *RenderResources, resource_entry const *Entry)
+{
+	uint32 const Mask = RenderResources->EntryTableSize - 1;
+	uint32 i = EntrySlot(RenderResources, Entry->Resource);
+	while (RenderResources->EntryTable[i] != Entry)
+		i = (i + 1) & Mask;
+
+	for (uint32 j = (i + 1) & Mask; RenderResources->EntryTable[j]; j = (j + 1) & Mask)
+	{
+		// The entry at j can fill the hole if its home slot isn't in (i, j]
+		uint32 const Home = EntrySlot(RenderResources, RenderResources->EntryTable[j]->Resource);
+		if (((j - Home) & Mask) >= ((j - i) & Mask))
+		{
+			RenderResources->EntryTable[i] = RenderResources->EntryTable[j];
+			i = j;
+		}
+	}
+	RenderResources->EntryTable[i] = NULL;
+}
+
+void *ResourceCheckExist(render_resources *RenderResources, render_resource_type Type, path const Filename)
+{
+	Assert(Type < RESOURCE_COUNT);
+	LogDebug("Checking for %s resource %s", GetResourceTypeName(Type), (char*)Filename);
+
+	resource_entry *Entry = GetEntry(RenderResources, Type, Filename);
+	return Entry ? Entry->Resource : NULL;
+}
+
+void *ResourceAcquire(render_resources *RenderResources, render_resource_type Type, path const Filename)
+{
+	Assert(Type < RESOURCE_COUNT);
+
+	resource_entry *Entry = GetEntry(RenderResources, Type, Filename);
+	if (!Entry)
+	{
+		RenderResources->Stats.Misses++;
+		return NULL;
 	}
+
+	RenderResources->Stats.Hits++;
+	Entry->RefCount++;
+	Entry->LastUse = ++RenderResources->UseTick;
+	return Entry->Resource;
+}
+
+void DestroyImage(image *Image);
+static void DestroyResource(render_resources *RenderResources, resource_entry *Entry)
+{
+	LogDebug("Destroying %s %s", GetResourceTypeName(Entry->Type), Entry->Name);
+	switch (Entry->Type)
 	{
-		Store = &RenderResources->Fonts;
-		for (uint64 i = 0; i < Store->HMap.Capacity; ++i)
+	case RESOURCE_IMAGE:
+		DestroyImage((image*)Entry->Resource);
+		break;
+	case RESOURCE_TEXTURE:
+		glDeleteTextures(1, (uint32*)Entry->Resource);
+		break;
+	case RESOURCE_FONT:
 		{
-			const char *KeyStr = MapStoreGetKey(Store, i);
-			if (KeyStr)
+			font *Font = (font*)Entry->Resource;
+			free(Font->Kerning);
+			if (Font->GlyphRects[1])
 			{
-				LogDebug("Destroying font %s", KeyStr);
+				glDeleteTextures(1, &Font->GlyphRects[1]);
+				glDeleteBuffers(1, &Font->GlyphRects[0]);
 			}
+			RenderResources->FontGeneration++;
+			if (Font->Cache)
+			{
+				glyphcache::ReleaseFace(Font->Cache, Font->Face);
+				break;
+			}
+			if (Font->Source)
+			{
+				// The atlas belongs to the distance field font, whose reference is given back with Entry->Parent
+				PoolFree(RenderResources->Pool, Font->Glyphs);
+				break;
+			}
+			if (Font->Atlas)
+			{
+				font **Fonts = Font->Atlas->Fonts;
+				for (uint64 i = 0; i < BufSize(Fonts); ++i)
+				{
+					if (Fonts[i] == Font)
+					{
+						Fonts[i] = BufPop(Fonts);
+						break;
+					}
+				}
+			}
+			else
+			{
+				glDeleteTextures(1, &Font->AtlasTextureID);
+				free(Font->Buffer);
+			}
+			PoolFree(RenderResources->Pool, Font->Glyphs);
 		}
-		MapStoreFree(Store);
+		break;
+	default:
+		break;
+	}
+}
+
+static bool OverBudget(render_resources *RenderResources)
+{
+	return (RenderResources->CPUBudget && RenderResources->Stats.CPUBytes > RenderResources->CPUBudget) ||
+		(RenderResources->GPUBudget && RenderResources->Stats.GPUBytes > RenderResources->GPUBudget);
+}
+
+// Removes the entry from the stores and frees the resource, whatever its refcount
+static void RemoveEntry(render_resources *RenderResources, uint64 EntryIdx)
+{
+	resource_entry *Entry = RenderResources->Entries[EntryIdx];
+	RenderResources->Entries[EntryIdx] = RenderResources->Entries[BufSize(RenderResources->Entries) - 1];
+	RenderResources->Entries[EntryIdx]->Index = EntryIdx;
+	mem_buf__hdr(RenderResources->Entries)->Size--;
+
+	MapStoreRemove(GetStore(RenderResources, Entry->Type), Entry->Name);
+	EraseEntry(RenderResources, Entry);
+	RenderResources->Stats.CPUBytes -= Entry->CPUBytes;
+	RenderResources->Stats.GPUBytes -= Entry->GPUBytes;
+	RenderResources->Stats.Count--;
+
+	if (Entry->ReloadInfo)
+	{
+		watch::RemoveUserData(Entry->ReloadInfo);
+		PoolFree(RenderResources->Pool, Entry->ReloadInfo);
+	}
 
+	// The parent can become evictable here
+	if (Entry->Parent)
+	{
+		Entry->Parent->RefCount--;
 	}
+
+	DestroyResource(RenderResources, Entry);
+	PoolFree(RenderResources->Pool, Entry->Resource);
+	PoolFree(RenderResources->Pool, Entry);
+}
+
+// Frees unreferenced resources, least recently used first, until both budgets are respected
+static void EvictResources(render_resources *RenderResources)
+{
+	while (OverBudget(RenderResources))
 	{
-		Store = &RenderResources->Textures;
-		for (uint64 i = 0; i < Store->HMap.Capacity; ++i)
+		uint64 LRUIdx = (uint64)-1;
+		for (uint64 i = 0; i < BufSize(RenderResources->Entries); ++i)
 		{
-			const char *KeyStr = MapStoreGetKey(Store, i);
-			if (KeyStr)
+			resource_entry *Entry = RenderResources->Entries[i];
+			if (Entry->RefCount <= 0 && (LRUIdx == (uint64)-1 || Entry->LastUse < RenderResources->Entries[LRUIdx]->LastUse))
 			{
-				LogDebug("Destroying texture %s", KeyStr);
-				glDeleteTextures(1, (uint32*)MapStoreGet(Store, KeyStr));
+				LRUIdx = i;
 			}
 		}
-		MapStoreFree(Store);
+
+		if (LRUIdx == (uint64)-1)
+		{ // everything left is in use
+			break;
+		}
+
+		resource_entry *Entry = RenderResources->Entries[LRUIdx];
+		LogInfo("Evicting %s %s (%llu KB CPU, %llu KB GPU)", GetResourceTypeName(Entry->Type), Entry->Name,
+			Entry->CPUBytes / KB, Entry->GPUBytes / KB);
+
+		RenderResources->Stats.Evictions++;
+		RemoveEntry(RenderResources, LRUIdx);
+	}
+}
+
+// Gives back a reference on Entry, and frees it right away if it isn't used anymore
+// Returns the number of CPU bytes freed
+static uint64 ReleaseAndDiscard(render_resources *RenderResources, resource_entry *Entry)
+{
+	Assert(Entry->RefCount > 0);
+	if (--Entry->RefCount > 0)
+		return 0;
+
+	uint64 Bytes = Entry->CPUBytes;
+	RemoveEntry(RenderResources, Entry->Index);
+	return Bytes;
+}
+
+void ResourceRelease(render_resources *RenderResources, void *Resource)
+{
+	if (!Resource)
+		return;
+
+	resource_entry *Entry = FindEntry(RenderResources, Resource);
+	if (!Entry)
+	{
+		LogError("Releasing a resource that isn't stored [%llu].", (uint64)Resource);
+		return;
+	}
+
+	// The fonts of a shared atlas aren't kept unused, for their rects to be given back (see FontAtlasCompact)
+	if (Entry->Type == RESOURCE_FONT && ((font*)Entry->Resource)->Atlas)
+	{
+		ReleaseAndDiscard(RenderResources, Entry);
+		return;
+	}
+
+	Assert(Entry->RefCount > 0);
+	Entry->RefCount--;
+	EvictResources(RenderResources);
+}
+
+resource_entry *ResourceStore(render_resources *RenderResources, render_resource_type Type, path const Filename, void *Resource,
+	uint64 CPUBytes, uint64 GPUBytes)
+{
+	Assert(Type < RESOURCE_COUNT);
+
+	resource_store *Store = GetStore(RenderResources, Type);
+	if (!Store)
+		return NULL;
+
+	LogDebug("Storing %s [%llu]", Filename, (Type == RESOURCE_IMAGE || Type == RESOURCE_TEXTURE) ? (uint64)*((uint32*)Resource) : (uint64)Resource);
+
+	// The caller gets the first reference
+	resource_entry *Entry = rf::PoolAlloc<resource_entry>(RenderResources->Pool, 1);
+	Entry->Type = Type;
+	Entry->Resource = Resource;
+	strncpy(Entry->Name, Filename, MAX_PATH - 1);
+	Entry->Name[MAX_PATH - 1] = 0;
+	Entry->RefCount = 1;
+	Entry->CPUBytes = CPUBytes;
+	Entry->GPUBytes = GPUBytes;
+	Entry->LastUse = ++RenderResources->UseTick;
+	Entry->Parent = NULL;
+	Entry->ReloadInfo = NULL;
+	Entry->Index = BufSize(RenderResources->Entries);
+
+	MapStoreAdd(Store, Filename, Entry);
+	InsertEntry(RenderResources, Entry);
+	BufPush(RenderResources->Entries, Entry);
+
+	RenderResources->Stats.CPUBytes += CPUBytes;
+	RenderResources->Stats.GPUBytes += GPUBytes;
+	RenderResources->Stats.Count++;
+	if (Type == RESOURCE_FONT)
+		RenderResources->FontGeneration++;
+
+	EvictResources(RenderResources);
+	return Entry;
+}
+
+// Updates the accounted size of a resource that was modified in place (e.g. hot-reloaded)
+static void ResourceResize(render_resources *RenderResources, resource_entry *Entry, uint64 CPUBytes, uint64 GPUBytes)
+{
+	RenderResources->Stats.CPUBytes += CPUBytes - Entry->CPUBytes;
+	RenderResources->Stats.GPUBytes += GPUBytes - Entry->GPUBytes;
+	Entry->CPUBytes = CPUBytes;
+	Entry->GPUBytes = GPUBytes;
+
+	EvictResources(RenderResources);
+}
+
+void ResourceSetBudget(render_resources *RenderResources, uint64 CPUBudget, uint64 GPUBudget)
+{
+	RenderResources->CPUBudget = CPUBudget;
+	RenderResources->GPUBudget = GPUBudget;
+
+	EvictResources(RenderResources);
+}
+
+void ResourceFree(render_resources *RenderResources)
+{
+	for (resource_entry **It = RenderResources->Entries; It != BufEnd(RenderResources->Entries); ++It)
+	{
+		DestroyResource(RenderResources, *It);
+	}
+	BufFree(RenderResources->Entries);
+	free(RenderResources->EntryTable);
+	RenderResources->EntryTable = NULL;
+	RenderResources->EntryTableSize = 0;
+
+	MapStoreFree(&RenderResources->Images);
+	MapStoreFree(&RenderResources->Fonts);
+	MapStoreFree(&RenderResources->Textures);
+	if (RenderResources->GlyphCache)
+	{
+		glyphcache::Destroy(RenderResources->GlyphCache);
+		RenderResources->GlyphCache = NULL;
 	}
+	RenderResources->Stats = resource_stats();
 }
 
 void CheckGLError(char const *Mark)
@@ -172,36 +452,153 @@ void CheckFramebufferError(char const *Mark)
 	)
 }
 
-image *ResourceLoadImage(context *Context, path const Filename, bool IsFloat, bool FlipY, int32 ForceNumChannel)
+// Load parameters kept for the hot-reload of images
+struct image_reload_info
+{
+	path Name;
+	bool IsFloat;
+	bool FlipY;
+	int32 ForceNumChannel;
+};
+
+// Reverses the row order of a decoded image in place
+static void FlipImageRows(image *Image, uint64 PixelBytes)
+{
+	uint64 RowBytes = (uint64)Image->Width * PixelBytes;
+	uint8 *Rows = (uint8*)Image->Buffer;
+	uint8 Tmp[1024];
+	for (int32 y = 0; y < Image->Height / 2; ++y)
+	{
+		uint8 *A = Rows + y * RowBytes, *B = Rows + (Image->Height - 1 - y) * RowBytes;
+		for (uint64 Offset = 0; Offset < RowBytes; Offset += sizeof(Tmp))
+		{
+			uint64 Bytes = Min((uint64)sizeof(Tmp), RowBytes - Offset);
+			memcpy(Tmp, A + Offset, Bytes);
+			memcpy(A + Offset, B + Offset, Bytes);
+			memcpy(B + Offset, Tmp, Bytes);
+		}
+	}
+}
+
+// NOTE - The rows are flipped here rather than with stbi_set_flip_vertically_on_load, a global that would race between
+// images decoded concurrently (see ResourceLoadManifest). Thread-safe.
+static bool DecodeImageMemory(image *Image, void const *Encoded, uint64 EncodedSize, bool IsFloat, bool FlipY,
+	int32 ForceNumChannel)
+{
+	if (!Encoded || EncodedSize >= 0x7FFFFFFF)
+		return false;
+
+	if (IsFloat)
+		Image->Buffer = stbi_loadf_from_memory((stbi_uc const*)Encoded, (int)EncodedSize, &Image->Width, &Image->Height, &Image->Channels, ForceNumChannel);
+	else
+		Image->Buffer = stbi_load_from_memory((stbi_uc const*)Encoded, (int)EncodedSize, &Image->Width, &Image->Height, &Image->Channels, ForceNumChannel);
+
+	if (Image->Buffer && FlipY) // NOTE - Flip Y so textures are Y-descending
+	{
+		uint64 Channels = ForceNumChannel ? ForceNumChannel : Image->Channels;
+		FlipImageRows(Image, Channels * (IsFloat ? sizeof(real32) : sizeof(uint8)));
+	}
+
+	return Image->Buffer != NULL;
+}
+
+// Filename is looked up in the mounted packs, then ResourceName on disk
+static bool DecodeImage(context *Context, image *Image, path const Filename, path const ResourceName, bool IsFloat, bool FlipY,
+	int32 ForceNumChannel)
+{
+	// Packed files are decoded in place, loose files from a mapped view instead of stdio reads
+	file_view View = {};
+	uint64 EncodedSize;
+	void const *Encoded = vfs::ReadFile(Context, Filename, &EncodedSize);
+	if (!Encoded && FileMapView(&View, ResourceName, FILE_ACCESS_SEQUENTIAL))
+	{
+		Encoded = View.Data;
+		EncodedSize = View.Size;
+	}
+
+	bool Decoded = DecodeImageMemory(Image, Encoded, EncodedSize, IsFloat, FlipY, ForceNumChannel);
+	FileUnmapView(&View);
+
+	return Decoded;
+}
+
+static uint64 ImageBytes(image const *Image, bool IsFloat, int32 ForceNumChannel)
+{
+	// NOTE - stbi returns the channel count of the file, even when forcing another one in the decoded buffer
+	uint64 Channels = ForceNumChannel ? ForceNumChannel : Image->Channels;
+	return (uint64)Image->Width * Image->Height * Channels * (IsFloat ? sizeof(real32) : sizeof(uint8));
+}
+
+static void ReloadImage(context *Context, char const *ResourceName, void *UserData)
+{
+	image_reload_info *Info = (image_reload_info*)UserData;
+	resource_entry *Entry = GetEntry(&Context->RenderResources, RESOURCE_IMAGE, Info->Name);
+	if (!Entry)
+		return;
+	image *Image = (image*)Entry->Resource;
+
+	// Decode in a temp first, the old data is kept if the new file is invalid (e.g. half-written)
+	image NewImage = {};
+	if (!DecodeImage(Context, &NewImage, Info->Name, ResourceName, Info->IsFloat, Info->FlipY, Info->ForceNumChannel))
+	{
+		LogError("Error reloading Image from %s. Keeping the previous one.", ResourceName);
+		return;
+	}
+
+	DestroyImage(Image);
+	*Image = NewImage;
+	ResourceResize(&Context->RenderResources, Entry, ImageBytes(Image, Info->IsFloat, Info->ForceNumChannel), 0);
+}
+
+// Decoded, if given, is an image already decoded with these parameters, whose buffer is taken over (stored or freed)
+static image *LoadImage(context *Context, path const Filename, bool IsFloat, bool FlipY, int32 ForceNumChannel,
+	image *Decoded)
 {
 	path ResourceName;
 	ConcatStrings(ResourceName, ctx::GetExePath(Context), Filename);
-	void *LoadedResource = ResourceCheckExist(&Context->RenderResources, RESOURCE_IMAGE, Filename);
+	void *LoadedResource = ResourceAcquire(&Context->RenderResources, RESOURCE_IMAGE, Filename);
 
 	if (LoadedResource)
 	{
+		if (Decoded)
+			DestroyImage(Decoded);
 		return (image*)LoadedResource;
 	}
+	TRACE_SCOPE("resource", "LoadImage", Filename);
 
 	image *Image = rf::PoolAlloc<image>(Context->SessionPool, 1);
-	stbi_set_flip_vertically_on_load(FlipY ? 1 : 0); // NOTE - Flip Y so textures are Y-descending
-
-	if (IsFloat)
-		Image->Buffer = stbi_loadf(ResourceName, &Image->Width, &Image->Height, &Image->Channels, ForceNumChannel);
-	else
-		Image->Buffer = stbi_load(ResourceName, &Image->Width, &Image->Height, &Image->Channels, ForceNumChannel);
-
-	if (!Image->Buffer)
+	if (Decoded)
+		*Image = *Decoded;
+	if (!(Decoded ? Image->Buffer != NULL : DecodeImage(Context, Image, Filename, ResourceName, IsFloat, FlipY, ForceNumChannel)))
 	{
 		LogError("Error loading Image from %s. Aborting..", ResourceName);
+		PoolFree(Context->SessionPool, Image);
 		return NULL;
 	}
 
-	ResourceStore(&Context->RenderResources, RESOURCE_IMAGE, Filename, Image);
+	resource_entry *Entry = ResourceStore(&Context->RenderResources, RESOURCE_IMAGE, Filename, Image,
+		ImageBytes(Image, IsFloat, ForceNumChannel), 0);
+
+	if (watch::IsActive())
+	{
+		image_reload_info *Info = rf::PoolAlloc<image_reload_info>(Context->SessionPool, 1);
+		strncpy(Info->Name, Filename, MAX_PATH - 1);
+		Info->Name[MAX_PATH - 1] = 0;
+		Info->IsFloat = IsFloat;
+		Info->FlipY = FlipY;
+		Info->ForceNumChannel = ForceNumChannel;
+		Entry->ReloadInfo = Info;
+		watch::AddFile(ResourceName, ReloadImage, Info);
+	}
 
 	return Image;
 }
 
+image *ResourceLoadImage(context *Context, path const Filename, bool IsFloat, bool FlipY, int32 ForceNumChannel)
+{
+	return LoadImage(Context, Filename, IsFloat, FlipY, ForceNumChannel, NULL);
+}
+
 void DestroyImage(image *Image)
 {
 	stbi_image_free(Image->Buffer);
@@ -248,17 +645,79 @@ void FormatFromChannels(uint32 Channels, bool IsFloat, bool FloatHalfPrecision,
 	}
 }
 
-uint32 Make2DTexture(void *ImageBuffer, uint32 Width, uint32 Height, uint32 Channels, bool IsFloat,
-	bool FloatHalfPrecision, real32 AnisotropicLevel, int MagFilter, int MinFilter, int WrapS, int WrapT)
+static bool UsesMipmaps(int MinFilter)
+{
+	return MinFilter >= GL_NEAREST_MIPMAP_NEAREST && MinFilter <= GL_LINEAR_MIPMAP_LINEAR;
+}
+
+// Conversion buffer of the uploads, grown as needed and kept across the levels/faces of a texture
+struct upload_buffer
+{
+	void	*Data;
+	uint64	Size;
+};
+
+static void *UploadBufferReserve(upload_buffer *Buffer, uint64 Size)
+{
+	if (Size > Buffer->Size)
+	{
+		free(Buffer->Data);
+		Buffer->Data = malloc(Size);
+		Buffer->Size = Buffer->Data ? Size : 0;
+	}
+	return Buffer->Data;
+}
+
+// glTexImage2D of a uint8 or float image, converted first to what the driver stores so that it doesn't convert it
+// itself : half floats for the FloatHalfPrecision formats, RGBA8 for RGB8 images (which the driver pads anyway).
+// Sets the unpack alignment of the uploaded rows.
+static void UploadTexImage2D(upload_buffer *Buffer, GLenum Target, GLint Level, uint32 Width, uint32 Height, uint32 Channels,
+	bool IsFloat, bool FloatHalfPrecision, void const *Pixels)
+{
+	GLint BaseFormat, Format;
+	FormatFromChannels(Channels, IsFloat, FloatHalfPrecision, &BaseFormat, &Format);
+	GLenum Type = IsFloat ? GL_FLOAT : GL_UNSIGNED_BYTE;
+	GLint Alignment = (IsFloat || Channels == 4) ? 4 : 1;
+
+	uint64 Count = (uint64)Width * Height;
+	if (Pixels && IsFloat && FloatHalfPrecision)
+	{
+		uint16 *Halves = (uint16*)UploadBufferReserve(Buffer, Count * Channels * sizeof(uint16));
+		if (Halves)
+		{
+			convert::FloatToHalf((real32 const*)Pixels, Halves, Count * Channels);
+			Pixels = Halves;
+			Type = GL_HALF_FLOAT;
+			Alignment = 2;
+		}
+	}
+	else if (Pixels && !IsFloat && Channels == 3)
+	{ // NOTE - The internal format stays GL_RGB, the padding alpha is never sampled
+		uint8 *RGBA = (uint8*)UploadBufferReserve(Buffer, Count * 4);
+		if (RGBA)
+		{
+			convert::RGB8ToRGBA8((uint8 const*)Pixels, RGBA, Count);
+			Pixels = RGBA;
+			Format = GL_RGBA;
+			Alignment = 4;
+		}
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, Alignment);
+	glTexImage2D(Target, Level, BaseFormat, Width, Height, 0, Format, Type, Pixels);
+}
+
+// (Re)specifies the whole storage of the given texture name. The mip levels are uploaded from Mips if given, generated
+// by the driver otherwise.
+static void Fill2DTexture(uint32 Texture, void *ImageBuffer, uint32 Width, uint32 Height, uint32 Channels, bool IsFloat,
+	bool FloatHalfPrecision, real32 AnisotropicLevel, int MagFilter, int MinFilter, int WrapS, int WrapT,
+	mip_chain const *Mips = NULL)
 {
-	uint32 Texture;
-	glGenTextures(1, &Texture);
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, Texture);
 
 	GLint CurrentAlignment;
 	glGetIntegerv(GL_UNPACK_ALIGNMENT, &CurrentAlignment);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 	glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
 	glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
@@ -269,24 +728,113 @@ uint32 Make2DTexture(void *ImageBuffer, uint32 Width, uint32 Height, uint32 Chan
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, WrapT);
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, AnisotropicLevel);
 
-	GLint BaseFormat, Format;
-	FormatFromChannels(Channels, IsFloat, FloatHalfPrecision, &BaseFormat, &Format);
-	GLenum Type = IsFloat ? GL_FLOAT : GL_UNSIGNED_BYTE;
-
-	glTexImage2D(GL_TEXTURE_2D, 0, BaseFormat, Width, Height, 0, Format, Type, ImageBuffer);
+	upload_buffer Buffer = {};
+	UploadTexImage2D(&Buffer, GL_TEXTURE_2D, 0, Width, Height, Channels, IsFloat, FloatHalfPrecision, ImageBuffer);
 	CheckGLError("glTexImage2D");
-	if (MinFilter >= GL_NEAREST_MIPMAP_NEAREST && MinFilter <= GL_LINEAR_MIPMAP_LINEAR)
+	if (Mips)
+	{
+		for (uint32 m = 1; m < Mips->LevelCount; ++m)
+		{
+			UploadTexImage2D(&Buffer, GL_TEXTURE_2D, m, Max(Width >> m, 1u), Max(Height >> m, 1u), Channels, IsFloat,
+				FloatHalfPrecision, Mips->Levels[m]);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, Mips->LevelCount - 1);
+		CheckGLError("glTexImage2D mips");
+	}
+	else if (UsesMipmaps(MinFilter))
 	{ // NOTE - Generate mipmaps if mag filter ask it
 		glGenerateMipmap(GL_TEXTURE_2D);
 	}
+	free(Buffer.Data);
 
 	glPixelStorei(GL_UNPACK_ALIGNMENT, CurrentAlignment);
 
 	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+uint32 Make2DTexture(void *ImageBuffer, uint32 Width, uint32 Height, uint32 Channels, bool IsFloat,
+	bool FloatHalfPrecision, real32 AnisotropicLevel, int MagFilter, int MinFilter, int WrapS, int WrapT)
+{
+	uint32 Texture;
+	glGenTextures(1, &Texture);
+	Fill2DTexture(Texture, ImageBuffer, Width, Height, Channels, IsFloat, FloatHalfPrecision, AnisotropicLevel,
+		MagFilter, MinFilter, WrapS, WrapT);
+
+	return Texture;
+}
+
+// Same as Fill2DTexture, with the mip chain built on the CPU. Falls back on glGenerateMipmap if it can't be built.
+static void Fill2DMipmappedTexture(render_resources *RenderResources, uint32 Texture, void *ImageBuffer, uint32 Width,
+	uint32 Height, uint32 Channels, bool IsFloat, bool FloatHalfPrecision, bool SRGB, real32 AnisotropicLevel, int MagFilter,
+	int MinFilter, int WrapS, int WrapT)
+{
+	mip_chain Chain = {};
+	bool CacheHit = false;
+	bool HasMips = UsesMipmaps(MinFilter) && mip::Build(&Chain, RenderResources->MipCacheDir, ImageBuffer, Width, Height,
+		Channels, IsFloat, SRGB, RenderResources->MipFilter, &CacheHit);
+	if (HasMips)
+	{
+		if (CacheHit)
+			RenderResources->Stats.MipCacheHits++;
+		else
+			RenderResources->Stats.MipsGenerated++;
+	}
+
+	Fill2DTexture(Texture, ImageBuffer, Width, Height, Channels, IsFloat, FloatHalfPrecision, AnisotropicLevel,
+		MagFilter, MinFilter, WrapS, WrapT, HasMips ? &Chain : NULL);
+	mip::Free(&Chain);
+}
+
+uint32 Make2DMipmappedTexture(render_resources *RenderResources, void *ImageBuffer, uint32 Width, uint32 Height,
+	uint32 Channels, bool IsFloat, bool FloatHalfPrecision, bool SRGB, real32 AnisotropicLevel, int MagFilter,
+	int MinFilter, int WrapS, int WrapT)
+{
+	uint32 Texture;
+	glGenTextures(1, &Texture);
+	Fill2DMipmappedTexture(RenderResources, Texture, ImageBuffer, Width, Height, Channels, IsFloat, FloatHalfPrecision,
+		SRGB, AnisotropicLevel, MagFilter, MinFilter, WrapS, WrapT);
 
 	return Texture;
 }
 
+// (Re)specifies the whole storage of the given texture name with the compressed levels
+static void Fill2DCompressedTexture(uint32 Texture, compressed_texture const *Compressed, real32 AnisotropicLevel, int MagFilter,
+	int MinFilter, int WrapS, int WrapT)
+{
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, Texture);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, MinFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, MagFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, WrapS);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, WrapT);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, AnisotropicLevel);
+	// NOTE - Mipmaps can't be generated for compressed formats, the texture stays complete with the levels it has
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, Compressed->MipCount - 1);
+
+	GLenum Format = bc::GLFormat(Compressed->Format, Compressed->SRGB);
+	for (uint32 m = 0; m < Compressed->MipCount; ++m)
+	{
+		glCompressedTexImage2D(GL_TEXTURE_2D, m, Format, Max(Compressed->Width >> m, 1u), Max(Compressed->Height >> m, 1u), 0,
+			(GLsizei)Compressed->MipSizes[m], Compressed->Mips[m]);
+	}
+	CheckGLError("glCompressedTexImage2D");
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+uint32 Make2DCompressedTexture(compressed_texture const *Texture, real32 AnisotropicLevel, int MagFilter, int MinFilter,
+	int WrapS, int WrapT)
+{
+	uint32 TextureID;
+	glGenTextures(1, &TextureID);
+	Fill2DCompressedTexture(TextureID, Texture, AnisotropicLevel, MagFilter, MinFilter, WrapS, WrapT);
+
+	return TextureID;
+}
+
 uint32 Make3DTexture(uint32 Width, uint32 Height, uint32 Depth, uint32 Channels, bool IsFloat, bool FloatHalfPrecision,
 	int MagFilter, int MinFilter, int WrapS, int WrapT, int WrapR)
 {
@@ -314,10 +862,11 @@ uint32 Make3DTexture(uint32 Width, uint32 Height, uint32 Depth, uint32 Channels,
 	return Texture;
 }
 
-static uint32 Make2DTexture(image *Image, bool IsFloat, bool FloatHalfPrecision, uint32 AnisotropicLevel, int MagFilter, int MinFilter, int WrapS, int WrapT)
+static uint32 Make2DTexture(render_resources *RenderResources, image *Image, bool IsFloat, bool FloatHalfPrecision, bool SRGB,
+	uint32 AnisotropicLevel, int MagFilter, int MinFilter, int WrapS, int WrapT)
 {
-	return Make2DTexture(Image->Buffer, Image->Width, Image->Height, Image->Channels, IsFloat, FloatHalfPrecision, (real32)AnisotropicLevel,
-		MagFilter, MinFilter, WrapS, WrapT);
+	return Make2DMipmappedTexture(RenderResources, Image->Buffer, Image->Width, Image->Height, Image->Channels, IsFloat,
+		FloatHalfPrecision, SRGB, (real32)AnisotropicLevel, MagFilter, MinFilter, WrapS, WrapT);
 }
 
 void BindTexture2D(uint32 TextureID, uint32 TextureUnit)
@@ -338,45 +887,368 @@ void BindCubemap(uint32 TextureID, uint32 TextureUnit)
 	glBindTexture(GL_TEXTURE_CUBE_MAP, TextureID);
 }
 
-uint32 *ResourceLoad2DTexture(context *Context, path const Filename, bool IsFloat, bool FloatHalfPrecision,
-	uint32 AnisotropicLevel, int MagFilter, int MinFilter, int WrapS, int WrapT, int32 ForceNumChannel)
+// Approximate video memory used by a 2D texture, the mip chain adding a third of the base level
+static uint64 TextureBytes(uint32 Width, uint32 Height, uint32 Channels, bool IsFloat, bool FloatHalfPrecision, int MinFilter)
 {
-	void *LoadedResource = ResourceCheckExist(&Context->RenderResources, RESOURCE_TEXTURE, Filename);
-	if (LoadedResource)
+	uint64 TexelBytes = Channels * (IsFloat ? (FloatHalfPrecision ? 2 : 4) : 1);
+	uint64 Bytes = (uint64)Width * Height * TexelBytes;
+	if (UsesMipmaps(MinFilter))
 	{
-		return (uint32*)LoadedResource;
+		Bytes += Bytes / 3;
 	}
-
-	uint32 *Tex = rf::PoolAlloc<uint32>(Context->SessionPool, 1);
-	*Tex = Make2DTexture(ResourceLoadImage(Context, Filename, IsFloat, true, ForceNumChannel),
-		IsFloat, FloatHalfPrecision, AnisotropicLevel, MagFilter, MinFilter, WrapS, WrapT);
-
-	ResourceStore(&Context->RenderResources, RESOURCE_TEXTURE, Filename, Tex);
-
-	return Tex;
+	return Bytes;
 }
 
-uint32 MakeCubemap(context *Context, path *Paths, bool IsFloat, bool FloatHalfPrecision, uint32 Width, uint32 Height, bool MakeMipmap)
+// Halves the image with a 2x2 box filter, the result is malloc'ed like the stbi buffers
+template<typename T>
+static T *HalveImage(T const *Src, int32 Width, int32 Height, int32 Channels, int32 *DstWidth, int32 *DstHeight)
 {
-	uint32 Cubemap = 0;
+	int32 W = Max(1, Width / 2), H = Max(1, Height / 2);
+	T *Dst = (T*)malloc((size_t)W * H * Channels * sizeof(T));
 
-	glGenTextures(1, &Cubemap);
+	// NOTE - rounds to nearest for integer types only ((T)0.5f is 0 for them)
+	real32 const Rounding = ((T)0.5f == 0) ? 0.5f : 0.f;
+	for (int32 y = 0; y < H; ++y)
+	{
+		int32 Y0 = Min(2 * y, Height - 1), Y1 = Min(2 * y + 1, Height - 1);
+		for (int32 x = 0; x < W; ++x)
+		{
+			int32 X0 = Min(2 * x, Width - 1), X1 = Min(2 * x + 1, Width - 1);
+			for (int32 c = 0; c < Channels; ++c)
+			{
+				real32 Sum = (real32)Src[(Y0 * Width + X0) * Channels + c] + (real32)Src[(Y0 * Width + X1) * Channels + c] +
+					(real32)Src[(Y1 * Width + X0) * Channels + c] + (real32)Src[(Y1 * Width + X1) * Channels + c];
+				Dst[(y * W + x) * Channels + c] = (T)(Sum * 0.25f + Rounding);
+			}
+		}
+	}
+
+	*DstWidth = W;
+	*DstHeight = H;
+	return Dst;
+}
+
+// Fills Dst with a downsampled copy of Src, whose largest side is at most RESIDENCY_LOWMIP_SIZE
+template<typename T>
+static void MakeLowMip(image *Dst, image const *Src, int32 Channels)
+{
+	T *Buffer = (T*)Src->Buffer;
+	int32 Width = Src->Width, Height = Src->Height;
+	while (Width > RESIDENCY_LOWMIP_SIZE || Height > RESIDENCY_LOWMIP_SIZE)
+	{
+		T *Halved = HalveImage(Buffer, Width, Height, Channels, &Width, &Height);
+		if (Buffer != Src->Buffer)
+			free(Buffer);
+		Buffer = Halved;
+	}
+
+	if (Buffer == Src->Buffer)
+	{ // already small enough, copy
+		Buffer = (T*)malloc((size_t)Width * Height * Channels * sizeof(T));
+		memcpy(Buffer, Src->Buffer, (size_t)Width * Height * Channels * sizeof(T));
+	}
+
+	Dst->Buffer = Buffer;
+	Dst->Width = Width;
+	Dst->Height = Height;
+	Dst->Channels = Channels;
+}
+
+static void MakeLowMip(image *Dst, image const *Src, bool IsFloat, int32 ForceNumChannel)
+{
+	int32 Channels = ForceNumChannel ? ForceNumChannel : Src->Channels;
+	if (IsFloat)
+		MakeLowMip<real32>(Dst, Src, Channels);
+	else
+		MakeLowMip<uint8>(Dst, Src, Channels);
+}
+
+static void LowMipName(path Dst, path const Filename)
+{
+	snprintf(Dst, MAX_PATH, "%s:lowmip", Filename);
+}
+
+// Load parameters kept for the hot-reload of textures
+struct texture_reload_info
+{
+	path Name;
+	bool IsFloat;
+	bool FloatHalfPrecision;
+	uint32 AnisotropicLevel;
+	int MagFilter, MinFilter, WrapS, WrapT;
+	int32 ForceNumChannel;
+	texture_residency Residency;
+	bool SRGB;
+};
+
+// NOTE - When the source image is kept, it is registered to the watcher before the texture (in ResourceLoadImage), so
+// it is already re-decoded when this is called. Otherwise the file is decoded in a temp image. The texture keeps its GL name.
+static void Reload2DTexture(context *Context, char const *ResourceName, void *UserData)
+{
+	texture_reload_info *Info = (texture_reload_info*)UserData;
+	resource_entry *Entry = GetEntry(&Context->RenderResources, RESOURCE_TEXTURE, Info->Name);
+	if (!Entry)
+		return;
+
+	image TmpImage = {};
+	image *Image = (image*)ResourceCheckExist(&Context->RenderResources, RESOURCE_IMAGE, Info->Name);
+	if (!Image)
+	{
+		if (!DecodeImage(Context, &TmpImage, Info->Name, ResourceName, Info->IsFloat, true, Info->ForceNumChannel))
+		{
+			LogError("Error reloading Texture from %s. Keeping the previous one.", ResourceName);
+			return;
+		}
+		Image = &TmpImage;
+	}
+
+	Fill2DMipmappedTexture(&Context->RenderResources, *(uint32*)Entry->Resource, Image->Buffer, Image->Width, Image->Height,
+		Image->Channels, Info->IsFloat, Info->FloatHalfPrecision, Info->SRGB, (real32)Info->AnisotropicLevel, Info->MagFilter,
+		Info->MinFilter, Info->WrapS, Info->WrapT);
+	ResourceResize(&Context->RenderResources, Entry, 0, TextureBytes(Image->Width, Image->Height, Image->Channels,
+		Info->IsFloat, Info->FloatHalfPrecision, Info->MinFilter));
+
+	if (Info->Residency == RESIDENCY_LOWMIP && Entry->Parent)
+	{
+		image *LowMip = (image*)Entry->Parent->Resource;
+		DestroyImage(LowMip);
+		MakeLowMip(LowMip, Image, Info->IsFloat, Info->ForceNumChannel);
+		ResourceResize(&Context->RenderResources, Entry->Parent, ImageBytes(LowMip, Info->IsFloat, 0), 0);
+	}
+
+	if (Image == &TmpImage)
+	{
+		DestroyImage(&TmpImage);
+	}
+}
+
+static bool IsCompressedTextureFile(char const *Filename)
+{
+	char const *Ext = strrchr(Filename, '.');
+	if (!Ext)
+		return false;
+
+	char Lower[8] = {};
+	for (int i = 0; i < 7 && Ext[i]; ++i)
+		Lower[i] = (char)tolower(Ext[i]);
+	return !strcmp(Lower, ".dds") || !strcmp(Lower, ".ktx2");
+}
+
+// Parses a DDS/KTX2 file from the packs, or mapped in View. The texture points in the file data.
+static bool LoadCompressedTextureFile(context *Context, path const Filename, path const ResourceName, file_view *View,
+	compressed_texture *Compressed)
+{
+	uint64 Size;
+	uint8 const *Data = (uint8 const*)vfs::ReadFile(Context, Filename, &Size);
+	if (!Data)
+	{
+		if (!FileMapView(View, ResourceName, FILE_ACCESS_SEQUENTIAL))
+		{
+			LogError("Error loading compressed Texture from %s : can't read the file.", ResourceName);
+			return false;
+		}
+		Data = View->Data;
+		Size = View->Size;
+	}
+
+	if (bc::ParseDDS(Compressed, Data, Size) || bc::ParseKTX2(Compressed, Data, Size))
+		return true;
+
+	LogError("Error loading compressed Texture from %s.", ResourceName);
+	FileUnmapView(View);
+	return false;
+}
+
+static uint64 CompressedTextureBytes(compressed_texture const *Compressed)
+{
+	uint64 Bytes = 0;
+	for (uint32 m = 0; m < Compressed->MipCount; ++m)
+		Bytes += Compressed->MipSizes[m];
+	return Bytes;
+}
+
+static void ReloadCompressed2DTexture(context *Context, char const *ResourceName, void *UserData)
+{
+	texture_reload_info *Info = (texture_reload_info*)UserData;
+	resource_entry *Entry = GetEntry(&Context->RenderResources, RESOURCE_TEXTURE, Info->Name);
+	if (!Entry)
+		return;
+
+	file_view View = {};
+	compressed_texture Compressed;
+	if (!LoadCompressedTextureFile(Context, Info->Name, ResourceName, &View, &Compressed))
+	{
+		LogError("Error reloading Texture from %s. Keeping the previous one.", ResourceName);
+		return;
+	}
+
+	Fill2DCompressedTexture(*(uint32*)Entry->Resource, &Compressed, (real32)Info->AnisotropicLevel, Info->MagFilter,
+		Info->MinFilter, Info->WrapS, Info->WrapT);
+	ResourceResize(&Context->RenderResources, Entry, 0, CompressedTextureBytes(&Compressed));
+	FileUnmapView(&View);
+}
+
+static uint32 *ResourceLoadCompressed2DTexture(context *Context, path const Filename, uint32 AnisotropicLevel, int MagFilter,
+	int MinFilter, int WrapS, int WrapT)
+{
+	path ResourceName;
+	ConcatStrings(ResourceName, ctx::GetExePath(Context), Filename);
+
+	file_view View = {};
+	compressed_texture Compressed;
+	if (!LoadCompressedTextureFile(Context, Filename, ResourceName, &View, &Compressed))
+		return NULL;
+
+	uint32 *Tex = rf::PoolAlloc<uint32>(Context->SessionPool, 1);
+	*Tex = Make2DCompressedTexture(&Compressed, (real32)AnisotropicLevel, MagFilter, MinFilter, WrapS, WrapT);
+	resource_entry *Entry = ResourceStore(&Context->RenderResources, RESOURCE_TEXTURE, Filename, Tex, 0,
+		CompressedTextureBytes(&Compressed));
+	FileUnmapView(&View);
+
+	if (watch::IsActive())
+	{
+		texture_reload_info *Info = rf::PoolAlloc<texture_reload_info>(Context->SessionPool, 1);
+		strncpy(Info->Name, Filename, MAX_PATH - 1);
+		Info->Name[MAX_PATH - 1] = 0;
+		Info->AnisotropicLevel = AnisotropicLevel;
+		Info->MagFilter = MagFilter;
+		Info->MinFilter = MinFilter;
+		Info->WrapS = WrapS;
+		Info->WrapT = WrapT;
+		Entry->ReloadInfo = Info;
+		watch::AddFile(ResourceName, ReloadCompressed2DTexture, Info);
+	}
+
+	return Tex;
+}
+
+// Decoded : see LoadImage
+static uint32 *Load2DTexture(context *Context, path const Filename, bool IsFloat, bool FloatHalfPrecision,
+	uint32 AnisotropicLevel, int MagFilter, int MinFilter, int WrapS, int WrapT, int32 ForceNumChannel, texture_residency Residency,
+	bool SRGB, image *Decoded)
+{
+	render_resources *RenderResources = &Context->RenderResources;
+	void *LoadedResource = ResourceAcquire(RenderResources, RESOURCE_TEXTURE, Filename);
+	if (LoadedResource)
+	{
+		if (Decoded)
+			DestroyImage(Decoded);
+		return (uint32*)LoadedResource;
+	}
+	TRACE_SCOPE("resource", "Load2DTexture", Filename);
+
+	if (IsCompressedTextureFile(Filename))
+	{
+		return ResourceLoadCompressed2DTexture(Context, Filename, AnisotropicLevel, MagFilter, MinFilter, WrapS, WrapT);
+	}
+
+	image *Image = LoadImage(Context, Filename, IsFloat, true, ForceNumChannel, Decoded);
+	if (!Image)
+	{
+		return NULL;
+	}
+
+	uint32 *Tex = rf::PoolAlloc<uint32>(Context->SessionPool, 1);
+	*Tex = Make2DTexture(RenderResources, Image, IsFloat, FloatHalfPrecision, SRGB, AnisotropicLevel, MagFilter, MinFilter,
+		WrapS, WrapT);
+
+	resource_entry *Entry = ResourceStore(RenderResources, RESOURCE_TEXTURE, Filename, Tex, 0,
+		TextureBytes(Image->Width, Image->Height, Image->Channels, IsFloat, FloatHalfPrecision, MinFilter));
+	resource_entry *ImageEntry = GetEntry(RenderResources, RESOURCE_IMAGE, Filename);
+
+	// NOTE - The texture keeps a reference on the CPU copy it keeps (the source image or its low mip), given back
+	// when the texture is evicted. The source image is only freed here if no one else uses it.
+	if (Residency == RESIDENCY_KEEP)
+	{
+		Entry->Parent = ImageEntry;
+	}
+	else
+	{
+		uint64 LowMipBytes = 0;
+		if (Residency == RESIDENCY_LOWMIP)
+		{
+			path LowMipKey;
+			LowMipName(LowMipKey, Filename);
+			if (ResourceAcquire(RenderResources, RESOURCE_IMAGE, LowMipKey))
+			{
+				Entry->Parent = GetEntry(RenderResources, RESOURCE_IMAGE, LowMipKey);
+			}
+			else
+			{
+				image *LowMip = rf::PoolAlloc<image>(Context->SessionPool, 1);
+				MakeLowMip(LowMip, Image, IsFloat, ForceNumChannel);
+				LowMipBytes = ImageBytes(LowMip, IsFloat, 0);
+				Entry->Parent = ResourceStore(RenderResources, RESOURCE_IMAGE, LowMipKey, LowMip, LowMipBytes, 0);
+			}
+		}
+
+		uint64 FreedBytes = ReleaseAndDiscard(RenderResources, ImageEntry);
+		if (FreedBytes > LowMipBytes)
+		{
+			RenderResources->Stats.ResidencySavedBytes += FreedBytes - LowMipBytes;
+		}
+	}
+
+	if (watch::IsActive())
+	{
+		path ResourceName;
+		ConcatStrings(ResourceName, ctx::GetExePath(Context), Filename);
+
+		texture_reload_info *Info = rf::PoolAlloc<texture_reload_info>(Context->SessionPool, 1);
+		strncpy(Info->Name, Filename, MAX_PATH - 1);
+		Info->Name[MAX_PATH - 1] = 0;
+		Info->IsFloat = IsFloat;
+		Info->FloatHalfPrecision = FloatHalfPrecision;
+		Info->AnisotropicLevel = AnisotropicLevel;
+		Info->MagFilter = MagFilter;
+		Info->MinFilter = MinFilter;
+		Info->WrapS = WrapS;
+		Info->WrapT = WrapT;
+		Info->ForceNumChannel = ForceNumChannel;
+		Info->Residency = Residency;
+		Info->SRGB = SRGB;
+		Entry->ReloadInfo = Info;
+		watch::AddFile(ResourceName, Reload2DTexture, Info);
+	}
+
+	return Tex;
+}
+
+uint32 *ResourceLoad2DTexture(context *Context, path const Filename, bool IsFloat, bool FloatHalfPrecision,
+	uint32 AnisotropicLevel, int MagFilter, int MinFilter, int WrapS, int WrapT, int32 ForceNumChannel, texture_residency Residency,
+	bool SRGB)
+{
+	return Load2DTexture(Context, Filename, IsFloat, FloatHalfPrecision, AnisotropicLevel, MagFilter, MinFilter, WrapS, WrapT,
+		ForceNumChannel, Residency, SRGB, NULL);
+}
+
+image *ResourceGetTextureImage(render_resources *RenderResources, uint32 *Texture)
+{
+	resource_entry const *Entry = FindEntry(RenderResources, Texture);
+	return Entry && Entry->Parent ? (image*)Entry->Parent->Resource : NULL;
+}
+
+uint32 MakeCubemap(context *Context, path *Paths, bool IsFloat, bool FloatHalfPrecision, uint32 Width, uint32 Height, bool MakeMipmap)
+{
+	uint32 Cubemap = 0;
+
+	glGenTextures(1, &Cubemap);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, Cubemap);
 	CheckGLError("SkyboxGen");
 
+	GLint CurrentAlignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &CurrentAlignment);
+	upload_buffer Buffer = {};
 	for (int i = 0; i < 6; ++i)
 	{ // Load each face
 		if (Paths)
 		{ // For loading from texture files
 			image *Face = ResourceLoadImage(Context, Paths[i], IsFloat);
 
-			GLint BaseFormat, Format;
-			FormatFromChannels(Face->Channels, IsFloat, FloatHalfPrecision, &BaseFormat, &Format);
-			GLenum Type = IsFloat ? GL_FLOAT : GL_UNSIGNED_BYTE;
-
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, BaseFormat, Face->Width, Face->Height,
-				0, Format, Type, Face->Buffer);
+			UploadTexImage2D(&Buffer, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, Face->Width, Face->Height, Face->Channels,
+				IsFloat, FloatHalfPrecision, Face->Buffer);
 			CheckGLError("SkyboxFace");
+			ResourceRelease(&Context->RenderResources, Face);
 		}
 		else
 		{ // Empty Cubemap
@@ -385,6 +1257,8 @@ uint32 MakeCubemap(context *Context, path *Paths, bool IsFloat, bool FloatHalfPr
 				Width, Height, 0, GL_RGB, IsFloat ? GL_FLOAT : GL_UNSIGNED_BYTE, NULL);
 		}
 	}
+	free(Buffer.Data);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, CurrentAlignment);
 
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, MakeMipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
@@ -449,146 +1323,1104 @@ frame_buffer MakeFramebuffer(uint32 NumAttachments, vec2i Size, bool AddDepthBuf
 		}
 	}
 
-	return FB;
+	return FB;
+}
+
+void FramebufferSetAttachmentCount(frame_buffer *FB, int Count)
+{
+	Assert(Count < MAX_FBO_ATTACHMENTS);
+	FB->NumAttachments = Count;
+	glDrawBuffers((GLsizei)Count, FBOAttachments);
+}
+
+void FramebufferAttachBuffer(frame_buffer *FB, uint32 Attachment, uint32 TextureID)
+{
+	Assert(Attachment < MAX_FBO_ATTACHMENTS);
+	glFramebufferTexture(GL_FRAMEBUFFER, FBOAttachments[Attachment], TextureID, 0);
+}
+
+void FramebufferAttachBuffer(frame_buffer *FB, uint32 Attachment, uint32 Channels, bool IsFloat, bool FloatHalfPrecision, bool Mipmap)
+{
+	Assert(Attachment < MAX_FBO_ATTACHMENTS);
+
+	uint32 *BufferID = &FB->BufferIDs[Attachment];
+	glGenTextures(1, BufferID);
+	glBindTexture(GL_TEXTURE_2D, *BufferID);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, Mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	GLint BaseFormat, Format;
+	FormatFromChannels(Channels, IsFloat, FloatHalfPrecision, &BaseFormat, &Format);
+	GLenum Type = IsFloat ? GL_FLOAT : GL_UNSIGNED_BYTE;
+	glTexImage2D(GL_TEXTURE_2D, 0, BaseFormat, FB->Size.x, FB->Size.y, 0, Format, Type, NULL);
+
+	if (Mipmap)
+	{
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+
+	glFramebufferTexture2D(GL_FRAMEBUFFER, (GLenum)(GL_COLOR_ATTACHMENT0 + Attachment), GL_TEXTURE_2D, *BufferID, 0);
+}
+
+#define FONT_ATLAS_PADDING 1		// empty texels around each glyph, so that bilinear filtering doesn't bleed
+#define FONT_ATLAS_WHITE_SIZE 4		// white texels reserved in shared atlases, see FontAtlasWhiteTexcoord
+#define FONT_ATLAS_MAX_SIZE 4096
+#define FONT_KERNING_MAX_CHARS 256	// fonts with more chars than this aren't kerned
+
+// Computes the glyph texcoords from their position in the atlas, after packing or when the atlas is resized
+static void UpdateGlyphTexcoords(font *Font)
+{
+	real32 const InvWidth = 1.f / (real32)Font->Width;
+	real32 const InvHeight = 1.f / (real32)Font->Height;
+	for (int i = 0; i < Font->CharN - Font->Char0; ++i)
+	{
+		glyph &Glyph = Font->Glyphs[i];
+		Glyph.TexX0 = Glyph.AtlasX * InvWidth;  Glyph.TexX1 = (Glyph.AtlasX + Glyph.CW) * InvWidth;
+		Glyph.TexY0 = Glyph.AtlasY * InvHeight; Glyph.TexY1 = (Glyph.AtlasY + Glyph.CH) * InvHeight;
+	}
+	Font->GlyphRectsDirty = true;
+}
+
+// Packs the boxes, doubling the packer height until they fit, up to MaxHeight
+static bool PackGrowing(atlas_packer *Packer, uint32 MaxHeight, uint32 const *Widths, uint32 const *Heights,
+	uint32 Count, uint32 *X, uint32 *Y)
+{
+	for (uint32 i = 0; i < Count; ++i)
+	{
+		while (!atlas::Pack(Packer, Widths[i], Heights[i], &X[i], &Y[i]))
+		{
+			if (Packer->Height >= MaxHeight)
+				return false;
+			atlas::Grow(Packer, Min(2 * Packer->Height, MaxHeight));
+		}
+	}
+	return true;
+}
+
+// Packs again from scratch the glyphs of the fonts in the atlas (but Skip, being baked again), moving their texels :
+// the rects of the fonts freed since, and of the previous glyphs of the reloaded ones, are given back.
+// The atlas is left as it is if the glyphs don't fit anymore.
+static bool FontAtlasCompact(font_atlas *Atlas, font const *Skip)
+{
+	uint32 Count = 1;
+	for (font **It = Atlas->Fonts; It != BufEnd(Atlas->Fonts); ++It)
+	{
+		if (*It != Skip)
+			Count += (uint32)((*It)->CharN - (*It)->Char0);
+	}
+
+	uint32 *Rects = (uint32*)malloc(4 * Count * sizeof(uint32));
+	uint32 *Widths = Rects, *Heights = Rects + Count, *X = Rects + 2 * Count, *Y = Rects + 3 * Count;
+	Widths[0] = Heights[0] = FONT_ATLAS_WHITE_SIZE;
+	uint32 r = 1;
+	for (font **It = Atlas->Fonts; It != BufEnd(Atlas->Fonts); ++It)
+	{
+		if (*It == Skip)
+			continue;
+		for (int i = 0; i < (*It)->CharN - (*It)->Char0; ++i, ++r)
+		{
+			Widths[r] = (uint32)(*It)->Glyphs[i].CW;
+			Heights[r] = (uint32)(*It)->Glyphs[i].CH;
+		}
+	}
+
+	atlas_packer Packer;
+	atlas::Init(&Packer, (uint32)Atlas->Width, (uint32)Atlas->Height, FONT_ATLAS_PADDING);
+	if (!PackGrowing(&Packer, (uint32)Atlas->MaxHeight, Widths, Heights, Count, X, Y))
+	{
+		atlas::Free(&Packer);
+		free(Rects);
+		return false;
+	}
+
+	int32 const Height = (int32)Packer.Height;
+	uint8 *Buffer = (uint8*)calloc((size_t)Atlas->Width * Height, 1);
+	Atlas->WhiteX = X[0];
+	Atlas->WhiteY = Y[0];
+	for (uint32 y = 0; y < FONT_ATLAS_WHITE_SIZE; ++y)
+		memset(Buffer + (size_t)(Atlas->WhiteY + y) * Atlas->Width + Atlas->WhiteX, 255, FONT_ATLAS_WHITE_SIZE);
+
+	r = 1;
+	for (font **It = Atlas->Fonts; It != BufEnd(Atlas->Fonts); ++It)
+	{
+		if (*It == Skip)
+			continue;
+		for (int i = 0; i < (*It)->CharN - (*It)->Char0; ++i, ++r)
+		{
+			glyph &Glyph = (*It)->Glyphs[i];
+			for (int y = 0; y < Glyph.CH; ++y)
+			{
+				memcpy(Buffer + (size_t)(Y[r] + y) * Atlas->Width + X[r],
+					Atlas->Buffer + (size_t)(Glyph.AtlasY + y) * Atlas->Width + Glyph.AtlasX, (size_t)Glyph.CW);
+			}
+			Glyph.AtlasX = (int)X[r];
+			Glyph.AtlasY = (int)Y[r];
+		}
+		(*It)->Height = Height;
+		UpdateGlyphTexcoords(*It);
+	}
+
+	free(Atlas->Buffer);
+	Atlas->Buffer = Buffer;
+	Atlas->Height = Height;
+	atlas::Free(&Atlas->Packer);
+	Atlas->Packer = Packer;
+	free(Rects);
+	return true;
+}
+
+// Packs the glyph boxes of Font in its shared atlas, doubling its height until they fit. When it is full, the
+// glyphs in use are packed again first.
+static bool FontAtlasPack(font *Font, uint32 const *Widths, uint32 const *Heights, uint32 Count, uint32 *X, uint32 *Y)
+{
+	font_atlas *Atlas = Font->Atlas;
+	if (!PackGrowing(&Atlas->Packer, (uint32)Atlas->MaxHeight, Widths, Heights, Count, X, Y))
+	{
+		if (!FontAtlasCompact(Atlas, Font) ||
+			!PackGrowing(&Atlas->Packer, (uint32)Atlas->MaxHeight, Widths, Heights, Count, X, Y))
+		{
+			return false;
+		}
+	}
+
+	int32 NewHeight = (int32)Atlas->Packer.Height;
+	if (NewHeight != Atlas->Height)
+	{
+		Atlas->Buffer = (uint8*)realloc(Atlas->Buffer, (size_t)Atlas->Width * NewHeight);
+		memset(Atlas->Buffer + (size_t)Atlas->Width * Atlas->Height, 0, (size_t)Atlas->Width * (NewHeight - Atlas->Height));
+		Atlas->Height = NewHeight;
+
+		// The rects don't move, only their normalized texcoords change
+		for (font **It = Atlas->Fonts; It != BufEnd(Atlas->Fonts); ++It)
+		{
+			(*It)->Height = NewHeight;
+			UpdateGlyphTexcoords(*It);
+		}
+	}
+	return true;
+}
+
+#define SDF_FONT_BAKE_HEIGHT 48	// height the distance fields are generated at, for every height they are drawn at
+#define SDF_FONT_SPREAD 6		// texels of distance encoded on each side of the glyph edges
+#define SDF_FONT_OVERSAMPLE 4	// the coverage the distance is computed from is rasterized this much larger
+
+// Writes the distance field of the glyph in the CW x CH box at Dst : its bitmap box grown by Spread on each side
+static void RasterizeSDFGlyph(stbtt_fontinfo const *STBFont, int Glyph, real32 PixelScale, int32 Spread, uint8 *Dst,
+	int32 CW, int32 CH, int32 DstStride)
+{
+	int32 const Oversample = SDF_FONT_OVERSAMPLE;
+	int32 const MaskWidth = CW * Oversample, MaskHeight = CH * Oversample;
+	uint8 *Mask = (uint8*)calloc((size_t)MaskWidth * MaskHeight, 1);
+
+	// The oversampled bitmap box starts at or after the scaled-up low resolution one, and ends at or before it
+	int X0, Y0, X1, Y1, HiX0, HiY0, HiX1, HiY1;
+	real32 const HiScale = PixelScale * Oversample;
+	stbtt_GetGlyphBitmapBox(STBFont, Glyph, PixelScale, PixelScale, &X0, &Y0, &X1, &Y1);
+	stbtt_GetGlyphBitmapBox(STBFont, Glyph, HiScale, HiScale, &HiX0, &HiY0, &HiX1, &HiY1);
+	int32 OffsetX = HiX0 - (X0 - Spread) * Oversample;
+	int32 OffsetY = HiY0 - (Y0 - Spread) * Oversample;
+	int32 HiWidth = Min(HiX1 - HiX0, MaskWidth - OffsetX);
+	int32 HiHeight = Min(HiY1 - HiY0, MaskHeight - OffsetY);
+	if (HiWidth > 0 && HiHeight > 0)
+	{
+		stbtt_MakeGlyphBitmap(STBFont, Mask + ((size_t)OffsetY * MaskWidth + OffsetX), HiWidth, HiHeight, MaskWidth,
+			HiScale, HiScale, Glyph);
+	}
+
+	sdf::Generate(Mask, MaskWidth, MaskHeight, Oversample, (real32)Spread, Dst, DstStride);
+	free(Mask);
+}
+
+#define FONT_RASTER_JOB_GLYPHS 8	// glyphs rasterized by each job of BakeFont
+
+struct glyph_raster_job
+{
+	stbtt_fontinfo const *STBFont;
+	font const *Font;
+	int const *GlyphIndices;
+	uint8 *Buffer;
+	real32 PixelScale;
+	uint32 Begin, End;
+};
+
+// Rasterizes the [Begin, End) glyphs of the font in their packed rect of the atlas
+static void RasterizeGlyphs(void *UserData)
+{
+	glyph_raster_job *Job = (glyph_raster_job*)UserData;
+	TRACE_SCOPE("job", "RasterizeGlyphs");
+	font const *Font = Job->Font;
+	for (uint32 i = Job->Begin; i < Job->End; ++i)
+	{
+		glyph const &Glyph = Font->Glyphs[i];
+		if (Glyph.CW <= 0 || Glyph.CH <= 0)
+			continue;
+
+		uint8 *BitmapPtr = Job->Buffer + ((size_t)Glyph.AtlasY * Font->Width + Glyph.AtlasX);
+		if (Font->SDFSpread)
+			RasterizeSDFGlyph(Job->STBFont, Job->GlyphIndices[i], Job->PixelScale, Font->SDFSpread, BitmapPtr, Glyph.CW,
+				Glyph.CH, Font->Width);
+		else
+			stbtt_MakeGlyphBitmap(Job->STBFont, BitmapPtr, Glyph.CW, Glyph.CH, Font->Width, Job->PixelScale,
+				Job->PixelScale, Job->GlyphIndices[i]);
+	}
+}
+
+// Rasterizes the [Char0, CharN) glyphs of the font file Contents, and fills the glyph metrics.
+// The glyphs are packed in Font->Atlas if set, otherwise in a new tightly sized Font->Buffer (replacing the previous
+// one), Font->Width/Height being the atlas size.
+// Distance fields are generated instead if Font->SDFSpread is set, the glyph boxes being grown by the spread.
+// The glyphs are measured and packed first, then rasterized in parallel by jobs, straight into their atlas rect.
+// Font->Glyphs must be allocated, and Font->Char0/CharN/Atlas/SDFSpread set.
+// NOTE - Without a shared atlas, nothing outside of Font is touched : can be called from a job
+static bool BakeFont(font *Font, uint8 *Contents, real32 PixelHeight)
+{
+	TRACE_SCOPE("resource", "BakeFont");
+	stbtt_fontinfo STBFont;
+	stbtt_InitFont(&STBFont, Contents, 0);
+
+	real32 PixelScale = stbtt_ScaleForPixelHeight(&STBFont, PixelHeight);
+	int Ascent, Descent, LineGap;
+	stbtt_GetFontVMetrics(&STBFont, &Ascent, &Descent, &LineGap);
+	Ascent = (int)floor(Ascent * PixelScale);
+	Descent = (int)floor(Descent * PixelScale);
+
+	Font->NumGlyphs = STBFont.numGlyphs;
+	Font->LineGap = Ascent - Descent;
+	Font->Ascent = Ascent;
+	Font->MaxGlyphWidth = 0;
+	Font->GlyphHeight = 0;
+
+	// Glyph boxes, then where they are packed
+	uint32 const Count = (uint32)(Font->CharN - Font->Char0);
+	uint32 *Rects = (uint32*)malloc(5 * Count * sizeof(uint32));
+	uint32 *Widths = Rects, *Heights = Rects + Count, *PackedX = Rects + 2 * Count, *PackedY = Rects + 3 * Count;
+	int *GlyphIndices = (int*)(Rects + 4 * Count);
+
+	for (uint32 i = 0; i < Count; ++i)
+	{
+		int Glyph = stbtt_FindGlyphIndex(&STBFont, Font->Char0 + (int)i);
+
+		int AdvX, Lsb;
+		int X0, X1, Y0, Y1;
+		stbtt_GetGlyphBitmapBox(&STBFont, Glyph, PixelScale, PixelScale, &X0, &Y0, &X1, &Y1);
+		stbtt_GetGlyphHMetrics(&STBFont, Glyph, &AdvX, &Lsb);
+		//int AdvKern = stbtt_GetCodepointKernAdvance(&STBFont, Codepoint, Codepoint+1);
+
+		if (Font->SDFSpread && X1 > X0 && Y1 > Y0)
+		{
+			X0 -= Font->SDFSpread; Y0 -= Font->SDFSpread;
+			X1 += Font->SDFSpread; Y1 += Font->SDFSpread;
+		}
+
+		glyph &DstGlyph = Font->Glyphs[i];
+		DstGlyph.X = X0; DstGlyph.Y = Y0;
+		DstGlyph.CW = X1 - X0; DstGlyph.CH = Y1 - Y0; DstGlyph.AdvX = AdvX * PixelScale;
+
+		Font->MaxGlyphWidth += DstGlyph.AdvX;
+		Font->GlyphHeight = Max(Font->GlyphHeight, (real32)DstGlyph.CH);
+
+		GlyphIndices[i] = Glyph;
+		Widths[i] = (uint32)DstGlyph.CW;
+		Heights[i] = (uint32)DstGlyph.CH;
+	}
+
+	Font->MaxGlyphWidth /= real32(Count);
+
+	// Kerning pairs, looked up once here rather than for each char drawn. Skipped for the large char ranges, where
+	// the pair count gets too high.
+	free(Font->Kerning);
+	Font->Kerning = NULL;
+	Font->KerningCount = 0;
+	if (STBFont.kern && Count <= FONT_KERNING_MAX_CHARS)
+	{
+		uint32 Capacity = 0;
+		for (uint32 a = 0; a < Count; ++a)
+		{
+			for (uint32 b = 0; b < Count; ++b)
+			{
+				int Kern = stbtt_GetGlyphKernAdvance(&STBFont, GlyphIndices[a], GlyphIndices[b]);
+				if (!Kern)
+					continue;
+
+				if (Font->KerningCount == Capacity)
+				{
+					Capacity = Max(64u, 2 * Capacity);
+					Font->Kerning = (glyph_kerning*)realloc(Font->Kerning, Capacity * sizeof(glyph_kerning));
+				}
+				glyph_kerning &Pair = Font->Kerning[Font->KerningCount++];
+				Pair.Pair = a << 16 | b;
+				Pair.Advance = Kern * PixelScale;
+			}
+		}
+	}
+
+	bool Packed;
+	if (Font->Atlas)
+	{
+		Packed = FontAtlasPack(Font, Widths, Heights, Count, PackedX, PackedY);
+		Font->Width = Font->Atlas->Width;
+		Font->Height = Font->Atlas->Height;
+	}
+	else
+	{
+		uint32 Width, Height;
+		Packed = atlas::PackAll(Widths, Heights, Count, FONT_ATLAS_PADDING, false, FONT_ATLAS_MAX_SIZE, PackedX, PackedY,
+			&Width, &Height);
+		if (Packed)
+		{
+			free(Font->Buffer);
+			Font->Buffer = (uint8*)calloc((size_t)Width * Height, 1);
+			Font->Width = (int)Width;
+			Font->Height = (int)Height;
+		}
+	}
+
+	if (!Packed)
+	{
+		LogError("The glyphs of the %gpx font don't fit in their atlas.", PixelHeight);
+		free(Rects);
+		return false;
+	}
+
+	for (uint32 i = 0; i < Count; ++i)
+	{
+		Font->Glyphs[i].AtlasX = (int)PackedX[i];
+		Font->Glyphs[i].AtlasY = (int)PackedY[i];
+	}
+
+	// Every glyph has its own rect of the atlas, so they are rasterized in parallel, straight into it
+	uint32 const JobCount = (Count + FONT_RASTER_JOB_GLYPHS - 1) / FONT_RASTER_JOB_GLYPHS;
+	glyph_raster_job *Jobs = (glyph_raster_job*)malloc(JobCount * sizeof(glyph_raster_job));
+	job_group Group = {};
+	for (uint32 j = 0; j < JobCount; ++j)
+	{
+		glyph_raster_job &Job = Jobs[j];
+		Job.STBFont = &STBFont;
+		Job.Font = Font;
+		Job.GlyphIndices = GlyphIndices;
+		Job.Buffer = Font->Atlas ? Font->Atlas->Buffer : Font->Buffer;
+		Job.PixelScale = PixelScale;
+		Job.Begin = j * FONT_RASTER_JOB_GLYPHS;
+		Job.End = Min(Job.Begin + FONT_RASTER_JOB_GLYPHS, Count);
+		jobs::Submit(&Group, RasterizeGlyphs, &Job);
+	}
+	jobs::Wait(&Group);
+	UpdateGlyphTexcoords(Font);
+
+	free(Jobs);
+	free(Rects);
+	return true;
+}
+
+// Uploads an R8 glyph atlas, re-specifying the storage of the same texture name if Resized
+static void UploadGlyphTexture(uint32 Texture, uint8 const *Buffer, int32 Width, int32 Height, bool Resized)
+{
+	GLint CurrentAlignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &CurrentAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glBindTexture(GL_TEXTURE_2D, Texture);
+	if (Resized)
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, Width, Height, 0, GL_RED, GL_UNSIGNED_BYTE, Buffer);
+	else
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, Width, Height, GL_RED, GL_UNSIGNED_BYTE, Buffer);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, CurrentAlignment);
+}
+
+static void UploadFontAtlas(font_atlas *Atlas)
+{
+	UploadGlyphTexture(Atlas->TextureID, Atlas->Buffer, Atlas->Width, Atlas->Height, Atlas->Height != Atlas->TextureHeight);
+	Atlas->TextureHeight = Atlas->Height;
+}
+
+void FontAtlasInit(context *Context, font_atlas *Atlas, int32 Width, int32 Height, int32 MaxHeight)
+{
+	atlas::Init(&Atlas->Packer, (uint32)Width, (uint32)Height, FONT_ATLAS_PADDING);
+	Atlas->Width = Width;
+	Atlas->Height = Height;
+	Atlas->MaxHeight = Max(Height, MaxHeight);
+	Atlas->Buffer = (uint8*)calloc((size_t)Width * Height, 1);
+
+	// Sampled at its center, so that bilinear filtering stays in the white texels
+	atlas::Pack(&Atlas->Packer, FONT_ATLAS_WHITE_SIZE, FONT_ATLAS_WHITE_SIZE, &Atlas->WhiteX, &Atlas->WhiteY);
+	for (uint32 y = 0; y < FONT_ATLAS_WHITE_SIZE; ++y)
+		memset(Atlas->Buffer + (size_t)(Atlas->WhiteY + y) * Width + Atlas->WhiteX, 255, FONT_ATLAS_WHITE_SIZE);
+
+	Atlas->TextureID = Make2DTexture(Atlas->Buffer, Width, Height, 1, false, false, 1.0f,
+		GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+	Atlas->TextureHeight = Height;
+	Atlas->Fonts = Buf<font*>(Context->SessionPool);
+}
+
+vec2f FontAtlasWhiteTexcoord(font_atlas const *Atlas)
+{
+	return vec2f((Atlas->WhiteX + 0.5f * FONT_ATLAS_WHITE_SIZE) / (real32)Atlas->Width,
+		(Atlas->WhiteY + 0.5f * FONT_ATLAS_WHITE_SIZE) / (real32)Atlas->Height);
+}
+
+void FontAtlasDestroy(font_atlas *Atlas)
+{
+	glDeleteTextures(1, &Atlas->TextureID);
+	free(Atlas->Buffer);
+	Atlas->Buffer = NULL;
+	atlas::Free(&Atlas->Packer);
+	BufFree(Atlas->Fonts);
+}
+
+// Fills Font with the metrics of the distance field font Source, scaled to PixelHeight.
+// The glyph quads are rounded to whole pixels, the texcoords stay those of the Source glyphs.
+static void ScaleSDFFont(font *Font, font *Source, uint32 PixelHeight)
+{
+	real32 const Scale = PixelHeight / (real32)SDF_FONT_BAKE_HEIGHT;
+	Font->Width = Source->Width;
+	Font->Height = Source->Height;
+	Font->LineGap = (int)roundf(Source->LineGap * Scale);
+	Font->Ascent = (int)roundf(Source->Ascent * Scale);
+	Font->NumGlyphs = Source->NumGlyphs;
+	Font->MaxGlyphWidth = Source->MaxGlyphWidth * Scale;
+	Font->GlyphHeight = Source->GlyphHeight * Scale;
+	Font->AtlasTextureID = Source->AtlasTextureID;
+	Font->PixelHeight = PixelHeight;
+	Font->SDFSpread = Source->SDFSpread;
+	Font->Source = Source;
+
+	for (int i = 0; i < Source->CharN - Source->Char0; ++i)
+	{
+		glyph const &Src = Source->Glyphs[i];
+		glyph &Dst = Font->Glyphs[i];
+		Dst = Src;
+		Dst.X = (int)roundf(Src.X * Scale);
+		Dst.Y = (int)roundf(Src.Y * Scale);
+		Dst.CW = (int)roundf((Src.X + Src.CW) * Scale) - Dst.X;
+		Dst.CH = (int)roundf((Src.Y + Src.CH) * Scale) - Dst.Y;
+		Dst.AdvX = Src.AdvX * Scale;
+	}
+	Font->GlyphRectsDirty = true;
+
+	free(Font->Kerning);
+	Font->Kerning = NULL;
+	Font->KerningCount = Source->KerningCount;
+	if (Source->KerningCount)
+	{
+		Font->Kerning = (glyph_kerning*)malloc(Source->KerningCount * sizeof(glyph_kerning));
+		for (uint32 i = 0; i < Source->KerningCount; ++i)
+		{
+			Font->Kerning[i].Pair = Source->Kerning[i].Pair;
+			Font->Kerning[i].Advance = Source->Kerning[i].Advance * Scale;
+		}
+	}
+}
+
+// Load parameters kept for the hot-reload of fonts
+struct font_reload_info
+{
+	path ResourceName;
+	uint32 FontHeight;
+};
+
+// NOTE - The glyphs are re-packed and re-uploaded in the same atlas texture (resized if needed), so the font pointer
+// and its AtlasTextureID stay valid. In a shared atlas, the rects of the previous glyphs are given back once it is
+// full (see FontAtlasCompact).
+static void ReloadFont(context *Context, char const *Filename, void *UserData)
+{
+	font_reload_info *Info = (font_reload_info*)UserData;
+	font *Font = (font*)ResourceCheckExist(&Context->RenderResources, RESOURCE_FONT, Info->ResourceName);
+	if (!Font || !Font->Glyphs)
+		return;
+
+	void *Contents = ReadFileContents(Context, Filename, 0);
+	if (!Contents)
+		return;
+
+	int32 OldWidth = Font->Width, OldHeight = Font->Height;
+	if (!BakeFont(Font, (uint8*)Contents, (real32)Info->FontHeight))
+		return;
+
+	if (Font->Atlas)
+		UploadFontAtlas(Font->Atlas);
+	else
+		UploadGlyphTexture(Font->AtlasTextureID, Font->Buffer, Font->Width, Font->Height,
+			Font->Width != OldWidth || Font->Height != OldHeight);
+
+	// The heights drawn from a distance field font follow its new glyphs
+	render_resources *RenderResources = &Context->RenderResources;
+	RenderResources->FontGeneration++;
+	resource_entry *SourceEntry = GetEntry(RenderResources, RESOURCE_FONT, Info->ResourceName);
+	for (resource_entry **It = RenderResources->Entries; It != BufEnd(RenderResources->Entries); ++It)
+	{
+		if ((*It)->Parent == SourceEntry && (*It)->Type == RESOURCE_FONT)
+		{
+			font *Scaled = (font*)(*It)->Resource;
+			ScaleSDFFont(Scaled, Font, Scaled->PixelHeight);
+		}
+	}
+}
+
+// Fonts are stored under their filename followed by their pixel height
+static void FontResourceName(path ResourceName, path const Filename, uint32 FontHeight)
+{
+	uint32 FilenameLen = (uint32)strlen(Filename);
+	Assert(FilenameLen < (MAX_PATH - 4));
+	strncpy(ResourceName, Filename, FilenameLen); // to add the 3 size characters + \0
+	sprintf(ResourceName + FilenameLen, "%d", (int32)FontHeight);
+}
+
+// Allocates a font and its glyph buffer, to be filled by BakeFont
+static font *AllocFont(context *Context, int Char0, int CharN, font_atlas *Atlas = NULL)
+{
+	font *Font = rf::PoolAlloc<font>(Context->SessionPool, 1);
+	Font->Char0 = Char0;
+	Font->CharN = CharN;
+	Font->Glyphs = rf::PoolAlloc<glyph>(Context->SessionPool, (uint32)(Font->CharN - Font->Char0));
+	Font->Atlas = Atlas;
+	return Font;
+}
+
+// Uploads the atlas of a baked font and stores it
+static void StoreFont(context *Context, path const Filename, path const ResourceName, uint32 FontHeight, font *Font)
+{
+	uint64 AtlasBytes = 0;
+	if (Font->Atlas)
+	{
+		// NOTE - The shared atlas memory isn't accounted to the fonts in it
+		Font->AtlasTextureID = Font->Atlas->TextureID;
+		UploadFontAtlas(Font->Atlas);
+		BufPush(Font->Atlas->Fonts, Font);
+	}
+	else
+	{
+		// Make Texture out of the Bitmap
+		Font->AtlasTextureID = Make2DTexture(Font->Buffer, Font->Width, Font->Height, 1, false, false, 1.0f,
+			GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+		AtlasBytes = (uint64)Font->Width * Font->Height;
+	}
+
+	uint64 GlyphBytes = (uint64)(Font->CharN - Font->Char0) * sizeof(glyph);
+	resource_entry *Entry = ResourceStore(&Context->RenderResources, RESOURCE_FONT, ResourceName, Font,
+		AtlasBytes + GlyphBytes, AtlasBytes);
+
+	if (watch::IsActive())
+	{
+		font_reload_info *Info = rf::PoolAlloc<font_reload_info>(Context->SessionPool, 1);
+		strncpy(Info->ResourceName, ResourceName, MAX_PATH - 1);
+		Info->ResourceName[MAX_PATH - 1] = 0;
+		Info->FontHeight = FontHeight;
+		Entry->ReloadInfo = Info;
+
+		// Under the executable directory, as the images and textures are watched
+		path WatchName;
+		ConcatStrings(WatchName, ctx::GetExePath(Context), Filename);
+		watch::AddFile(WatchName, ReloadFont, Info);
+	}
+}
+
+// TODO - This method isn't perfect. Some letters have KERN advance between them when in sentences.
+// This doesnt take it into account since we bake each letter separately for future use by texture lookup
+font *ResourceLoadFont(context *Context, path const Filename, uint32 FontHeight, int Char0, int CharN,
+	font_atlas *Atlas)
+{
+	if (FontHeight > 256) FontHeight = 256; // upper bound on font height
+	if ((CharN - Char0) <= 0) return nullptr;
+
+	path ResourceName;
+	FontResourceName(ResourceName, Filename, FontHeight);
+
+	void *LoadedResource = ResourceAcquire(&Context->RenderResources, RESOURCE_FONT, ResourceName);
+	if (LoadedResource)
+	{
+		return (font*)LoadedResource;
+	}
+	TRACE_SCOPE("resource", "LoadFont", ResourceName);
+
+	void *Contents = ReadFileContents(Context, Filename, 0);
+	if (!Contents)
+	{
+		return rf::PoolAlloc<font>(Context->SessionPool, 1);
+	}
+
+	font *Font = AllocFont(Context, Char0, CharN, Atlas);
+	if (!BakeFont(Font, (uint8*)Contents, (real32)FontHeight))
+	{
+		return rf::PoolAlloc<font>(Context->SessionPool, 1);
+	}
+	StoreFont(Context, Filename, ResourceName, FontHeight, Font);
+
+	return Font;
+}
+
+font *ResourceLoadSDFFont(context *Context, path const Filename, uint32 FontHeight, int Char0, int CharN)
+{
+	if (FontHeight > 256) FontHeight = 256; // upper bound on font height
+	if ((CharN - Char0) <= 0) return nullptr;
+
+	path ResourceName;
+	FontResourceName(ResourceName, Filename, FontHeight);
+	strcat(ResourceName, "~");
+
+	void *LoadedResource = ResourceAcquire(&Context->RenderResources, RESOURCE_FONT, ResourceName);
+	if (LoadedResource)
+	{
+		return (font*)LoadedResource;
+	}
+	TRACE_SCOPE("resource", "LoadSDFFont", ResourceName);
+
+	// The distance field font, shared by every height (the first load decides of its codepoint range)
+	render_resources *RenderResources = &Context->RenderResources;
+	path SourceName;
+	snprintf(SourceName, MAX_PATH, "%s~sdf", Filename);
+	font *Source = (font*)ResourceAcquire(RenderResources, RESOURCE_FONT, SourceName);
+	if (!Source)
+	{
+		void *Contents = ReadFileContents(Context, Filename, 0);
+		if (!Contents)
+		{
+			return rf::PoolAlloc<font>(Context->SessionPool, 1);
+		}
+
+		Source = AllocFont(Context, Char0, CharN);
+		Source->SDFSpread = SDF_FONT_SPREAD;
+		Source->PixelHeight = SDF_FONT_BAKE_HEIGHT;
+		if (!BakeFont(Source, (uint8*)Contents, (real32)SDF_FONT_BAKE_HEIGHT))
+		{
+			return rf::PoolAlloc<font>(Context->SessionPool, 1);
+		}
+		StoreFont(Context, Filename, SourceName, SDF_FONT_BAKE_HEIGHT, Source);
+	}
+
+	font *Font = AllocFont(Context, Source->Char0, Source->CharN);
+	ScaleSDFFont(Font, Source, FontHeight);
+
+	// NOTE - The reference acquired on the distance field font is given back when this one is evicted
+	uint64 GlyphBytes = (uint64)(Font->CharN - Font->Char0) * sizeof(glyph);
+	resource_entry *Entry = ResourceStore(RenderResources, RESOURCE_FONT, ResourceName, Font, GlyphBytes, 0);
+	Entry->Parent = GetEntry(RenderResources, RESOURCE_FONT, SourceName);
+	return Font;
+}
+
+// NOTE - Not hot-reloaded : the face is shared by every height, and its glyphs may be drawn from already
+font *ResourceLoadDynamicFont(context *Context, path const Filename, uint32 FontHeight)
+{
+	if (FontHeight > 256) FontHeight = 256; // upper bound on font height
+
+	// Stored apart from the baked fonts of the same file and height
+	path ResourceName;
+	FontResourceName(ResourceName, Filename, FontHeight);
+	strcat(ResourceName, "*");
+
+	void *LoadedResource = ResourceAcquire(&Context->RenderResources, RESOURCE_FONT, ResourceName);
+	if (LoadedResource)
+	{
+		return (font*)LoadedResource;
+	}
+	TRACE_SCOPE("resource", "LoadDynamicFont", ResourceName);
+
+	render_resources *RenderResources = &Context->RenderResources;
+	if (!RenderResources->GlyphCache)
+	{
+		RenderResources->GlyphCache = rf::PoolAlloc<glyph_cache>(Context->SessionPool, 1);
+		glyphcache::Init(RenderResources->GlyphCache);
+	}
+	glyph_cache *Cache = RenderResources->GlyphCache;
+
+	font_face *Face = glyphcache::FindFace(Cache, Filename);
+	if (!Face)
+	{
+		int32 FileSize;
+		void *Contents = ReadFileContents(Context, Filename, &FileSize);
+		Face = Contents ? glyphcache::AddFace(Cache, Filename, Contents, (uint64)FileSize) : NULL;
+		if (!Face)
+		{
+			return rf::PoolAlloc<font>(Context->SessionPool, 1);
+		}
+	}
+
+	font *Font = rf::PoolAlloc<font>(Context->SessionPool, 1);
+	Font->Cache = Cache;
+	Font->Face = Face;
+	Font->PixelHeight = FontHeight;
+	Font->Width = Cache->Width;
+	Font->Height = Cache->Height;
+	Font->AtlasTextureID = Cache->TextureID;
+	glyphcache::GetFontMetrics(Face, FontHeight, Font);
+
+	// NOTE - The cache texture isn't accounted to its fonts
+	ResourceStore(RenderResources, RESOURCE_FONT, ResourceName, Font, sizeof(font), 0);
+	return Font;
+}
+
+// ##########################################################################
+// Preload manifests
+
+enum manifest_entry_type
+{
+	MANIFEST_IMAGE,
+	MANIFEST_TEXTURE,
+	MANIFEST_FONT,
+	MANIFEST_MODEL
+};
+
+// One resource listed in a manifest, with its load parameters and its state during the load
+struct manifest_entry
+{
+	manifest_entry_type Type;
+	path Filename;
+	path ResourceName;		// store key : Filename, or Filename + height for fonts
+	path DiskName;			// where the file is read from when not in a mounted pack
+
+	bool IsFloat;
+	bool FloatHalfPrecision;
+	bool FlipY;
+	bool SRGB;
+	int32 ForceNumChannel;
+	uint32 AnisotropicLevel;
+	int MagFilter, MinFilter, WrapS, WrapT;
+	texture_residency Residency;
+	uint32 FontHeight;
+	int Char0, CharN;
+
+	bool Read;				// file read and decoded/baked in a worker, false when stored already or loaded directly
+	uint8 const *Encoded;
+	uint64 EncodedSize;
+	job_group Group;
+	image Decoded;
+	font *Font;
+};
+
+struct manifest_gl_name
+{
+	char const *Name;
+	int Value;
+};
+
+static manifest_gl_name const ManifestGLNames[] = {
+	{ "nearest", GL_NEAREST }, { "linear", GL_LINEAR },
+	{ "nearest_mipmap_nearest", GL_NEAREST_MIPMAP_NEAREST }, { "linear_mipmap_nearest", GL_LINEAR_MIPMAP_NEAREST },
+	{ "nearest_mipmap_linear", GL_NEAREST_MIPMAP_LINEAR }, { "linear_mipmap_linear", GL_LINEAR_MIPMAP_LINEAR },
+	{ "repeat", GL_REPEAT }, { "mirror", GL_MIRRORED_REPEAT }, { "clamp", GL_CLAMP_TO_EDGE }
+};
+
+// Filter and wrap modes are given by name, or as GL enum values (like in glTF)
+static int ManifestGLParam(cJSON *Item, char const *Name, int DefaultValue)
+{
+	cJSON *Obj = cJSON_GetObjectItem(Item, Name);
+	if (!Obj)
+		return DefaultValue;
+	if (Obj->type != cJSON_String)
+		return Obj->valueint;
+
+	for (uint32 i = 0; i < sizeof(ManifestGLNames) / sizeof(ManifestGLNames[0]); ++i)
+	{
+		if (!strcmp(Obj->valuestring, ManifestGLNames[i].Name))
+			return ManifestGLNames[i].Value;
+	}
+	LogError("Manifest : unknown %s value \"%s\".", Name, Obj->valuestring);
+	return DefaultValue;
+}
+
+static texture_residency ManifestResidency(cJSON *Item)
+{
+	cJSON *Obj = cJSON_GetObjectItem(Item, "residency");
+	if (Obj && Obj->type == cJSON_String)
+	{
+		if (!strcmp(Obj->valuestring, "discard")) return RESIDENCY_DISCARD;
+		if (!strcmp(Obj->valuestring, "lowmip")) return RESIDENCY_LOWMIP;
+	}
+	return RESIDENCY_KEEP;
+}
+
+// Entries are either a filename, or an object with a "file" and the load parameters
+static void ParseManifestEntries(context *Context, cJSON *Root, char const *Key, manifest_entry_type Type,
+	manifest_entry *&Entries)
+{
+	cJSON *List = cJSON_GetObjectItem(Root, Key);
+	for (cJSON *Item = List ? List->child : NULL; Item; Item = Item->next)
+	{
+		cJSON *File = (Item->type == cJSON_String) ? Item : cJSON_GetObjectItem(Item, "file");
+		if (!File || File->type != cJSON_String)
+		{
+			LogError("Manifest : %s entry without a file, skipped.", Key);
+			continue;
+		}
+
+		manifest_entry Entry = {};
+		Entry.Type = Type;
+		strncpy(Entry.Filename, File->valuestring, MAX_PATH - 1);
+		strncpy(Entry.ResourceName, Entry.Filename, MAX_PATH);
+		ConcatStrings(Entry.DiskName, ctx::GetExePath(Context), Entry.Filename);
+
+		Entry.IsFloat = JSON_Get(Item, "float", 0) != 0;
+		Entry.FloatHalfPrecision = JSON_Get(Item, "half", 0) != 0;
+		Entry.FlipY = JSON_Get(Item, "flip", 1) != 0;
+		Entry.SRGB = JSON_Get(Item, "srgb", 0) != 0;
+		Entry.ForceNumChannel = JSON_Get(Item, "channels", 0);
+		Entry.AnisotropicLevel = (uint32)JSON_Get(Item, "aniso", 1);
+		Entry.MagFilter = ManifestGLParam(Item, "mag", GL_LINEAR);
+		Entry.MinFilter = ManifestGLParam(Item, "min", GL_LINEAR_MIPMAP_LINEAR);
+		Entry.WrapS = ManifestGLParam(Item, "wrap_s", GL_CLAMP_TO_EDGE);
+		Entry.WrapT = ManifestGLParam(Item, "wrap_t", GL_CLAMP_TO_EDGE);
+		Entry.Residency = ManifestResidency(Item);
+
+		if (Type == MANIFEST_TEXTURE)
+		{
+			Entry.FlipY = true; // like ResourceLoad2DTexture
+		}
+		else if (Type == MANIFEST_FONT)
+		{
+			Entry.FontHeight = Min((uint32)JSON_Get(Item, "height", 16), 256u);
+			Entry.Char0 = JSON_Get(Item, "first", 32);
+			Entry.CharN = JSON_Get(Item, "last", 127);
+			FontResourceName(Entry.ResourceName, Entry.Filename, Entry.FontHeight);
+			strncpy(Entry.DiskName, Entry.Filename, MAX_PATH); // like ReadFileContents
+		}
+
+		BufPush(Entries, Entry);
+	}
+}
+
+// Tells if the entry's file has to be read and decoded : not stored already, not read by an earlier entry of the
+// batch, and decoded on the CPU (block-compressed textures are mapped and uploaded as they are, models parse themselves)
+static bool ManifestEntryNeedsRead(render_resources *RenderResources, manifest_entry const *Entry,
+	manifest_entry const *BatchStart)
+{
+	switch (Entry->Type)
+	{
+	case MANIFEST_TEXTURE:
+		if (IsCompressedTextureFile(Entry->Filename) || ResourceCheckExist(RenderResources, RESOURCE_TEXTURE, Entry->Filename))
+			return false;
+		// NOTE - the texture is made from its stored image if there is one
+		// fallthrough
+	case MANIFEST_IMAGE:
+		if (ResourceCheckExist(RenderResources, RESOURCE_IMAGE, Entry->Filename))
+			return false;
+		break;
+	case MANIFEST_FONT:
+		if (Entry->CharN <= Entry->Char0 || ResourceCheckExist(RenderResources, RESOURCE_FONT, Entry->ResourceName))
+			return false;
+		break;
+	default:
+		return false;
+	}
+
+	for (manifest_entry const *It = BatchStart; It != Entry; ++It)
+	{
+		if (It->Read && (It->Type == MANIFEST_FONT) == (Entry->Type == MANIFEST_FONT) &&
+			!strcmp(It->ResourceName, Entry->ResourceName))
+			return false;
+	}
+	return true;
 }
 
-void FramebufferSetAttachmentCount(frame_buffer *FB, int Count)
+static void DecodeManifestImage(void *UserData)
 {
-	Assert(Count < MAX_FBO_ATTACHMENTS);
-	FB->NumAttachments = Count;
-	glDrawBuffers((GLsizei)Count, FBOAttachments);
+	manifest_entry *Entry = (manifest_entry*)UserData;
+	TRACE_SCOPE("job", "DecodeImage", Entry->Filename);
+	DecodeImageMemory(&Entry->Decoded, Entry->Encoded, Entry->EncodedSize, Entry->IsFloat, Entry->FlipY,
+		Entry->ForceNumChannel);
 }
 
-void FramebufferAttachBuffer(frame_buffer *FB, uint32 Attachment, uint32 TextureID)
+static void BakeManifestFont(void *UserData)
 {
-	Assert(Attachment < MAX_FBO_ATTACHMENTS);
-	glFramebufferTexture(GL_FRAMEBUFFER, FBOAttachments[Attachment], TextureID, 0);
+	manifest_entry *Entry = (manifest_entry*)UserData;
+	TRACE_SCOPE("job", "BakeFont", Entry->ResourceName);
+	BakeFont(Entry->Font, (uint8*)Entry->Encoded, (real32)Entry->FontHeight);
 }
 
-void FramebufferAttachBuffer(frame_buffer *FB, uint32 Attachment, uint32 Channels, bool IsFloat, bool FloatHalfPrecision, bool Mipmap)
+// Reads the files of the batch entries that need it, all at once, and queues their decoding as they arrive
+static void ReadManifestBatch(context *Context, manifest_entry *Begin, manifest_entry *End)
 {
-	Assert(Attachment < MAX_FBO_ATTACHMENTS);
+	render_resources *RenderResources = &Context->RenderResources;
+	char const *Filenames[IO_BATCH_DEPTH];
+	manifest_entry *ReadEntries[IO_BATCH_DEPTH];
+	uint32 ReadCount = 0;
 
-	uint32 *BufferID = &FB->BufferIDs[Attachment];
-	glGenTextures(1, BufferID);
-	glBindTexture(GL_TEXTURE_2D, *BufferID);
+	for (manifest_entry *Entry = Begin; Entry != End; ++Entry)
+	{
+		Entry->Read = ManifestEntryNeedsRead(RenderResources, Entry, Begin);
+		if (!Entry->Read)
+			continue;
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, Mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		// Packed files are mapped already, only loose files go through the batch
+		Entry->Encoded = (uint8 const*)vfs::ReadFile(Context, Entry->Filename, &Entry->EncodedSize);
+		if (!Entry->Encoded)
+		{
+			Filenames[ReadCount] = Entry->DiskName;
+			ReadEntries[ReadCount++] = Entry;
+		}
+	}
 
-	GLint BaseFormat, Format;
-	FormatFromChannels(Channels, IsFloat, FloatHalfPrecision, &BaseFormat, &Format);
-	GLenum Type = IsFloat ? GL_FLOAT : GL_UNSIGNED_BYTE;
-	glTexImage2D(GL_TEXTURE_2D, 0, BaseFormat, FB->Size.x, FB->Size.y, 0, Format, Type, NULL);
+	io_batch *Batch = ReadCount ? io::BatchRead(Context, Context->ScratchPool, Filenames, ReadCount) : NULL;
+	io_file *File = Batch ? io::BatchNext(Batch) : NULL;
 
-	if (Mipmap)
+	// NOTE - Entries from packs are queued first, then the others in read completion order
+	for (manifest_entry *Entry = Begin; Entry != End || File; )
 	{
-		glGenerateMipmap(GL_TEXTURE_2D);
+		manifest_entry *Ready = NULL;
+		if (Entry != End)
+		{
+			Ready = Entry++;
+			if (!Ready->Read || !Ready->Encoded)
+				continue;
+		}
+		else
+		{
+			Ready = ReadEntries[File->Index];
+			Ready->Encoded = File->Data;
+			Ready->EncodedSize = File->Size;
+			File = io::BatchNext(Batch);
+			if (!Ready->Encoded)
+				continue;
+		}
+
+		if (Ready->Type == MANIFEST_FONT)
+		{
+			Ready->Font = AllocFont(Context, Ready->Char0, Ready->CharN);
+			jobs::Submit(&Ready->Group, BakeManifestFont, Ready);
+		}
+		else
+		{
+			jobs::Submit(&Ready->Group, DecodeManifestImage, Ready);
+		}
 	}
 
-	glFramebufferTexture2D(GL_FRAMEBUFFER, (GLenum)(GL_COLOR_ATTACHMENT0 + Attachment), GL_TEXTURE_2D, *BufferID, 0);
+	if (Batch)
+		io::BatchFree(Batch);
 }
 
-// TODO - This method isn't perfect. Some letters have KERN advance between them when in sentences.
-// This doesnt take it into account since we bake each letter separately for future use by texture lookup
-font *ResourceLoadFont(context *Context, path const Filename, uint32 FontHeight, int Char0, int CharN)
+// Stores the resource of the entry once decoded (or loads it directly if it wasn't read), in the manifest order
+static bool FinishManifestEntry(context *Context, resource_manifest *Manifest, manifest_entry *Entry)
 {
-	if (FontHeight > 256) FontHeight = 256; // upper bound on font height
-	if ((CharN - Char0) <= 0) return nullptr;
-	real32 PixelHeight = (real32)FontHeight;
-
-	path ResourceName;
-	uint32 FilenameLen = (uint32)strlen(Filename);
-	Assert(FilenameLen < (MAX_PATH - 4));
-	strncpy(ResourceName, Filename, FilenameLen); // to add the 3 size characters + \0
-	sprintf(ResourceName + FilenameLen, "%d", (int32)FontHeight);
+	jobs::Wait(&Entry->Group);
 
-	void *LoadedResource = ResourceCheckExist(&Context->RenderResources, RESOURCE_FONT, ResourceName);
-	if (LoadedResource)
+	if (Entry->Read && !Entry->Encoded)
 	{
-		return (font*)LoadedResource;
+		LogError("Manifest : can't read %s.", Entry->DiskName);
 	}
 
-	font *Font = rf::PoolAlloc<font>(Context->SessionPool, 1);
-
-	void *Contents = ReadFileContents(Context, Filename, 0);
-	if (Contents)
-	{
-		stbtt_fontinfo STBFont;
-		stbtt_InitFont(&STBFont, (uint8*)Contents, 0);
-
-		real32 PixelScale = stbtt_ScaleForPixelHeight(&STBFont, PixelHeight);
-		int Ascent, Descent, LineGap;
-		stbtt_GetFontVMetrics(&STBFont, &Ascent, &Descent, &LineGap);
-		Ascent = (int)floor(Ascent * PixelScale);
-		Descent = (int)floor(Descent * PixelScale);
-
-		Font->Width = 1024;
-		Font->Height = 1024;
-		Font->NumGlyphs = STBFont.numGlyphs;
-		Font->Char0 = Char0;
-		Font->CharN = CharN;
-		Font->Buffer = rf::PoolAlloc<uint8>(Context->SessionPool, (uint32)(Font->Width*Font->Height));
-		Font->Glyphs = rf::PoolAlloc<glyph>(Context->SessionPool, (uint32)(Font->CharN - Font->Char0));
-		Font->LineGap = Ascent - Descent;
-		Font->Ascent = Ascent;
-		Font->MaxGlyphWidth = 0;
-		Font->GlyphHeight = 0;
-
-		real32 X = 0, Y = 0;
-
-		for (int Codepoint = Font->Char0; Codepoint < Font->CharN; ++Codepoint)
-		{
-			int Glyph = stbtt_FindGlyphIndex(&STBFont, Codepoint);
-
-			//real32 ShiftX = X - (real32)floor(X);
-			int AdvX, Lsb;
-			int X0, X1, Y0, Y1;
-			stbtt_GetGlyphBitmapBox(&STBFont, Glyph, PixelScale, PixelScale, &X0, &Y0, &X1, &Y1);
-			stbtt_GetGlyphHMetrics(&STBFont, Glyph, &AdvX, &Lsb);
-			//int AdvKern = stbtt_GetCodepointKernAdvance(&STBFont, Codepoint, Codepoint+1);
-
-			int CW = X1 - X0;
-			int CH = Y1 - Y0;
-			real32 AdvanceX = AdvX * PixelScale;
-
-			if (X + AdvanceX >= Font->Width)
-			{
-				X = 0;
-				Y += Font->LineGap;
-				Assert((Y + Font->LineGap) < Font->Height);
-			}
+	bool Loaded = false;
+	image *Decoded = Entry->Read ? &Entry->Decoded : NULL;
+	switch (Entry->Type)
+	{
+	case MANIFEST_IMAGE:
+	{
+		image *Image = LoadImage(Context, Entry->Filename, Entry->IsFloat, Entry->FlipY, Entry->ForceNumChannel, Decoded);
+		BufPush(Manifest->Images, Image);
+		Loaded = Image != NULL;
+	} break;
+	case MANIFEST_TEXTURE:
+	{
+		uint32 *Texture = Load2DTexture(Context, Entry->Filename, Entry->IsFloat, Entry->FloatHalfPrecision,
+			Entry->AnisotropicLevel, Entry->MagFilter, Entry->MinFilter, Entry->WrapS, Entry->WrapT, Entry->ForceNumChannel,
+			Entry->Residency, Entry->SRGB, Decoded);
+		BufPush(Manifest->Textures, Texture);
+		Loaded = Texture != NULL;
+	} break;
+	case MANIFEST_FONT:
+	{
+		font *Font = NULL;
+		if (Entry->Font && Entry->Font->Buffer)
+		{
+			StoreFont(Context, Entry->Filename, Entry->ResourceName, Entry->FontHeight, Entry->Font);
+			Font = Entry->Font;
+		}
+		else if (!Entry->Read)
+		{
+			Font = ResourceLoadFont(Context, Entry->Filename, Entry->FontHeight, Entry->Char0, Entry->CharN);
+		}
+		BufPush(Manifest->Fonts, Font);
+		Loaded = Font && Font->AtlasTextureID;
+	} break;
+	case MANIFEST_MODEL:
+	{
+		model Model = {};
+		Loaded = ModelLoadGLTF(Context, &Model, Entry->Filename, (int)Entry->AnisotropicLevel);
+		BufPush(Manifest->Models, Model);
+	} break;
+	}
 
-			int CharX = (int)ceil(X);
-			int CharY = (int)ceil(Max(0.f, Y + Ascent + Y0));
+	// The encoded files read in the batch are given back right away, packed ones stay mapped
+	mem_pool *Scratch = Context->ScratchPool;
+	if (Entry->Encoded >= Scratch->Buffer && Entry->Encoded < Scratch->Buffer + Scratch->Capacity)
+	{
+		PoolFree(Scratch, (uint8*)Entry->Encoded);
+	}
+	return Loaded;
+}
 
-			glyph &DstGlyph = Font->Glyphs[Codepoint - Font->Char0];
-			DstGlyph.X = X0; DstGlyph.Y = Y0;
-			DstGlyph.TexX0 = (X + 0) / (real32)Font->Width;            DstGlyph.TexX1 = (X + CW) / (real32)Font->Width;
-			DstGlyph.TexY0 = (Y + Ascent + Y0) / (real32)Font->Height; DstGlyph.TexY1 = (Y + Ascent + Y1) / (real32)Font->Height;
-			DstGlyph.CW = CW; DstGlyph.CH = CH; DstGlyph.AdvX = AdvanceX;
+bool ResourceLoadManifest(context *Context, resource_manifest *Manifest, path const Filename,
+	manifest_progress_func ProgressFunc, void *UserData)
+{
+	TRACE_SCOPE("resource", "LoadManifest", Filename);
+	memset(Manifest, 0, sizeof(resource_manifest));
 
-			Font->MaxGlyphWidth += AdvanceX;
-			Font->GlyphHeight = Max(Font->GlyphHeight, CH);
+	void *Content = ReadFileContents(Context, Filename, 0);
+	cJSON *Root = Content ? cJSON_Parse((char*)Content) : NULL;
+	if (!Root)
+	{
+		LogError("Error loading manifest %s : %s.", Filename, Content ? "invalid JSON" : "can't read the file");
+		return false;
+	}
 
-			uint8 *BitmapPtr = Font->Buffer + (CharY * Font->Width + CharX);
-			stbtt_MakeGlyphBitmap(&STBFont, BitmapPtr, CW, CH, Font->Width, PixelScale, PixelScale, Glyph);
+	manifest_entry *Entries = Buf<manifest_entry>(Context->ScratchPool);
+	ParseManifestEntries(Context, Root, "images", MANIFEST_IMAGE, Entries);
+	ParseManifestEntries(Context, Root, "textures", MANIFEST_TEXTURE, Entries);
+	ParseManifestEntries(Context, Root, "fonts", MANIFEST_FONT, Entries);
+	ParseManifestEntries(Context, Root, "models", MANIFEST_MODEL, Entries);
+	cJSON_Delete(Root);
+
+	Manifest->Images = Buf<image*>(Context->SessionPool);
+	Manifest->Textures = Buf<uint32*>(Context->SessionPool);
+	Manifest->Fonts = Buf<font*>(Context->SessionPool);
+	Manifest->Models = Buf<model>(Context->SessionPool);
+	Manifest->Progress.Total = (uint32)BufSize(Entries);
+
+	// By batches of IO_BATCH_DEPTH entries, to bound the scratch memory holding the encoded files
+	for (uint32 BatchStart = 0; BatchStart < Manifest->Progress.Total; BatchStart += IO_BATCH_DEPTH)
+	{
+		manifest_entry *Begin = Entries + BatchStart;
+		manifest_entry *End = Entries + Min(BatchStart + IO_BATCH_DEPTH, Manifest->Progress.Total);
+		ReadManifestBatch(Context, Begin, End);
 
-			X += CW;
+		for (manifest_entry *Entry = Begin; Entry != End; ++Entry)
+		{
+			if (!FinishManifestEntry(Context, Manifest, Entry))
+				Manifest->Progress.Failed++;
+			Manifest->Progress.Done++;
+			Manifest->Progress.Current = Entry->Filename;
+			if (ProgressFunc)
+				ProgressFunc(Context, &Manifest->Progress, UserData);
 		}
+	}
 
-		Font->MaxGlyphWidth /= real32(Font->CharN - Font->Char0);
+	Manifest->Progress.Current = NULL;
+	BufFree(Entries);
 
-		// Make Texture out of the Bitmap
-		Font->AtlasTextureID = Make2DTexture(Font->Buffer, Font->Width, Font->Height, 1, false, false, 1.0f,
-			GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+	LogInfo("Manifest %s : %u resources loaded, %u failed.", Filename, Manifest->Progress.Done - Manifest->Progress.Failed,
+		Manifest->Progress.Failed);
+	return Manifest->Progress.Failed == 0;
+}
 
-		ResourceStore(&Context->RenderResources, RESOURCE_FONT, ResourceName, Font);
+void ResourceReleaseManifest(context *Context, resource_manifest *Manifest)
+{
+	render_resources *RenderResources = &Context->RenderResources;
+	for (image **It = Manifest->Images; It != BufEnd(Manifest->Images); ++It)
+		ResourceRelease(RenderResources, *It);
+	for (uint32 **It = Manifest->Textures; It != BufEnd(Manifest->Textures); ++It)
+		ResourceRelease(RenderResources, *It);
+	for (font **It = Manifest->Fonts; It != BufEnd(Manifest->Fonts); ++It)
+	{
+		if (*It && (*It)->AtlasTextureID)
+			ResourceRelease(RenderResources, *It);
 	}
+	for (model *It = Manifest->Models; It != BufEnd(Manifest->Models); ++It)
+		ModelFree(It);
 
-	return Font;
+	BufFree(Manifest->Images);
+	BufFree(Manifest->Textures);
+	BufFree(Manifest->Fonts);
+	BufFree(Manifest->Models);
 }
 
 uint32 _CompileShader(context *Context, char const *Src, int Type)
@@ -721,34 +2553,335 @@ uint32 BuildShaderFromSource(context *Context, char const *VSrc, char const *FSr
 	return ProgramID;
 }
 
-uint32 BuildShader(context *Context, char *VSPath, char *FSPath, char *GSPath, char *TESCPath, char *TESEPath)
+static bool ReadShaderSources(context *Context, char const **Paths, char **Srcs)
+{
+	// Order : VS, FS, GS, TESC, TESE
+	char const *Filenames[5];
+	int Stages[5];
+	uint32 Count = 0;
+	for (int i = 0; i < 5; ++i)
+	{
+		Srcs[i] = NULL;
+		if (Paths[i])
+		{
+			Filenames[Count] = Paths[i];
+			Stages[Count++] = i;
+		}
+	}
+
+	// The stages are read in one batch
+	io_batch *Batch = io::BatchRead(Context, Context->ScratchPool, Filenames, Count);
+	for (io_file *File = io::BatchNext(Batch); File; File = io::BatchNext(Batch))
+	{
+		Srcs[Stages[File->Index]] = (char*)File->Data;
+	}
+	io::BatchFree(Batch);
+
+	return Srcs[0] && Srcs[1] && (!Paths[2] || Srcs[2]) && (!Paths[4] || Srcs[4]) && (!Paths[3] || (Srcs[4] && Srcs[3]));
+}
+
+// Source paths kept for the hot-reload of shader programs
+struct shader_reload_info
+{
+	uint32 ProgramID;
+	path Paths[5];
+	bool HasPath[5];
+};
+
+static shader_reload_info **ShaderReloadInfos = nullptr;
+
+#define SHADER_UNIFORM_NAME_MAX 128
+#define SHADER_MAX_UNIFORM_BLOCKS 32
+
+// Value of a default block uniform (an array element for arrays), kept across a relink that resets them all
+struct saved_uniform
+{
+	char Name[SHADER_UNIFORM_NAME_MAX];
+	GLenum Type;
+	uint32 Components;
+	char Kind;			// 'f'loat, 'i'nt (bools, samplers and images too), 'u'nsigned
+	union
+	{
+		GLfloat F[16];
+		GLint I[16];
+		GLuint U[16];
+	};
+};
+
+// Components of a uniform type, and how they are read and written. 0 for the double types, which aren't kept.
+static uint32 UniformComponents(GLenum Type, char *Kind)
+{
+	*Kind = 'f';
+	switch (Type)
+	{
+	case GL_FLOAT: return 1;
+	case GL_FLOAT_VEC2: return 2;
+	case GL_FLOAT_VEC3: return 3;
+	case GL_FLOAT_VEC4: case GL_FLOAT_MAT2: return 4;
+	case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2: return 6;
+	case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT4x2: return 8;
+	case GL_FLOAT_MAT3: return 9;
+	case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3: return 12;
+	case GL_FLOAT_MAT4: return 16;
+	case GL_DOUBLE: case GL_DOUBLE_VEC2: case GL_DOUBLE_VEC3: case GL_DOUBLE_VEC4:
+	case GL_DOUBLE_MAT2: case GL_DOUBLE_MAT3: case GL_DOUBLE_MAT4: case GL_DOUBLE_MAT2x3: case GL_DOUBLE_MAT2x4:
+	case GL_DOUBLE_MAT3x2: case GL_DOUBLE_MAT3x4: case GL_DOUBLE_MAT4x2: case GL_DOUBLE_MAT4x3: return 0;
+	case GL_UNSIGNED_INT: *Kind = 'u'; return 1;
+	case GL_UNSIGNED_INT_VEC2: *Kind = 'u'; return 2;
+	case GL_UNSIGNED_INT_VEC3: *Kind = 'u'; return 3;
+	case GL_UNSIGNED_INT_VEC4: *Kind = 'u'; return 4;
+	case GL_INT_VEC2: case GL_BOOL_VEC2: *Kind = 'i'; return 2;
+	case GL_INT_VEC3: case GL_BOOL_VEC3: *Kind = 'i'; return 3;
+	case GL_INT_VEC4: case GL_BOOL_VEC4: *Kind = 'i'; return 4;
+	default: *Kind = 'i'; return 1; // int, bool, samplers and images
+	}
+}
+
+// Reads the values of the default block uniforms of Program, and the bindings of its uniform blocks
+static saved_uniform *SaveUniforms(context *Context, uint32 Program, uint32 *Count, GLint *BlockBindings,
+	GLint *BlockCount)
+{
+	GLint ActiveCount = 0;
+	glGetProgramiv(Program, GL_ACTIVE_UNIFORMS, &ActiveCount);
+
+	// Arrays are saved element by element
+	uint32 Capacity = 0;
+	for (GLint i = 0; i < ActiveCount; ++i)
+	{
+		GLint Size;
+		GLenum Type;
+		glGetActiveUniform(Program, (GLuint)i, 0, NULL, &Size, &Type, NULL);
+		Capacity += (uint32)Size;
+	}
+
+	saved_uniform *Uniforms = PoolAlloc<saved_uniform>(Context->ScratchPool, Max(Capacity, 1u));
+	*Count = 0;
+	for (GLint i = 0; i < ActiveCount; ++i)
+	{
+		char Name[SHADER_UNIFORM_NAME_MAX];
+		GLint Size;
+		GLenum Type;
+		glGetActiveUniform(Program, (GLuint)i, SHADER_UNIFORM_NAME_MAX, NULL, &Size, &Type, Name);
+
+		// Array names are reported as Name[0]
+		char *Bracket = strchr(Name, '[');
+		if (Bracket && Size > 1)
+			*Bracket = 0;
+
+		for (GLint e = 0; e < Size; ++e)
+		{
+			saved_uniform &Uniform = Uniforms[*Count];
+			if (Size > 1)
+			{
+				// An element whose name doesn't fit can't be looked up again after the relink
+				int const Length = snprintf(Uniform.Name, SHADER_UNIFORM_NAME_MAX, "%s[%d]", Name, e);
+				if (Length < 0 || Length >= SHADER_UNIFORM_NAME_MAX)
+					continue;
+			}
+			else
+			{
+				strcpy(Uniform.Name, Name);
+			}
+
+			GLint Loc = glGetUniformLocation(Program, Uniform.Name);
+			Uniform.Type = Type;
+			Uniform.Components = UniformComponents(Type, &Uniform.Kind);
+			if (Loc < 0 || !Uniform.Components) // in a uniform block, or a double
+				continue;
+
+			switch (Uniform.Kind)
+			{
+			case 'f': glGetUniformfv(Program, Loc, Uniform.F); break;
+			case 'u': glGetUniformuiv(Program, Loc, Uniform.U); break;
+			default: glGetUniformiv(Program, Loc, Uniform.I); break;
+			}
+			(*Count)++;
+		}
+	}
+
+	*BlockCount = 0;
+	glGetProgramiv(Program, GL_ACTIVE_UNIFORM_BLOCKS, BlockCount);
+	*BlockCount = Min(*BlockCount, (GLint)SHADER_MAX_UNIFORM_BLOCKS);
+	for (GLint b = 0; b < *BlockCount; ++b)
+		glGetActiveUniformBlockiv(Program, (GLuint)b, GL_UNIFORM_BLOCK_BINDING, &BlockBindings[b]);
+
+	return Uniforms;
+}
+
+static void SetUniform(GLint Loc, saved_uniform const &Uniform)
+{
+	switch (Uniform.Type)
+	{
+	case GL_FLOAT_MAT2: glUniformMatrix2fv(Loc, 1, GL_FALSE, Uniform.F); return;
+	case GL_FLOAT_MAT3: glUniformMatrix3fv(Loc, 1, GL_FALSE, Uniform.F); return;
+	case GL_FLOAT_MAT4: glUniformMatrix4fv(Loc, 1, GL_FALSE, Uniform.F); return;
+	case GL_FLOAT_MAT2x3: glUniformMatrix2x3fv(Loc, 1, GL_FALSE, Uniform.F); return;
+	case GL_FLOAT_MAT2x4: glUniformMatrix2x4fv(Loc, 1, GL_FALSE, Uniform.F); return;
+	case GL_FLOAT_MAT3x2: glUniformMatrix3x2fv(Loc, 1, GL_FALSE, Uniform.F); return;
+	case GL_FLOAT_MAT3x4: glUniformMatrix3x4fv(Loc, 1, GL_FALSE, Uniform.F); return;
+	case GL_FLOAT_MAT4x2: glUniformMatrix4x2fv(Loc, 1, GL_FALSE, Uniform.F); return;
+	case GL_FLOAT_MAT4x3: glUniformMatrix4x3fv(Loc, 1, GL_FALSE, Uniform.F); return;
+	default: break;
+	}
+
+	switch (Uniform.Kind)
+	{
+	case 'f':
+		if (Uniform.Components == 1) glUniform1fv(Loc, 1, Uniform.F);
+		else if (Uniform.Components == 2) glUniform2fv(Loc, 1, Uniform.F);
+		else if (Uniform.Components == 3) glUniform3fv(Loc, 1, Uniform.F);
+		else glUniform4fv(Loc, 1, Uniform.F);
+		break;
+	case 'u':
+		if (Uniform.Components == 1) glUniform1uiv(Loc, 1, Uniform.U);
+		else if (Uniform.Components == 2) glUniform2uiv(Loc, 1, Uniform.U);
+		else if (Uniform.Components == 3) glUniform3uiv(Loc, 1, Uniform.U);
+		else glUniform4uiv(Loc, 1, Uniform.U);
+		break;
+	default:
+		if (Uniform.Components == 1) glUniform1iv(Loc, 1, Uniform.I);
+		else if (Uniform.Components == 2) glUniform2iv(Loc, 1, Uniform.I);
+		else if (Uniform.Components == 3) glUniform3iv(Loc, 1, Uniform.I);
+		else glUniform4iv(Loc, 1, Uniform.I);
+		break;
+	}
+}
+
+// Sets the saved values back in the relinked Program, matched by name : the uniforms removed from the new source
+// are dropped, the new ones keep their defaults.
+static void RestoreUniforms(uint32 Program, saved_uniform const *Uniforms, uint32 Count, GLint const *BlockBindings,
+	GLint BlockCount)
+{
+	GLint CurrentProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &CurrentProgram);
+	glUseProgram(Program);
+	for (uint32 i = 0; i < Count; ++i)
+	{
+		GLint Loc = glGetUniformLocation(Program, Uniforms[i].Name);
+		GLenum Type;
+		GLint Size;
+		if (Loc < 0)
+			continue;
+
+		// Skipped if the uniform changed type in the new source
+		GLuint Index;
+		char const *Name = Uniforms[i].Name;
+		glGetUniformIndices(Program, 1, &Name, &Index);
+		if (Index == GL_INVALID_INDEX)
+			continue;
+		glGetActiveUniform(Program, Index, 0, NULL, &Size, &Type, NULL);
+		if (Type == Uniforms[i].Type)
+			SetUniform(Loc, Uniforms[i]);
+	}
+	glUseProgram((GLuint)CurrentProgram);
+
+	GLint NewBlockCount = 0;
+	glGetProgramiv(Program, GL_ACTIVE_UNIFORM_BLOCKS, &NewBlockCount);
+	for (GLint b = 0; b < Min(BlockCount, NewBlockCount); ++b)
+		glUniformBlockBinding(Program, (GLuint)b, (GLuint)BlockBindings[b]);
+}
+
+// NOTE - The new stages are linked in the same program object, so the ProgramIDs held by the application stay valid.
+// The uniform values set by the application (and the uniform block bindings) are read before the relink and set
+// back after it, by name. Uniform locations can change if the new source declares different uniforms.
+static void ReloadShader(context *Context, char const *Filename, void *UserData)
 {
-	char *VSrc = NULL, *FSrc = NULL, *GSrc = NULL, *TESESrc = NULL, *TESCSrc = NULL;
+	shader_reload_info *Info = (shader_reload_info*)UserData;
+	if (!glIsProgram(Info->ProgramID))
+		return;
+
+	char const *Paths[5];
+	for (int i = 0; i < 5; ++i)
+		Paths[i] = Info->HasPath[i] ? Info->Paths[i] : NULL;
+
+	char *Srcs[5];
+	if (!ReadShaderSources(Context, Paths, Srcs))
+		return;
+
+	// Build and validate in a temp program first, the old one is kept as is on compile/link error
+	uint32 TmpProgram = BuildShaderFromSource(Context, Srcs[0], Srcs[1], Srcs[2], Srcs[3], Srcs[4]);
+	if (!TmpProgram)
+	{
+		LogError("Error reloading shader %s. Keeping the previous program.", Filename);
+		return;
+	}
+
+	// Relinking resets every uniform of the program
+	uint32 UniformCount;
+	GLint BlockBindings[SHADER_MAX_UNIFORM_BLOCKS], BlockCount;
+	saved_uniform *Uniforms = SaveUniforms(Context, Info->ProgramID, &UniformCount, BlockBindings, &BlockCount);
+
+	GLuint Shaders[5];
+	GLsizei ShaderCount;
+
+	glGetAttachedShaders(Info->ProgramID, 5, &ShaderCount, Shaders);
+	for (GLsizei i = 0; i < ShaderCount; ++i)
+		glDetachShader(Info->ProgramID, Shaders[i]); // already flagged for deletion
+
+	glGetAttachedShaders(TmpProgram, 5, &ShaderCount, Shaders);
+	for (GLsizei i = 0; i < ShaderCount; ++i)
+		glAttachShader(Info->ProgramID, Shaders[i]);
+	glDeleteProgram(TmpProgram);
+
+	glLinkProgram(Info->ProgramID);
+	RestoreUniforms(Info->ProgramID, Uniforms, UniformCount, BlockBindings, BlockCount);
+
+	// For a projection uniform that wasn't active in the previous source
+	ctx::UpdateShaderProjection(Context);
+}
 
-	VSrc = (char*)ReadFileContents(Context, VSPath, 0);
-	FSrc = (char*)ReadFileContents(Context, FSPath, 0);
+static void WatchShader(context *Context, uint32 ProgramID, char const **Paths)
+{
+	if (!ShaderReloadInfos)
+		ShaderReloadInfos = Buf<shader_reload_info*>(Context->SessionPool, 16);
 
-	if (GSPath)
+	// GL can give back the name of a deleted program, reuse its record
+	shader_reload_info *Info = nullptr;
+	for (shader_reload_info **It = ShaderReloadInfos; It != BufEnd(ShaderReloadInfos); ++It)
 	{
-		GSrc = (char*)ReadFileContents(Context, GSPath, 0);
+		if ((*It)->ProgramID == ProgramID)
+		{
+			Info = *It;
+			watch::RemoveUserData(Info);
+			break;
+		}
 	}
 
-	if (TESCPath)
+	if (!Info)
 	{
-		TESCSrc = (char*)ReadFileContents(Context, TESCPath, 0);
+		Info = rf::PoolAlloc<shader_reload_info>(Context->SessionPool, 1);
+		BufPush(ShaderReloadInfos, Info);
 	}
 
-	if (TESEPath)
+	Info->ProgramID = ProgramID;
+	for (int i = 0; i < 5; ++i)
 	{
-		TESESrc = (char*)ReadFileContents(Context, TESEPath, 0);
+		Info->HasPath[i] = Paths[i] != NULL;
+		if (Paths[i])
+		{
+			strncpy(Info->Paths[i], Paths[i], MAX_PATH);
+			watch::AddFile(Paths[i], ReloadShader, Info);
+		}
 	}
+}
+
+uint32 BuildShader(context *Context, char *VSPath, char *FSPath, char *GSPath, char *TESCPath, char *TESEPath)
+{
+	TRACE_SCOPE("resource", "BuildShader", VSPath);
+	char const *Paths[5] = { VSPath, FSPath, GSPath, TESCPath, TESEPath };
+	char *Srcs[5];
 
 	uint32 ProgramID = 0;
-	bool IsValid = VSrc && FSrc && (!GSPath || GSrc) && (!TESEPath || TESESrc) && (!TESCPath || (TESESrc && TESCSrc));
+	bool IsValid = ReadShaderSources(Context, Paths, Srcs);
 
 	if (IsValid)
 	{
-		ProgramID = BuildShaderFromSource(Context, VSrc, FSrc, GSrc, TESCSrc, TESESrc);
+		ProgramID = BuildShaderFromSource(Context, Srcs[0], Srcs[1], Srcs[2], Srcs[3], Srcs[4]);
+	}
+
+	if (ProgramID && watch::IsActive())
+	{
+		WatchShader(Context, ProgramID, Paths);
 	}
 
 	return ProgramID;
@@ -863,10 +2996,46 @@ void RenderMesh(mesh *Mesh, uint32 GLDrawType)
 	glDrawElements(GLDrawType, Mesh->IndexCount, Mesh->IndexType, 0);
 }
 
-static void FillCharInterleaved(real32 *VertData, uint16 *IdxData, uint32 i, uint16 c, font *Font, int *X, int *Y, vec3i const &Pos, real32 Scale)
+glyph const *GetFontGlyph(font *Font, uint32 Codepoint)
+{
+	static glyph const EmptyGlyph = {};
+	glyph const *Glyph = NULL;
+	if (Font->Cache)
+	{
+		Glyph = glyphcache::Get(Font->Cache, Font->Face, Font->PixelHeight, Codepoint);
+	}
+	else if (Font->Glyphs && (int)Codepoint >= Font->Char0 && (int)Codepoint < Font->CharN)
+	{
+		Glyph = &Font->Glyphs[Codepoint - Font->Char0];
+	}
+	return Glyph ? Glyph : &EmptyGlyph;
+}
+
+real32 GetFontKerning(font *Font, uint32 First, uint32 Second)
+{
+	if (Font->Cache)
+		return glyphcache::GetKerning(Font->Face, Font->PixelHeight, First, Second);
+
+	if (!Font->KerningCount || (int)First < Font->Char0 || (int)First >= Font->CharN || (int)Second < Font->Char0 ||
+		(int)Second >= Font->CharN)
+		return 0.f;
+
+	uint32 const Pair = (First - Font->Char0) << 16 | (Second - Font->Char0);
+	uint32 Lo = 0, Hi = Font->KerningCount;
+	while (Lo < Hi)
+	{
+		uint32 Mid = (Lo + Hi) / 2;
+		if (Font->Kerning[Mid].Pair < Pair)
+			Lo = Mid + 1;
+		else
+			Hi = Mid;
+	}
+	return (Lo < Font->KerningCount && Font->Kerning[Lo].Pair == Pair) ? Font->Kerning[Lo].Advance : 0.f;
+}
+
+static void FillCharInterleaved(real32 *VertData, uint16 *IdxData, uint32 i, glyph const &Glyph, font *Font, int *X, int *Y, vec3i const &Pos, real32 Scale)
 {
 	uint32 const Stride = 5 * 4;
-	glyph &Glyph = Font->Glyphs[c];
 
 #if 0
 	// Modify DisplayWidth to always be at least the length of each character
@@ -883,23 +3052,19 @@ static void FillCharInterleaved(real32 *VertData, uint16 *IdxData, uint32 i, uin
 #endif
 
 	// Position (TL, BL, BR, TR)
-	real32 BaseX = (real32)(*X + Glyph.X);
-	real32 BaseY = (real32)(*Y - Font->Ascent - Glyph.Y);
+	// NOTE - The glyph offsets and advance are scaled too, so that scaled text (of SDF fonts) keeps its proportions
+	real32 BaseX = *X + Scale * Glyph.X;
+	real32 BaseY = *Y - Scale * (Font->Ascent + Glyph.Y);
 	vec3f TL = Pos + vec3f(BaseX, BaseY, 0);
 	vec3f BR = TL + vec3f(Scale * Glyph.CW, Scale * -Glyph.CH, 0);
-	VertData[i*Stride + 0 + 0] = TL.x; VertData[i*Stride + 0 + 1] = TL.y;   VertData[i*Stride + 0 + 2] = TL.z;
-	VertData[i*Stride + 3 + 0] = Glyph.TexX0;  VertData[i*Stride + 3 + 1] = Glyph.TexY0;
-	VertData[i*Stride + 5 + 0] = TL.x; VertData[i*Stride + 5 + 1] = BR.y;   VertData[i*Stride + 5 + 2] = TL.z;
-	VertData[i*Stride + 8 + 0] = Glyph.TexX0;  VertData[i*Stride + 8 + 1] = Glyph.TexY1;
-	VertData[i*Stride + 10 + 0] = BR.x; VertData[i*Stride + 10 + 1] = BR.y;  VertData[i*Stride + 10 + 2] = TL.z;
-	VertData[i*Stride + 13 + 0] = Glyph.TexX1; VertData[i*Stride + 13 + 1] = Glyph.TexY1;
-	VertData[i*Stride + 15 + 0] = BR.x; VertData[i*Stride + 15 + 1] = TL.y;  VertData[i*Stride + 15 + 2] = TL.z;
-	VertData[i*Stride + 18 + 0] = Glyph.TexX1; VertData[i*Stride + 18 + 1] = Glyph.TexY0;
+	textlayout::StoreQuad(VertData + i * Stride, TL.x, TL.y, BR.x, BR.y, TL.z, Glyph);
 
-	IdxData[i * 6 + 0] = i * 4 + 0; IdxData[i * 6 + 1] = i * 4 + 1; IdxData[i * 6 + 2] = i * 4 + 2;
-	IdxData[i * 6 + 3] = i * 4 + 0; IdxData[i * 6 + 4] = i * 4 + 2; IdxData[i * 6 + 5] = i * 4 + 3;
+	uint16 *Idx = IdxData + i * 6;
+	uint16 const V = (uint16)(i * 4);
+	Idx[0] = V + 0; Idx[1] = V + 1; Idx[2] = V + 2;
+	Idx[3] = V + 0; Idx[4] = V + 2; Idx[5] = V + 3;
 
-	*X += (int)ceil(Glyph.AdvX);
+	*X += (int)ceil(Scale * Glyph.AdvX);
 }
 
 void FillDisplayTextInterleaved(char const *Text, int32 TextLength, font *Font, vec3i Pos, int MaxPixelWidth,
@@ -921,80 +3086,104 @@ void FillDisplayTextInterleaved(char const *Text, int32 TextLength, font *Font,
 	int X = 0, Y = 0;
 	for (int32 i = 0; i < TextLength; ++i)
 	{
-		uint8 AsciiIdx = Text[i] - Font->Char0;
+		uint8 Char = (uint8)Text[i];
 
 		if (Text[i] == '\n')
 		{
 			X = 0;
 			Y -= (int)ceil(Scale * Font->LineGap);
-			AsciiIdx = Text[++i] - Font->Char0;
+			Char = (uint8)Text[++i];
 			IndexCount -= 6;
 		}
 
-		FillCharInterleaved(VertData, IdxData, i, AsciiIdx, Font, &X, &Y, Pos, Scale);
+		FillCharInterleaved(VertData, IdxData, i, *GetFontGlyph(Font, Char), Font, &X, &Y, Pos, Scale);
 	}
 
 	// Add '..' to the string if it's too long and clamped
 	if (AdditionalLen > 0)
 	{
-		uint8 AsciiIdx = '.' - Font->Char0;
-		FillCharInterleaved(VertData, IdxData, TextLength++, AsciiIdx, Font, &X, &Y, Pos, Scale);
-		FillCharInterleaved(VertData, IdxData, TextLength, AsciiIdx, Font, &X, &Y, Pos, Scale);
+		FillCharInterleaved(VertData, IdxData, TextLength++, *GetFontGlyph(Font, '.'), Font, &X, &Y, Pos, Scale);
+		FillCharInterleaved(VertData, IdxData, TextLength, *GetFontGlyph(Font, '.'), Font, &X, &Y, Pos, Scale);
 	}
 
 }
+uint32 GetFontGlyphRects(font *Font)
+{
+	if (!Font->Glyphs)
+		return 0;
+
+	if (!Font->GlyphRects[1] || Font->GlyphRectsDirty)
+	{
+		uint32 const Count = (uint32)(Font->CharN - Font->Char0);
+		real32 *Rects = (real32*)malloc(Count * 8 * sizeof(real32));
+		for (uint32 i = 0; i < Count; ++i)
+		{
+			glyph const &Glyph = Font->Glyphs[i];
+			real32 *Rect = Rects + i * 8;
+			Rect[0] = Glyph.TexX0; Rect[1] = Glyph.TexY0; Rect[2] = Glyph.TexX1; Rect[3] = Glyph.TexY1;
+			Rect[4] = (real32)Glyph.CW; Rect[5] = (real32)Glyph.CH; Rect[6] = 0.f; Rect[7] = 0.f;
+		}
+
+		if (!Font->GlyphRects[1])
+		{
+			glGenBuffers(1, &Font->GlyphRects[0]);
+			glGenTextures(1, &Font->GlyphRects[1]);
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, Font->GlyphRects[0]);
+		glBufferData(GL_TEXTURE_BUFFER, Count * 8 * sizeof(real32), Rects, GL_STATIC_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		glBindTexture(GL_TEXTURE_BUFFER, Font->GlyphRects[1]);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, Font->GlyphRects[0]);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+		free(Rects);
+		Font->GlyphRectsDirty = false;
+	}
+	return Font->GlyphRects[1];
+}
+
+#define DISPLAY_TEXT_STACK_CHARS 512	// decoded on the stack up to this length, in a heap buffer above
+
 void FillDisplayTextInterleavedUTF8(char const *Text, int32 TextLength, font *Font, vec3i Pos, int MaxPixelWidth,
 	real32 *VertData, uint16 *IdxData, real32 Scale)
 {
-	uint32 VertexCount = TextLength * 4;
-	uint32 IndexCount = TextLength * 6;
+	uint32 Stack[DISPLAY_TEXT_STACK_CHARS];
+	uint32 Length = (uint32)strlen(Text);
+	uint32 *Codepoints = Length <= DISPLAY_TEXT_STACK_CHARS ? Stack : (uint32*)malloc(Length * sizeof(uint32));
+	uint32 Count = Min(UTF8Decode(Text, Length, Codepoints), (uint32)Max(TextLength, 0));
 
 	int X = 0, Y = 0;
-	size_t TextIdx = 0;
 	real32 TextWidth = 0.f;
-	for (int32 i = 0; i < TextLength; ++i)
+	for (uint32 i = 0; i < Count; ++i)
 	{
-		size_t CharAdvance;
-		uint16 UTFIdx = UTF8CharToInt(&Text[TextIdx], &CharAdvance) - Font->Char0;
+		glyph const *Glyph = GetFontGlyph(Font, Codepoints[i]);
 
-		TextWidth += Scale * Font->Glyphs[UTFIdx].AdvX;
+		TextWidth += Scale * Glyph->AdvX;
 		if (TextWidth >= MaxPixelWidth)
 			break;
 
-		FillCharInterleaved(VertData, IdxData, i, UTFIdx, Font, &X, &Y, Pos, Scale);
-
-		TextIdx += CharAdvance;
+		FillCharInterleaved(VertData, IdxData, i, *Glyph, Font, &X, &Y, Pos, Scale);
 	}
+
+	if (Codepoints != Stack)
+		free(Codepoints);
 }
 
 real32 GetDisplayTextWidth(char const *Text, font *Font, real32 Scale)
 {
-	real32 TextWidth = 0.f;
-
-	int UTFLen = UTF8CharCount(Text);
-	if (UTFLen > 1)
-	{
-		uint32 TextLength = UTF8Len(Text);
-		size_t TextIdx = 0;
-		for (uint32 i = 0; i < TextLength; ++i)
-		{
-			size_t CharAdvance;
-			uint16 UTFIdx = UTF8CharToInt(&Text[TextIdx], &CharAdvance) - Font->Char0;
+	uint32 Stack[DISPLAY_TEXT_STACK_CHARS];
+	uint32 Length = (uint32)strlen(Text);
+	uint32 *Codepoints = Length <= DISPLAY_TEXT_STACK_CHARS ? Stack : (uint32*)malloc(Length * sizeof(uint32));
+	uint32 Count = UTF8Decode(Text, Length, Codepoints);
 
-			TextWidth += Scale * Font->Glyphs[UTFIdx].AdvX;
-			TextIdx += CharAdvance;
-		}
-	}
-	else
+	real32 TextWidth = 0.f;
+	for (uint32 i = 0; i < Count; ++i)
 	{
-		uint32 TextLength = (uint32)strlen(Text);
-		for (uint32 i = 0; i < TextLength; ++i)
-		{
-			uint8 AsciiIdx = Text[i] - Font->Char0;
-			TextWidth += Scale * Font->Glyphs[AsciiIdx].AdvX;
-		}
+		TextWidth += Scale * GetFontGlyph(Font, Codepoints[i])->AdvX;
 	}
 
+	if (Codepoints != Stack)
+		free(Codepoints);
 	return TextWidth;
 }
 
@@ -1016,8 +3205,7 @@ display_text MakeDisplayText(context *Context, font *Font, char const *Msg, int
 	int X = 0, Y = 0;
 	for (uint32 i = 0; i < MsgLength; ++i)
 	{
-		uint8 AsciiIdx = Msg[i] - Font->Char0;
-		glyph &Glyph = Font->Glyphs[AsciiIdx];
+		glyph Glyph = *GetFontGlyph(Font, (uint8)Msg[i]);
 
 		// Modify DisplayWidth to always be at least the length of each character
 		if (MaxPixelWidth < Glyph.CW)
@@ -1029,8 +3217,7 @@ display_text MakeDisplayText(context *Context, font *Font, char const *Msg, int
 		{
 			X = 0;
 			Y -= Font->LineGap;
-			AsciiIdx = Msg[++i] - Font->Char0;
-			Glyph = Font->Glyphs[AsciiIdx];
+			Glyph = *GetFontGlyph(Font, (uint8)Msg[++i]);
 			IndexCount -= 6;
 		}
 
@@ -1494,6 +3681,71 @@ void DestroyUBO(uint32 ID)
 	glDeleteBuffers(1, &ID);
 }
 
+// Float RGB image uploaded as GL_RGB9_E5 with its mip chain (4 bytes per texel instead of 12), for HDR textures
+// that are only sampled
+static uint32 MakeRGB9E5Texture(render_resources *RenderResources, image const *Image, int MagFilter, int MinFilter,
+	int WrapS, int WrapT)
+{
+	if (Image->Channels < 3)
+	{
+		return Make2DMipmappedTexture(RenderResources, Image->Buffer, Image->Width, Image->Height, Image->Channels, true,
+			true, false, 1.f, MagFilter, MinFilter, WrapS, WrapT);
+	}
+
+	mip_chain Chain = {};
+	uint32 LevelCount = 1;
+	if (UsesMipmaps(MinFilter) && mip::Build(&Chain, RenderResources->MipCacheDir, Image->Buffer, Image->Width,
+		Image->Height, Image->Channels, true, false, RenderResources->MipFilter))
+	{
+		LevelCount = Chain.LevelCount;
+	}
+	else
+	{
+		Chain.Levels[0] = Image->Buffer;
+	}
+
+	uint64 PackedSize = (uint64)Image->Width * Image->Height * sizeof(uint32);
+	uint32 *Packed = (uint32*)malloc(PackedSize);
+	if (!Packed)
+	{
+		LogError("RGB9E5 Texture : can't allocate %llu bytes.", (unsigned long long)PackedSize);
+		if (LevelCount > 1)
+			mip::Free(&Chain);
+		return 0;
+	}
+
+	uint32 Texture;
+	glGenTextures(1, &Texture);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, Texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, LevelCount > 1 ? MinFilter : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, MagFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, WrapS);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, WrapT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, LevelCount - 1);
+
+	GLint CurrentAlignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &CurrentAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	for (uint32 m = 0; m < LevelCount; ++m)
+	{
+		uint32 W = Max((uint32)Image->Width >> m, 1u), H = Max((uint32)Image->Height >> m, 1u);
+		convert::FloatToRGB9E5((real32 const*)Chain.Levels[m], Image->Channels, Packed, (uint64)W * H);
+		glTexImage2D(GL_TEXTURE_2D, m, GL_RGB9_E5, W, H, 0, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, Packed);
+	}
+	CheckGLError("RGB9E5 Texture");
+	free(Packed);
+	if (LevelCount > 1)
+		mip::Free(&Chain);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, CurrentAlignment);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return Texture;
+}
+
 void ComputeIrradianceCubemap(context *Context, char const *HDREnvmapFilename,
 	uint32 *HDRCubemapEnvmap, uint32 *HDRGlossyEnvmap, uint32 *HDRIrradianceEnvmap)
 {
@@ -1531,8 +3783,9 @@ void ComputeIrradianceCubemap(context *Context, char const *HDREnvmapFilename,
 
 	image *HDREnvmapImage = ResourceLoadImage(Context, HDREnvmapFilename, true);
 
-	uint32 HDRLatlongEnvmap = Make2DTexture(HDREnvmapImage->Buffer, HDREnvmapImage->Width, HDREnvmapImage->Height,
-		HDREnvmapImage->Channels, true, false, 1, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR, GL_REPEAT, GL_MIRRORED_REPEAT);
+	uint32 HDRLatlongEnvmap = MakeRGB9E5Texture(&Context->RenderResources, HDREnvmapImage, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR,
+		GL_REPEAT, GL_MIRRORED_REPEAT);
+	ResourceRelease(&Context->RenderResources, HDREnvmapImage);
 
 	mesh SkyboxCube = MakeUnitCube(false);
 
@@ -0,0 +1,115 @@
+#include "sdf.h"
+
+#include <cmath>
+
+namespace rf {
+namespace sdf {
+
+#define SDF_INF 1e20
+
+// 1D squared distance transform of the sampled function F (lower envelope of the parabolas rooted at each sample),
+// in D. V and Z are scratch buffers of N and N + 1 elements.
+static void Transform1D(double const *F, int32 N, double *D, int32 *V, double *Z)
+{
+	int32 k = 0;
+	V[0] = 0;
+	Z[0] = -SDF_INF;
+	Z[1] = SDF_INF;
+	for (int32 q = 1; q < N; ++q)
+	{
+		double s = ((F[q] + (double)q * q) - (F[V[k]] + (double)V[k] * V[k])) / (2.0 * q - 2.0 * V[k]);
+		while (s <= Z[k])
+		{
+			--k;
+			s = ((F[q] + (double)q * q) - (F[V[k]] + (double)V[k] * V[k])) / (2.0 * q - 2.0 * V[k]);
+		}
+		++k;
+		V[k] = q;
+		Z[k] = s;
+		Z[k + 1] = SDF_INF;
+	}
+
+	k = 0;
+	for (int32 q = 0; q < N; ++q)
+	{
+		while (Z[k + 1] < q)
+			++k;
+		D[q] = (double)(q - V[k]) * (q - V[k]) + F[V[k]];
+	}
+}
+
+// In place 2D squared distance transform : columns, then rows
+static void Transform2D(double *Grid, int32 Width, int32 Height, double *F, double *D, int32 *V, double *Z)
+{
+	for (int32 x = 0; x < Width; ++x)
+	{
+		for (int32 y = 0; y < Height; ++y)
+			F[y] = Grid[y * Width + x];
+		Transform1D(F, Height, D, V, Z);
+		for (int32 y = 0; y < Height; ++y)
+			Grid[y * Width + x] = D[y];
+	}
+
+	for (int32 y = 0; y < Height; ++y)
+	{
+		double *Row = Grid + (size_t)y * Width;
+		memcpy(F, Row, Width * sizeof(double));
+		Transform1D(F, Width, Row, V, Z);
+	}
+}
+
+void Generate(uint8 const *Mask, int32 Width, int32 Height, int32 Oversample, real32 Spread, uint8 *Dst,
+	int32 DstStride)
+{
+	size_t const Count = (size_t)Width * Height;
+	int32 const MaxDim = Max(Width, Height);
+
+	// Squared distance to the closest texel inside the shape, and to the closest one outside of it
+	double *Outside = (double*)malloc(2 * Count * sizeof(double));
+	double *Inside = Outside + Count;
+	for (size_t i = 0; i < Count; ++i)
+	{
+		bool In = Mask[i] >= 128;
+		Outside[i] = In ? 0.0 : SDF_INF;
+		Inside[i] = In ? SDF_INF : 0.0;
+	}
+
+	double *F = (double*)malloc((3 * MaxDim + 1) * sizeof(double));
+	double *D = F + MaxDim;
+	double *Z = D + MaxDim;
+	int32 *V = (int32*)malloc(MaxDim * sizeof(int32));
+	Transform2D(Outside, Width, Height, F, D, V, Z);
+	Transform2D(Inside, Width, Height, F, D, V, Z);
+
+	int32 const DstWidth = Width / Oversample, DstHeight = Height / Oversample;
+	real32 const Scale = 1.f / (real32)(Oversample * Oversample * Oversample);
+	for (int32 y = 0; y < DstHeight; ++y)
+	{
+		for (int32 x = 0; x < DstWidth; ++x)
+		{
+			// Signed distance in mask texels, positive outside, the edge lying halfway between an inside and an
+			// outside texel
+			real32 Sum = 0.f;
+			for (int32 sy = 0; sy < Oversample; ++sy)
+			{
+				size_t Row = (size_t)(y * Oversample + sy) * Width + x * Oversample;
+				for (int32 sx = 0; sx < Oversample; ++sx)
+				{
+					size_t i = Row + sx;
+					Sum += Outside[i] > 0.0 ? (real32)sqrt(Outside[i]) - 0.5f : 0.5f - (real32)sqrt(Inside[i]);
+				}
+			}
+
+			// Average, in field texels
+			real32 Distance = Sum * Scale;
+			real32 Value = 0.5f - Distance / (2.f * Spread);
+			Dst[y * DstStride + x] = (uint8)Min(255.f, Max(0.f, Value * 255.f + 0.5f));
+		}
+	}
+
+	free(V);
+	free(F);
+	free(Outside);
+}
+}
+}
@@ -0,0 +1,63 @@
+#include "simd.h"
+
+#ifdef RF_SSE2
+#   ifdef _MSC_VER
+#       include <intrin.h>
+#   else
+#       include <cpuid.h>
+#   endif
+#endif
+
+namespace rf {
+
+struct cpu_features
+{
+	bool SSSE3;
+	bool F16C;
+
+	cpu_features()
+	{
+		SSSE3 = F16C = false;
+#ifdef RF_SSE2
+		uint32 Regs[4] = {}; // eax, ebx, ecx, edx
+#   ifdef _MSC_VER
+		__cpuid((int*)Regs, 1);
+#   else
+		__get_cpuid(1, &Regs[0], &Regs[1], &Regs[2], &Regs[3]);
+#   endif
+		SSSE3 = (Regs[2] & (1 << 9)) != 0;
+
+		// NOTE - The F16C instructions are VEX-encoded : they also need the OS to save the AVX registers (OSXSAVE + XCR0)
+		bool AVX = (Regs[2] & (1 << 28)) && (Regs[2] & (1 << 27));
+		if (AVX)
+		{
+#   ifdef _MSC_VER
+			uint64 XCR0 = _xgetbv(0);
+#   else
+			uint32 Lo, Hi;
+			__asm__ volatile("xgetbv" : "=a"(Lo), "=d"(Hi) : "c"(0));
+			uint64 XCR0 = ((uint64)Hi << 32) | Lo;
+#   endif
+			AVX = (XCR0 & 6) == 6;
+		}
+		F16C = AVX && (Regs[2] & (1 << 29));
+#endif
+	}
+};
+
+static cpu_features const &Features()
+{
+	static cpu_features Features;
+	return Features;
+}
+
+bool simd::HasSSSE3()
+{
+	return Features().SSSE3;
+}
+
+bool simd::HasF16C()
+{
+	return Features().F16C;
+}
+}
@@ -0,0 +1,167 @@
+#include "streambuf.h"
+#include "render.h"
+#include "log.h"
+
+namespace rf {
+namespace streambuf {
+
+#define STREAM_BUFFER_ALIGNMENT 256     // of the regions, enough for any binding offset
+#define STREAM_BUFFER_FENCE_TIMEOUT 1000000000ull  // ns
+
+// The buffer is only bound to GL_COPY_WRITE_BUFFER here, the other targets being VAO or drawing state
+static void CreateStorage(stream_buffer *Stream)
+{
+	glGenBuffers(1, &Stream->Buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, Stream->Buffer);
+
+	Stream->Mapping = NULL;
+	if (Stream->Persistent)
+	{
+		GLbitfield const Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		size_t const Size = STREAM_BUFFER_FRAMES * Stream->RegionSize;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, Size, NULL, Flags);
+		Stream->Mapping = (uint8*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, Size, Flags);
+		if (!Stream->Mapping)
+		{
+			// The storage is immutable, orphaning needs a new buffer
+			LogError("Stream buffer : persistent mapping failed, falling back to orphaning");
+			glDeleteBuffers(1, &Stream->Buffer);
+			glGenBuffers(1, &Stream->Buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, Stream->Buffer);
+			Stream->Persistent = false;
+		}
+	}
+
+	if (!Stream->Persistent)
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, Stream->RegionSize, NULL, GL_STREAM_DRAW);
+		Stream->Mapping = (uint8*)malloc(Stream->RegionSize);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	CheckGLError("Stream Buffer");
+
+	Stream->Region = 0;
+	Stream->Head = 0;
+	Stream->Flushed = 0;
+}
+
+static void DestroyStorage(stream_buffer *Stream)
+{
+	for (uint32 i = 0; i < STREAM_BUFFER_FRAMES; ++i)
+	{
+		if (Stream->Fences[i])
+		{
+			glDeleteSync(Stream->Fences[i]);
+			Stream->Fences[i] = 0;
+		}
+	}
+
+	if (Stream->Persistent)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, Stream->Buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	else
+	{
+		free(Stream->Mapping);
+	}
+	Stream->Mapping = NULL;
+
+	// The GPU may still read it : GL keeps the storage alive until then
+	glDeleteBuffers(1, &Stream->Buffer);
+	Stream->Buffer = 0;
+}
+
+// Waits for the GPU to be done with the draws reading the current region, fenced STREAM_BUFFER_FRAMES frames ago
+static void WaitRegion(stream_buffer *Stream)
+{
+	GLsync &Fence = Stream->Fences[Stream->Region];
+	if (!Fence)
+		return;
+
+	GLenum Status = glClientWaitSync(Fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_BUFFER_FENCE_TIMEOUT);
+	while (Status == GL_TIMEOUT_EXPIRED)
+		Status = glClientWaitSync(Fence, 0, STREAM_BUFFER_FENCE_TIMEOUT);
+	if (Status == GL_WAIT_FAILED)
+		LogError("Stream buffer : fence wait failed");
+
+	glDeleteSync(Fence);
+	Fence = 0;
+}
+
+void Init(stream_buffer *Stream, size_t RegionSize)
+{
+	*Stream = stream_buffer();
+	Stream->Persistent = GLEW_ARB_buffer_storage || GLEW_VERSION_4_4;
+	Stream->RegionSize = (RegionSize + STREAM_BUFFER_ALIGNMENT - 1) & ~(size_t)(STREAM_BUFFER_ALIGNMENT - 1);
+	CreateStorage(Stream);
+}
+
+void Destroy(stream_buffer *Stream)
+{
+	DestroyStorage(Stream);
+}
+
+void Reserve(stream_buffer *Stream, size_t Size)
+{
+	if (Stream->Head + Size <= Stream->RegionSize)
+		return;
+
+	size_t const RegionSize = (Size + STREAM_BUFFER_ALIGNMENT - 1) & ~(size_t)(STREAM_BUFFER_ALIGNMENT - 1);
+	Stream->RegionSize = Max(RegionSize, 2 * Stream->RegionSize);
+	DestroyStorage(Stream);
+	CreateStorage(Stream);
+}
+
+void *Alloc(stream_buffer *Stream, size_t Size, size_t Alignment, size_t *Offset)
+{
+	size_t const Start = (Stream->Head + Alignment - 1) & ~(Alignment - 1);
+	if (Start + Size > Stream->RegionSize)
+		return NULL;
+	Stream->Head = Start + Size;
+
+	if (Stream->Persistent)
+	{
+		*Offset = Stream->Region * Stream->RegionSize + Start;
+		return Stream->Mapping + *Offset;
+	}
+
+	*Offset = Start;
+	return Stream->Mapping + Start;
+}
+
+void Flush(stream_buffer *Stream)
+{
+	// The persistent mapping is coherent : the writes are seen by the commands issued after them
+	if (Stream->Persistent || Stream->Head == Stream->Flushed)
+		return;
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, Stream->Buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, Stream->Flushed, Stream->Head - Stream->Flushed,
+		(GLvoid*)(Stream->Mapping + Stream->Flushed));
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	Stream->Flushed = Stream->Head;
+}
+
+void EndFrame(stream_buffer *Stream)
+{
+	if (Stream->Persistent)
+	{
+		Stream->Fences[Stream->Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		Stream->Region = (Stream->Region + 1) % STREAM_BUFFER_FRAMES;
+		WaitRegion(Stream);
+	}
+	else
+	{
+		// Orphaning : the driver gives new storage to the buffer, the draws in flight keep the previous one
+		glBindBuffer(GL_COPY_WRITE_BUFFER, Stream->Buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, Stream->RegionSize, NULL, GL_STREAM_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	Stream->Head = 0;
+	Stream->Flushed = 0;
+}
+}
+}
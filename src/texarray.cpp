@@ -0,0 +1,329 @@
+#include "texarray.h"
+#include "render.h"
+#include "convert.h"
+#include "mip.h"
+#include "log.h"
+
+namespace rf {
+
+#define TEXARRAY_INITIAL_LAYERS 4
+
+// Sized internal format (needed by glTexStorage3D) and upload format/type of the images added to an array
+static void ArrayFormats(texture_array const *Array, GLenum *InternalFormat, GLenum *Format, GLenum *Type)
+{
+	static GLenum const Formats[4] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	static GLenum const Unorm[4] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+	static GLenum const Half[4] = { GL_R16F, GL_RG16F, GL_RGB16F, GL_RGBA16F };
+	static GLenum const Float[4] = { GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F };
+
+	uint32 c = Array->Channels - 1;
+	*Format = Formats[c];
+	if (!Array->IsFloat)
+	{
+		*InternalFormat = Unorm[c];
+		*Type = GL_UNSIGNED_BYTE;
+	}
+	else if (Array->FloatHalfPrecision)
+	{
+		*InternalFormat = Half[c];
+		*Type = GL_HALF_FLOAT;
+	}
+	else
+	{
+		*InternalFormat = Float[c];
+		*Type = GL_FLOAT;
+	}
+}
+
+// Allocates the storage of the array's GL texture for LayerCapacity layers. Immutable with ARB_texture_storage,
+// otherwise each level is specified, with the max level set for the texture to be complete.
+static uint32 MakeArrayTexture(texture_array const *Array)
+{
+	GLenum InternalFormat, Format, Type;
+	ArrayFormats(Array, &InternalFormat, &Format, &Type);
+
+	uint32 Texture;
+	glGenTextures(1, &Texture);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, Texture);
+	if (GLEW_ARB_texture_storage || GLEW_VERSION_4_2)
+	{
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, Array->LevelCount, InternalFormat, Array->Width, Array->Height,
+			Array->LayerCapacity);
+	}
+	else
+	{
+		for (uint32 m = 0; m < Array->LevelCount; ++m)
+		{
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, m, InternalFormat, Max(Array->Width >> m, 1u), Max(Array->Height >> m, 1u),
+				Array->LayerCapacity, 0, Format, Type, NULL);
+		}
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, Array->LevelCount - 1);
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, Array->MinFilter);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, Array->MagFilter);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, Array->WrapS);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, Array->WrapT);
+	glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, Array->AnisotropicLevel);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	CheckGLError("TextureArray Storage");
+
+	return Texture;
+}
+
+// Doubles the layer capacity : new storage, where the layers in use are copied
+static bool GrowArray(texture_array_pool *Pool, texture_array *Array)
+{
+	if (Array->LayerCapacity >= Pool->MaxLayers)
+		return false;
+
+	uint32 OldTexture = Array->Texture, OldCapacity = Array->LayerCapacity;
+	Array->LayerCapacity = Min(Array->LayerCapacity * 2, Pool->MaxLayers);
+	Array->Texture = MakeArrayTexture(Array);
+
+	if (GLEW_ARB_copy_image || GLEW_VERSION_4_3)
+	{
+		for (uint32 m = 0; m < Array->LevelCount; ++m)
+		{
+			glCopyImageSubData(OldTexture, GL_TEXTURE_2D_ARRAY, m, 0, 0, 0, Array->Texture, GL_TEXTURE_2D_ARRAY, m, 0, 0, 0,
+				Max(Array->Width >> m, 1u), Max(Array->Height >> m, 1u), Array->LayerCount);
+		}
+	}
+	else
+	{
+		// The layers make a round trip through the CPU, once per level for all the layers
+		GLenum InternalFormat, Format, Type;
+		ArrayFormats(Array, &InternalFormat, &Format, &Type);
+		uint64 const PixelSize = Array->Channels * (!Array->IsFloat ? 1 : Array->FloatHalfPrecision ? 2 : 4);
+		uint8 *Pixels = (uint8*)malloc((uint64)Array->Width * Array->Height * OldCapacity * PixelSize);
+		if (!Pixels)
+		{
+			LogError("Texture array : can't allocate the copy of the %ux%u array.", Array->Width, Array->Height);
+			glDeleteTextures(1, &Array->Texture);
+			Array->Texture = OldTexture;
+			Array->LayerCapacity = OldCapacity;
+			return false;
+		}
+
+		GLint PackAlignment, UnpackAlignment;
+		glGetIntegerv(GL_PACK_ALIGNMENT, &PackAlignment);
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &UnpackAlignment);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (uint32 m = 0; m < Array->LevelCount; ++m)
+		{
+			uint32 Width = Max(Array->Width >> m, 1u), Height = Max(Array->Height >> m, 1u);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, OldTexture);
+			glGetTexImage(GL_TEXTURE_2D_ARRAY, m, Format, Type, Pixels);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, Array->Texture);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, m, 0, 0, 0, Width, Height, Array->LayerCount, Format, Type, Pixels);
+		}
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		glPixelStorei(GL_PACK_ALIGNMENT, PackAlignment);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, UnpackAlignment);
+		free(Pixels);
+	}
+	CheckGLError("TextureArray Grow");
+	glDeleteTextures(1, &OldTexture);
+
+	return true;
+}
+
+// Converts the level to the array's upload format (see UploadTexImage2D) and copies it in the layer
+static void UploadLayerLevel(texture_array const *Array, uint32 Layer, uint32 Level, void const *Pixels, void **Buffer)
+{
+	GLenum InternalFormat, Format, Type;
+	ArrayFormats(Array, &InternalFormat, &Format, &Type);
+	uint32 Width = Max(Array->Width >> Level, 1u), Height = Max(Array->Height >> Level, 1u);
+	uint64 Count = (uint64)Width * Height;
+	GLint Alignment = (Array->IsFloat || Array->Channels == 4) ? 4 : 1;
+
+	if (Array->IsFloat && Array->FloatHalfPrecision)
+	{
+		if (!*Buffer)
+			*Buffer = malloc((uint64)Array->Width * Array->Height * Array->Channels * sizeof(uint16));
+		convert::FloatToHalf((real32 const*)Pixels, (uint16*)*Buffer, Count * Array->Channels);
+		Pixels = *Buffer;
+		Alignment = 2;
+	}
+	else if (!Array->IsFloat && Array->Channels == 3)
+	{
+		if (!*Buffer)
+			*Buffer = malloc((uint64)Array->Width * Array->Height * 4);
+		convert::RGB8ToRGBA8((uint8 const*)Pixels, (uint8*)*Buffer, Count);
+		Pixels = *Buffer;
+		Format = GL_RGBA;
+		Alignment = 4;
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, Alignment);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, Level, 0, 0, Layer, Width, Height, 1, Format, Type, Pixels);
+}
+
+void texarray::Init(texture_array_pool *Pool, render_resources *RenderResources)
+{
+	Pool->RenderResources = RenderResources;
+	Pool->Arrays = Buf<texture_array>(RenderResources->Pool, 8);
+
+	GLint MaxLayers = 256;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &MaxLayers);
+	Pool->MaxLayers = (uint32)MaxLayers;
+
+	uint8 const White[3] = { 255, 255, 255 }, Normal[3] = { 127, 127, 255 }, Black[3] = { 0, 0, 0 };
+	Pool->DefaultDiffuse = texarray::Add(Pool, White, 1, 1, 3, false, false, false, 1.f, GL_LINEAR, GL_LINEAR, GL_REPEAT, GL_REPEAT);
+	Pool->DefaultNormal = texarray::Add(Pool, Normal, 1, 1, 3, false, false, false, 1.f, GL_LINEAR, GL_LINEAR, GL_REPEAT, GL_REPEAT);
+	Pool->DefaultEmissive = texarray::Add(Pool, Black, 1, 1, 3, false, false, false, 1.f, GL_LINEAR, GL_LINEAR, GL_REPEAT, GL_REPEAT);
+}
+
+void texarray::Destroy(texture_array_pool *Pool)
+{
+	for (texture_array *It = Pool->Arrays; It != BufEnd(Pool->Arrays); ++It)
+	{
+		glDeleteTextures(1, &It->Texture);
+		BufFree(It->FreeLayers);
+	}
+	BufFree(Pool->Arrays);
+}
+
+static texture_array *FindArray(texture_array_pool *Pool, texture_array const *Key)
+{
+	for (texture_array *It = Pool->Arrays; It != BufEnd(Pool->Arrays); ++It)
+	{
+		if (It->Width == Key->Width && It->Height == Key->Height && It->Channels == Key->Channels &&
+			It->IsFloat == Key->IsFloat && It->FloatHalfPrecision == Key->FloatHalfPrecision &&
+			It->MagFilter == Key->MagFilter && It->MinFilter == Key->MinFilter && It->WrapS == Key->WrapS &&
+			It->WrapT == Key->WrapT && It->AnisotropicLevel == Key->AnisotropicLevel &&
+			(BufSize(It->FreeLayers) || It->LayerCount < Pool->MaxLayers))
+		{
+			return It;
+		}
+	}
+	return NULL;
+}
+
+texture_layer texarray::Add(texture_array_pool *Pool, void const *Pixels, uint32 Width, uint32 Height, uint32 Channels,
+	bool IsFloat, bool FloatHalfPrecision, bool SRGB, real32 AnisotropicLevel, int MagFilter, int MinFilter, int WrapS,
+	int WrapT)
+{
+	texture_layer Handle = {};
+	if (!Pixels || !Width || !Height || Channels < 1 || Channels > 4)
+	{
+		LogError("Texture array : invalid image (%ux%u, %u channels).", Width, Height, Channels);
+		return Handle;
+	}
+
+	texture_array Key = {};
+	Key.Width = Width;
+	Key.Height = Height;
+	Key.Channels = Channels;
+	Key.IsFloat = IsFloat;
+	Key.FloatHalfPrecision = IsFloat && FloatHalfPrecision;
+	Key.MagFilter = MagFilter;
+	Key.MinFilter = MinFilter;
+	Key.WrapS = WrapS;
+	Key.WrapT = WrapT;
+	Key.AnisotropicLevel = AnisotropicLevel;
+
+	texture_array *Array = FindArray(Pool, &Key);
+	if (!Array)
+	{
+		Key.LevelCount = (MinFilter >= GL_NEAREST_MIPMAP_NEAREST && MinFilter <= GL_LINEAR_MIPMAP_LINEAR) ?
+			Min(mip::LevelCount(Width, Height), (uint32)MIP_MAX_LEVELS) : 1;
+		Key.LayerCapacity = Min((uint32)TEXARRAY_INITIAL_LAYERS, Pool->MaxLayers);
+		Key.FreeLayers = Buf<uint32>(Pool->RenderResources->Pool);
+		Key.Texture = MakeArrayTexture(&Key);
+		BufPush(Pool->Arrays, Key);
+		Array = BufEnd(Pool->Arrays) - 1;
+	}
+
+	uint32 Layer;
+	if (BufSize(Array->FreeLayers))
+	{
+		Layer = BufPop(Array->FreeLayers);
+	}
+	else
+	{
+		if (Array->LayerCount == Array->LayerCapacity && !GrowArray(Pool, Array))
+		{
+			LogError("Texture array : can't grow the %ux%u array past %u layers.", Width, Height, Array->LayerCapacity);
+			return Handle;
+		}
+		Layer = Array->LayerCount++;
+	}
+
+	mip_chain Chain = {};
+	uint32 LevelCount = 1;
+	if (Array->LevelCount > 1 && mip::Build(&Chain, Pool->RenderResources->MipCacheDir, Pixels, Width, Height, Channels,
+		IsFloat, SRGB, Pool->RenderResources->MipFilter))
+	{
+		LevelCount = Array->LevelCount;
+	}
+	else
+	{
+		Chain.Levels[0] = Pixels;
+	}
+
+	GLint CurrentAlignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &CurrentAlignment);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, Array->Texture);
+
+	void *Buffer = NULL;
+	for (uint32 m = 0; m < LevelCount; ++m)
+	{
+		UploadLayerLevel(Array, Layer, m, Chain.Levels[m], &Buffer);
+	}
+	free(Buffer);
+	CheckGLError("TextureArray Upload");
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, CurrentAlignment);
+	if (LevelCount > 1)
+		mip::Free(&Chain);
+
+	Handle.Array = (uint32)(Array - Pool->Arrays) + 1;
+	Handle.Layer = Layer;
+	return Handle;
+}
+
+static bool SameLayer(texture_layer A, texture_layer B)
+{
+	return A.Array == B.Array && A.Layer == B.Layer;
+}
+
+void texarray::Remove(texture_array_pool *Pool, texture_layer Layer)
+{
+	if (!Layer.Array || Layer.Array > BufSize(Pool->Arrays))
+		return;
+	if (SameLayer(Layer, Pool->DefaultDiffuse) || SameLayer(Layer, Pool->DefaultNormal) ||
+		SameLayer(Layer, Pool->DefaultEmissive))
+		return;
+
+	texture_array *Array = &Pool->Arrays[Layer.Array - 1];
+	if (Layer.Layer >= Array->LayerCount)
+		return;
+	for (uint32 *It = Array->FreeLayers; It != BufEnd(Array->FreeLayers); ++It)
+	{
+		if (*It == Layer.Layer)
+		{
+			LogError("Texture array : layer %u of the %ux%u array removed twice.", Layer.Layer, Array->Width,
+				Array->Height);
+			return;
+		}
+	}
+	BufPush(Array->FreeLayers, Layer.Layer);
+}
+
+uint32 texarray::Texture(texture_array_pool const *Pool, texture_layer Layer)
+{
+	if (!Layer.Array || Layer.Array > BufSize(Pool->Arrays))
+		return 0;
+	return Pool->Arrays[Layer.Array - 1].Texture;
+}
+
+void texarray::Bind(texture_array_pool const *Pool, texture_layer Layer, uint32 TextureUnit)
+{
+	glActiveTexture(GL_TEXTURE0 + TextureUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, Texture(Pool, Layer));
+}
+}
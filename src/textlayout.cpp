@@ -0,0 +1,386 @@
+#include "textlayout.h"
+#include "utils.h"
+
+namespace rf {
+struct text_layout_pen
+{
+	real32	X;
+	uint32	GlyphCount;		// quads of the layout before the char
+};
+
+namespace textlayout {
+
+#define TEXT_LAYOUT_MIN_SLOTS 256
+
+static uint64 Mix(uint64 Key)
+{
+	// splitmix64 finalizer
+	Key ^= Key >> 30; Key *= 0xbf58476d1ce4e5b9ULL;
+	Key ^= Key >> 27; Key *= 0x94d049bb133111ebULL;
+	Key ^= Key >> 31;
+	return Key;
+}
+
+// FNV-1a hash of the text, combined with the layout parameters
+static uint64 LayoutKey(char const *Text, uint32 *TextLength, font const *Font, real32 Scale, int32 MaxWidth)
+{
+	uint64 Hash = 14695981039346656037ULL;
+	char const *C = Text;
+	for (; *C; ++C)
+	{
+		Hash ^= (uint8)*C;
+		Hash *= 1099511628211ULL;
+	}
+	*TextLength = (uint32)(C - Text);
+
+	uint32 ScaleBits;
+	memcpy(&ScaleBits, &Scale, sizeof(ScaleBits));
+	uint64 Key = Mix(Hash ^ Mix((uint64)(uintptr_t)Font) ^ Mix(((uint64)ScaleBits << 32) | (uint32)MaxWidth));
+	return Key ? Key : 1; // 0 is the empty slot key
+}
+
+// Slot holding the layout, or the empty slot where it would go
+static text_layout *FindSlot(text_layout *Slots, uint32 SlotCount, uint64 Key, font const *Font, real32 Scale,
+	int32 MaxWidth, uint32 TextLength)
+{
+	uint32 Index = (uint32)Key & (SlotCount - 1);
+	while (Slots[Index].Key)
+	{
+		text_layout const *Slot = &Slots[Index];
+		if (Slot->Key == Key && Slot->Font == Font && Slot->Scale == Scale && Slot->MaxWidth == MaxWidth &&
+			Slot->TextLength == TextLength)
+			break;
+		Index = (Index + 1) & (SlotCount - 1);
+	}
+	return &Slots[Index];
+}
+
+static bool IsUnused(text_layout_cache const *Cache, text_layout const *Layout)
+{
+	return Layout->LastUse + TEXT_LAYOUT_MAX_AGE < Cache->Frame;
+}
+
+// Re-inserts the layouts in a new table, growing it to keep it at most 1/4 full (it grows again when half full).
+// The unused layouts are dropped if DropUnused.
+static void Rehash(text_layout_cache *Cache, bool DropUnused)
+{
+	uint32 Kept = 0;
+	for (uint32 i = 0; i < Cache->SlotCount; ++i)
+	{
+		text_layout *Slot = &Cache->Slots[i];
+		if (!Slot->Key)
+			continue;
+
+		if (DropUnused && IsUnused(Cache, Slot))
+		{
+			free(Slot->Vertices);
+			free(Slot->Instances);
+			Slot->Key = 0;
+		}
+		else
+		{
+			++Kept;
+		}
+	}
+
+	uint32 NewCount = TEXT_LAYOUT_MIN_SLOTS;
+	while (Kept * 4 > NewCount)
+		NewCount *= 2;
+
+	text_layout *NewSlots = (text_layout*)calloc(NewCount, sizeof(text_layout));
+	for (uint32 i = 0; i < Cache->SlotCount; ++i)
+	{
+		text_layout const *Slot = &Cache->Slots[i];
+		if (Slot->Key)
+			*FindSlot(NewSlots, NewCount, Slot->Key, Slot->Font, Slot->Scale, Slot->MaxWidth, Slot->TextLength) = *Slot;
+	}
+
+	free(Cache->Slots);
+	Cache->Slots = NewSlots;
+	Cache->SlotCount = NewCount;
+	Cache->Count = Kept;
+}
+
+static void Reserve(text_layout *Layout, uint32 GlyphCount)
+{
+	if (Layout->Capacity < GlyphCount)
+	{
+		Layout->Capacity = Max(GlyphCount, 2 * Layout->Capacity);
+		Layout->Vertices = (real32*)realloc(Layout->Vertices,
+			(size_t)Layout->Capacity * 4 * TEXT_LAYOUT_VERTEX_SIZE * sizeof(real32));
+		Layout->Instances = (glyph_instance*)realloc(Layout->Instances, Layout->Capacity * sizeof(glyph_instance));
+	}
+}
+
+static void AddQuad(text_layout *Layout, glyph const &Glyph, uint32 Codepoint, font const *Font, real32 X, real32 Y,
+	real32 Scale)
+{
+	// NOTE - The pen is snapped to whole pixels, so that the coverage glyphs stay crisp. The glyph offsets are scaled
+	// too, so that scaled text (of SDF fonts) keeps its proportions.
+	real32 const X0 = roundf(X) + Scale * Glyph.X;
+	real32 const Y0 = Y - Scale * (Font->Ascent + Glyph.Y);
+	real32 const X1 = X0 + Scale * Glyph.CW;
+	real32 const Y1 = Y0 - Scale * Glyph.CH;
+
+	if (Layout->GlyphCount)
+	{
+		Layout->MinX = Min(Layout->MinX, X0);
+		Layout->MinY = Min(Layout->MinY, Y1);
+		Layout->MaxX = Max(Layout->MaxX, X1);
+		Layout->MaxY = Max(Layout->MaxY, Y0);
+	}
+	else
+	{
+		Layout->MinX = X0;
+		Layout->MinY = Y1;
+		Layout->MaxX = X1;
+		Layout->MaxY = Y0;
+	}
+
+	glyph_instance &Instance = Layout->Instances[Layout->GlyphCount];
+	Instance.X = X0;
+	Instance.Y = Y0;
+	Instance.Scale = Scale;
+	Instance.Rect = Codepoint - (uint32)Font->Char0;
+	Instance.Color = 0;
+
+	StoreQuad(Layout->Vertices + (size_t)Layout->GlyphCount++ * 4 * TEXT_LAYOUT_VERTEX_SIZE, X0, Y0, X1, Y1, 0.f, Glyph);
+}
+
+static void LayoutText(text_layout_cache *Cache, text_layout *Layout, char const *Text)
+{
+	font *Font = Layout->Font;
+	real32 const Scale = Layout->Scale;
+	real32 const MaxWidth = (real32)Layout->MaxWidth;
+	real32 const LineHeight = ceilf(Scale * Font->LineGap);
+
+	// A char is at least a byte, plus the 2 dots of a clamped line
+	Reserve(Layout, Layout->TextLength + 2);
+	if (Cache->ScratchCapacity < Layout->TextLength)
+	{
+		Cache->ScratchCapacity = Max(Layout->TextLength, 2 * Cache->ScratchCapacity);
+		Cache->Pens = (text_layout_pen*)realloc(Cache->Pens, Cache->ScratchCapacity * sizeof(text_layout_pen));
+		Cache->Codepoints = (uint32*)realloc(Cache->Codepoints, Cache->ScratchCapacity * sizeof(uint32));
+	}
+	uint32 const CodepointCount = UTF8Decode(Text, Layout->TextLength, Cache->Codepoints);
+
+	Layout->GlyphCount = 0;
+	Layout->LineCount = 1;
+	Layout->Width = 0.f;
+
+	real32 X = 0.f, Y = 0.f;
+	uint32 Prev = 0, PenCount = 0;
+	bool Clamped = false;
+	for (uint32 c = 0; c < CodepointCount; ++c)
+	{
+		uint32 const Codepoint = Cache->Codepoints[c];
+		if (Codepoint == '\n')
+		{
+			Layout->Width = Max(Layout->Width, X);
+			X = 0.f;
+			Y -= LineHeight;
+			++Layout->LineCount;
+			Prev = 0;
+			PenCount = 0;
+			Clamped = false;
+			continue;
+		}
+		if (Clamped)
+			continue;
+
+		text_layout_pen &Pen = Cache->Pens[PenCount++];
+		Pen.X = X;
+		Pen.GlyphCount = Layout->GlyphCount;
+
+		if (Prev)
+			X += Scale * GetFontKerning(Font, Prev, Codepoint);
+
+		// NOTE - Copied, the glyphs of dynamic fonts being only valid until the next lookup
+		glyph const Glyph = *GetFontGlyph(Font, Codepoint);
+		real32 const Advance = Scale * Glyph.AdvX;
+		if (X + Advance > MaxWidth)
+		{
+			// The last chars of the line make room for '..'
+			glyph const Dot = *GetFontGlyph(Font, '.');
+			real32 const DotAdvance = Scale * Dot.AdvX;
+			do
+			{
+				text_layout_pen const &Last = Cache->Pens[--PenCount];
+				X = Last.X;
+				Layout->GlyphCount = Last.GlyphCount;
+			} while (PenCount > 0 && X + 2.f * DotAdvance > MaxWidth);
+
+			AddQuad(Layout, Dot, '.', Font, X, Y, Scale);
+			X += DotAdvance;
+			AddQuad(Layout, Dot, '.', Font, X, Y, Scale);
+			X += DotAdvance;
+			Clamped = true;
+			continue;
+		}
+
+		if (Glyph.CW > 0 && Glyph.CH > 0)
+			AddQuad(Layout, Glyph, Codepoint, Font, X, Y, Scale);
+		X += Advance;
+		Prev = Codepoint;
+	}
+	Layout->Width = Max(Layout->Width, X);
+}
+
+void Init(text_layout_cache *Cache, render_resources *Resources)
+{
+	memset(Cache, 0, sizeof(text_layout_cache));
+	Cache->Resources = Resources;
+	Cache->FontGeneration = Resources->FontGeneration;
+	Cache->SlotCount = TEXT_LAYOUT_MIN_SLOTS;
+	Cache->Slots = (text_layout*)calloc(Cache->SlotCount, sizeof(text_layout));
+}
+
+void Destroy(text_layout_cache *Cache)
+{
+	Clear(Cache);
+	free(Cache->Slots);
+	free(Cache->Scratch.Vertices);
+	free(Cache->Scratch.Instances);
+	free(Cache->Pens);
+	free(Cache->Codepoints);
+	memset(Cache, 0, sizeof(text_layout_cache));
+}
+
+void Clear(text_layout_cache *Cache)
+{
+	for (uint32 i = 0; i < Cache->SlotCount; ++i)
+	{
+		if (Cache->Slots[i].Key)
+		{
+			free(Cache->Slots[i].Vertices);
+			free(Cache->Slots[i].Instances);
+		}
+	}
+	memset(Cache->Slots, 0, Cache->SlotCount * sizeof(text_layout));
+	Cache->Count = 0;
+}
+
+text_layout const *Get(text_layout_cache *Cache, font *Font, char const *Text, real32 Scale, int32 MaxWidth)
+{
+	// The glyphs or their texcoords may have changed, with the font pointers reused
+	if (Cache->FontGeneration != Cache->Resources->FontGeneration)
+	{
+		Clear(Cache);
+		Cache->FontGeneration = Cache->Resources->FontGeneration;
+	}
+
+	uint32 TextLength;
+	uint64 Key = LayoutKey(Text, &TextLength, Font, Scale, MaxWidth);
+
+	text_layout *Layout;
+	if (Font->Cache)
+	{
+		Layout = &Cache->Scratch;
+	}
+	else
+	{
+		Layout = FindSlot(Cache->Slots, Cache->SlotCount, Key, Font, Scale, MaxWidth, TextLength);
+		if (Layout->Key)
+		{
+			Layout->LastUse = Cache->Frame;
+			return Layout;
+		}
+
+		if (2 * (Cache->Count + 1) > Cache->SlotCount)
+		{
+			Rehash(Cache, false);
+			Layout = FindSlot(Cache->Slots, Cache->SlotCount, Key, Font, Scale, MaxWidth, TextLength);
+		}
+		++Cache->Count;
+	}
+
+	Layout->Key = Key;
+	Layout->Font = Font;
+	Layout->Scale = Scale;
+	Layout->MaxWidth = MaxWidth;
+	Layout->TextLength = TextLength;
+	Layout->LastUse = Cache->Frame;
+	LayoutText(Cache, Layout, Text);
+	return Layout;
+}
+
+void Fill(text_layout const *Layout, vec3i const &Pos, real32 *VertData, uint16 *IdxData, uint16 BaseVertex)
+{
+	real32 const PX = (real32)Pos.x, PY = (real32)Pos.y, PZ = (real32)Pos.z;
+	uint32 const GlyphCount = Layout->GlyphCount;
+	real32 const *Src = Layout->Vertices;
+	uint32 i = 0;
+
+#ifdef RF_SSE2
+	// The offset of the 5 float vertices, as seen by the 5 vectors of a quad
+	__m128 const Offset0 = _mm_setr_ps(PX, PY, PZ, 0.f);
+	__m128 const Offset1 = _mm_setr_ps(0.f, PX, PY, PZ);
+	__m128 const Offset2 = _mm_setr_ps(0.f, 0.f, PX, PY);
+	__m128 const Offset3 = _mm_setr_ps(PZ, 0.f, 0.f, PX);
+	__m128 const Offset4 = _mm_setr_ps(PY, PZ, 0.f, 0.f);
+	for (uint32 g = 0; g < GlyphCount; ++g)
+	{
+		_mm_storeu_ps(VertData + 0, _mm_add_ps(_mm_loadu_ps(Src + 0), Offset0));
+		_mm_storeu_ps(VertData + 4, _mm_add_ps(_mm_loadu_ps(Src + 4), Offset1));
+		_mm_storeu_ps(VertData + 8, _mm_add_ps(_mm_loadu_ps(Src + 8), Offset2));
+		_mm_storeu_ps(VertData + 12, _mm_add_ps(_mm_loadu_ps(Src + 12), Offset3));
+		_mm_storeu_ps(VertData + 16, _mm_add_ps(_mm_loadu_ps(Src + 16), Offset4));
+		VertData += 4 * TEXT_LAYOUT_VERTEX_SIZE;
+		Src += 4 * TEXT_LAYOUT_VERTEX_SIZE;
+	}
+
+	// Indices of 4 quads (24) in 3 stores, offset by their first vertex
+	__m128i const Quads0 = _mm_setr_epi16(0, 1, 2, 0, 2, 3, 4, 5);
+	__m128i const Quads1 = _mm_setr_epi16(6, 4, 6, 7, 8, 9, 10, 8);
+	__m128i const Quads2 = _mm_setr_epi16(10, 11, 12, 13, 14, 12, 14, 15);
+	__m128i Base = _mm_set1_epi16((short)BaseVertex);
+	__m128i const Step = _mm_set1_epi16(16);
+	for (; i + 4 <= GlyphCount; i += 4)
+	{
+		__m128i *Dst = (__m128i*)(IdxData + i * 6);
+		_mm_storeu_si128(Dst + 0, _mm_add_epi16(Quads0, Base));
+		_mm_storeu_si128(Dst + 1, _mm_add_epi16(Quads1, Base));
+		_mm_storeu_si128(Dst + 2, _mm_add_epi16(Quads2, Base));
+		Base = _mm_add_epi16(Base, Step);
+	}
+#else
+	uint32 const VertexCount = GlyphCount * 4;
+	for (uint32 v = 0; v < VertexCount; ++v)
+	{
+		VertData[0] = Src[0] + PX;
+		VertData[1] = Src[1] + PY;
+		VertData[2] = Src[2] + PZ;
+		VertData[3] = Src[3];
+		VertData[4] = Src[4];
+		VertData += TEXT_LAYOUT_VERTEX_SIZE;
+		Src += TEXT_LAYOUT_VERTEX_SIZE;
+	}
+#endif
+
+	for (; i < GlyphCount; ++i)
+	{
+		uint16 const V = (uint16)(BaseVertex + i * 4);
+		IdxData[i * 6 + 0] = V + 0; IdxData[i * 6 + 1] = V + 1; IdxData[i * 6 + 2] = V + 2;
+		IdxData[i * 6 + 3] = V + 0; IdxData[i * 6 + 4] = V + 2; IdxData[i * 6 + 5] = V + 3;
+	}
+}
+
+void FillInstances(text_layout const *Layout, vec3i const &Pos, uint32 Color, glyph_instance *Instances)
+{
+	real32 const PX = (real32)Pos.x, PY = (real32)Pos.y;
+	for (uint32 i = 0; i < Layout->GlyphCount; ++i)
+	{
+		Instances[i] = Layout->Instances[i];
+		Instances[i].X += PX;
+		Instances[i].Y += PY;
+		Instances[i].Color = Color;
+	}
+}
+
+void EndFrame(text_layout_cache *Cache)
+{
+	if (++Cache->Frame % TEXT_LAYOUT_MAX_AGE == 0 && Cache->Count)
+		Rehash(Cache, true);
+}
+}
+}
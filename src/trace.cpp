@@ -0,0 +1,197 @@
+#include "trace.h"
+#include "log.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+namespace rf {
+namespace trace {
+
+#define TRACE_ARG_SIZE 128
+
+struct trace_event
+{
+	char const	*Category;
+	char const	*Name;
+	char		Arg[TRACE_ARG_SIZE];
+	uint64		Start;
+	uint64		Duration;
+	uint32		Thread;
+};
+
+typedef std::chrono::steady_clock trace_clock;
+
+// Everything below is protected by Lock, except the frame counters only used on the main thread.
+// Active is read without it to skip the work early, but only cleared under it and re-checked there
+static std::atomic<bool>		Active(false);
+static trace_clock::time_point	Origin;
+static path						Filename;
+static uint32					FramesToRecord = 1;
+static uint32					FrameCount = 0;
+static uint64					FrameStart = 0;
+
+static std::mutex				Lock;
+static trace_event				*Events = nullptr;
+static uint32					EventCount = 0;
+static uint32					EventCapacity = 0;
+static uint32					ThreadCount = 0;
+
+// Small sequential thread ids, in order of first recorded span (the main thread is 0, it records the init spans)
+static uint32 ThreadIndex()
+{
+	static thread_local uint32 Index = ~0u;
+	if (Index == ~0u)
+	{
+		Index = ThreadCount++;
+	}
+	return Index;
+}
+
+void Init()
+{
+	char const *Output = getenv("RF_TRACE");
+	if (!Output || !Output[0])
+		return;
+
+	strncpy(Filename, Output, MAX_PATH - 1);
+	char const *Frames = getenv("RF_TRACE_FRAMES");
+	FramesToRecord = Frames ? (uint32)atoi(Frames) : 1;
+
+	Origin = trace_clock::now();
+	Active = true;
+	std::lock_guard<std::mutex> Guard(Lock);
+	ThreadIndex();
+}
+
+bool IsActive()
+{
+	return Active;
+}
+
+uint64 Now()
+{
+	if (!Active)
+		return 0;
+	// NOTE - +1 so that a span started right at Init isn't mistaken for a disabled one
+	return 1 + (uint64)std::chrono::duration_cast<std::chrono::microseconds>(trace_clock::now() - Origin).count();
+}
+
+void Span(char const *Category, char const *Name, char const *Arg, uint64 Start)
+{
+	if (!Active || !Start)
+		return;
+	uint64 End = Now();
+
+	std::lock_guard<std::mutex> Guard(Lock);
+	// Dump can have cleared Active since the check above, don't record after the events were written out
+	if (!Active)
+		return;
+	if (EventCount == EventCapacity)
+	{
+		uint32 NewCapacity = Max(256u, EventCapacity * 2);
+		trace_event *NewEvents = (trace_event*)realloc(Events, NewCapacity * sizeof(trace_event));
+		if (!NewEvents)
+			return;
+		Events = NewEvents;
+		EventCapacity = NewCapacity;
+	}
+
+	trace_event *Event = &Events[EventCount++];
+	Event->Category = Category;
+	Event->Name = Name;
+	Event->Arg[0] = 0;
+	if (Arg)
+	{
+		strncpy(Event->Arg, Arg, TRACE_ARG_SIZE - 1);
+		Event->Arg[TRACE_ARG_SIZE - 1] = 0;
+	}
+	Event->Start = Start;
+	Event->Duration = End - Start;
+	Event->Thread = ThreadIndex();
+}
+
+void FrameMark()
+{
+	if (!Active)
+		return;
+
+	if (FrameStart)
+	{
+		char Arg[16];
+		snprintf(Arg, sizeof(Arg), "%u", FrameCount);
+		Span("frame", "Frame", Arg, FrameStart);
+		if (++FrameCount == FramesToRecord)
+		{
+			Dump();
+			return;
+		}
+	}
+	FrameStart = Now();
+}
+
+// Writes Str as a JSON string, with quotes
+static void WriteJSONString(FILE *fp, char const *Str)
+{
+	fputc('"', fp);
+	for (; *Str; ++Str)
+	{
+		unsigned char c = (unsigned char)*Str;
+		if (c == '"' || c == '\\')
+			fprintf(fp, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(fp, "\\u%04x", c);
+		else
+			fputc(c, fp);
+	}
+	fputc('"', fp);
+}
+
+void Dump()
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	if (!Active)
+		return;
+	Active = false;
+
+	FILE *fp = fopen(Filename, "wb");
+	if (!fp)
+	{
+		LogError("Can't write the trace file %s.", Filename);
+	}
+	else
+	{
+		fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		for (uint32 t = 0; t < ThreadCount; ++t)
+		{
+			fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+				t ? ",\n" : "", t, t ? "rf thread" : "rf main", t);
+		}
+		for (uint32 i = 0; i < EventCount; ++i)
+		{
+			trace_event const *Event = &Events[i];
+			fprintf(fp, ",\n{\"name\":");
+			WriteJSONString(fp, Event->Name);
+			fprintf(fp, ",\"cat\":");
+			WriteJSONString(fp, Event->Category);
+			fprintf(fp, ",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":1,\"tid\":%u", (unsigned long long)Event->Start,
+				(unsigned long long)Event->Duration, Event->Thread);
+			if (Event->Arg[0])
+			{
+				fprintf(fp, ",\"args\":{\"arg\":");
+				WriteJSONString(fp, Event->Arg);
+				fprintf(fp, "}");
+			}
+			fprintf(fp, "}");
+		}
+		fprintf(fp, "\n]}\n");
+		fclose(fp);
+		LogInfo("Trace of %u spans written to %s", EventCount, Filename);
+	}
+
+	free(Events);
+	Events = nullptr;
+	EventCount = EventCapacity = 0;
+}
+}
+}
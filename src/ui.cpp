@@ -2,6 +2,9 @@
 #include "ui_theme.h"
 #include "utils.h"
 #include "context.h"
+#include "glyphcache.h"
+#include "textlayout.h"
+#include "streambuf.h"
 
 
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -26,6 +29,7 @@ struct input_state
 	int16  Priority;
 };
 
+static text_layout_cache TextLayouts;		// layouts of the labels drawn in the last frames
 static mem_pool		*FramePool = nullptr;		// used memory pool for the frame (should be scratch_pool always, kept for reuse ease)
 
 static uint16       PanelCount;                 // Total number of panels ever registered
@@ -44,16 +48,30 @@ static bool         ResizeHold;
 
 static int16        LastRootWidget;             // Address of the last widget not attached to anything
 
-static uint32       Program, ProgramRGBTexture;
-static uint32       ColorUniformLoc;
+// Rect of a panel the last frame it was begun, for the panels under it to know if they are hidden (only the rects
+// of the current frame are used)
+struct panel_cover
+{
+	vec2i   TL, BR;
+	bool    Opaque;
+	uint64  Frame;
+};
+static panel_cover  PanelCovers[UI_MAX_PANELS];
+static bool         PanelCulled[UI_MAX_PANELS]; // off-screen, or under an opaque panel : nothing drawn
+static uint64       FrameIndex;
+
+static uint32       Program, ProgramRGBTexture, ProgramSDFText;
+static uint32       ProgramGlyphs, ProgramSDFGlyphs;    // instanced text
 static uint32       VAO;
-static uint32       VBO[2];
+static uint32       GlyphVAO;                   // glyph_instance attributes, one instance per glyph
+static stream_buffer FrameStream;              // ui_vertex, indices and glyph_instance of the frame
 
 // NOTE - This is what is stored each frame in scratch Memory
 // It stacks draw commands with this layout :
 // 1 render_info
 // 1 array of vertex
 // 1 array of uint16 for the indices
+// 1 array of glyph_instance, for the text drawn instanced (no vertices nor indices then)
 static void         *RenderCmd[UI_MAX_PANELS];
 static uint32       RenderCmdCount[UI_MAX_PANELS];
 static mem_arena	RenderCmdArena[UI_MAX_PANELS];
@@ -74,7 +92,9 @@ struct render_info
 {
 	uint32      VertexCount;
 	uint32      IndexCount;
+	uint32      InstanceCount;
 	uint32      TextureID;
+	uint32      GlyphRectsID;   // texture buffer of the glyph rects of instanced text
 	col4f       Color;
 	void        *ID;
 	void        *ParentID;
@@ -90,6 +110,47 @@ struct vertex
 	vec2f Texcoord;
 };
 
+// Vertex of the panel geometry : the widget vertices get the color of their widget, so that widgets of different
+// colors are drawn together
+struct ui_vertex
+{
+	vec3f  Position;
+	vec2f  Texcoord;
+	uint32 Color;   // RGBA8
+};
+
+// Consecutive commands sharing their program and textures, drawn in a single call
+struct ui_batch
+{
+	uint32 Program;
+	uint32 TextureID;
+	uint32 GlyphRectsID;    // instanced text
+	uint32 First;           // first index in the panel geometry, or first instance
+	uint32 Count;           // indices, or instances
+};
+
+// What was drawn for a panel, kept on the GPU and drawn again as long as the commands of the panel don't change.
+// Buffer holds the ui_vertex of the panel, then its uint32 indices, then its glyph_instance.
+struct panel_geometry
+{
+	uint64      Hash;               // of the commands the geometry was built from, 0 : not built
+	uint32      Buffer;             // GL buffer
+	size_t      Capacity;           // bytes
+	size_t      IndexOffset;
+	size_t      InstanceOffset;
+	ui_batch    *Batches;           // malloc'ed
+	uint32      BatchCount;
+	uint32      BatchCapacity;
+	uint32      CommandCount;       // visible commands
+};
+
+#define UI_STREAM_SIZE (256 * 1024)     // initial bytes per frame of FrameStream
+
+static panel_geometry   PanelGeometry[UI_MAX_PANELS];
+static uint32           GeometryFontGeneration;     // the geometry is rebuilt when fonts change
+static uint32           LastCommandCount, LastDrawCallCount, LastRebuiltPanelCount;
+static bool             BaseInstance;               // glDrawArraysInstancedBaseInstance is available (GL 4.2)
+
 vertex UIVertex(vec3f const &Position, vec2f const &Texcoord)
 {
 	vertex V = { Position, Texcoord };
@@ -99,17 +160,24 @@ vertex UIVertex(vec3f const &Position, vec2f const &Texcoord)
 void Init(context *Context)
 {
 	ui::Context = Context;
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(2, VBO);
+	textlayout::Init(&TextLayouts, &Context->RenderResources);
+	streambuf::Init(&FrameStream, UI_STREAM_SIZE);
+	BaseInstance = GLEW_ARB_base_instance || GLEW_VERSION_4_2;
 
+	// The attribute pointers are set each frame by PointStreams, the data moving in FrameStream
+	glGenVertexArrays(1, &VAO);
 	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), 0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), (GLvoid*)sizeof(vec3f));
+	for (uint32 a = 0; a < 3; ++a)
+		glEnableVertexAttribArray(a);
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	// Instanced text : the quad corners come from gl_VertexID, the glyph from its instance
+	glGenVertexArrays(1, &GlyphVAO);
+	glBindVertexArray(GlyphVAO);
+	for (uint32 a = 0; a < 4; ++a)
+	{
+		glEnableVertexAttribArray(a);
+		glVertexAttribDivisor(a, 1);
+	}
 	glBindVertexArray(0);
 
 	Hover = { NULL, 0, 0 };
@@ -136,6 +204,26 @@ void Init(context *Context)
 	ParseUIConfig(Context, ConfigPath);
 }
 
+void Destroy()
+{
+	for (uint32 p = 0; p < UI_MAX_PANELS; ++p)
+	{
+		glDeleteBuffers(1, &PanelGeometry[p].Buffer);
+		free(PanelGeometry[p].Batches);
+		PanelGeometry[p] = panel_geometry();
+	}
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteVertexArrays(1, &GlyphVAO);
+	glDeleteProgram(Program);
+	glDeleteProgram(ProgramRGBTexture);
+	glDeleteProgram(ProgramSDFText);
+	glDeleteProgram(ProgramGlyphs);
+	glDeleteProgram(ProgramSDFGlyphs);
+	streambuf::Destroy(&FrameStream);
+	textlayout::Destroy(&TextLayouts);
+	FontAtlasDestroy(&ThemeAtlas);
+}
+
 bool HasFocus()
 {
 	return Hover.ID != NULL;
@@ -148,13 +236,16 @@ void ReloadShaders(context *Context)
 
 		"layout(location=0) in vec3 position;\n"
 		"layout(location=1) in vec2 texcoord;\n"
+		"layout(location=2) in vec4 color;\n"
 
 		"uniform mat4 ProjMatrix;\n"
 
 		"out vec2 v_texcoord;\n"
+		"out vec4 v_color;\n"
 
 		"void main(){\n"
 		"    v_texcoord = texcoord;\n"
+		"    v_color = color;\n"
 		"    gl_Position = ProjMatrix * vec4(position, 1.0);\n"
 		"}";
 
@@ -162,18 +253,36 @@ void ReloadShaders(context *Context)
 		"#version 400\n"
 
 		"in vec2 v_texcoord;\n"
+		"in vec4 v_color;\n"
 
 		"uniform sampler2D Texture0;\n"
-		"uniform vec4 Color;\n"
 
 		"out vec4 frag_color;\n"
 
 		"void main() {\n"
 		"    vec4 TexValue = texture(Texture0, v_texcoord);\n"
-		"    frag_color = Color;\n"
+		"    frag_color = v_color;\n"
 		"    frag_color.a *= TexValue.r;\n"
 		"}";
 
+	// Distance fields are 0.5 on the glyph edges, the edge being smoothed over about one screen pixel
+	static char const *FSSDFTextSrc =
+		"#version 400\n"
+
+		"in vec2 v_texcoord;\n"
+		"in vec4 v_color;\n"
+
+		"uniform sampler2D Texture0;\n"
+
+		"out vec4 frag_color;\n"
+
+		"void main() {\n"
+		"    float Distance = texture(Texture0, v_texcoord).r;\n"
+		"    float Smoothing = max(fwidth(Distance) * 0.75, 1e-4);\n"
+		"    frag_color = v_color;\n"
+		"    frag_color.a *= smoothstep(0.5 - Smoothing, 0.5 + Smoothing, Distance);\n"
+		"}";
+
 	static char const *FSTexRGBSrc =
 		"#version 400\n"
 
@@ -188,6 +297,63 @@ void ReloadShaders(context *Context)
 		"    frag_color = texture(Texture0, v_texcoord);\n"
 		"}";
 
+	// One instance per glyph, drawn as a 4 vertex strip (TL, BL, TR, BR) : the quad is the glyph size in the font
+	// rect table times the instance scale, from the instance top-left corner (y up)
+	static char const *VSGlyphsSrc =
+		"#version 400\n"
+
+		"layout(location=0) in vec2 position;\n"
+		"layout(location=1) in float scale;\n"
+		"layout(location=2) in uint rect;\n"
+		"layout(location=3) in vec4 color;\n"
+
+		"uniform mat4 ProjMatrix;\n"
+		"uniform samplerBuffer GlyphRects;\n"
+
+		"out vec2 v_texcoord;\n"
+		"out vec4 v_color;\n"
+
+		"void main(){\n"
+		"    vec4 Texcoords = texelFetch(GlyphRects, int(rect) * 2);\n"
+		"    vec2 Size = texelFetch(GlyphRects, int(rect) * 2 + 1).xy * scale;\n"
+		"    vec2 Corner = vec2(gl_VertexID >> 1, gl_VertexID & 1);\n"
+		"    v_texcoord = mix(Texcoords.xy, Texcoords.zw, Corner);\n"
+		"    v_color = color;\n"
+		"    gl_Position = ProjMatrix * vec4(position + vec2(Corner.x, -Corner.y) * Size, 0.0, 1.0);\n"
+		"}";
+
+	static char const *FSGlyphsSrc =
+		"#version 400\n"
+
+		"in vec2 v_texcoord;\n"
+		"in vec4 v_color;\n"
+
+		"uniform sampler2D Texture0;\n"
+
+		"out vec4 frag_color;\n"
+
+		"void main() {\n"
+		"    frag_color = v_color;\n"
+		"    frag_color.a *= texture(Texture0, v_texcoord).r;\n"
+		"}";
+
+	static char const *FSSDFGlyphsSrc =
+		"#version 400\n"
+
+		"in vec2 v_texcoord;\n"
+		"in vec4 v_color;\n"
+
+		"uniform sampler2D Texture0;\n"
+
+		"out vec4 frag_color;\n"
+
+		"void main() {\n"
+		"    float Distance = texture(Texture0, v_texcoord).r;\n"
+		"    float Smoothing = max(fwidth(Distance) * 0.75, 1e-4);\n"
+		"    frag_color = v_color;\n"
+		"    frag_color.a *= smoothstep(0.5 - Smoothing, 0.5 + Smoothing, Distance);\n"
+		"}";
+
 	// free programs if they already exist
 	if (Program)
 		glDeleteProgram(Program);
@@ -195,10 +361,18 @@ void ReloadShaders(context *Context)
 	if (ProgramRGBTexture)
 		glDeleteProgram(ProgramRGBTexture);
 
+	if (ProgramSDFText)
+		glDeleteProgram(ProgramSDFText);
+
+	if (ProgramGlyphs)
+		glDeleteProgram(ProgramGlyphs);
+
+	if (ProgramSDFGlyphs)
+		glDeleteProgram(ProgramSDFGlyphs);
+
 	Program = BuildShaderFromSource(Context, VSSrc, FSSrc);
 	glUseProgram(Program);
 	SendInt(glGetUniformLocation(Program, "Texture0"), 0);
-	ColorUniformLoc = glGetUniformLocation(Program, "Color");
 	ctx::RegisterShader2D(Context, Program);
 
 	ProgramRGBTexture = BuildShaderFromSource(Context, VSSrc, FSTexRGBSrc);
@@ -206,6 +380,27 @@ void ReloadShaders(context *Context)
 	SendInt(glGetUniformLocation(ProgramRGBTexture, "Texture0"), 0);
 	ctx::RegisterShader2D(Context, ProgramRGBTexture);
 
+	ProgramSDFText = BuildShaderFromSource(Context, VSSrc, FSSDFTextSrc);
+	glUseProgram(ProgramSDFText);
+	SendInt(glGetUniformLocation(ProgramSDFText, "Texture0"), 0);
+	ctx::RegisterShader2D(Context, ProgramSDFText);
+
+	ProgramGlyphs = BuildShaderFromSource(Context, VSGlyphsSrc, FSGlyphsSrc);
+	glUseProgram(ProgramGlyphs);
+	SendInt(glGetUniformLocation(ProgramGlyphs, "Texture0"), 0);
+	SendInt(glGetUniformLocation(ProgramGlyphs, "GlyphRects"), 1);
+	ctx::RegisterShader2D(Context, ProgramGlyphs);
+
+	ProgramSDFGlyphs = BuildShaderFromSource(Context, VSGlyphsSrc, FSSDFGlyphsSrc);
+	glUseProgram(ProgramSDFGlyphs);
+	SendInt(glGetUniformLocation(ProgramSDFGlyphs, "Texture0"), 0);
+	SendInt(glGetUniformLocation(ProgramSDFGlyphs, "GlyphRects"), 1);
+	ctx::RegisterShader2D(Context, ProgramSDFGlyphs);
+
+	// The retained batches hold the names of the previous programs
+	for (uint32 p = 0; p < UI_MAX_PANELS; ++p)
+		PanelGeometry[p].Hash = 0;
+
 	CheckGLError("UI Shader");
 }
 
@@ -223,6 +418,7 @@ void BeginFrame(input *Input)
 		RenderCmd[p] = ArenaReserve(&RenderCmdArena[p], FramePool, panelStackSize);
 	}
 	memset(RenderCmdCount, 0, UI_MAX_PANELS * sizeof(uint32));
+	++FrameIndex;
 
 	ui::Input = Input;
 	ctx::SetCursor(Context, ctx::CURSOR_NORMAL);
@@ -281,6 +477,16 @@ static bool PointInTriangle(const vec2f &Point, vec2f const &A, vec2f const &B,
 	return false;
 }
 
+// Solid widgets sample the white texels of the theme atlas : bound with the same texture as the text, they are drawn
+// in the same batches
+static void MakeSolid(render_info *RenderInfo, vertex *VertData)
+{
+	vec2f const White = FontAtlasWhiteTexcoord(&ThemeAtlas);
+	RenderInfo->TextureID = ThemeAtlas.TextureID;
+	for (uint32 v = 0; v < RenderInfo->VertexCount; ++v)
+		VertData[v].Texcoord = White;
+}
+
 /// This accepts squares defined in the Top Left coordinate system (Top left of window is (0,0), Bottom right is (WinWidth, WinHeight))
 static void FillSquare(vertex *VertData, uint16 *IdxData, int V1, int I1, vec2f const &TL, vec2f const &BR,
 	vec2f const &TexOffset = vec2f(0, 0), real32 TexScale = 1.f, bool FlipY = false)
@@ -305,7 +511,6 @@ void MakeBorder(vec2f const &OrigTL, vec2f const &OrigBR)
 	RenderInfo->Type = WIDGET_BORDER;
 	RenderInfo->VertexCount = 16;
 	RenderInfo->IndexCount = 24;
-	RenderInfo->TextureID = *Context->RenderResources.DefaultDiffuseTexture;
 	RenderInfo->Color = Theme.BorderBG;
 	RenderInfo->ID = NULL;
 	RenderInfo->ParentID = ParentID[ParentLayer];
@@ -326,36 +531,30 @@ void MakeBorder(vec2f const &OrigTL, vec2f const &OrigBR)
 	BR = vec2f(OrigBR.x, OrigBR.y - UI_BORDER_WIDTH);
 	FillSquare(VertData, IdxData, 12, 18, TL, BR);
 
+	MakeSolid(RenderInfo, VertData);
 	++(RenderCmdCount[ParentPanelIdx]);
 }
 
-void MakeText(void *ID, char const *Text, theme_font FontStyle, vec2i PositionOffset, col4f const &Color, real32 FontScale, int MaxWidth)
+// RGBA8, as read by the normalized color attribute of the glyph instances
+static uint32 PackColor(col4f const &Color)
 {
-	uint32 MsgLength, VertexCount, IndexCount;
+	uint32 R = (uint32)(Min(1.f, Max(0.f, Color.r())) * 255.f + 0.5f);
+	uint32 G = (uint32)(Min(1.f, Max(0.f, Color.g())) * 255.f + 0.5f);
+	uint32 B = (uint32)(Min(1.f, Max(0.f, Color.b())) * 255.f + 0.5f);
+	uint32 A = (uint32)(Min(1.f, Max(0.f, Color.a())) * 255.f + 0.5f);
+	return R | (G << 8) | (B << 16) | (A << 24);
+}
 
+void MakeText(void *ID, char const *Text, theme_font FontStyle, vec2i PositionOffset, col4f const &Color, real32 FontScale, int MaxWidth)
+{
 	font *Font = GetFont(FontStyle);
-	if (!Font)
+	if (!Font || !*Text)
 		return;
 
-	// Test UTF8 String
-	int UTFLen = UTF8CharCount(Text);
-	if (UTFLen > 1)
-	{
-		MsgLength = UTF8Len(Text);
-		VertexCount = MsgLength * 4;
-		IndexCount = MsgLength * 6;
-	}
-	else
-	{
-		MsgLength = (uint32)strlen(Text);
-		VertexCount = (MsgLength + 1) * 4;
-		IndexCount = (MsgLength + 1) * 6;
-	}
-
-	if (UTFLen <= 0) return;
-
 	bool const NoParent = IsRootWidget();
 	uint16 const ParentPanelIdx = LastRootWidget;
+	if (!NoParent && PanelCulled[ParentPanelIdx])
+		return;
 
 	int const Y = Context->WindowHeight;
 	render_info const *ParentRI = GetParentRenderInfo(ParentPanelIdx);
@@ -373,32 +572,50 @@ void MakeText(void *ID, char const *Text, theme_font FontStyle, vec2i PositionOf
 	vec3i const DisplayPos = vec3i(ParentPos.x + PositionOffset.x + BorderOffset + MarginOffset,
 		Y - ParentPos.y - TitlebarOffset - MarginOffset - PositionOffset.y - BorderOffset, 0);
 
-	// Check if the panel is too small vertically to display the text
-	if ((DisplayPos.y - FontScale * Font->LineGap) <= (Y - ParentPos.y - ParentSize.y + MarginOffset + BorderOffset))
+	// Text starting below the panel isn't drawn at all, the text partially in it is cut by the panel scissor
+	if (DisplayPos.y <= (Y - ParentPos.y - ParentSize.y + MarginOffset + BorderOffset))
+		return;
+
+	text_layout const *Layout = textlayout::Get(&TextLayouts, Font, Text, FontScale, MaxWidth);
+	if (!Layout->GlyphCount)
 		return;
 
+	// The text of baked fonts is drawn instanced, 20 bytes per glyph. The glyphs of dynamic fonts have no rect table
+	// (they move in the glyph cache), and are drawn as quads.
+	uint32 const GlyphRectsID = GetFontGlyphRects(Font);
+	uint32 const InstanceCount = GlyphRectsID ? Layout->GlyphCount : 0;
+	uint32 const VertexCount = GlyphRectsID ? 0 : Layout->GlyphCount * 4;
+	uint32 const IndexCount = GlyphRectsID ? 0 : Layout->GlyphCount * 6;
+
 	render_info *RenderInfo = ArenaAlloc<render_info>(&RenderCmdArena[ParentPanelIdx], FramePool, 1);
 	vertex *VertData = ArenaAlloc<vertex>(&RenderCmdArena[ParentPanelIdx], FramePool, VertexCount);
 	uint16 *IdxData = ArenaAlloc<uint16>(&RenderCmdArena[ParentPanelIdx], FramePool, IndexCount);
-
+	glyph_instance *Instances = ArenaAlloc<glyph_instance>(&RenderCmdArena[ParentPanelIdx], FramePool, InstanceCount);
 
 	RenderInfo->Type = WIDGET_TEXT;
 	RenderInfo->VertexCount = VertexCount;
 	RenderInfo->IndexCount = IndexCount;
+	RenderInfo->InstanceCount = InstanceCount;
 	RenderInfo->TextureID = Font->AtlasTextureID;
+	RenderInfo->GlyphRectsID = GlyphRectsID;
+	RenderInfo->Flags = Font->SDFSpread ? DECORATION_SDFTEXT : DECORATION_NONE;
 	RenderInfo->Color = Color;
 	RenderInfo->ID = ID;
 	RenderInfo->ParentID = NoParent ? NULL : ParentID[ParentLayer];
 
-	if (UTFLen > 1)
-		FillDisplayTextInterleavedUTF8(Text, MsgLength, Font, DisplayPos, MaxWidth, (real32*)VertData, IdxData, FontScale);
+	// Rect of the glyph quads, y down like the widgets : the panel geometry keeps the quads overlapping it after it
+	RenderInfo->Position = vec2i((int)floorf(DisplayPos.x + Layout->MinX), (int)floorf(Y - DisplayPos.y - Layout->MaxY));
+	RenderInfo->Size = vec2i((int)ceilf(Layout->MaxX - Layout->MinX) + 1, (int)ceilf(Layout->MaxY - Layout->MinY) + 1);
+
+	if (InstanceCount)
+		textlayout::FillInstances(Layout, DisplayPos, PackColor(Color), Instances);
 	else
-		FillDisplayTextInterleaved(Text, MsgLength, Font, DisplayPos, MaxWidth, (real32*)VertData, IdxData, FontScale);
+		textlayout::Fill(Layout, DisplayPos, (real32*)VertData, IdxData);
 	++(RenderCmdCount[ParentPanelIdx]);
 
 #if 0
 	vec2f TL(DisplayPos.x, Y - DisplayPos.y);
-	vec2f BR(TL.x + GetDisplayTextWidth(Text, Font, FontScale), TL.y + FontScale * Font->LineGap);
+	vec2f BR(TL.x + Layout->Width, TL.y + FontScale * Font->LineGap);
 	MakeBorder(TL, BR);
 #endif
 }
@@ -418,7 +635,6 @@ void MakeTitlebar(void *ID, char const *PanelTitle, vec3i Position, vec2i Size,
 	RenderInfo->Type = WIDGET_TITLEBAR;
 	RenderInfo->VertexCount = 4;
 	RenderInfo->IndexCount = 6;
-	RenderInfo->TextureID = *Context->RenderResources.DefaultDiffuseTexture;
 	RenderInfo->Color = Color;
 	RenderInfo->ID = ID;
 	RenderInfo->ParentID = ParentID[ParentLayer];
@@ -427,6 +643,7 @@ void MakeTitlebar(void *ID, char const *PanelTitle, vec3i Position, vec2i Size,
 	vec2f BR((real32)Position.x + Size.x, (real32)Position.y + Size.y);
 
 	FillSquare(VertData, IdxData, 0, 0, TL, BR);
+	MakeSolid(RenderInfo, VertData);
 	++(RenderCmdCount[ParentPanelIdx]);
 
 	// Add panel title as text
@@ -436,7 +653,7 @@ void MakeTitlebar(void *ID, char const *PanelTitle, vec3i Position, vec2i Size,
 void MakeSlider(real32 *ID, real32 MinVal, real32 MaxVal)
 {
 	int16 const ParentPanelIdx = LastRootWidget;
-	if (ParentPanelIdx == 0) return;
+	if (ParentPanelIdx == 0 || PanelCulled[ParentPanelIdx]) return;
 
 	// TODO - this is pretty redundant, all this work for 2 squares...
 	// Maybe allow color attribute to vertices instead of having it uniform
@@ -449,7 +666,6 @@ void MakeSlider(real32 *ID, real32 MinVal, real32 MaxVal)
 	RenderInfo->Type = WIDGET_SLIDER;
 	RenderInfo->VertexCount = 4;
 	RenderInfo->IndexCount = 6;
-	RenderInfo->TextureID = *Context->RenderResources.DefaultDiffuseTexture;
 	RenderInfo->Color = Theme.SliderBG;
 	RenderInfo->ID = ID;
 	RenderInfo->ParentID = ParentID[ParentLayer];
@@ -464,6 +680,7 @@ void MakeSlider(real32 *ID, real32 MinVal, real32 MaxVal)
 	vec2f BR((real32)Pos.x + Size.x, (real32)Pos.y + Size.y);
 
 	FillSquare(VertData, IdxData, 0, 0, TL, BR);
+	MakeSolid(RenderInfo, VertData);
 	++(RenderCmdCount[ParentPanelIdx]);
 
 	// NOTE - Foreground slider
@@ -474,7 +691,6 @@ void MakeSlider(real32 *ID, real32 MinVal, real32 MaxVal)
 	RenderInfo->Type = WIDGET_SLIDER;
 	RenderInfo->VertexCount = 4;
 	RenderInfo->IndexCount = 6;
-	RenderInfo->TextureID = *Context->RenderResources.DefaultDiffuseTexture;
 	RenderInfo->Color = Theme.SliderFG;
 	RenderInfo->ID = ID;
 	RenderInfo->ParentID = ParentID[ParentLayer];
@@ -486,6 +702,7 @@ void MakeSlider(real32 *ID, real32 MinVal, real32 MaxVal)
 	BR = vec2f((real32)Pos.x + Size.x, (real32)Pos.y + HalfSliderHeight + Ratio * PXHeight + HalfSliderHeight);
 
 	FillSquare(VertData, IdxData, 0, 0, TL, BR);
+	MakeSolid(RenderInfo, VertData);
 	++(RenderCmdCount[ParentPanelIdx]);
 
 	//vec2i TL(ParentRI->Position.x, Y - ParentRI->Position.y);
@@ -504,7 +721,7 @@ void MakeSlider(real32 *ID, real32 MinVal, real32 MaxVal)
 void MakeProgressbar(real32 *ID, real32 MaxVal, vec2i const &PositionOffset, vec2i const &Size)
 {
 	int16 const ParentPanelIdx = LastRootWidget;
-	if (ParentPanelIdx == 0) return;
+	if (ParentPanelIdx == 0 || PanelCulled[ParentPanelIdx]) return;
 
 	// NOTE - Background Square
 	render_info *RenderInfo = ArenaAlloc<render_info>(&RenderCmdArena[ParentPanelIdx], FramePool, 1);
@@ -514,7 +731,6 @@ void MakeProgressbar(real32 *ID, real32 MaxVal, vec2i const &PositionOffset, vec
 	RenderInfo->Type = WIDGET_PROGRESSBAR;
 	RenderInfo->VertexCount = 4;
 	RenderInfo->IndexCount = 6;
-	RenderInfo->TextureID = *Context->RenderResources.DefaultDiffuseTexture;
 	RenderInfo->Color = Theme.ProgressbarBG;
 	RenderInfo->ID = ID;
 	RenderInfo->ParentID = ParentID[ParentLayer];
@@ -529,6 +745,7 @@ void MakeProgressbar(real32 *ID, real32 MaxVal, vec2i const &PositionOffset, vec
 	vec2i BR(TL.x + MaxWidth, TL.y + Size.y);
 
 	FillSquare(VertData, IdxData, 0, 0, TL + vec2i(BorderOffset), BR - vec2i(BorderOffset));
+	MakeSolid(RenderInfo, VertData);
 	++(RenderCmdCount[ParentPanelIdx]);
 
 #if 1
@@ -543,7 +760,6 @@ void MakeProgressbar(real32 *ID, real32 MaxVal, vec2i const &PositionOffset, vec
 		RenderInfo->Type = WIDGET_PROGRESSBAR;
 		RenderInfo->VertexCount = 4;
 		RenderInfo->IndexCount = 6;
-		RenderInfo->TextureID = *Context->RenderResources.DefaultDiffuseTexture;
 		RenderInfo->Color = Theme.ProgressbarFG;
 		RenderInfo->ID = ID;
 		RenderInfo->ParentID = ParentID[ParentLayer];
@@ -551,6 +767,7 @@ void MakeProgressbar(real32 *ID, real32 MaxVal, vec2i const &PositionOffset, vec
 		vec2i BRP(TL.x + (int)ceil(ProgressWidth) - BorderOffset, TL.y + Size.y - BorderOffset);
 
 		FillSquare(VertData, IdxData, 0, 0, TL + vec2i(BorderOffset), BRP);
+		MakeSolid(RenderInfo, VertData);
 		++(RenderCmdCount[ParentPanelIdx]);
 	}
 
@@ -561,7 +778,7 @@ void MakeProgressbar(real32 *ID, real32 MaxVal, vec2i const &PositionOffset, vec
 bool MakeButton(uint32 *ID, char const *ButtonText, theme_font FontStyle, vec2i const &PositionOffset, vec2i const &Size, real32 FontScale, int32 DecorationFlags)
 {
 	int16 const ParentPanelIdx = LastRootWidget;
-	if (ParentPanelIdx == 0) return false;
+	if (ParentPanelIdx == 0 || PanelCulled[ParentPanelIdx]) return false;
 
 	font *Font = GetFont(FontStyle);
 
@@ -572,7 +789,6 @@ bool MakeButton(uint32 *ID, char const *ButtonText, theme_font FontStyle, vec2i
 	RenderInfo->Type = WIDGET_BUTTON;
 	RenderInfo->VertexCount = 4;
 	RenderInfo->IndexCount = 6;
-	RenderInfo->TextureID = *Context->RenderResources.DefaultDiffuseTexture;
 	RenderInfo->Color = *ID > 0 ? Theme.ButtonPressedBG : Theme.ButtonBG;
 	RenderInfo->ID = ID;
 	RenderInfo->ParentID = ParentID[ParentLayer];
@@ -591,6 +807,7 @@ bool MakeButton(uint32 *ID, char const *ButtonText, theme_font FontStyle, vec2i
 	BR.y = Min(BR.y, MaxBR.y);
 
 	FillSquare(VertData, IdxData, 0, 0, TL, BR);
+	MakeSolid(RenderInfo, VertData);
 	++(RenderCmdCount[ParentPanelIdx]);
 
 	if (BorderOffset > 0)
@@ -601,7 +818,7 @@ bool MakeButton(uint32 *ID, char const *ButtonText, theme_font FontStyle, vec2i
 	if (Font)
 	{
 		real32 const MaxButtonTextWidth = BR.x - TL.x - 2 * UI_BORDER_WIDTH - 2 * UI_MARGIN_WIDTH;
-		real32 const TextWidth = GetDisplayTextWidth(ButtonText, Font, FontScale);
+		real32 const TextWidth = textlayout::Get(&TextLayouts, Font, ButtonText, FontScale, (int32)MaxButtonTextWidth)->Width;
 		real32 const TextMargin = (MaxButtonTextWidth - TextWidth) * 0.5f;//BR.x-TL.x - TextWidth;//(MaxButtonTextWidth-TextWidth) * 0.5f;
 		MakeText(NULL, ButtonText, FontStyle, vec2i(PositionOffset.x + (int)ceil(TextMargin) + BorderOffset + MarginOffset, PositionOffset.y + MarginOffset + BorderOffset),
 			Theme.PanelFG, FontScale, (int)MaxButtonTextWidth);
@@ -633,7 +850,7 @@ bool MakeButton(uint32 *ID, char const *ButtonText, theme_font FontStyle, vec2i
 void MakeImage(real32 *ID, uint32 TextureID, vec2f *TexOffset, vec2i const &Size, bool FlipY)
 {
 	int16 const ParentPanelIdx = LastRootWidget;
-	if (ParentPanelIdx == 0) return;
+	if (ParentPanelIdx == 0 || PanelCulled[ParentPanelIdx]) return;
 
 	render_info *RenderInfo = ArenaAlloc<render_info>(&RenderCmdArena[ParentPanelIdx], FramePool, 1);
 	vertex *VertData = ArenaAlloc<vertex>(&RenderCmdArena[ParentPanelIdx], FramePool, 4);
@@ -688,7 +905,7 @@ void MakeImage(real32 *ID, uint32 TextureID, vec2f *TexOffset, vec2i const &Size
 void MakeResizingTriangle(vec2f const &BR)
 {
 	int16 const ParentPanelIdx = LastRootWidget;
-	if (ParentPanelIdx == 0) return;
+	if (ParentPanelIdx == 0 || PanelCulled[ParentPanelIdx]) return;
 
 	render_info *RenderInfo = ArenaAlloc<render_info>(&RenderCmdArena[ParentPanelIdx], FramePool, 1);
 	vertex *VertData = ArenaAlloc<vertex>(&RenderCmdArena[ParentPanelIdx], FramePool, 3);
@@ -697,7 +914,6 @@ void MakeResizingTriangle(vec2f const &BR)
 	RenderInfo->Type = WIDGET_OTHER;
 	RenderInfo->VertexCount = 3;
 	RenderInfo->IndexCount = 3;
-	RenderInfo->TextureID = *Context->RenderResources.DefaultDiffuseTexture;
 	RenderInfo->Color = Theme.BorderBG;
 	RenderInfo->ID = NULL;
 	RenderInfo->ParentID = ParentID[ParentLayer];
@@ -708,9 +924,34 @@ void MakeResizingTriangle(vec2f const &BR)
 	VertData[0] = UIVertex(vec3f(BR.x, Y - BR.y, 0), vec2f(1.f, 1.f));
 	VertData[1] = UIVertex(vec3f(BR.x, Y - BR.y + 8.f, 0), vec2f(1.f, 1.f));
 	VertData[2] = UIVertex(vec3f(BR.x - 8.f, Y - BR.y, 0), vec2f(0.f, 1.f));
+	MakeSolid(RenderInfo, VertData);
 	++(RenderCmdCount[ParentPanelIdx]);
 }
 
+// Panels under an opaque panel drawn after them, among the panels already begun in the frame
+static bool IsPanelCovered(int16 PanelIdx, vec2i const &TL, vec2i const &BR)
+{
+	for (int16 p = 1; p < PanelCount; ++p)
+	{
+		panel_cover const &Cover = PanelCovers[p];
+		if (p != PanelIdx && PanelOrder[p] > PanelOrder[PanelIdx] && Cover.Opaque && Cover.Frame == FrameIndex &&
+			Cover.TL.x <= TL.x && Cover.TL.y <= TL.y && Cover.BR.x >= BR.x && Cover.BR.y >= BR.y)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// Panels entirely out of the window, or covered by a panel begun before them. Those covered by a panel begun after
+// them are found by ui::Draw.
+static bool IsPanelCulled(int16 PanelIdx, vec2i const &TL, vec2i const &BR)
+{
+	if (BR.x <= 0 || BR.y <= 0 || TL.x >= Context->WindowWidth || TL.y >= Context->WindowHeight)
+		return true;
+	return IsPanelCovered(PanelIdx, TL, BR);
+}
+
 void BeginPanel(uint32 *ID, char const *PanelTitle, vec3i *Position, vec2i *Size, theme_color Color, uint32 DecorationFlags)
 {
 	Assert(PanelCount < UI_MAX_PANELS);
@@ -736,8 +977,12 @@ void BeginPanel(uint32 *ID, char const *PanelTitle, vec3i *Position, vec2i *Size
 
 	ParentID[ParentLayer++] = ID;
 
+	// A culled panel still has its render_info, for its widgets and the input, but no geometry
+	vec2i const PanelTL(Position->x, Position->y), PanelBR(Position->x + Size->x, Position->y + Size->y);
+	PanelCulled[PanelIdx] = IsPanelCulled(PanelIdx, PanelTL, PanelBR);
+
 	int VCount = 4, ICount = 6;
-	if (DecorationFlags & DECORATION_INVISIBLE)
+	if ((DecorationFlags & DECORATION_INVISIBLE) || PanelCulled[PanelIdx])
 	{
 		VCount = ICount = 0;
 	}
@@ -749,7 +994,6 @@ void BeginPanel(uint32 *ID, char const *PanelTitle, vec3i *Position, vec2i *Size
 	RenderInfo->Type = WIDGET_PANEL;
 	RenderInfo->VertexCount = VCount;
 	RenderInfo->IndexCount = ICount;
-	RenderInfo->TextureID = *Context->RenderResources.DefaultDiffuseTexture;
 	RenderInfo->Color = GetColor(Color);
 	RenderInfo->ID = ID;
 	RenderInfo->ParentID = NULL;
@@ -758,14 +1002,21 @@ void BeginPanel(uint32 *ID, char const *PanelTitle, vec3i *Position, vec2i *Size
 	RenderInfo->Flags = DecorationFlags;
 	LastRootWidget = *ID;
 
+	panel_cover &Cover = PanelCovers[PanelIdx];
+	Cover.TL = PanelTL;
+	Cover.BR = PanelBR;
+	Cover.Opaque = !(DecorationFlags & DECORATION_INVISIBLE) && RenderInfo->Color.a() >= 1.f;
+	Cover.Frame = FrameIndex;
+
 	vec2f TL((real32)Position->x, (real32)Position->y);
 	vec2f BR((real32)Position->x + Size->x, (real32)Position->y + Size->y);
 
 	++(RenderCmdCount[PanelIdx]);
 
-	if (!(DecorationFlags & DECORATION_INVISIBLE))
+	if (VCount)
 	{
 		FillSquare(VertData, IdxData, 0, 0, TL, BR);
+		MakeSolid(RenderInfo, VertData);
 
 		if (DecorationFlags & DECORATION_BORDER)
 		{
@@ -877,65 +1128,413 @@ static void *RenderCmdOffset(uint8 *CmdList, size_t *OffsetAccum, size_t Size)
 	return Ptr;
 }
 
-void Draw()
+// Program a command is drawn with
+static uint32 CommandProgram(render_info const *RenderInfo)
 {
-	Update();
-	
-	uint32 CurrProgram = 0;
+	if (RenderInfo->Flags & DECORATION_RGBTEXTURE)
+		return ProgramRGBTexture;
+	if (RenderInfo->InstanceCount)
+		return (RenderInfo->Flags & DECORATION_SDFTEXT) ? ProgramSDFGlyphs : ProgramGlyphs;
+	return (RenderInfo->Flags & DECORATION_SDFTEXT) ? ProgramSDFText : Program;
+}
 
-	glDisable(GL_DEPTH_TEST);
+// Points the glyph VAO at the instances starting at InstanceOffset, leaving it bound
+static void PointGlyphs(uint32 Buffer, size_t InstanceOffset)
+{
+	glBindVertexArray(GlyphVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, Buffer);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glyph_instance), (GLvoid*)InstanceOffset);
+	glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(glyph_instance),
+		(GLvoid*)(InstanceOffset + offsetof(glyph_instance, Scale)));
+	glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(glyph_instance),
+		(GLvoid*)(InstanceOffset + offsetof(glyph_instance, Rect)));
+	glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(glyph_instance),
+		(GLvoid*)(InstanceOffset + offsetof(glyph_instance, Color)));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Points the VAOs at the vertices and instances of a panel geometry buffer
+static void PointStreams(uint32 Buffer, size_t VertexOffset, size_t InstanceOffset)
+{
 	glBindVertexArray(VAO);
-	for (int p = 0; p < PanelCount; ++p)
+	glBindBuffer(GL_ARRAY_BUFFER, Buffer);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ui_vertex), (GLvoid*)VertexOffset);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ui_vertex),
+		(GLvoid*)(VertexOffset + offsetof(ui_vertex, Texcoord)));
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ui_vertex),
+		(GLvoid*)(VertexOffset + offsetof(ui_vertex, Color)));
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Buffer);
+
+	PointGlyphs(Buffer, InstanceOffset);
+}
+
+static uint64 HashWord(uint64 Hash, uint64 Word)
+{
+	Hash = (Hash ^ Word) * 0x9E3779B97F4A7C15ULL;
+	return Hash ^ (Hash >> 32);
+}
+
+// Hash of the data of a command, 8 bytes at a time
+static uint64 HashBytes(uint64 Hash, uint8 const *Data, size_t Size)
+{
+	size_t i = 0;
+	for (; i + 8 <= Size; i += 8)
 	{
-		// we should have only one big allocated block for each panel, if we have more we are above UI_STACK_SIZE/UI_MAX_PANELS limit
-		Assert(BufSize(RenderCmdArena[p].Blocks) == 1);
+		uint64 Word;
+		memcpy(&Word, Data + i, 8);
+		Hash = HashWord(Hash, Word);
+	}
+
+	uint64 Tail = 0;
+	memcpy(&Tail, Data + i, Size - i);
+	return HashWord(Hash, Tail ^ ((uint64)Size << 56));
+}
+
+// Size of the command : its render_info, and the vertices, indices and instances following it
+static size_t CommandSize(render_info const *RenderInfo)
+{
+	return sizeof(render_info) + RenderInfo->VertexCount * sizeof(vertex) + RenderInfo->IndexCount * sizeof(uint16) +
+		RenderInfo->InstanceCount * sizeof(glyph_instance);
+}
+
+static size_t AlignGeometry(size_t Offset)
+{
+	return (Offset + 15) & ~(size_t)15;
+}
+
+// Hashes what the visible commands of the panel draw, and sizes their geometry. Hashes only the fields the geometry
+// is built from : the struct padding and the bookkeeping fields (IDs, widget rects) would change it for nothing.
+static uint64 HashPanel(int16 PanelIdx, uint32 *VertexCount, uint32 *IndexCount, uint32 *InstanceCount)
+{
+	uint64 Hash = 0xCBF29CE484222325ULL;
+	*VertexCount = *IndexCount = *InstanceCount = 0;
 
-		int16 OrdPanelIdx = RenderOrder[p];
-		uint8 *Cmd = (uint8*)RenderCmd[OrdPanelIdx];
-		for (uint32 i = 0; i < RenderCmdCount[OrdPanelIdx]; ++i)
+	uint8 const *Cmd = (uint8 const*)RenderCmd[PanelIdx];
+	for (uint32 i = 0; i < RenderCmdCount[PanelIdx]; ++i)
+	{
+		render_info const *RenderInfo = (render_info const*)Cmd;
+		if (!(RenderInfo->Flags & DECORATION_INVISIBLE))
 		{
-			size_t Offset = 0;
-			render_info *RenderInfo = (render_info*)RenderCmdOffset(Cmd, &Offset, sizeof(render_info));
-			vertex *VertData = (vertex*)RenderCmdOffset(Cmd, &Offset, RenderInfo->VertexCount * sizeof(vertex));
-			uint16 *IdxData = (uint16*)RenderCmdOffset(Cmd, &Offset, RenderInfo->IndexCount * sizeof(uint16));
+			Hash = HashWord(Hash, ((uint64)RenderInfo->VertexCount << 32) | RenderInfo->IndexCount);
+			Hash = HashWord(Hash, ((uint64)RenderInfo->InstanceCount << 32) | (uint32)RenderInfo->Flags);
+			Hash = HashWord(Hash, ((uint64)RenderInfo->TextureID << 32) | RenderInfo->GlyphRectsID);
+			Hash = HashWord(Hash, PackColor(RenderInfo->Color));
+			Hash = HashBytes(Hash, Cmd + sizeof(render_info), CommandSize(RenderInfo) - sizeof(render_info));
+
+			*VertexCount += RenderInfo->VertexCount;
+			*IndexCount += RenderInfo->IndexCount;
+			*InstanceCount += RenderInfo->InstanceCount;
+		}
+		Cmd += CommandSize(RenderInfo);
+	}
+
+	// 0 stands for no geometry
+	return Hash ? Hash : 1;
+}
 
-			if (!(RenderInfo->Flags & DECORATION_INVISIBLE))
+// Returns the end of the run of commands starting at RunStart (at *Cmd) : the first quad overlapping the instanced
+// text before it in the run. *Cmd is moved to the command ending the run.
+static uint32 FindRunEnd(int16 PanelIdx, uint32 RunStart, uint8 **Cmd)
+{
+	// Bounds of the text of the run, in window coordinates (y down) : the quad vertices are y up
+	int const Y = Context->WindowHeight;
+	vec2i TextTL(0, 0), TextBR(0, 0);
+	bool HasText = false;
+	uint32 i = RunStart;
+	for (; i < RenderCmdCount[PanelIdx]; ++i)
+	{
+		render_info const *RenderInfo = (render_info const*)*Cmd;
+		bool const Visible = !(RenderInfo->Flags & DECORATION_INVISIBLE);
+		if (Visible && RenderInfo->InstanceCount)
+		{
+			vec2i const TL = RenderInfo->Position, BR = RenderInfo->Position + RenderInfo->Size;
+			TextTL = HasText ? vec2i(Min(TextTL.x, TL.x), Min(TextTL.y, TL.y)) : TL;
+			TextBR = HasText ? vec2i(Max(TextBR.x, BR.x), Max(TextBR.y, BR.y)) : BR;
+			HasText = true;
+		}
+		else if (Visible && HasText && RenderInfo->VertexCount)
+		{
+			vertex const *VertData = (vertex const*)(*Cmd + sizeof(render_info));
+			vec2f Lo(VertData[0].Position.x, VertData[0].Position.y), Hi = Lo;
+			for (uint32 v = 1; v < RenderInfo->VertexCount; ++v)
 			{
-				// Switch program depending on rgb texture or normal UI widget
-				if (RenderInfo->Flags & DECORATION_RGBTEXTURE)
+				Lo = vec2f(Min(Lo.x, VertData[v].Position.x), Min(Lo.y, VertData[v].Position.y));
+				Hi = vec2f(Max(Hi.x, VertData[v].Position.x), Max(Hi.y, VertData[v].Position.y));
+			}
+
+			if (Lo.x < TextBR.x && Hi.x > TextTL.x && Y - Hi.y < TextBR.y && Y - Lo.y > TextTL.y)
+				break;
+		}
+		*Cmd += CommandSize(RenderInfo);
+	}
+	return i;
+}
+
+// Converts the visible commands of the panel into its geometry : written in FrameStream, then copied GPU side to the
+// panel buffer. Consecutive commands sharing their program and textures are merged in batches.
+static void BuildPanel(int16 PanelIdx, uint64 Hash, uint32 VertexCount, uint32 IndexCount, uint32 InstanceCount)
+{
+	panel_geometry *Geometry = &PanelGeometry[PanelIdx];
+	Geometry->Hash = Hash;
+	Geometry->BatchCount = 0;
+	Geometry->CommandCount = 0;
+	Geometry->IndexOffset = AlignGeometry(VertexCount * sizeof(ui_vertex));
+	Geometry->InstanceOffset = AlignGeometry(Geometry->IndexOffset + IndexCount * sizeof(uint32));
+	size_t const Size = Geometry->InstanceOffset + InstanceCount * sizeof(glyph_instance);
+	if (!Size)
+		return;
+
+	// At most one batch per command
+	if (Geometry->BatchCapacity < RenderCmdCount[PanelIdx])
+	{
+		Geometry->BatchCapacity = Max(RenderCmdCount[PanelIdx], 2 * Geometry->BatchCapacity);
+		Geometry->Batches = (ui_batch*)realloc(Geometry->Batches, Geometry->BatchCapacity * sizeof(ui_batch));
+	}
+
+	size_t StreamOffset;
+	uint8 *Dst = (uint8*)streambuf::Alloc(&FrameStream, Size, 16, &StreamOffset);
+	ui_vertex *Vertices = (ui_vertex*)Dst;
+	uint32 *Indices = (uint32*)(Dst + Geometry->IndexOffset);
+	glyph_instance *GlyphInstances = (glyph_instance*)(Dst + Geometry->InstanceOffset);
+
+	// The instanced text of a run of commands is drawn above its quads (widgets, images, text of dynamic fonts) : the
+	// solid quads, sharing the theme atlas, then make a single batch, and the text another, instead of alternating.
+	// A quad overlapping the text before it in the run ends the run, so that the overlapping commands keep their order.
+	VertexCount = IndexCount = InstanceCount = 0;
+	uint8 *RunCmd = (uint8*)RenderCmd[PanelIdx];
+	uint32 RunStart = 0;
+	while (RunStart < RenderCmdCount[PanelIdx])
+	{
+		uint8 *RunEndCmd = RunCmd;
+		uint32 RunEnd = FindRunEnd(PanelIdx, RunStart, &RunEndCmd);
+		for (uint32 Layer = 0; Layer < 2; ++Layer)
+		{
+			uint8 *Cmd = RunCmd;
+			for (uint32 i = RunStart; i < RunEnd; ++i)
+			{
+				size_t Offset = 0;
+				render_info *RenderInfo = (render_info*)RenderCmdOffset(Cmd, &Offset, sizeof(render_info));
+				vertex *VertData = (vertex*)RenderCmdOffset(Cmd, &Offset, RenderInfo->VertexCount * sizeof(vertex));
+				uint16 *IdxData = (uint16*)RenderCmdOffset(Cmd, &Offset, RenderInfo->IndexCount * sizeof(uint16));
+				glyph_instance *Instances = (glyph_instance*)RenderCmdOffset(Cmd, &Offset,
+					RenderInfo->InstanceCount * sizeof(glyph_instance));
+				Cmd += Offset;
+
+				if ((RenderInfo->Flags & DECORATION_INVISIBLE) || (RenderInfo->InstanceCount != 0) != (Layer == 1))
+					continue;
+				++Geometry->CommandCount;
+
+				uint32 First, Count;
+				if (RenderInfo->InstanceCount)
 				{
-					if (CurrProgram != ProgramRGBTexture)
-					{
-						CurrProgram = ProgramRGBTexture;
-						glUseProgram(CurrProgram);
-					}
+					First = InstanceCount;
+					Count = RenderInfo->InstanceCount;
+					memcpy(GlyphInstances + InstanceCount, Instances, Count * sizeof(glyph_instance));
+					InstanceCount += Count;
 				}
 				else
 				{
-					if (CurrProgram != Program)
+					uint32 const Color = PackColor(RenderInfo->Color);
+					for (uint32 v = 0; v < RenderInfo->VertexCount; ++v)
+					{
+						ui_vertex &V = Vertices[VertexCount + v];
+						V.Position = VertData[v].Position;
+						V.Texcoord = VertData[v].Texcoord;
+						V.Color = Color;
+					}
+					for (uint32 n = 0; n < RenderInfo->IndexCount; ++n)
 					{
-						CurrProgram = Program;
-						glUseProgram(Program);
+						Indices[IndexCount + n] = VertexCount + IdxData[n];
 					}
-					SendVec4(ColorUniformLoc, RenderInfo->Color);
+
+					First = IndexCount;
+					Count = RenderInfo->IndexCount;
+					VertexCount += RenderInfo->VertexCount;
+					IndexCount += Count;
+				}
+
+				uint32 const CmdProgram = CommandProgram(RenderInfo);
+				ui_batch *Last = Geometry->BatchCount ? &Geometry->Batches[Geometry->BatchCount - 1] : NULL;
+				if (Last && Last->Program == CmdProgram && Last->TextureID == RenderInfo->TextureID &&
+					Last->GlyphRectsID == RenderInfo->GlyphRectsID)
+				{
+					Last->Count += Count;
+				}
+				else
+				{
+					ui_batch &Batch = Geometry->Batches[Geometry->BatchCount++];
+					Batch.Program = CmdProgram;
+					Batch.TextureID = RenderInfo->TextureID;
+					Batch.GlyphRectsID = RenderInfo->GlyphRectsID;
+					Batch.First = First;
+					Batch.Count = Count;
 				}
+			}
+		}
+		RunCmd = RunEndCmd;
+		RunStart = RunEnd;
+	}
+	streambuf::Flush(&FrameStream);
+
+	if (!Geometry->Buffer)
+		glGenBuffers(1, &Geometry->Buffer);
+	glBindBuffer(GL_COPY_READ_BUFFER, FrameStream.Buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, Geometry->Buffer);
+	if (Geometry->Capacity < Size)
+	{
+		Geometry->Capacity = Max(Size, 2 * Geometry->Capacity);
+		glBufferData(GL_COPY_WRITE_BUFFER, Geometry->Capacity, NULL, GL_DYNAMIC_DRAW);
+	}
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, StreamOffset, 0, Size);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GetDrawStats(uint32 *CommandCount, uint32 *DrawCallCount, uint32 *RebuiltPanelCount)
+{
+	*CommandCount = LastCommandCount;
+	*DrawCallCount = LastDrawCallCount;
+	if (RebuiltPanelCount)
+		*RebuiltPanelCount = LastRebuiltPanelCount;
+}
+
+void Draw()
+{
+	Update();
+
+	// Uploads the glyphs of the dynamic fonts rasterized while building the frame
+	if (Context->RenderResources.GlyphCache)
+		glyphcache::Flush(Context->RenderResources.GlyphCache);
+	textlayout::EndFrame(&TextLayouts);
 
-				glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
-				glBufferData(GL_ARRAY_BUFFER, RenderInfo->VertexCount * sizeof(vertex), (GLvoid*)VertData, GL_STREAM_DRAW);
+	// Texture names are reused by GL : the geometry of texts drawn with deleted fonts can't be trusted
+	if (GeometryFontGeneration != Context->RenderResources.FontGeneration)
+	{
+		GeometryFontGeneration = Context->RenderResources.FontGeneration;
+		for (int p = 0; p < PanelCount; ++p)
+			PanelGeometry[p].Hash = 0;
+	}
 
-				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, VBO[0]);
-				glBufferData(GL_ELEMENT_ARRAY_BUFFER, RenderInfo->IndexCount * sizeof(uint16), (GLvoid*)IdxData, GL_STREAM_DRAW);
+	// Every panel has its rect for the frame now (and its final order) : hides the panels covered by a panel begun
+	// after them. Their widgets did build, but they aren't uploaded nor drawn.
+	for (int16 p = 1; p < PanelCount; ++p)
+	{
+		panel_cover const &Cover = PanelCovers[p];
+		if (!PanelCulled[p] && Cover.Frame == FrameIndex)
+			PanelCulled[p] = IsPanelCovered(p, Cover.TL, Cover.BR);
+	}
 
-				glBindTexture(GL_TEXTURE_2D, RenderInfo->TextureID);
+	// Finds the panels whose commands changed since their geometry was built
+	uint64 Hashes[UI_MAX_PANELS];
+	uint32 Counts[UI_MAX_PANELS][3];
+	size_t RebuildSize = 0;
+	for (int p = 0; p < PanelCount; ++p)
+	{
+		// we should have only one big allocated block for each panel, if we have more we are above UI_STACK_SIZE/UI_MAX_PANELS limit
+		Assert(BufSize(RenderCmdArena[p].Blocks) == 1);
 
-				glDrawElements(GL_TRIANGLES, RenderInfo->IndexCount, GL_UNSIGNED_SHORT, 0);
+		// The geometry of culled panels is kept as it was, for when they show again
+		if (PanelCulled[p])
+			continue;
+
+		Hashes[p] = HashPanel(p, &Counts[p][0], &Counts[p][1], &Counts[p][2]);
+		if (Hashes[p] != PanelGeometry[p].Hash)
+		{
+			// Bytes of the geometry, and its worst case alignment padding in the stream
+			RebuildSize += AlignGeometry(AlignGeometry(Counts[p][0] * sizeof(ui_vertex)) + Counts[p][1] * sizeof(uint32)) +
+				Counts[p][2] * sizeof(glyph_instance) + 16;
+		}
+	}
+
+	// Only the changed panels are converted and uploaded
+	uint32 RebuiltPanelCount = 0;
+	streambuf::Reserve(&FrameStream, RebuildSize);
+	for (int p = 0; p < PanelCount; ++p)
+	{
+		if (!PanelCulled[p] && Hashes[p] != PanelGeometry[p].Hash)
+		{
+			BuildPanel(p, Hashes[p], Counts[p][0], Counts[p][1], Counts[p][2]);
+			++RebuiltPanelCount;
+		}
+	}
+
+	// One draw per batch, each panel clipped to its rect
+	uint32 CommandCount = 0, DrawCallCount = 0;
+	uint32 CurrProgram = 0, CurrVAO = 0;
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_SCISSOR_TEST);
+	for (int p = 0; p < PanelCount; ++p)
+	{
+		int16 const PanelIdx = RenderOrder[p];
+		panel_geometry const *Geometry = &PanelGeometry[PanelIdx];
+		if (PanelCulled[PanelIdx] || !Geometry->BatchCount)
+			continue;
+
+		// The root widgets (panel 0) are only clipped by the window
+		if (PanelIdx)
+		{
+			render_info const *PanelRI = GetParentRenderInfo(PanelIdx);
+			glScissor(PanelRI->Position.x, Context->WindowHeight - PanelRI->Position.y - PanelRI->Size.y,
+				PanelRI->Size.x, PanelRI->Size.y);
+		}
+		else
+		{
+			glScissor(0, 0, Context->WindowWidth, Context->WindowHeight);
+		}
+
+		PointStreams(Geometry->Buffer, 0, Geometry->InstanceOffset);
+		CurrVAO = GlyphVAO;
+		CommandCount += Geometry->CommandCount;
+		DrawCallCount += Geometry->BatchCount;
+
+		for (uint32 b = 0; b < Geometry->BatchCount; ++b)
+		{
+			ui_batch const &Batch = Geometry->Batches[b];
+			if (CurrProgram != Batch.Program)
+			{
+				CurrProgram = Batch.Program;
+				glUseProgram(CurrProgram);
+			}
+
+			uint32 const BatchVAO = Batch.GlyphRectsID ? GlyphVAO : VAO;
+			if (CurrVAO != BatchVAO)
+			{
+				CurrVAO = BatchVAO;
+				glBindVertexArray(CurrVAO);
 			}
 
-			Cmd += Offset;
+			glBindTexture(GL_TEXTURE_2D, Batch.TextureID);
+			if (Batch.GlyphRectsID)
+			{
+				glActiveTexture(GL_TEXTURE1);
+				glBindTexture(GL_TEXTURE_BUFFER, Batch.GlyphRectsID);
+				glActiveTexture(GL_TEXTURE0);
+				if (BaseInstance)
+				{
+					glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, Batch.Count, Batch.First);
+				}
+				else
+				{
+					// Without ARB_base_instance the first instance is baked in the attribute pointers
+					PointGlyphs(Geometry->Buffer, Geometry->InstanceOffset + Batch.First * sizeof(glyph_instance));
+					glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, Batch.Count);
+				}
+			}
+			else
+			{
+				glDrawElements(GL_TRIANGLES, Batch.Count, GL_UNSIGNED_INT,
+					(GLvoid*)(Geometry->IndexOffset + Batch.First * sizeof(uint32)));
+			}
 		}
 	}
+	glDisable(GL_SCISSOR_TEST);
 	glEnable(GL_DEPTH_TEST);
 	glBindVertexArray(0);
+	streambuf::EndFrame(&FrameStream);
+
+	LastCommandCount = CommandCount;
+	LastDrawCallCount = DrawCallCount;
+	LastRebuiltPanelCount = RebuiltPanelCount;
 }
 }
 }
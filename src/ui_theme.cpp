@@ -1,6 +1,8 @@
 #include "ui_theme.h"
 #include "context.h"
 #include "utils.h"
+#include "watch.h"
+#include "trace.h"
 
 // by default, RF is shiped with 
 // - Font Awesome - http://fortawesome.github.com/Font-Awesome
@@ -11,6 +13,7 @@ namespace rf {
 namespace ui {
 
 ui_theme Theme;
+font_atlas ThemeAtlas;
 ui_theme DefaultTheme = {
 	{ 1, 0, 0, 1 },				// Red
 	{ 0, 1, 0, 1 },				// Green
@@ -90,12 +93,20 @@ int32 GetFontLineGap(theme_font Font)
 static font *ParseConfigFont(cJSON *root, context *Context, char const *Name, int c0, int cn)
 {
 	cJSON *FontInfo = cJSON_GetObjectItem(root, Name);
-	if (FontInfo && cJSON_GetArraySize(FontInfo) == 2)
+	int const ArraySize = FontInfo ? cJSON_GetArraySize(FontInfo) : 0;
+	if (ArraySize == 2 || ArraySize == 3)
 	{
 		path FontPath;
 		strncpy(FontPath, cJSON_GetArrayItem(FontInfo, 0)->valuestring, MAX_PATH);
 		int FontSize = cJSON_GetArrayItem(FontInfo, 1)->valueint;
-		return ResourceLoadFont(Context, FontPath, FontSize, c0, cn);
+		// Optional 3rd element : "dynamic" for glyphs rasterized on use, any codepoint being displayable,
+		// "sdf" for distance field glyphs, sharp at any scale
+		cJSON *Mode = ArraySize == 3 ? cJSON_GetArrayItem(FontInfo, 2) : NULL;
+		if (Mode && Mode->type == cJSON_String && !strcmp(Mode->valuestring, "dynamic"))
+			return ResourceLoadDynamicFont(Context, FontPath, FontSize);
+		if (Mode && Mode->type == cJSON_String && !strcmp(Mode->valuestring, "sdf"))
+			return ResourceLoadSDFFont(Context, FontPath, FontSize, c0, cn);
+		return ResourceLoadFont(Context, FontPath, FontSize, c0, cn, &ThemeAtlas);
 	}
 	else
 	{
@@ -131,8 +142,48 @@ static void ParseUIConfigRoot(ui_theme *DstTheme, cJSON *root, context *Context)
 	DstTheme->AwesomeFont = ParseConfigFont(root, Context, "AwesomeFont", ICON_MIN_FA, 1 + ICON_MAX_FA);
 }
 
+static void ReleaseThemeFonts(context *Context, ui_theme *SrcTheme)
+{
+	ResourceRelease(&Context->RenderResources, SrcTheme->DefaultFont);
+	ResourceRelease(&Context->RenderResources, SrcTheme->ConsoleFont);
+	ResourceRelease(&Context->RenderResources, SrcTheme->AwesomeFont);
+}
+
+// NOTE - Unlike the first load, a broken config keeps the current theme instead of falling back to the default one
+static void ReloadUIConfig(context *Context, char const *ConfigPath, void *)
+{
+	void *Content = ReadFileContents(Context, ConfigPath, 0);
+	if (!Content)
+		return;
+
+	cJSON *root = cJSON_Parse((char*)Content);
+	if (!root)
+	{
+		LogError("Error parsing UI Config File (%s) as JSON. Keeping the current Theme.\n", ConfigPath);
+		return;
+	}
+
+	ui_theme NewTheme = Theme;
+	ParseUIConfigRoot(&NewTheme, root, Context);
+	if (NewTheme.DefaultFont && NewTheme.ConsoleFont && NewTheme.AwesomeFont)
+	{
+		ReleaseThemeFonts(Context, &Theme);
+		Theme = NewTheme;
+	}
+	else
+	{
+		ReleaseThemeFonts(Context, &NewTheme);
+	}
+}
+
 void ParseUIConfig(context *Context, path const ConfigPath)
 {
+	TRACE_SCOPE("init", "ParseUIConfig", ConfigPath);
+	watch::AddFile(ConfigPath, ReloadUIConfig, nullptr);
+
+	// The theme fonts reloaded later are packed in it too, the atlas growing as needed
+	FontAtlasInit(Context, &ThemeAtlas);
+
 	// Start with default theme, overwriting if config exists
 	Theme = DefaultTheme;
 
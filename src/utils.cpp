@@ -1,6 +1,16 @@
 #include <ctime>
 #include "utils.h"
 #include "context.h"
+#include "vfs.h"
+#include "simd.h"
+
+#ifdef RF_WIN32
+#define FileSeek64 _fseeki64
+#define FileTell64 _ftelli64
+#else
+#define FileSeek64 fseeko
+#define FileTell64 ftello
+#endif
 
 namespace rf {
 
@@ -16,6 +26,11 @@ void _MemPoolAddFreeChunk(mem_pool *Pool, mem_chunk &chunk)
 		}
 	}
 
+	if (chunkIdx >= MEM_POOL_CHUNK_LIST_SIZE)
+	{ // the list is full of larger chunks, this one is dropped like the smaller ones pushed out below
+		return;
+	}
+
 	int moveIdx = Pool->NumMemChunks;
 
 	if (moveIdx < MEM_POOL_CHUNK_LIST_SIZE)
@@ -146,6 +161,12 @@ void _MemPoolFree(mem_pool *Pool, void *Ptr)
 			_MemPoolRemoveFreeChunk(Pool, prevChunkFreeIdx);
 			newChunk.Loc = prevChunk.Loc;
 			newChunk.Size += prevChunk.Size;
+
+			// the chunks after the removed one moved down the list
+			if (nextChunkFreeIdx > prevChunkFreeIdx)
+			{
+				nextChunkFreeIdx--;
+			}
 		}
 		if (nextChunkFreeIdx >= 0)
 		{
@@ -179,17 +200,19 @@ void *_MemPoolRealloc(mem_pool *Pool, void *Ptr, uint64 Size)
 		mem_chunk contiguousChunk = Pool->MemChunks[chunkIdx];
 		uint64 totalSize = ptrAddr->Size + contiguousChunk.Size;
 		uint64 slotLoc = AlignUp(AlignUp(ptrAddr->Loc, MEM_POOL_ALIGNMENT) + 1, MEM_POOL_ALIGNMENT);
-		uint64 hdrSize = slotLoc - ptrAddr->Loc;
-		uint64 allocSize = Size + hdrSize;
-		uint64 slotEnd = slotLoc + Size;
+		// keep the end aligned, _MemPoolAlloc expects free chunks to start on MEM_POOL_ALIGNMENT
+		uint64 slotEnd = AlignUp(slotLoc + Size, MEM_POOL_ALIGNMENT);
+		uint64 allocSize = slotEnd - ptrAddr->Loc;
 		if (totalSize >= allocSize)
 		{ // grouped chunks are large enough to fit the realloc, use that
 			_MemPoolRemoveFreeChunk(Pool, chunkIdx);
 
 			// add the unneeded part back to the available list
-			mem_chunk cutChunk{ slotEnd, totalSize - allocSize };
-
-			_MemPoolAddFreeChunk(Pool, cutChunk);
+			if (totalSize > allocSize)
+			{
+				mem_chunk cutChunk{ slotEnd, totalSize - allocSize };
+				_MemPoolAddFreeChunk(Pool, cutChunk);
+			}
 
 			ptrAddr->Size = allocSize;
 			return Ptr;
@@ -200,7 +223,9 @@ void *_MemPoolRealloc(mem_pool *Pool, void *Ptr, uint64 Size)
 	void *retPtr = _MemPoolAlloc(Pool, Size);
 	if (retPtr)
 	{
-		memcpy(retPtr, Ptr, ptrAddr->Size);
+		// ptrAddr->Size includes the header part in front of Ptr, only copy the old slot
+		uint64 oldSize = mem_chunk__end((mem_chunk*)ptrAddr) - (uint64)((uint8*)Ptr - Pool->Buffer);
+		memcpy(retPtr, Ptr, Min(oldSize, Size));
 		_MemPoolFree(Pool, Ptr);
 		return retPtr;
 	}
@@ -572,6 +597,17 @@ void *MapStoreGet(map_store *MStore, const char *Key)
 	return (Value == (uint64)-1) ? nullptr : (void*)Value;
 }
 
+void MapStoreRemove(map_store *MStore, const char *Key)
+{
+	Assert(MStore && Key);
+	uint64 hashIdx = (uint64)-1;
+	uint64 Value = MapGetFromBytes(&MStore->HMap, Key, (const char*)MStore->KeyStorage, &hashIdx);
+	if (Value != (uint64)-1)
+	{ // a null value reads as absent in MapStoreGet
+		MStore->HMap.Values[hashIdx] = 0;
+	}
+}
+
 const char  *MapStoreGetKey(map_store *MStore, uint64 KeyIdx)
 {
 	Assert(MStore && KeyIdx < MStore->HMap.Capacity);
@@ -609,9 +645,14 @@ void *ReadFileContentsNoContext(path const Filename, int32 *FileSize)
 
     if(fp)
     {
-        if(0 == fseek(fp, 0, SEEK_END))
+        int64 FileLen = (0 == FileSeek64(fp, 0, SEEK_END)) ? (int64)FileTell64(fp) : -1;
+        if(FileLen >= 0x7FFFFFFF)
         {
-            int32 Size = ftell(fp);
+            printf("File Open Error [%s] : too large, use a file_view or file_stream.\n", Filename);
+        }
+        else if(FileLen >= 0)
+        {
+            int32 Size = (int32)FileLen;
             rewind(fp);
             Contents = (char*)calloc(1, Size+1);
             size_t Read = fread(Contents, Size, 1, fp);
@@ -641,14 +682,31 @@ void *ReadFileContentsNoContext(path const Filename, int32 *FileSize)
 
 void *ReadFileContents(context *Context, path const Filename, int32 *FileSize)
 {
+    // Mounted packs first, without copy for raw entries
+    uint64 PackedFileSize;
+    void *PackedContents = vfs::ReadFile(Context, Filename, &PackedFileSize);
+    if(PackedContents)
+    {
+        if(FileSize)
+        {
+            *FileSize = (int32)PackedFileSize + 1;
+        }
+        return PackedContents;
+    }
+
     char *Contents = NULL;
     FILE *fp = fopen(Filename, "rb");
 
     if(fp)
     {
-        if(0 == fseek(fp, 0, SEEK_END))
+        int64 FileLen = (0 == FileSeek64(fp, 0, SEEK_END)) ? (int64)FileTell64(fp) : -1;
+        if(FileLen >= 0x7FFFFFFF)
         {
-            int32 Size = ftell(fp);
+            LogError("File Open Error [%s] : too large, use a file_view or file_stream.", Filename);
+        }
+        else if(FileLen >= 0)
+        {
+            int32 Size = (int32)FileLen;
             rewind(fp);
 			Contents = PoolAlloc<char>(Context->ScratchPool, Size + 1);
             size_t Read = fread(Contents, Size, 1, fp);
@@ -777,12 +835,132 @@ uint16 UTF8CharToInt(char const *Str, size_t *CharAdvance)
     return Unicode;
 }
 
+uint32 UTF8Decode(char const *Str, uint32 Length, uint32 *Codepoints, bool *Valid)
+{
+    uint8 const *Bytes = (uint8 const*)Str;
+    uint32 i = 0, Count = 0;
+    bool AllValid = true;
+    while (i < Length)
+    {
+#ifdef RF_SSE2
+        // ASCII fast path : 16 bytes without their high bit set, zero-extended to 16 codepoints
+        __m128i const Zero = _mm_setzero_si128();
+        while (i + 16 <= Length)
+        {
+            __m128i Chars = _mm_loadu_si128((__m128i const*)(Bytes + i));
+            if (_mm_movemask_epi8(Chars))
+                break;
+
+            __m128i Lo = _mm_unpacklo_epi8(Chars, Zero), Hi = _mm_unpackhi_epi8(Chars, Zero);
+            __m128i *Dst = (__m128i*)(Codepoints + Count);
+            _mm_storeu_si128(Dst + 0, _mm_unpacklo_epi16(Lo, Zero));
+            _mm_storeu_si128(Dst + 1, _mm_unpackhi_epi16(Lo, Zero));
+            _mm_storeu_si128(Dst + 2, _mm_unpacklo_epi16(Hi, Zero));
+            _mm_storeu_si128(Dst + 3, _mm_unpackhi_epi16(Hi, Zero));
+            i += 16;
+            Count += 16;
+        }
+        if (i == Length)
+            break;
+#endif
+
+        uint32 Lead = Bytes[i];
+        if (Lead < 0x80)
+        {
+            Codepoints[Count++] = Lead;
+            ++i;
+            continue;
+        }
+
+        uint32 Trailing = 0, Codepoint = 0, MinCodepoint = 0;
+        if ((Lead & 0xE0) == 0xC0)      { Trailing = 1; Codepoint = Lead & 0x1F; MinCodepoint = 0x80; }
+        else if ((Lead & 0xF0) == 0xE0) { Trailing = 2; Codepoint = Lead & 0x0F; MinCodepoint = 0x800; }
+        else if ((Lead & 0xF8) == 0xF0) { Trailing = 3; Codepoint = Lead & 0x07; MinCodepoint = 0x10000; }
+
+        uint32 j = 1;
+        for (; j <= Trailing && i + j < Length && (Bytes[i + j] & 0xC0) == 0x80; ++j)
+        {
+            Codepoint = (Codepoint << 6) | (Bytes[i + j] & 0x3F);
+        }
+
+        // NOTE - An invalid sequence is skipped up to its first unexpected byte, that starts the next sequence
+        if (!Trailing || j <= Trailing || Codepoint < MinCodepoint || Codepoint > 0x10FFFF ||
+            (Codepoint >= 0xD800 && Codepoint <= 0xDFFF))
+        {
+            Codepoint = UTF8_REPLACEMENT_CHAR;
+            AllValid = false;
+        }
+        Codepoints[Count++] = Codepoint;
+        i += j;
+    }
+
+    if (Valid)
+    {
+        *Valid = AllValid;
+    }
+    return Count;
+}
+
 char *GetFirstNonWhitespace( char *Src )
 {
 	while ( Src && *Src && *Src == ' ' ) Src++;
 	return Src;
 }
 
+bool FileStreamOpen(file_stream *Stream, path const Filename)
+{
+	Stream->Size = Stream->Offset = 0;
+	Stream->File = fopen(Filename, "rb");
+	if (!Stream->File)
+	{
+		LogError("File Open Error [%s] : Couldn't open file.", Filename);
+		return false;
+	}
+
+	// NOTE - No stdio buffering, the reads go straight to the caller's buffers
+	setvbuf(Stream->File, NULL, _IONBF, 0);
+
+	int64 FileLen = (0 == FileSeek64(Stream->File, 0, SEEK_END)) ? (int64)FileTell64(Stream->File) : -1;
+	if (FileLen < 0 || FileSeek64(Stream->File, 0, SEEK_SET))
+	{
+		LogError("File Open Error [%s] : Couldn't get the file size.", Filename);
+		FileStreamClose(Stream);
+		return false;
+	}
+
+	Stream->Size = (uint64)FileLen;
+	return true;
+}
+
+uint64 FileStreamRead(file_stream *Stream, void *Buffer, uint64 BufferSize)
+{
+	if (!Stream->File)
+		return 0;
+
+	uint64 ToRead = Min(BufferSize, Stream->Size - Stream->Offset);
+	uint64 Read = (uint64)fread(Buffer, 1, (size_t)ToRead, Stream->File);
+	Stream->Offset += Read;
+	return Read;
+}
+
+bool FileStreamSeek(file_stream *Stream, uint64 Offset)
+{
+	if (!Stream->File || Offset > Stream->Size || FileSeek64(Stream->File, (int64)Offset, SEEK_SET))
+		return false;
+
+	Stream->Offset = Offset;
+	return true;
+}
+
+void FileStreamClose(file_stream *Stream)
+{
+	if (Stream->File)
+	{
+		fclose(Stream->File);
+		Stream->File = NULL;
+	}
+}
+
 struct cpu_info
 {
 	int CPUCount;
@@ -833,6 +1011,11 @@ void DiskFileCopy(path const DstPath, path const SrcPath)
     CopyFileA(SrcPath, DstPath, FALSE);
 }
 
+bool DiskCreateDirectory(path const Dirname)
+{
+    return CreateDirectoryA(Dirname, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
 void PlatformSleep(uint32 MillisecondsToSleep)
 {
     Sleep(MillisecondsToSleep);
@@ -1019,6 +1202,47 @@ void SetClipboardContent( char *Content )
 	}
 }
 
+bool FileMapView(file_view *View, path const Filename, file_access_hint Hint)
+{
+	View->Data = NULL;
+	View->Size = 0;
+
+	HANDLE File = CreateFileA(Filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (File == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Empty files can't be mapped : their view is empty
+	LARGE_INTEGER FileSize;
+	bool Mapped = GetFileSizeEx(File, &FileSize) && FileSize.QuadPart == 0;
+	if (!Mapped && FileSize.QuadPart > 0)
+	{
+		HANDLE Mapping = CreateFileMappingA(File, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+		if (Mapping)
+		{
+			View->Data = (uint8*)MapViewOfFile(Mapping, FILE_MAP_COPY, 0, 0, 0);
+			if (View->Data)
+			{
+				View->Size = (uint64)FileSize.QuadPart;
+				Mapped = true;
+			}
+			CloseHandle(Mapping); // the view stays valid
+		}
+	}
+
+	CloseHandle(File);
+	return Mapped;
+}
+
+void FileUnmapView(file_view *View)
+{
+	if (View->Data)
+	{
+		UnmapViewOfFile(View->Data);
+	}
+	View->Data = NULL;
+	View->Size = 0;
+}
+
 #else
 #ifdef RF_UNIX
 #include <stdio.h>
@@ -1029,6 +1253,8 @@ void SetClipboardContent( char *Content )
 #include <unistd.h>
 #include <dlfcn.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <errno.h>
 
 // NOTE : expect a MAX_PATH string as Path
 void GetExecutablePath(path Path)
@@ -1085,6 +1311,51 @@ void DiskFileCopy(path const DstPath, path const SrcPath)
     CopyFile(SrcPath, DstPath);
 }
 
+bool DiskCreateDirectory(path const Dirname)
+{
+    return mkdir(Dirname, 0755) == 0 || errno == EEXIST;
+}
+
+bool FileMapView(file_view *View, path const Filename, file_access_hint Hint)
+{
+	View->Data = NULL;
+	View->Size = 0;
+
+	int Fd = open(Filename, O_RDONLY);
+	if (Fd < 0)
+		return false;
+
+	// Empty files can't be mapped : their view is empty
+	struct stat Info;
+	bool Mapped = !fstat(Fd, &Info) && Info.st_size == 0;
+	if (!Mapped && Info.st_size > 0)
+	{
+		void *Ptr = mmap(NULL, (size_t)Info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, Fd, 0);
+		if (Ptr != MAP_FAILED)
+		{
+			View->Data = (uint8*)Ptr;
+			View->Size = (uint64)Info.st_size;
+			Mapped = true;
+
+			static int const Advice[] = { MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED };
+			madvise(Ptr, (size_t)View->Size, Advice[Hint]);
+		}
+	}
+
+	close(Fd); // the mapping stays valid
+	return Mapped;
+}
+
+void FileUnmapView(file_view *View)
+{
+	if (View->Data)
+	{
+		munmap(View->Data, (size_t)View->Size);
+	}
+	View->Data = NULL;
+	View->Size = 0;
+}
+
 void PlatformSleep(uint32 MillisecondsToSleep)
 {
     struct timespec TS;
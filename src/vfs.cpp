@@ -0,0 +1,381 @@
+#include "vfs.h"
+#include "context.h"
+#include "utils.h"
+#include "lz4.h"
+
+namespace rf {
+namespace vfs {
+
+/*
+	Pack file layout (little endian) :
+	- vfs_pack_header
+	- TOC : vfs_pack_entry[EntryCount], sorted by NameHash (hash_bytes of the normalized name)
+	- Names : null-terminated entry names, referenced by NameOffset
+	- Data : each entry starts on a VFS_PACK_ALIGNMENT boundary. Raw entries are followed by a 0 byte so that
+	  text files can be used in place as C strings.
+*/
+#define VFS_PACK_MAGIC 0x4B504652 // 'RFPK'
+#define VFS_PACK_VERSION 1
+#define VFS_PACK_ALIGNMENT 16
+
+#define VFS_ENTRY_LZ4 0x1
+
+struct vfs_pack_header
+{
+	uint32 Magic;
+	uint32 Version;
+	uint32 EntryCount;
+	uint32 NamesSize;
+	uint64 TOCOffset;
+	uint64 NamesOffset;
+};
+
+struct vfs_pack_entry
+{
+	uint64 NameHash;
+	uint64 Offset;
+	uint64 Size;		// uncompressed size
+	uint64 PackedSize;	// size in the pack, equal to Size for raw entries
+	uint32 NameOffset;
+	uint32 Flags;
+};
+
+struct vfs_pack
+{
+	path					Filename;
+	file_view				View;
+	vfs_pack_header const	*Header;
+	vfs_pack_entry const	*TOC;
+	char const				*Names;
+};
+
+static vfs_pack *Packs = nullptr;
+static path ExePath = "";
+
+// Entry names are relative, with '/' separators and without leading "./"
+static void NormalizeName(path Dst, char const *Src)
+{
+	if (!ExePath[0])
+	{
+		GetExecutablePath(ExePath);
+	}
+
+	size_t ExeLen = strlen(ExePath);
+	if (ExeLen && !strncmp(Src, ExePath, ExeLen))
+	{
+		Src += ExeLen;
+	}
+
+	while (Src[0] == '.' && (Src[1] == '/' || Src[1] == '\\'))
+	{
+		Src += 2;
+	}
+
+	int i = 0;
+	for (; Src[i] && i < MAX_PATH - 1; ++i)
+	{
+		Dst[i] = (Src[i] == '\\') ? '/' : Src[i];
+	}
+	Dst[i] = 0;
+}
+
+static uint64 NameHash(char const *Name)
+{
+	return hash_bytes(Name, strlen(Name));
+}
+
+// Points the header, TOC and names of the pack in its view, each once checked to be in it
+static bool ValidatePack(vfs_pack *Pack)
+{
+	if (Pack->View.Size < sizeof(vfs_pack_header))
+		return false;
+
+	vfs_pack_header const *Header = Pack->Header = (vfs_pack_header const*)Pack->View.Data;
+	if (Header->Magic != VFS_PACK_MAGIC || Header->Version != VFS_PACK_VERSION)
+		return false;
+
+	if (Header->TOCOffset > Pack->View.Size || (Pack->View.Size - Header->TOCOffset) / sizeof(vfs_pack_entry) < Header->EntryCount)
+		return false;
+	Pack->TOC = (vfs_pack_entry const*)(Pack->View.Data + Header->TOCOffset);
+
+	if (!Header->NamesSize || Header->NamesOffset > Pack->View.Size || Pack->View.Size - Header->NamesOffset < Header->NamesSize)
+		return false;
+	Pack->Names = (char const*)(Pack->View.Data + Header->NamesOffset);
+	if (Pack->Names[Header->NamesSize - 1] != 0)
+		return false;
+
+	for (uint32 i = 0; i < Header->EntryCount; ++i)
+	{
+		vfs_pack_entry const &Entry = Pack->TOC[i];
+		uint64 Extent = Entry.PackedSize + ((Entry.Flags & VFS_ENTRY_LZ4) ? 0 : 1);
+		if (Entry.NameOffset >= Header->NamesSize || Entry.Offset > Pack->View.Size || Pack->View.Size - Entry.Offset < Extent)
+			return false;
+		if ((Entry.Flags & VFS_ENTRY_LZ4) && (Entry.Size >= 0x7FFFFFFF || Entry.PackedSize >= 0x7FFFFFFF))
+			return false;
+		if (!(Entry.Flags & VFS_ENTRY_LZ4) && Entry.Size != Entry.PackedSize)
+			return false;
+	}
+
+	return true;
+}
+
+bool Mount(context *Context, path const PackFilename)
+{
+	vfs_pack Pack = {};
+	if (!FileMapView(&Pack.View, PackFilename, FILE_ACCESS_RANDOM))
+	{
+		LogError("Couldn't map pack file %s.", PackFilename);
+		return false;
+	}
+
+	if (!ValidatePack(&Pack))
+	{
+		LogError("Pack file %s is invalid or corrupted.", PackFilename);
+		FileUnmapView(&Pack.View);
+		return false;
+	}
+
+	strncpy(Pack.Filename, PackFilename, MAX_PATH - 1);
+	Pack.Filename[MAX_PATH - 1] = 0;
+	if (!Packs)
+	{
+		Packs = Buf<vfs_pack>(Context->SessionPool, 4);
+	}
+	BufPush(Packs, Pack);
+
+	LogInfo("Mounted pack %s (%u files, %llu KB).", PackFilename, Pack.Header->EntryCount, Pack.View.Size / KB);
+	return true;
+}
+
+void Destroy()
+{
+	for (vfs_pack *It = Packs; It != BufEnd(Packs); ++It)
+	{
+		FileUnmapView(&It->View);
+	}
+	BufFree(Packs);
+}
+
+static vfs_pack_entry const *FindEntry(vfs_pack const *Pack, char const *Name, uint64 Hash)
+{
+	// lower bound on the hash, then compare the names of the entries sharing it
+	uint32 Lo = 0, Hi = Pack->Header->EntryCount;
+	while (Lo < Hi)
+	{
+		uint32 Mid = Lo + (Hi - Lo) / 2;
+		if (Pack->TOC[Mid].NameHash < Hash)
+			Lo = Mid + 1;
+		else
+			Hi = Mid;
+	}
+
+	for (; Lo < Pack->Header->EntryCount && Pack->TOC[Lo].NameHash == Hash; ++Lo)
+	{
+		if (!strcmp(Pack->Names + Pack->TOC[Lo].NameOffset, Name))
+			return &Pack->TOC[Lo];
+	}
+
+	return NULL;
+}
+
+static vfs_pack_entry const *Find(char const *Filename, vfs_pack **FoundPack)
+{
+	if (!BufSize(Packs))
+		return NULL;
+
+	path Name;
+	NormalizeName(Name, Filename);
+	uint64 Hash = NameHash(Name);
+
+	for (uint64 i = BufSize(Packs); i > 0; --i)
+	{
+		vfs_pack_entry const *Entry = FindEntry(&Packs[i - 1], Name, Hash);
+		if (Entry)
+		{
+			*FoundPack = &Packs[i - 1];
+			return Entry;
+		}
+	}
+
+	return NULL;
+}
+
+bool Exists(char const *Filename)
+{
+	vfs_pack *Pack;
+	return Find(Filename, &Pack) != NULL;
+}
+
+void *ReadFile(context *Context, char const *Filename, uint64 *FileSize)
+{
+	vfs_pack *Pack;
+	vfs_pack_entry const *Entry = Find(Filename, &Pack);
+	if (!Entry)
+		return NULL;
+
+	uint8 *Data = Pack->View.Data + Entry->Offset;
+	if (Entry->Flags & VFS_ENTRY_LZ4)
+	{
+		uint8 *Contents = PoolAlloc<uint8>(Context->ScratchPool, Entry->Size + 1);
+		int32 Decoded = lz4::Decompress(Data, (int32)Entry->PackedSize, Contents, (int32)Entry->Size);
+		if (Decoded != (int32)Entry->Size)
+		{
+			LogError("Corrupted entry %s in pack %s.", Filename, Pack->Filename);
+			return NULL;
+		}
+		Contents[Entry->Size] = 0;
+		Data = Contents;
+	}
+
+	if (FileSize)
+	{
+		*FileSize = Entry->Size;
+	}
+	return Data;
+}
+
+bool WritePack(path const PackFilename, char const * const *Filenames, uint32 FileCount, bool Compress)
+{
+	vfs_pack_entry *Entries = (vfs_pack_entry*)calloc(FileCount, sizeof(vfs_pack_entry));
+	file_view *Views = (file_view*)calloc(FileCount, sizeof(file_view));
+	uint8 **Datas = (uint8**)calloc(FileCount, sizeof(uint8*)); // points in Views[i] or to the compressed data
+	char *Names = (char*)calloc(FileCount, MAX_PATH);
+	uint32 NamesSize = 0;
+	bool Success = true;
+
+	uint32 *Order = (uint32*)malloc(FileCount * sizeof(uint32));
+	for (uint32 i = 0; i < FileCount; ++i)
+	{
+		path Name;
+		NormalizeName(Name, Filenames[i]);
+		Entries[i].NameHash = NameHash(Name);
+		Entries[i].NameOffset = NamesSize;
+		strcpy(Names + NamesSize, Name);
+		NamesSize += (uint32)strlen(Name) + 1;
+		Order[i] = i;
+	}
+
+	// Entries are found by name : 2 files with the same normalized name would make one of them unreachable
+	std::sort(Order, Order + FileCount, [Entries](uint32 A, uint32 B) { return Entries[A].NameHash < Entries[B].NameHash; });
+	for (uint32 i = 1; i < FileCount && Success; ++i)
+	{
+		for (uint32 j = i; j > 0 && Entries[Order[j - 1]].NameHash == Entries[Order[i]].NameHash; --j)
+		{
+			if (!strcmp(Names + Entries[Order[j - 1]].NameOffset, Names + Entries[Order[i]].NameOffset))
+			{
+				LogError("Can't pack %s and %s : they have the same name in the pack.", Filenames[Order[j - 1]],
+					Filenames[Order[i]]);
+				Success = false;
+				break;
+			}
+		}
+	}
+
+	for (uint32 i = 0; i < FileCount && Success; ++i)
+	{
+		// Inputs are mapped instead of read, they can be larger than what ReadFileContents handles
+		if (!FileMapView(&Views[i], Filenames[i], FILE_ACCESS_SEQUENTIAL))
+		{
+			LogError("Couldn't read %s to pack it.", Filenames[i]);
+			Success = false;
+			break;
+		}
+
+		uint8 *Contents = Views[i].Data;
+		uint64 FileSize = Views[i].Size;
+		Entries[i].Size = Entries[i].PackedSize = FileSize;
+		Datas[i] = Contents;
+
+		// LZ4 blocks are limited to 2GB, larger entries are stored raw, as are empty ones
+		if (Compress && FileSize && FileSize < 0x7FFFFFFF)
+		{
+			int32 Bound = lz4::CompressBound((int32)FileSize);
+			uint8 *Packed = (uint8*)malloc(Bound);
+			int32 PackedSize = lz4::Compress(Contents, (int32)FileSize, Packed, Bound);
+			if (PackedSize > 0 && (uint64)PackedSize < FileSize)
+			{
+				FileUnmapView(&Views[i]);
+				Datas[i] = Packed;
+				Entries[i].PackedSize = PackedSize;
+				Entries[i].Flags |= VFS_ENTRY_LZ4;
+			}
+			else
+			{
+				free(Packed);
+			}
+		}
+	}
+
+	FILE *fp = Success ? fopen(PackFilename, "wb") : NULL;
+	if (fp)
+	{
+		vfs_pack_header Header = {};
+		Header.Magic = VFS_PACK_MAGIC;
+		Header.Version = VFS_PACK_VERSION;
+		Header.EntryCount = FileCount;
+		Header.NamesSize = NamesSize;
+		Header.TOCOffset = sizeof(vfs_pack_header);
+		Header.NamesOffset = Header.TOCOffset + FileCount * sizeof(vfs_pack_entry);
+
+		uint64 Offset = AlignUp(Header.NamesOffset + NamesSize, VFS_PACK_ALIGNMENT);
+		for (uint32 i = 0; i < FileCount; ++i)
+		{
+			vfs_pack_entry &Entry = Entries[Order[i]];
+			Entry.Offset = Offset;
+			Offset = AlignUp(Offset + Entry.PackedSize + ((Entry.Flags & VFS_ENTRY_LZ4) ? 0 : 1), VFS_PACK_ALIGNMENT);
+		}
+
+		fwrite(&Header, sizeof(Header), 1, fp);
+		for (uint32 i = 0; i < FileCount; ++i)
+		{
+			fwrite(&Entries[Order[i]], sizeof(vfs_pack_entry), 1, fp);
+		}
+		fwrite(Names, 1, NamesSize, fp);
+
+		static uint8 const Zeros[VFS_PACK_ALIGNMENT] = {};
+		uint64 Written = Header.NamesOffset + NamesSize;
+		for (uint32 i = 0; i < FileCount; ++i)
+		{
+			vfs_pack_entry const &Entry = Entries[Order[i]];
+			fwrite(Zeros, 1, Entry.Offset - Written, fp);
+			if (Entry.PackedSize)
+				fwrite(Datas[Order[i]], 1, Entry.PackedSize, fp);
+			Written = Entry.Offset + Entry.PackedSize;
+			if (!(Entry.Flags & VFS_ENTRY_LZ4))
+			{
+				fwrite(Zeros, 1, 1, fp);
+				Written += 1;
+			}
+		}
+
+		Success = !ferror(fp);
+		fclose(fp);
+
+		if (Success)
+		{
+			LogInfo("Wrote pack %s (%u files, %llu KB).", PackFilename, FileCount, Written / KB);
+		}
+	}
+	else if (Success)
+	{
+		LogError("Couldn't open %s for writing.", PackFilename);
+		Success = false;
+	}
+
+	for (uint32 i = 0; i < FileCount; ++i)
+	{
+		if (Entries[i].Flags & VFS_ENTRY_LZ4)
+			free(Datas[i]);
+		else
+			FileUnmapView(&Views[i]);
+	}
+	free(Order);
+	free(Datas);
+	free(Views);
+	free(Names);
+	free(Entries);
+	return Success;
+}
+
+}
+}
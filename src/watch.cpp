@@ -0,0 +1,209 @@
+#include "watch.h"
+#include "context.h"
+#include "utils.h"
+
+#ifdef RF_UNIX
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+namespace rf {
+namespace watch {
+
+// inotify watches directories and not single files, so that files replaced by editors
+// doing a write-to-temp + rename are still caught
+struct watch_dir
+{
+	int32	WD;
+	path	Dir;
+};
+
+struct watch_entry
+{
+	int32				WD;
+	path				Filename;	// as registered
+	uint32				NameIdx;	// start of the basename in Filename
+	watch_reload_func	Func;
+	void				*UserData;
+	bool				Dirty;
+};
+
+static int32		Fd = -1;
+static watch_dir	*Dirs = nullptr;
+static watch_entry	*Entries = nullptr;
+
+bool IsActive()
+{
+	return Fd >= 0;
+}
+
+// Fills Dir with the directory part of Filename, returns the index of the basename in Filename
+static uint32 SplitPath(char const *Filename, path Dir)
+{
+	char const *LastSep = strrchr(Filename, '/');
+	if (!LastSep)
+	{
+		strncpy(Dir, ".", MAX_PATH);
+		return 0;
+	}
+
+	size_t DirLen = Min((size_t)(LastSep - Filename), (size_t)(MAX_PATH - 1));
+	if (DirLen == 0) DirLen = 1; // root '/'
+	memcpy(Dir, Filename, DirLen);
+	Dir[DirLen] = 0;
+	return (uint32)(LastSep + 1 - Filename);
+}
+
+void RemoveUserData(void *UserData)
+{
+	if (!IsActive())
+		return;
+
+	uint64 Dst = 0;
+	for (uint64 i = 0; i < BufSize(Entries); ++i)
+	{
+		if (Entries[i].UserData != UserData)
+		{
+			Entries[Dst++] = Entries[i];
+		}
+	}
+	mem_buf__hdr(Entries)->Size = Dst;
+}
+
+void Update(context *Context)
+{
+	if (!IsActive())
+		return;
+
+#ifdef RF_UNIX
+	char EventBuf[4 * KB] ALIGNED(__alignof__(struct inotify_event));
+	for (;;)
+	{
+		ssize_t Len = read(Fd, EventBuf, sizeof(EventBuf));
+		if (Len <= 0) // EAGAIN : no more pending events
+			break;
+
+		for (char *Ptr = EventBuf; Ptr < EventBuf + Len; )
+		{
+			struct inotify_event const *Event = (struct inotify_event const*)Ptr;
+			Ptr += sizeof(struct inotify_event) + Event->len;
+
+			if (!Event->len || !(Event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)))
+				continue;
+
+			for (watch_entry *It = Entries; It != BufEnd(Entries); ++It)
+			{
+				if (It->WD == Event->wd && !strcmp(It->Filename + It->NameIdx, Event->name))
+				{
+					It->Dirty = true;
+				}
+			}
+		}
+	}
+#endif
+
+	// NOTE - Index based, callbacks are allowed to register new files (and grow the buffer)
+	for (uint64 i = 0; i < BufSize(Entries); ++i)
+	{
+		if (Entries[i].Dirty)
+		{
+			Entries[i].Dirty = false;
+			LogInfo("Hot-reloading %s", Entries[i].Filename);
+			Entries[i].Func(Context, Entries[i].Filename, Entries[i].UserData);
+		}
+	}
+}
+
+#ifdef RF_UNIX
+bool Init(context *Context)
+{
+	if (IsActive())
+		return true;
+
+	Fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (Fd < 0)
+	{
+		LogError("Couldn't initialize inotify, hot-reload disabled (errno %d).", errno);
+		return false;
+	}
+
+	Dirs = Buf<watch_dir>(Context->SessionPool, 16);
+	Entries = Buf<watch_entry>(Context->SessionPool, 64);
+	LogInfo("Asset hot-reload enabled.");
+	return true;
+}
+
+void Destroy()
+{
+	if (IsActive())
+	{
+		close(Fd); // removes every inotify watch as well
+		Fd = -1;
+		BufFree(Dirs);
+		BufFree(Entries);
+	}
+}
+
+static int32 GetDirWatch(path const Dir)
+{
+	for (watch_dir *It = Dirs; It != BufEnd(Dirs); ++It)
+	{
+		if (!strcmp(It->Dir, Dir))
+			return It->WD;
+	}
+
+	int32 WD = inotify_add_watch(Fd, Dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (WD < 0)
+	{
+		LogError("Couldn't watch directory %s for hot-reload (errno %d).", Dir, errno);
+		return -1;
+	}
+
+	watch_dir NewDir;
+	NewDir.WD = WD;
+	strncpy(NewDir.Dir, Dir, MAX_PATH);
+	BufPush(Dirs, NewDir);
+	return WD;
+}
+
+void AddFile(char const *Filename, watch_reload_func Func, void *UserData)
+{
+	if (!IsActive() || !Filename || !Func)
+		return;
+
+	for (watch_entry *It = Entries; It != BufEnd(Entries); ++It)
+	{
+		if (It->Func == Func && It->UserData == UserData && !strcmp(It->Filename, Filename))
+			return;
+	}
+
+	watch_entry Entry = {};
+	path Dir;
+	Entry.NameIdx = SplitPath(Filename, Dir);
+	Entry.WD = GetDirWatch(Dir);
+	if (Entry.WD < 0)
+		return;
+
+	strncpy(Entry.Filename, Filename, MAX_PATH - 1);
+	Entry.Func = Func;
+	Entry.UserData = UserData;
+	BufPush(Entries, Entry);
+}
+#else
+bool Init(context *Context)
+{
+	LogInfo("Asset hot-reload is only implemented on Linux.");
+	return false;
+}
+
+void Destroy()
+{
+}
+
+void AddFile(char const *Filename, watch_reload_func Func, void *UserData)
+{
+}
+#endif
+}
+}